@@ -65,12 +65,14 @@ int main(int argc, char *argv[]) {
     action.sa_handler = sig_handler;
     sigaction(SIGTERM, &action, NULL);
     sigaction(SIGINT, &action, NULL);
+    db_rt_plan_t radiotap_plan;
+    db_rt_plan_init(&radiotap_plan);
     printf("DroneBridge example receiver: Waiting for data\n");
     while (keep_going) {
         uint16_t radiotap_length = 0;
         ssize_t received_bytes = recv(raw_interfaces[0].db_socket, buffer, BUFFER_SIZE, 0);
         uint16_t payload_length = get_db_payload(buffer, received_bytes, payload_buff, &seq_num, &radiotap_length);
-        int8_t rssi = get_rssi(buffer, radiotap_length);
+        int8_t rssi = get_rssi(buffer, radiotap_length, &radiotap_plan);
         printf("Received raw frame with %zi bytes & %i bytes of payload (%i dBm)\n", received_bytes,
                payload_length, rssi);
     }
@@ -0,0 +1,521 @@
+/*
+ *   This file is part of DroneBridge: https://github.com/seeul8er/DroneBridge
+ *
+ *   Copyright 2020 Wolfgang Christl
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <net/if.h>
+#include "db_emu.h"
+#include "db_common.h"
+#include "db_raw_receive.h"
+
+#define DB_EMU_MAX_FRAME        2048
+#define DB_EMU_MAX_PEERS        16
+#define DB_EMU_RESCAN_NS        200000000ULL    // peers (other adapters on the same medium) are looked up periodically
+#define DB_EMU_MAX_BACKLOG_NS   100000000ULL    // send blocks if the emulated air is busy for longer than that
+#define DB_EMU_SEND_TIMEOUT_US  100000          // max. time to wait for a receiver with a full socket queue
+#define DB_EMU_RT_LENGTH        12              // length of the radiotap header of the delivered frames
+#define DB_EMU_RT_FLAGS_BADFCS  0x40
+
+typedef struct {
+    struct sockaddr_un addr;
+    bool burst_loss;        // Gilbert-Elliott state of the link to this peer
+} emu_peer_t;
+
+typedef struct {
+    uint64_t release_ns;
+    uint64_t order;         // tie breaker. Frames with the same release time are delivered in the order they were sent
+    struct sockaddr_un dst;
+    uint16_t length;
+    uint8_t frame[DB_EMU_RT_LENGTH + DB_EMU_MAX_FRAME];
+} emu_delivery_t;
+
+typedef struct {
+    int socket_fd;
+    char medium[IFNAMSIZ];
+    char dir[sizeof(DB_EMU_DIR) + IFNAMSIZ];
+    struct sockaddr_un own_addr;
+    db_emu_config_t config;
+    double p_good_bad, p_bad_good;  // Gilbert-Elliott transition probabilities
+    uint32_t rand_state;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;            // queue changed or closing
+    pthread_t thread;
+    bool thread_running, closing;
+    emu_delivery_t *slots;
+    uint16_t heap[DB_EMU_QUEUE_LEN];    // min-heap of slot indexes ordered by release time
+    uint16_t free_slots[DB_EMU_QUEUE_LEN];
+    int heap_size, num_free;
+    uint64_t order;
+
+    emu_peer_t peers[DB_EMU_MAX_PEERS];
+    int num_peers;
+    uint64_t last_scan_ns;
+    uint64_t link_free_ns;          // time the emulated air becomes free for the next frame
+
+    uint32_t sent_cnt, lost_cnt, corrupted_cnt, reordered_cnt, dropped_cnt;
+} db_emu_t;
+
+static unsigned int emu_socket_cnt = 0;
+
+static inline uint64_t emu_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static inline uint32_t emu_rand(db_emu_t *emu) {
+    uint32_t x = emu->rand_state;   // xorshift32
+    x ^= x << 13u;
+    x ^= x >> 17u;
+    x ^= x << 5u;
+    return emu->rand_state = x;
+}
+
+/**
+ * @return Uniformly distributed random number [0..1)
+ */
+static inline double emu_uniform(db_emu_t *emu) {
+    return (emu_rand(emu) >> 8u) / 16777216.0;
+}
+
+bool db_emu_is_emu_if(const char *ifName) {
+    return strncmp(ifName, DB_EMU_IF_PREFIX, strlen(DB_EMU_IF_PREFIX)) == 0;
+}
+
+/**
+ * Parses an impairment configuration string. Unset values default to a perfect link.
+ *
+ * @param config_str Comma separated key=value list (see db_emu_config_t). May be NULL
+ * @param config Returns the parsed configuration
+ * @return 0 on success, -1 if the string contained unknown keys or invalid values (those are ignored)
+ */
+int db_emu_parse_config(const char *config_str, db_emu_config_t *config) {
+    memset(config, 0, sizeof(db_emu_config_t));
+    config->burst = 1;
+    config->rssi_dbm = -50;
+    if (config_str == NULL)
+        return 0;
+    int ret = 0;
+    char buf[256], *saveptr = NULL;
+    strncpy(buf, config_str, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+    for (char *tok = strtok_r(buf, ",", &saveptr); tok != NULL; tok = strtok_r(NULL, ",", &saveptr)) {
+        char *value = strchr(tok, '=');
+        if (value == NULL) {
+            ret = -1;
+            continue;
+        }
+        *value++ = '\0';
+        char *end;
+        double v = strtod(value, &end);
+        if (end == value || v < 0) {
+            LOG_SYS_STD(LOG_NOTICE, "DroneBridgeCommon: Invalid link emulator value %s=%s\n", tok, value);
+            ret = -1;
+            continue;
+        }
+        if (strcmp(tok, "loss") == 0) config->loss = v > 1 ? 1 : v;
+        else if (strcmp(tok, "burst") == 0) config->burst = v < 1 ? 1 : v;
+        else if (strcmp(tok, "ber") == 0) config->ber = v > 1 ? 1 : v;
+        else if (strcmp(tok, "reorder") == 0) config->reorder = v > 1 ? 1 : v;
+        else if (strcmp(tok, "reorder_us") == 0) config->reorder_us = (uint32_t) v;
+        else if (strcmp(tok, "delay") == 0) config->delay_us = (uint32_t) v;
+        else if (strcmp(tok, "jitter") == 0) config->jitter_us = (uint32_t) v;
+        else if (strcmp(tok, "rate") == 0) config->rate_kbps = (uint32_t) v;
+        else if (strcmp(tok, "rssi") == 0) config->rssi_dbm = (int8_t) -v;
+        else if (strcmp(tok, "seed") == 0) config->seed = (uint32_t) v;
+        else {
+            LOG_SYS_STD(LOG_NOTICE, "DroneBridgeCommon: Unknown link emulator option %s\n", tok);
+            ret = -1;
+        }
+    }
+    return ret;
+}
+
+static void heap_swap(db_emu_t *emu, int a, int b) {
+    uint16_t tmp = emu->heap[a];
+    emu->heap[a] = emu->heap[b];
+    emu->heap[b] = tmp;
+}
+
+static inline bool heap_less(db_emu_t *emu, int a, int b) {
+    emu_delivery_t *da = &emu->slots[emu->heap[a]], *db = &emu->slots[emu->heap[b]];
+    return da->release_ns < db->release_ns || (da->release_ns == db->release_ns && da->order < db->order);
+}
+
+static void heap_push(db_emu_t *emu, uint16_t slot) {
+    int i = emu->heap_size++;
+    emu->heap[i] = slot;
+    while (i > 0 && heap_less(emu, i, (i - 1) / 2)) {
+        heap_swap(emu, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static uint16_t heap_pop(db_emu_t *emu) {
+    uint16_t top = emu->heap[0];
+    emu->heap[0] = emu->heap[--emu->heap_size];
+    int i = 0;
+    while (true) {
+        int smallest = i, l = 2 * i + 1, r = 2 * i + 2;
+        if (l < emu->heap_size && heap_less(emu, l, smallest)) smallest = l;
+        if (r < emu->heap_size && heap_less(emu, r, smallest)) smallest = r;
+        if (smallest == i)
+            break;
+        heap_swap(emu, i, smallest);
+        i = smallest;
+    }
+    return top;
+}
+
+/**
+ * Looks up the other emulated adapters on the medium. Keeps the loss state of known peers. Called with lock held
+ */
+static void scan_peers(db_emu_t *emu) {
+    DIR *d = opendir(emu->dir);
+    if (d == NULL)
+        return;
+    emu_peer_t peers[DB_EMU_MAX_PEERS];
+    int num_peers = 0;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL && num_peers < DB_EMU_MAX_PEERS) {
+        if (entry->d_name[0] == '.')
+            continue;
+        emu_peer_t *peer = &peers[num_peers];
+        memset(peer, 0, sizeof(emu_peer_t));
+        peer->addr.sun_family = AF_UNIX;
+        if (snprintf(peer->addr.sun_path, sizeof(peer->addr.sun_path), "%s/%s", emu->dir, entry->d_name) >=
+            (int) sizeof(peer->addr.sun_path) || strcmp(peer->addr.sun_path, emu->own_addr.sun_path) == 0)
+            continue;
+        for (int i = 0; i < emu->num_peers; i++) {
+            if (strcmp(emu->peers[i].addr.sun_path, peer->addr.sun_path) == 0)
+                peer->burst_loss = emu->peers[i].burst_loss;
+        }
+        num_peers++;
+    }
+    closedir(d);
+    memcpy(emu->peers, peers, sizeof(emu_peer_t) * num_peers);
+    emu->num_peers = num_peers;
+    emu->last_scan_ns = emu_now_ns();
+}
+
+/**
+ * Removes a peer that no longer exists (process terminated). Called with lock held
+ */
+static void remove_peer(db_emu_t *emu, const struct sockaddr_un *addr) {
+    for (int i = 0; i < emu->num_peers; i++) {
+        if (strcmp(emu->peers[i].addr.sun_path, addr->sun_path) == 0) {
+            emu->peers[i] = emu->peers[--emu->num_peers];
+            return;
+        }
+    }
+}
+
+/**
+ * Gilbert-Elliott channel: Frames sent in the bad state are lost. The mean burst length is 1/p_bad_good and the state
+ * probabilities result in a mean loss of config.loss
+ *
+ * @return true if the frame gets lost on the way to the peer
+ */
+static bool frame_lost(db_emu_t *emu, emu_peer_t *peer) {
+    if (emu->config.loss <= 0)
+        return false;
+    if (peer->burst_loss)
+        peer->burst_loss = emu_uniform(emu) >= emu->p_bad_good;
+    else
+        peer->burst_loss = emu_uniform(emu) < emu->p_good_bad;
+    return peer->burst_loss;
+}
+
+/**
+ * Flips random bits of the frame according to the bit error rate. Distance between errors is geometric distributed
+ *
+ * @return true if at least one bit was flipped
+ */
+static bool corrupt_frame(db_emu_t *emu, uint8_t *data, int length) {
+    if (emu->config.ber <= 0)
+        return false;
+    bool corrupted = false;
+    double log_q = log1p(-emu->config.ber);
+    uint64_t num_bits = (uint64_t) length * 8;
+    uint64_t bit = 0;
+    while (true) {
+        double u = emu_uniform(emu);
+        bit += (log_q == 0) ? 0 : (uint64_t) (log(1.0 - u) / log_q);   // log_q == -inf with ber == 1
+        if (bit >= num_bits)
+            break;
+        data[bit / 8] ^= (uint8_t) (1u << (bit % 8));
+        corrupted = true;
+        bit++;
+    }
+    return corrupted;
+}
+
+static void *emu_delivery_thread(void *arg) {
+    db_emu_t *emu = arg;
+    emu_delivery_t *d = malloc(sizeof(emu_delivery_t));
+    pthread_mutex_lock(&emu->lock);
+    while (!emu->closing || emu->heap_size > 0) {
+        if (emu->heap_size == 0) {
+            pthread_cond_wait(&emu->cond, &emu->lock);
+            continue;
+        }
+        uint64_t release_ns = emu->slots[emu->heap[0]].release_ns, now = emu_now_ns();
+        if (release_ns > now) {
+            struct timespec ts = {.tv_sec = (time_t) (release_ns / 1000000000ULL),
+                                  .tv_nsec = (long) (release_ns % 1000000000ULL)};
+            pthread_cond_timedwait(&emu->cond, &emu->lock, &ts);
+            continue;
+        }
+        uint16_t slot = heap_pop(emu);
+        memcpy(d, &emu->slots[slot], offsetof(emu_delivery_t, frame));
+        memcpy(d->frame, emu->slots[slot].frame, emu->slots[slot].length);
+        emu->free_slots[emu->num_free++] = slot;
+        pthread_cond_broadcast(&emu->cond);
+        pthread_mutex_unlock(&emu->lock);
+
+        ssize_t ret = sendto(emu->socket_fd, d->frame, d->length, 0, (struct sockaddr *) &d->dst,
+                             sizeof(struct sockaddr_un));
+        int err = errno;
+        pthread_mutex_lock(&emu->lock);
+        if (ret < 0) {
+            if (err == ECONNREFUSED || err == ENOENT) {
+                remove_peer(emu, &d->dst);  // peer terminated without cleaning up
+                if (err == ECONNREFUSED)
+                    unlink(d->dst.sun_path);
+            } else {
+                emu->dropped_cnt++;     // receiver did not read its socket in time
+            }
+        }
+    }
+    pthread_mutex_unlock(&emu->lock);
+    free(d);
+    return NULL;
+}
+
+/**
+ * Transport backend: Converts the frames to the format received from a monitor mode adapter, applies the configured
+ * impairments and queues a copy for every other adapter on the same medium. Blocks if the emulated air is busy.
+ */
+static int emu_send_frames(void *transport_data, int socket_fd, struct mmsghdr *msgs, unsigned int num) {
+    db_emu_t *emu = transport_data;
+    uint8_t frame[DB_EMU_MAX_FRAME];
+    uint64_t backlog_ns = 0;
+    pthread_mutex_lock(&emu->lock);
+    if (!emu->thread_running) {
+        if (pthread_create(&emu->thread, NULL, emu_delivery_thread, emu) != 0) {
+            pthread_mutex_unlock(&emu->lock);
+            errno = EAGAIN;
+            return -1;
+        }
+        emu->thread_running = true;
+    }
+    uint64_t now = emu_now_ns();
+    if (now - emu->last_scan_ns > DB_EMU_RESCAN_NS)
+        scan_peers(emu);
+    for (unsigned int m = 0; m < num; m++) {
+        size_t length = 0;
+        for (size_t i = 0; i < msgs[m].msg_hdr.msg_iovlen; i++) {
+            struct iovec *iov = &msgs[m].msg_hdr.msg_iov[i];
+            if (length + iov->iov_len > DB_EMU_MAX_FRAME) {
+                pthread_mutex_unlock(&emu->lock);
+                errno = EMSGSIZE;
+                return m > 0 ? (int) m : -1;
+            }
+            memcpy(frame + length, iov->iov_base, iov->iov_len);
+            length += iov->iov_len;
+        }
+        msgs[m].msg_len = (unsigned int) length;
+        uint16_t tx_rt_length = (uint16_t) (frame[2] | (frame[3] << 8u));
+        if (length < 9 || tx_rt_length > length) {
+            pthread_mutex_unlock(&emu->lock);
+            errno = EINVAL;
+            return m > 0 ? (int) m : -1;
+        }
+        size_t air_length = length - tx_rt_length;
+        emu->sent_cnt++;
+        if (emu->link_free_ns < now)
+            emu->link_free_ns = now;
+        if (emu->config.rate_kbps > 0)
+            emu->link_free_ns += air_length * 8 * 1000000ULL / emu->config.rate_kbps;
+
+        for (int p = 0; p < emu->num_peers; p++) {
+            if (frame_lost(emu, &emu->peers[p])) {
+                emu->lost_cnt++;
+                continue;
+            }
+            while (emu->num_free == 0 && !emu->closing)
+                pthread_cond_wait(&emu->cond, &emu->lock);
+            if (emu->closing)
+                break;
+            uint16_t slot = emu->free_slots[--emu->num_free];
+            emu_delivery_t *d = &emu->slots[slot];
+            uint8_t rt[DB_EMU_RT_LENGTH] = {0x00, 0x00, DB_EMU_RT_LENGTH, 0x00,
+                                            0x26, 0x08, 0x00, 0x00,     // FLAGS, RATE, DBM_ANTSIGNAL, ANTENNA
+                                            0x00, frame[8], (uint8_t) emu->config.rssi_dbm, 0x00};
+            memcpy(d->frame + DB_EMU_RT_LENGTH, frame + tx_rt_length, air_length);
+            if (corrupt_frame(emu, d->frame + DB_EMU_RT_LENGTH, (int) air_length)) {
+                rt[8] |= DB_EMU_RT_FLAGS_BADFCS;
+                emu->corrupted_cnt++;
+            }
+            memcpy(d->frame, rt, DB_EMU_RT_LENGTH);
+            d->length = (uint16_t) (DB_EMU_RT_LENGTH + air_length);
+            d->dst = emu->peers[p].addr;
+            d->release_ns = emu->link_free_ns + emu->config.delay_us * 1000ULL;
+            if (emu->config.jitter_us > 0)
+                d->release_ns += (uint64_t) (emu_uniform(emu) * emu->config.jitter_us * 1000.0);
+            if (emu->config.reorder > 0 && emu_uniform(emu) < emu->config.reorder) {
+                d->release_ns += emu->config.reorder_us * 1000ULL;
+                emu->reordered_cnt++;
+            }
+            d->order = emu->order++;
+            heap_push(emu, slot);
+        }
+    }
+    if (emu->link_free_ns > now + DB_EMU_MAX_BACKLOG_NS)
+        backlog_ns = emu->link_free_ns - now - DB_EMU_MAX_BACKLOG_NS;
+    pthread_cond_broadcast(&emu->cond);
+    pthread_mutex_unlock(&emu->lock);
+    if (backlog_ns > 0) {
+        struct timespec ts = {.tv_sec = (time_t) (backlog_ns / 1000000000ULL),
+                              .tv_nsec = (long) (backlog_ns % 1000000000ULL)};
+        nanosleep(&ts, NULL);
+    }
+    return (int) num;
+}
+
+/**
+ * Delivers the frames still in flight, closes the socket and removes the adapter from the medium
+ */
+static void emu_close(void *transport_data, int socket_fd) {
+    db_emu_t *emu = transport_data;
+    pthread_mutex_lock(&emu->lock);
+    emu->closing = true;
+    pthread_cond_broadcast(&emu->cond);
+    pthread_mutex_unlock(&emu->lock);
+    if (emu->thread_running)
+        pthread_join(emu->thread, NULL);
+    close(socket_fd);
+    unlink(emu->own_addr.sun_path);
+    rmdir(emu->dir);    // last adapter on the medium
+    if (emu->sent_cnt > 0)
+        LOG_SYS_STD(LOG_NOTICE, "DroneBridgeCommon: %s%s sent %u frames. Lost %u, corrupted %u, reordered %u, "
+                                "dropped by receiver %u\n", DB_EMU_IF_PREFIX, emu->medium, emu->sent_cnt,
+                    emu->lost_cnt, emu->corrupted_cnt, emu->reordered_cnt, emu->dropped_cnt);
+    pthread_cond_destroy(&emu->cond);
+    pthread_mutex_destroy(&emu->lock);
+    free(emu->slots);
+    free(emu);
+}
+
+// Link emulator: Frames are exchanged via UNIX domain sockets between processes that opened the same medium
+const db_transport_t db_transport_emu = {.name = "emu", .send_frames = emu_send_frames, .close = emu_close};
+
+/**
+ * Opens an emulated adapter. Every process that opens "emu:<medium>" gets a UNIX datagram socket in
+ * DB_EMU_DIR/<medium>/. Frames sent on the socket are delivered to all other sockets of the medium with the
+ * impairments read from the DB_EMU environment variable. Received frames have a radiotap header like the ones of a
+ * monitor mode adapter and pass the same BPF filter, so they can be read using recv()/select() on the returned socket.
+ *
+ * @param a_db_socket Socket to set up. Its transport and transport data are set
+ * @param ifName "emu:<medium>"
+ * @param comm_id Communication ID to filter for
+ * @param recv_direction Direction to filter for
+ * @param port Port to filter for
+ * @return The socket file descriptor or -1 on failure
+ */
+int db_emu_open(db_socket_t *a_db_socket, const char *ifName, uint8_t comm_id, uint8_t recv_direction,
+                uint8_t port) {
+    const char *medium = ifName + strlen(DB_EMU_IF_PREFIX);
+    if (strlen(medium) == 0 || strchr(medium, '/') != NULL || strlen(medium) >= IFNAMSIZ) {
+        LOG_SYS_STD(LOG_ERR, "DroneBridgeCommon: Invalid emulated adapter name %s\n", ifName);
+        return -1;
+    }
+    db_emu_t *emu = calloc(1, sizeof(db_emu_t));
+    if (emu == NULL || (emu->slots = malloc(sizeof(emu_delivery_t) * DB_EMU_QUEUE_LEN)) == NULL) {
+        LOG_SYS_STD(LOG_ERR, "DroneBridgeCommon: Could not allocate link emulator\n");
+        free(emu);
+        return -1;
+    }
+    strcpy(emu->medium, medium);
+    if (db_emu_parse_config(getenv(DB_EMU_ENV), &emu->config) < 0)
+        LOG_SYS_STD(LOG_NOTICE, "DroneBridgeCommon: Ignored parts of %s=%s\n", DB_EMU_ENV, getenv(DB_EMU_ENV));
+    if (emu->config.loss >= 1) {
+        emu->p_good_bad = 1;
+        emu->p_bad_good = 0;
+    } else {
+        emu->p_bad_good = 1.0 / emu->config.burst;
+        emu->p_good_bad = emu->config.loss * emu->p_bad_good / (1.0 - emu->config.loss);
+    }
+    unsigned int socket_no = __sync_fetch_and_add(&emu_socket_cnt, 1);
+    emu->rand_state = emu->config.seed != 0 ? emu->config.seed : (uint32_t) (getpid() * 2654435761u + socket_no);
+    if (emu->rand_state == 0)
+        emu->rand_state = 1;
+    for (int i = 0; i < DB_EMU_QUEUE_LEN; i++)
+        emu->free_slots[i] = (uint16_t) (DB_EMU_QUEUE_LEN - 1 - i);
+    emu->num_free = DB_EMU_QUEUE_LEN;
+    pthread_mutex_init(&emu->lock, NULL);
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&emu->cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+
+    snprintf(emu->dir, sizeof(emu->dir), "%s/%s", DB_EMU_DIR, medium);
+    mkdir(DB_EMU_DIR, 0777);
+    mkdir(emu->dir, 0777);
+    emu->own_addr.sun_family = AF_UNIX;
+    snprintf(emu->own_addr.sun_path, sizeof(emu->own_addr.sun_path), "%s/%i-%u", emu->dir, getpid(), socket_no);
+    unlink(emu->own_addr.sun_path);
+    emu->socket_fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (emu->socket_fd < 0 || bind(emu->socket_fd, (struct sockaddr *) &emu->own_addr, sizeof(struct sockaddr_un)) < 0) {
+        LOG_SYS_STD(LOG_ERR, "DroneBridgeCommon: Could not open emulated adapter %s: %s\n", ifName, strerror(errno));
+        if (emu->socket_fd >= 0)
+            close(emu->socket_fd);
+        free(emu->slots);
+        free(emu);
+        return -1;
+    }
+    struct timeval timeout = {.tv_sec = 0, .tv_usec = DB_EMU_SEND_TIMEOUT_US};
+    setsockopt(emu->socket_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    if (setBPF(emu->socket_fd, comm_id, recv_direction, port) < 0) {
+        unlink(emu->own_addr.sun_path);
+        free(emu->slots);
+        free(emu);
+        return -1;
+    }
+    a_db_socket->transport = &db_transport_emu;
+    a_db_socket->transport_data = emu;
+    LOG_SYS_STD(LOG_NOTICE, "DroneBridgeCommon: Emulated adapter %s (loss %.3f, burst %.1f, ber %g, delay %u us, "
+                            "rate %u kbps)\n", ifName, emu->config.loss, emu->config.burst, emu->config.ber,
+                emu->config.delay_us, emu->config.rate_kbps);
+    return emu->socket_fd;
+}
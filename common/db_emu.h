@@ -0,0 +1,56 @@
+/*
+ *   This file is part of DroneBridge: https://github.com/seeul8er/DroneBridge
+ *
+ *   Copyright 2020 Wolfgang Christl
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+#ifndef DRONEBRIDGE_DB_EMU_H
+#define DRONEBRIDGE_DB_EMU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "db_raw_send_receive.h"
+
+#define DB_EMU_IF_PREFIX    "emu:"          // adapter names starting with the prefix open an emulated link
+#define DB_EMU_DIR          "/tmp/db_emu"   // every medium is a directory with one UNIX socket per emulated adapter
+#define DB_EMU_ENV          "DB_EMU"        // impairment configuration of the emulated links of a process
+#define DB_EMU_QUEUE_LEN    512             // max. frames in flight per emulated adapter
+
+// Impairments applied by the sender. Read from the DB_EMU environment variable, a comma separated list of
+// key=value pairs e.g. DB_EMU=loss=0.05,burst=3,delay=2000,jitter=500,rate=12000
+typedef struct {
+    double loss;            // loss=     mean frame loss probability [0..1]
+    double burst;           // burst=    mean length of a loss burst in frames (Gilbert-Elliott). 1 = independent loss
+    double ber;             // ber=      bit error rate. Corrupted frames are delivered with the bad FCS flag set
+    double reorder;         // reorder=  probability that a frame is held back by reorder_us
+    uint32_t reorder_us;    // reorder_us=
+    uint32_t delay_us;      // delay=    propagation delay
+    uint32_t jitter_us;     // jitter=   uniformly distributed extra delay [0..jitter]
+    uint32_t rate_kbps;     // rate=     air data rate. 0 = unlimited
+    int8_t rssi_dbm;        // rssi=     reported signal strength
+    uint32_t seed;          // seed=     random seed. 0 = derived from PID
+} db_emu_config_t;
+
+int db_emu_parse_config(const char *config_str, db_emu_config_t *config);
+
+bool db_emu_is_emu_if(const char *ifName);
+
+int db_emu_open(db_socket_t *a_db_socket, const char *ifName, uint8_t comm_id, uint8_t recv_direction,
+                uint8_t port);
+
+extern const db_transport_t db_transport_emu;
+
+#endif //DRONEBRIDGE_DB_EMU_H
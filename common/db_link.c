@@ -0,0 +1,275 @@
+/*
+ *   This file is part of DroneBridge: https://github.com/seeul8er/DroneBridge
+ *
+ *   Copyright 2020 Wolfgang Christl
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "db_link.h"
+#include "db_common.h"
+
+static inline db_link_slot_t *ring_slot(db_link_ring_t *ring, uint32_t index) {
+    return (db_link_slot_t *) (ring->slots + (size_t) (index & (ring->slot_nr - 1)) * ring->slot_size);
+}
+
+/**
+ * @param slot_nr Number of slots of the ring. Must be a power of two
+ * @return Size of the shared memory needed by a ring with slot_nr slots
+ */
+size_t db_link_ring_length(uint32_t slot_nr) {
+    return sizeof(db_link_ring_t) + (size_t) slot_nr * DB_LINK_SLOT_SIZE;
+}
+
+/**
+ * Link daemon side: Initializes a ring inside freshly created shared memory of db_link_ring_length() bytes
+ *
+ * @param ring The shared memory
+ * @param slot_nr Number of slots. Must be a power of two
+ * @param adapter_cnt Number of adapters the link daemon receives on
+ * @param adapter_names Names of the adapters. Index equals db_link_slot_t.adapter_no
+ */
+void db_link_ring_init(db_link_ring_t *ring, uint32_t slot_nr, uint32_t adapter_cnt,
+                       char adapter_names[][IFNAMSIZ]) {
+    memset(ring, 0, sizeof(db_link_ring_t));
+    ring->slot_nr = slot_nr;
+    ring->slot_size = DB_LINK_SLOT_SIZE;
+    ring->adapter_cnt = adapter_cnt;
+    for (uint32_t i = 0; i < adapter_cnt && i < DB_MAX_ADAPTERS; i++)
+        strncpy(ring->adapter_names[i], adapter_names[i], IFNAMSIZ - 1);
+    ring->magic = DB_LINK_MAGIC;
+}
+
+/**
+ * Link daemon side: Returns the next free slot. Slot is handed to the module with db_link_ring_push()
+ *
+ * @param ring The ring of a port
+ * @return Pointer to a free slot or NULL if the ring is full. In that case the frame is counted as dropped
+ */
+db_link_slot_t *db_link_ring_producer_slot(db_link_ring_t *ring) {
+    uint32_t head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= ring->slot_nr) {
+        ring->dropped_frame_cnt++;
+        return NULL;
+    }
+    return ring_slot(ring, head);
+}
+
+/**
+ * Link daemon side: Hands the slot returned by db_link_ring_producer_slot() to the module
+ */
+void db_link_ring_push(db_link_ring_t *ring) {
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Link daemon side: Wakes up the module in case it is waiting for frames. Call once after pushing a batch of frames.
+ * No syscall is done if the module is busy processing frames.
+ *
+ * @param ring The ring of a port
+ * @param event_fd The eventfd passed to the module of that port
+ */
+void db_link_ring_notify(db_link_ring_t *ring, int event_fd) {
+    // pairs with the fence in db_link_arm(): either we see the module waiting or the module sees the new head
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->consumer_waiting, __ATOMIC_RELAXED) &&
+        __atomic_exchange_n(&ring->consumer_waiting, 0, __ATOMIC_ACQ_REL)) {
+        uint64_t one = 1;
+        if (write(event_fd, &one, sizeof(one)) != sizeof(one))
+            LOG_SYS_STD(LOG_ERR, "DB_LINK: Could not notify module: %s\n", strerror(errno));
+    }
+}
+
+/**
+ * Receives the reply of the link daemon including the attached shared memory fd and eventfd
+ *
+ * @return 0 on success, -1 on failure
+ */
+static int receive_register_reply(int control_socket, db_link_register_reply_t *reply, int *shm_fd, int *event_fd) {
+    union {
+        struct cmsghdr align;
+        uint8_t buf[CMSG_SPACE(2 * sizeof(int))];
+    } control;
+    struct iovec iov = {.iov_base = reply, .iov_len = sizeof(db_link_register_reply_t)};
+    struct msghdr msg = {.msg_iov = &iov, .msg_iovlen = 1, .msg_control = control.buf,
+                         .msg_controllen = sizeof(control.buf)};
+    if (recvmsg(control_socket, &msg, 0) != sizeof(db_link_register_reply_t) || reply->status != 0)
+        return -1;
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(2 * sizeof(int)))
+        return -1;
+    int fds[2];
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+    *shm_fd = fds[0];
+    *event_fd = fds[1];
+    return 0;
+}
+
+/**
+ * Module side: Registers at the link daemon for all frames received on a DroneBridge port. Replaces the receiving part
+ * of open_db_socket(). Frames are read via db_link_next_frame() or db_link_recv(). Only one module per port.
+ *
+ * @param client Connection to init
+ * @param port DroneBridge port to receive (see db_protocol.h)
+ * @param slot_nr Number of frames the ring can hold (e.g. DB_LINK_RING_SLOTS). Gets rounded up to a power of two
+ * @return 0 on success, -1 if the link daemon is not running or refused the registration
+ */
+int db_link_connect(db_link_client_t *client, uint8_t port, uint32_t slot_nr) {
+    memset(client, 0, sizeof(db_link_client_t));
+    client->event_fd = -1;
+    client->port = port;
+    if ((client->control_socket = socket(AF_UNIX, SOCK_SEQPACKET, 0)) == -1) {
+        LOG_SYS_STD(LOG_ERR, "DB_LINK: Could not create unix socket: %s\n", strerror(errno));
+        return -1;
+    }
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(struct sockaddr_un));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, DB_LINK_UNIX_PATH, sizeof(addr.sun_path) - 1);
+    if (connect(client->control_socket, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        LOG_SYS_STD(LOG_ERR, "DB_LINK: Could not connect to link daemon at %s: %s\n", DB_LINK_UNIX_PATH,
+                    strerror(errno));
+        db_link_close(client);
+        return -1;
+    }
+    db_link_register_t request = {.port = port, .slot_nr = slot_nr};
+    db_link_register_reply_t reply;
+    int shm_fd = -1;
+    if (send(client->control_socket, &request, sizeof(request), 0) != sizeof(request) ||
+        receive_register_reply(client->control_socket, &reply, &shm_fd, &client->event_fd) < 0) {
+        LOG_SYS_STD(LOG_ERR, "DB_LINK: Link daemon refused registration of port %u\n", port);
+        db_link_close(client);
+        return -1;
+    }
+    void *ring = mmap(NULL, reply.ring_length, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    close(shm_fd);
+    if (ring == MAP_FAILED) {
+        LOG_SYS_STD(LOG_ERR, "DB_LINK: Could not map ring of port %u: %s\n", port, strerror(errno));
+        db_link_close(client);
+        return -1;
+    }
+    client->ring = ring;
+    client->ring_length = reply.ring_length;
+    if (client->ring->magic != DB_LINK_MAGIC) {
+        LOG_SYS_STD(LOG_ERR, "DB_LINK: Ring of port %u is not initialized\n", port);
+        db_link_close(client);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Module side: Call before waiting on client->event_fd with select()/poll(). Tells the link daemon to signal the
+ * eventfd with the next frame.
+ *
+ * @param client The connection
+ * @return 1 if frames are already waiting (do not block), 0 if it is safe to wait on the eventfd
+ */
+int db_link_arm(db_link_client_t *client) {
+    uint64_t cnt;
+    while (read(client->event_fd, &cnt, sizeof(cnt)) == sizeof(cnt));   // eventfd is non-blocking
+    __atomic_store_n(&client->ring->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&client->ring->head, __ATOMIC_ACQUIRE) != client->ring->tail) {
+        __atomic_store_n(&client->ring->consumer_waiting, 0, __ATOMIC_RELAXED);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Module side: Returns the oldest received frame. Frame is read in place and released with db_link_release_frame()
+ *
+ * @param client The connection
+ * @return The slot holding the frame or NULL if no frame is waiting
+ */
+db_link_slot_t *db_link_next_frame(db_link_client_t *client) {
+    uint32_t tail = client->ring->tail;
+    if (tail == __atomic_load_n(&client->ring->head, __ATOMIC_ACQUIRE))
+        return NULL;
+    return ring_slot(client->ring, tail);
+}
+
+/**
+ * Module side: Releases the frame returned by db_link_next_frame() so that the link daemon can reuse the slot
+ */
+void db_link_release_frame(db_link_client_t *client) {
+    __atomic_store_n(&client->ring->tail, client->ring->tail + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Module side: Drop in replacement for recv() on a DB raw socket. Copies the next frame into the buffer and blocks
+ * until a frame is available or the timeout expires.
+ *
+ * @param client The connection
+ * @param buffer Buffer the frame gets copied to. Frames that do not fit are truncated
+ * @param buffer_size Size of the buffer
+ * @param adapter_no Optional (may be NULL): Index of the adapter that received the frame
+ * @param timeout_ms Max. time to wait for a frame. -1 to wait forever
+ * @return Length of the frame. -1 on timeout (errno EAGAIN) or if the link daemon is gone (errno ENOTCONN)
+ */
+ssize_t db_link_recv(db_link_client_t *client, uint8_t *buffer, size_t buffer_size, uint8_t *adapter_no,
+                     int timeout_ms) {
+    for (;;) {
+        db_link_slot_t *slot = db_link_next_frame(client);
+        if (slot != NULL) {
+            size_t length = slot->frame_length < buffer_size ? slot->frame_length : buffer_size;
+            memcpy(buffer, slot->frame, length);
+            if (adapter_no != NULL)
+                *adapter_no = slot->adapter_no;
+            db_link_release_frame(client);
+            return (ssize_t) length;
+        }
+        if (db_link_arm(client))
+            continue;
+        struct pollfd poll_fds[2] = {{.fd = client->event_fd, .events = POLLIN},
+                                     {.fd = client->control_socket, .events = POLLIN}};
+        int ret = poll(poll_fds, 2, timeout_ms);
+        if (ret == 0) {
+            errno = EAGAIN;
+            return -1;
+        } else if (ret < 0 && errno != EINTR) {
+            return -1;
+        } else if (ret > 0 && poll_fds[1].revents) {
+            // the link daemon never sends anything after the registration. Readable means closed
+            LOG_SYS_STD(LOG_ERR, "DB_LINK: Lost connection to link daemon\n");
+            errno = ENOTCONN;
+            return -1;
+        }
+    }
+}
+
+/**
+ * Module side: Unregisters from the link daemon and frees all resources of the connection
+ */
+void db_link_close(db_link_client_t *client) {
+    if (client->ring != NULL)
+        munmap(client->ring, client->ring_length);
+    if (client->event_fd >= 0)
+        close(client->event_fd);
+    if (client->control_socket >= 0)
+        close(client->control_socket);
+    client->ring = NULL;
+    client->event_fd = -1;
+    client->control_socket = -1;
+}
@@ -0,0 +1,101 @@
+/*
+ *   This file is part of DroneBridge: https://github.com/seeul8er/DroneBridge
+ *
+ *   Copyright 2020 Wolfgang Christl
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+#ifndef DRONEBRIDGE_DB_LINK_H
+#define DRONEBRIDGE_DB_LINK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <net/if.h>
+#include "db_protocol.h"
+#include "db_spsc_ring.h"
+
+// The link daemon (db_link) owns one raw socket per adapter and hands the received frames to the modules through one
+// shared memory ring per DroneBridge port. Modules register for their port via a unix domain socket and get the ring
+// memory and an eventfd for notification passed as file descriptors.
+#define DB_LINK_UNIX_PATH       "/tmp/db_link"
+#define DB_LINK_SHM_NAME        "/db_link_port_%u"
+#define DB_LINK_RING_SLOTS      512     // default number of frames a ring of a port can hold
+#define DB_LINK_MAX_RING_SLOTS  8192
+#define DB_LINK_SLOT_SIZE       4096    // slot header + received frame (radiotap header + DB raw header + payload)
+#define DB_LINK_MAX_FRAME_SIZE  (DB_LINK_SLOT_SIZE - sizeof(db_link_slot_t))
+#define DB_LINK_NUM_PORTS       256
+#define DB_LINK_MAGIC           0x44424c4b  // "DBLK"
+
+// One received frame inside the shared memory ring
+typedef struct {
+    uint16_t frame_length;      // length of frame[] in bytes
+    uint8_t adapter_no;         // index of the adapter (order of -n arguments of the link daemon) that received it
+    uint8_t reserved;
+    uint8_t frame[];            // complete frame as received by recv() on a DB raw socket
+} db_link_slot_t;
+
+// Single producer (link daemon)/single consumer (module) ring placed in shared memory. Same protocol as db_spsc_ring_t,
+// but slots are addressed by offset since both processes map the memory at different addresses.
+typedef struct {
+    uint32_t magic;
+    uint32_t slot_nr;           // power of two
+    uint32_t slot_size;
+    uint32_t adapter_cnt;
+    char adapter_names[DB_MAX_ADAPTERS][IFNAMSIZ];
+    _Alignas(DB_CACHE_LINE_SIZE) uint32_t head;     // next slot to be written. Only written by the link daemon
+    uint32_t dropped_frame_cnt;                     // frames dropped by the link daemon because the ring was full
+    _Alignas(DB_CACHE_LINE_SIZE) uint32_t tail;     // next slot to be read. Only written by the module
+    uint32_t consumer_waiting;                      // set by the module before it blocks on the eventfd
+    _Alignas(DB_CACHE_LINE_SIZE) uint8_t slots[];
+} db_link_ring_t;
+
+// Sent by a module to the link daemon after connecting to DB_LINK_UNIX_PATH
+typedef struct {
+    uint8_t port;
+    uint32_t slot_nr;
+} db_link_register_t;
+
+// Reply of the link daemon. On success the shared memory fd and the eventfd are attached (SCM_RIGHTS)
+typedef struct {
+    int32_t status;             // 0 on success, -1 if the port is already taken or the ring could not be created
+    uint32_t ring_length;       // size of the shared memory in bytes
+} db_link_register_reply_t;
+
+// Module side of a link daemon connection
+typedef struct {
+    int control_socket;         // unix domain socket connected to the link daemon. -1 if not connected
+    int event_fd;               // becomes readable once frames are available. Can be used with select()/poll()
+    db_link_ring_t *ring;
+    size_t ring_length;
+    uint8_t port;
+} db_link_client_t;
+
+size_t db_link_ring_length(uint32_t slot_nr);
+void db_link_ring_init(db_link_ring_t *ring, uint32_t slot_nr, uint32_t adapter_cnt,
+                       char adapter_names[][IFNAMSIZ]);
+db_link_slot_t *db_link_ring_producer_slot(db_link_ring_t *ring);
+void db_link_ring_push(db_link_ring_t *ring);
+void db_link_ring_notify(db_link_ring_t *ring, int event_fd);
+
+int db_link_connect(db_link_client_t *client, uint8_t port, uint32_t slot_nr);
+int db_link_arm(db_link_client_t *client);
+db_link_slot_t *db_link_next_frame(db_link_client_t *client);
+void db_link_release_frame(db_link_client_t *client);
+ssize_t db_link_recv(db_link_client_t *client, uint8_t *buffer, size_t buffer_size, uint8_t *adapter_no,
+                     int timeout_ms);
+void db_link_close(db_link_client_t *client);
+
+#endif //DRONEBRIDGE_DB_LINK_H
@@ -0,0 +1,224 @@
+/*
+ *   This file is part of DroneBridge: https://github.com/seeul8er/DroneBridge
+ *
+ *   Copyright 2020 Wolfgang Christl
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "db_pcap.h"
+#include "db_common.h"
+
+#define PCAP_MAGIC_US           0xa1b2c3d4
+#define PCAP_MAGIC_NS           0xa1b23c4d
+#define PCAP_READ_BUFFER        (1024 * 1024)
+
+static inline uint32_t get_u32(const db_pcap_reader_t *reader, const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return reader->swapped ? __builtin_bswap32(v) : v;
+}
+
+static inline uint16_t get_u16(const db_pcap_reader_t *reader, const uint8_t *p) {
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return reader->swapped ? __builtin_bswap16(v) : v;
+}
+
+static inline uint64_t to_ns(uint64_t timestamp, uint64_t units) {
+    return timestamp / units * 1000000000ULL + timestamp % units * 1000000000ULL / units;
+}
+
+/**
+ * Opens a pcap or pcapng file. The format is detected from the file header.
+ *
+ * @param reader Reader to init
+ * @param path Path of the capture file
+ * @return 0 on success, -1 on failure
+ */
+int db_pcap_open(db_pcap_reader_t *reader, const char *path) {
+    memset(reader, 0, sizeof(db_pcap_reader_t));
+    reader->file = fopen(path, "rb");
+    if (reader->file == NULL) {
+        LOG_SYS_STD(LOG_ERR, "DB_PCAP: Could not open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    setvbuf(reader->file, NULL, _IOFBF, PCAP_READ_BUFFER);
+    reader->buf = malloc(DB_PCAP_MAX_FRAME + 64);
+    uint8_t header[24];
+    if (reader->buf == NULL || fread(header, 1, sizeof(header), reader->file) != sizeof(header)) {
+        LOG_SYS_STD(LOG_ERR, "DB_PCAP: %s is not a capture file\n", path);
+        db_pcap_close(reader);
+        return -1;
+    }
+    uint32_t magic;
+    memcpy(&magic, header, sizeof(magic));
+    if (magic == PCAPNG_BLOCK_SHB) {
+        reader->pcapng = true;
+        reader->swapped = get_u32(reader, header + 8) != PCAPNG_BYTE_ORDER_MAGIC;
+        // skip rest of the section header block
+        if (fseek(reader->file, (long) get_u32(reader, header + 4), SEEK_SET) == 0)
+            return 0;
+    } else if (magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS || __builtin_bswap32(magic) == PCAP_MAGIC_US ||
+               __builtin_bswap32(magic) == PCAP_MAGIC_NS) {
+        reader->swapped = magic != PCAP_MAGIC_US && magic != PCAP_MAGIC_NS;
+        reader->num_interfaces = 1;
+        reader->link_type[0] = (uint16_t) get_u32(reader, header + 20);
+        reader->ts_units[0] = get_u32(reader, header) == PCAP_MAGIC_NS ? 1000000000ULL : 1000000ULL;
+        return 0;
+    }
+    LOG_SYS_STD(LOG_ERR, "DB_PCAP: %s is not a pcap/pcapng file\n", path);
+    db_pcap_close(reader);
+    return -1;
+}
+
+/**
+ * Reads the options of an interface description block. Only the timestamp resolution is of interest
+ */
+static void parse_idb(db_pcap_reader_t *reader, const uint8_t *body, uint32_t body_length) {
+    if (reader->num_interfaces == DB_PCAP_MAX_INTERFACES || body_length < 8)
+        return;
+    int id = reader->num_interfaces++;
+    reader->link_type[id] = get_u16(reader, body);
+    reader->ts_units[id] = 1000000ULL;
+    for (uint32_t pos = 8; pos + 4 <= body_length;) {
+        uint16_t code = get_u16(reader, body + pos), length = get_u16(reader, body + pos + 2);
+        if (code == 0 || pos + 4 + length > body_length)
+            break;
+        if (code == PCAPNG_OPT_IF_TSRESOL && length >= 1) {
+            uint8_t resol = body[pos + 4];
+            uint64_t units = 1;
+            for (int i = 0; i < (resol & 0x7f) && units < 1000000000000000000ULL; i++)
+                units *= (resol & 0x80) ? 2 : 10;
+            reader->ts_units[id] = units;
+        }
+        pos += 4 + ((length + 3u) & ~3u);
+    }
+}
+
+static int next_pcap(db_pcap_reader_t *reader, db_pcap_frame_t *frame) {
+    uint8_t header[16];
+    while (fread(header, 1, sizeof(header), reader->file) == sizeof(header)) {
+        uint32_t incl_len = get_u32(reader, header + 8), orig_len = get_u32(reader, header + 12);
+        if (incl_len > DB_PCAP_MAX_FRAME) {
+            LOG_SYS_STD(LOG_ERR, "DB_PCAP: Invalid record length %u\n", incl_len);
+            return -1;
+        }
+        if (fread(reader->buf, 1, incl_len, reader->file) != incl_len)
+            return 0;
+        if (reader->link_type[0] != DB_PCAP_LINKTYPE_RADIOTAP || incl_len < orig_len) {
+            reader->skipped_cnt++;
+            continue;
+        }
+        frame->data = reader->buf;
+        frame->length = incl_len;
+        frame->interface_id = 0;
+        frame->timestamp_ns = to_ns((uint64_t) get_u32(reader, header) * reader->ts_units[0] +
+                                    get_u32(reader, header + 4), reader->ts_units[0]);
+        return 1;
+    }
+    return 0;
+}
+
+static int next_pcapng(db_pcap_reader_t *reader, db_pcap_frame_t *frame) {
+    uint8_t header[8];
+    while (fread(header, 1, sizeof(header), reader->file) == sizeof(header)) {
+        uint32_t type, total_length;
+        memcpy(&type, header, sizeof(type));
+        if (type == PCAPNG_BLOCK_SHB) {
+            // new section: byte order and interfaces might change
+            uint8_t bom[4];
+            if (fread(bom, 1, sizeof(bom), reader->file) != sizeof(bom))
+                return 0;
+            uint32_t bom_value;
+            memcpy(&bom_value, bom, sizeof(bom_value));
+            reader->swapped = bom_value != PCAPNG_BYTE_ORDER_MAGIC;
+            reader->num_interfaces = 0;
+            if (fseek(reader->file, (long) get_u32(reader, header + 4) - 12, SEEK_CUR) != 0)
+                return 0;
+            continue;
+        }
+        type = get_u32(reader, header);
+        total_length = get_u32(reader, header + 4);
+        if (total_length < 12 || total_length - 12 > DB_PCAP_MAX_FRAME + 32) {
+            LOG_SYS_STD(LOG_ERR, "DB_PCAP: Invalid pcapng block length %u\n", total_length);
+            return -1;
+        }
+        uint32_t body_length = total_length - 12;
+        if (type != PCAPNG_BLOCK_IDB && type != PCAPNG_BLOCK_EPB && type != PCAPNG_BLOCK_SPB) {
+            if (fseek(reader->file, (long) body_length + 4, SEEK_CUR) != 0)
+                return 0;
+            continue;
+        }
+        if (fread(reader->buf, 1, body_length + 4, reader->file) != body_length + 4)
+            return 0;
+        if (type == PCAPNG_BLOCK_IDB) {
+            parse_idb(reader, reader->buf, body_length);
+            continue;
+        }
+        uint32_t interface_id = 0, cap_length, orig_length, offset;
+        uint64_t timestamp_ns = reader->last_timestamp_ns;    // simple packet blocks carry no time stamp
+        if (type == PCAPNG_BLOCK_EPB) {
+            if (body_length < 20)
+                return -1;
+            interface_id = get_u32(reader, reader->buf);
+            cap_length = get_u32(reader, reader->buf + 12);
+            orig_length = get_u32(reader, reader->buf + 16);
+            offset = 20;
+            if ((int) interface_id < reader->num_interfaces)
+                timestamp_ns = to_ns(((uint64_t) get_u32(reader, reader->buf + 4) << 32u) |
+                                     get_u32(reader, reader->buf + 8), reader->ts_units[interface_id]);
+        } else {
+            if (body_length < 4)
+                return -1;
+            orig_length = get_u32(reader, reader->buf);
+            cap_length = orig_length < body_length - 4 ? orig_length : body_length - 4;
+            offset = 4;
+        }
+        if ((int) interface_id >= reader->num_interfaces || cap_length > body_length - offset ||
+            reader->link_type[interface_id] != DB_PCAP_LINKTYPE_RADIOTAP || cap_length < orig_length) {
+            reader->skipped_cnt++;
+            continue;
+        }
+        reader->last_timestamp_ns = timestamp_ns;
+        frame->data = reader->buf + offset;
+        frame->length = cap_length;
+        frame->interface_id = interface_id;
+        frame->timestamp_ns = timestamp_ns;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Reads the next radiotap frame from the capture
+ *
+ * @param reader Opened reader
+ * @param frame Returns the frame. Data is valid until the next call
+ * @return 1 if a frame was read, 0 at the end of the file, -1 if the file is corrupt
+ */
+int db_pcap_next(db_pcap_reader_t *reader, db_pcap_frame_t *frame) {
+    return reader->pcapng ? next_pcapng(reader, frame) : next_pcap(reader, frame);
+}
+
+void db_pcap_close(db_pcap_reader_t *reader) {
+    if (reader->file != NULL)
+        fclose(reader->file);
+    free(reader->buf);
+    reader->file = NULL;
+    reader->buf = NULL;
+}
@@ -0,0 +1,68 @@
+/*
+ *   This file is part of DroneBridge: https://github.com/seeul8er/DroneBridge
+ *
+ *   Copyright 2020 Wolfgang Christl
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+#ifndef DRONEBRIDGE_DB_PCAP_H
+#define DRONEBRIDGE_DB_PCAP_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DB_PCAP_LINKTYPE_RADIOTAP   127     // LINKTYPE_IEEE802_11_RADIOTAP
+#define DB_PCAP_MAX_INTERFACES      16      // pcapng interfaces per section
+#define DB_PCAP_MAX_FRAME           65536
+#define PCAPNG_BLOCK_SHB            0x0a0d0d0a
+#define PCAPNG_BLOCK_IDB            0x00000001
+#define PCAPNG_BLOCK_SPB            0x00000003
+#define PCAPNG_BLOCK_EPB            0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC     0x1a2b3c4d
+#define PCAPNG_OPT_END              0
+#define PCAPNG_OPT_COMMENT          1
+#define PCAPNG_OPT_IF_NAME          2
+#define PCAPNG_OPT_IF_TSRESOL       9
+
+// A frame read from a capture. Data is valid until the next call of db_pcap_next()
+typedef struct {
+    const uint8_t *data;    // starts with the radiotap header
+    uint32_t length;
+    uint64_t timestamp_ns;
+    uint32_t interface_id;  // pcapng interface the frame was captured on. Always 0 for pcap files
+} db_pcap_frame_t;
+
+// Reader for pcap and pcapng capture files (both byte orders, any timestamp resolution). Only radiotap frames are
+// returned, frames of other link types are skipped
+typedef struct {
+    FILE *file;
+    bool pcapng;
+    bool swapped;           // file was written on a machine with different byte order
+    uint16_t link_type[DB_PCAP_MAX_INTERFACES];
+    uint64_t ts_units[DB_PCAP_MAX_INTERFACES];  // timestamp units per second of every interface
+    int num_interfaces;
+    uint64_t last_timestamp_ns;
+    uint8_t *buf;
+    uint32_t skipped_cnt;   // frames that were not radiotap frames or that were truncated
+} db_pcap_reader_t;
+
+int db_pcap_open(db_pcap_reader_t *reader, const char *path);
+
+int db_pcap_next(db_pcap_reader_t *reader, db_pcap_frame_t *frame);
+
+void db_pcap_close(db_pcap_reader_t *reader);
+
+#endif //DRONEBRIDGE_DB_PCAP_H
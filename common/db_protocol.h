@@ -41,6 +41,9 @@ typedef u32 __le32;
 
 #define RADIOTAP_LENGTH         13
 #define DB_RAW_V2_HEADER_LENGTH 10
+#define DB_RAW_EXT_HEADER_LENGTH 4      // optional extension of the DB raw v2 header: stream ID + bits 8-31 of seq. num.
+#define DB_RAW_EXT_SEQ_FLAG     0x8000  // set in payload_length of the DB raw v2 header if the extension follows
+#define DB_RAW_EXT_MAX_STREAMS  4       // max. number of senders on one port that receivers tell apart
 #define DB_MAX_ADAPTERS 4
 
 #define MSP_DATA_LENTH          34      // size of MSP v1
@@ -74,6 +77,10 @@ typedef u32 __le32;
 #define DB_PORT_PROXY		0x06
 #define DB_PORT_RC			0x07
 
+// stream IDs of the extended DB raw header. Only needed where more than one module sends to the same port
+#define DB_STREAM_DEFAULT   0x00
+#define DB_STREAM_RC        0x01 // RC via MSP/MAVLink sent by the control module to DB_PORT_CONTROLLER next to proxy
+
 #define DB_DIREC_DRONE      0x01 // packet to/for drone
 #define DB_DIREC_GROUND   	0x03 // packet to/for ground station
 
@@ -120,6 +127,21 @@ struct db_raw_v2_header_t {
 	uint8_t seq_num;
 };
 
+// Optional extension of the DB raw v2 header. Directly follows the v2 header (before the payload or inside the
+// DB_RAW_OFFSET gap) if DB_RAW_EXT_SEQ_FLAG is set in payload_length. Extends seq_num to 32 bit so that receivers can
+// tell duplicates (diversity) from new frames even after long outages
+struct db_raw_v2_ext_header_t {
+	uint8_t stream_id;			// tells apart senders with independent seq. nums. on the same port (DB_STREAM_*)
+	uint8_t seq_num_high[3];	// bits 8-31 of the sequence number, little endian
+};
+
+// Sequence number of a received frame
+typedef struct {
+	uint32_t seq_num;
+	uint8_t seq_num_bits;		// 8 for DB raw v2 frames, 32 if the frame had the extended header
+	uint8_t stream_id;			// 0 for DB raw v2 frames
+} db_seq_num_t;
+
 typedef struct {
 	uint8_t ident[2];
 	uint8_t message_id;
@@ -0,0 +1,128 @@
+/*
+ *   This file is part of DroneBridge: https://github.com/seeul8er/DroneBridge
+ *
+ *   Copyright 2020 Wolfgang Christl
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+#include <string.h>
+#include <errno.h>
+#include "db_radiotap.h"
+#include "radiotap/radiotap_iter.h"
+
+#define RT_PRESENT_OFFSET   4   // it_version, it_pad, it_len
+
+static inline uint32_t get_le32(const uint8_t *p) {
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8u) | ((uint32_t) p[2] << 16u) | ((uint32_t) p[3] << 24u);
+}
+
+static inline bool is_field_of_interest(int index) {
+    switch (index) {
+        case IEEE80211_RADIOTAP_FLAGS:
+        case IEEE80211_RADIOTAP_RATE:
+        case IEEE80211_RADIOTAP_DBM_ANTSIGNAL:
+        case IEEE80211_RADIOTAP_LOCK_QUALITY:
+        case IEEE80211_RADIOTAP_ANTENNA:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void db_rt_plan_init(db_rt_plan_t *plan) {
+    memset(plan, 0, sizeof(db_rt_plan_t));
+}
+
+/**
+ * Checks if the radiotap header has the layout the plan was compiled for: Same length and same present bitmaps
+ */
+static inline bool plan_matches(const db_rt_plan_t *plan, const uint8_t *radiotap_header, int radiotap_length) {
+    if (!plan->valid || plan->it_len != radiotap_length)
+        return false;
+    for (int i = 0; i < plan->num_present; i++) {
+        if (get_le32(radiotap_header + RT_PRESENT_OFFSET + 4 * i) != plan->present[i])
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Slow path: Walks the header using the radiotap iterator and compiles a new plan from the found field offsets.
+ * Headers with vendor namespaces are not cached since their layout depends on the frame content (skip_length).
+ *
+ * @return Number of fields of interest found, -1 if the radiotap header is invalid
+ */
+static int compile_plan(db_rt_plan_t *plan, const uint8_t *radiotap_header, int radiotap_length) {
+    struct ieee80211_radiotap_iterator rti;
+    bool cacheable = true;
+    int ret;
+    plan->valid = false;
+    plan->num_fields = 0;
+    plan->miss_cnt++;
+    if (ieee80211_radiotap_iterator_init(&rti, (struct ieee80211_radiotap_header *) radiotap_header,
+                                         radiotap_length, NULL) != 0)
+        return -1;
+    while ((ret = ieee80211_radiotap_iterator_next(&rti)) == 0) {
+        if (!rti.is_radiotap_ns || !is_field_of_interest(rti.this_arg_index))
+            continue;
+        if (plan->num_fields == DB_RT_MAX_FIELDS) {
+            cacheable = false;
+            break;
+        }
+        plan->fields[plan->num_fields].index = (uint8_t) rti.this_arg_index;
+        plan->fields[plan->num_fields].offset = (uint16_t) (rti.this_arg - radiotap_header);
+        plan->num_fields++;
+    }
+    if (ret != 0 && ret != -ENOENT)
+        cacheable = false;  // malformed header. Keep what was found but do not trust the layout
+
+    uint32_t present;
+    plan->num_present = 0;
+    do {
+        if (plan->num_present == DB_RT_MAX_PRESENT_WORDS ||
+            RT_PRESENT_OFFSET + 4 * (plan->num_present + 1) > radiotap_length) {
+            cacheable = false;
+            break;
+        }
+        present = get_le32(radiotap_header + RT_PRESENT_OFFSET + 4 * plan->num_present);
+        if (present & (1u << IEEE80211_RADIOTAP_VENDOR_NAMESPACE))
+            cacheable = false;
+        plan->present[plan->num_present++] = present;
+    } while (present & (1u << IEEE80211_RADIOTAP_EXT));
+    plan->it_len = (uint16_t) radiotap_length;
+    plan->valid = cacheable;
+    return plan->num_fields;
+}
+
+/**
+ * Returns the RATE, FLAGS, ANTENNA, DBM_ANTSIGNAL and LOCK_QUALITY fields of a radiotap header in the order the radiotap
+ * iterator would return them. Uses direct loads at cached offsets if the header has the same layout as the last one
+ * seen with this plan, otherwise falls back to the radiotap iterator and caches the new layout.
+ *
+ * @param plan Parse plan of the adapter that received the frame. Init with db_rt_plan_init()
+ * @param radiotap_header Start of the received frame
+ * @param radiotap_length Length of the radiotap header (it_len)
+ * @param fields Returns the list of found fields. Field data is at radiotap_header + offset. Valid until next call
+ * @return Number of fields in the list, -1 if the radiotap header is invalid
+ */
+int db_rt_get_fields(db_rt_plan_t *plan, const uint8_t *radiotap_header, int radiotap_length,
+                     const db_rt_field_t **fields) {
+    *fields = plan->fields;
+    if (plan_matches(plan, radiotap_header, radiotap_length)) {
+        plan->hit_cnt++;
+        return plan->num_fields;
+    }
+    return compile_plan(plan, radiotap_header, radiotap_length);
+}
@@ -0,0 +1,54 @@
+/*
+ *   This file is part of DroneBridge: https://github.com/seeul8er/DroneBridge
+ *
+ *   Copyright 2020 Wolfgang Christl
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+#ifndef DRONEBRIDGE_DB_RADIOTAP_H
+#define DRONEBRIDGE_DB_RADIOTAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DB_RT_MAX_PRESENT_WORDS 8   // max. number of it_present bitmaps (namespaces) a plan can be compiled for
+#define DB_RT_MAX_FIELDS        24  // max. number of fields of interest in one radiotap header
+
+// A field of interest (RATE, FLAGS, ANTENNA, DBM_ANTSIGNAL, LOCK_QUALITY) found in a radiotap header
+typedef struct {
+    uint8_t index;          // IEEE80211_RADIOTAP_* type of the field
+    uint16_t offset;        // offset of the field data from the start of the radiotap header
+} db_rt_field_t;
+
+// Cached radiotap parse plan. The layout of a radiotap header only depends on its present bitmaps, which almost never
+// change for a given driver. The plan stores the field offsets of the last seen layout so that following frames with
+// the same layout are parsed without the radiotap iterator. Use one plan per adapter (not thread safe).
+typedef struct {
+    bool valid;             // false if no layout is cached (e.g. header contains vendor namespaces)
+    uint16_t it_len;
+    uint8_t num_present;
+    uint32_t present[DB_RT_MAX_PRESENT_WORDS];
+    uint8_t num_fields;
+    db_rt_field_t fields[DB_RT_MAX_FIELDS];     // in the order the radiotap iterator returns them
+    uint32_t hit_cnt;       // frames parsed using the cached plan
+    uint32_t miss_cnt;      // frames parsed using the radiotap iterator
+} db_rt_plan_t;
+
+void db_rt_plan_init(db_rt_plan_t *plan);
+
+int db_rt_get_fields(db_rt_plan_t *plan, const uint8_t *radiotap_header, int radiotap_length,
+                     const db_rt_field_t **fields);
+
+#endif //DRONEBRIDGE_DB_RADIOTAP_H
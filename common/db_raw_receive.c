@@ -19,6 +19,7 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <sys/socket.h>
 #include <string.h>
 #include <linux/filter.h> // BPF
@@ -30,22 +31,15 @@
 #include <arpa/inet.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include "db_protocol.h"
+#include "db_raw_receive.h"
 #include "radiotap/radiotap_iter.h"
 
 #define ARRAY_SIZE(arr) (sizeof(arr)/sizeof((arr)[0]))
 int expected_seq_num;
 
-/**
- * Set a BPF filter on the socket (DroneBridge raw protocol v2)
- *
- * @param newsocket The socket file descriptor on which the BPF filter should be set
- * @param new_comm_id The communication ID that we filter for
- * @param direction Packets with what kind of directions (DB_DIREC_DRONE or DB_V2_DIREC_GROUND) are allowed to pass the filter
- * @param port The port of the module using this function. See db_protocol.h (DB_PORT_CONTROLLER, DB_PORT_COMM, ...)
- * @return The socket with set BPF filter
- */
-int setBPF(int newsocket, const uint8_t new_comm_id, uint8_t direction, uint8_t port) {
+static int attach_bpf(int newsocket, const uint8_t new_comm_id, uint8_t direction, uint8_t port, bool any_port) {
     struct sock_filter dest_filter[] =
             {
                     {0x30, 0, 0, 0x00000003},
@@ -69,6 +63,8 @@ int setBPF(int newsocket, const uint8_t new_comm_id, uint8_t direction, uint8_t
     // override some of the filter settings
     dest_filter[11].k = (uint32_t) ((0x00 << 24) | (0x00 << 16) | (direction << 8) | new_comm_id);
     dest_filter[13].k = (uint32_t) port;
+    if (any_port)
+        dest_filter[13].jf = 0;     // port check falls through to accept in both cases
 
     struct sock_fprog bpf =
             {
@@ -84,6 +80,32 @@ int setBPF(int newsocket, const uint8_t new_comm_id, uint8_t direction, uint8_t
     return newsocket;
 }
 
+/**
+ * Set a BPF filter on the socket (DroneBridge raw protocol v2)
+ *
+ * @param newsocket The socket file descriptor on which the BPF filter should be set
+ * @param new_comm_id The communication ID that we filter for
+ * @param direction Packets with what kind of directions (DB_DIREC_DRONE or DB_V2_DIREC_GROUND) are allowed to pass the filter
+ * @param port The port of the module using this function. See db_protocol.h (DB_PORT_CONTROLLER, DB_PORT_COMM, ...)
+ * @return The socket with set BPF filter
+ */
+int setBPF(int newsocket, const uint8_t new_comm_id, uint8_t direction, uint8_t port) {
+    return attach_bpf(newsocket, new_comm_id, direction, port, false);
+}
+
+/**
+ * Set a BPF filter on the socket that lets frames of all DroneBridge ports pass. Used by the link daemon that
+ * distributes the frames to the modules by port. Replaces any filter set before.
+ *
+ * @param newsocket The socket file descriptor on which the BPF filter should be set
+ * @param new_comm_id The communication ID that we filter for
+ * @param direction Packets with what kind of directions (DB_DIREC_DRONE or DB_V2_DIREC_GROUND) are allowed to pass the filter
+ * @return The socket with set BPF filter
+ */
+int setBPF_all_ports(int newsocket, const uint8_t new_comm_id, uint8_t direction) {
+    return attach_bpf(newsocket, new_comm_id, direction, 0, true);
+}
+
 /**
  * Bind the socket to a network interface
  *
@@ -159,49 +181,241 @@ uint8_t count_lost_packets(uint8_t last_seq_num, uint8_t received_seq_num) {
                       (255 - expected_seq_num) + received_seq_num);
 }
 
+/**
+ * Gets a pointer to the payload inside a received packet buffer of a raw socket (DB raw socket). No copy is made.
+ * Handles frames with and without the extended DB raw header (32 bit sequence number).
+ *
+ * @param receive_buffer: The buffer filled by the raw socket during recv() or a frame inside a TPACKET_V3 ring
+ * @param receive_length: The length of the received raw packet (return value of recv())
+ * @param payload_length: A pointer to the variable where we write the length of the DroneBridge payload into
+ * @param seq_num: A pointer to the variable where we write the sequence number, its width and the stream ID into
+ * @param radiotap_length: A pointer to the variable where we write the radiotap header length into
+ * @return Pointer to the first byte of the DroneBridge payload inside receive_buffer or NULL if the payload length
+ * is invalid: Longer than DATA_UNI_LENGTH or than the bytes actually received after the header
+ */
+uint8_t *get_db_payload_pointer_seq(uint8_t *receive_buffer, ssize_t receive_length, uint16_t *payload_length,
+                                    db_seq_num_t *seq_num, uint16_t *radiotap_length) {
+    *payload_length = 0;
+    if (receive_length < 4)
+        return NULL;
+    *radiotap_length = receive_buffer[2] | (receive_buffer[3] << 8);
+    // bytes following the DB raw v2 header. Frames with a bad FCS may be truncated, never trust payload_length alone
+    ssize_t available = receive_length - *radiotap_length - DB_RAW_V2_HEADER_LENGTH;
+    if (available < 0)
+        return NULL;
+    uint8_t *db_header = &receive_buffer[*radiotap_length];
+    *payload_length = db_header[7] | (db_header[8] << 8); // DB_v2
+    seq_num->seq_num = db_header[9];
+    seq_num->seq_num_bits = 8;
+    seq_num->stream_id = DB_STREAM_DEFAULT;
+    int ext_length = 0;
+    if (*payload_length & DB_RAW_EXT_SEQ_FLAG) {
+        if (available < DB_RAW_EXT_HEADER_LENGTH)
+            return NULL;
+        struct db_raw_v2_ext_header_t *ext_header =
+                (struct db_raw_v2_ext_header_t *) &db_header[DB_RAW_V2_HEADER_LENGTH];
+        *payload_length &= (uint16_t) ~DB_RAW_EXT_SEQ_FLAG;
+        seq_num->seq_num |= ((uint32_t) ext_header->seq_num_high[0] << 8u) |
+                            ((uint32_t) ext_header->seq_num_high[1] << 16u) |
+                            ((uint32_t) ext_header->seq_num_high[2] << 24u);
+        seq_num->seq_num_bits = 32;
+        seq_num->stream_id = ext_header->stream_id;
+        ext_length = DB_RAW_EXT_HEADER_LENGTH;
+    }
+    // estimate if the packet was sent with offset payload. 4 FCS bytes may or may not be supplied at end of frame.
+    // The extended header sits inside the offset, so it only adds to the length of frames without offset
+    if (*payload_length > DATA_UNI_LENGTH)
+        return NULL;
+    if (available <= (*payload_length + ext_length + 4)) {
+        if (*payload_length > available - ext_length)
+            return NULL;
+        return &db_header[DB_RAW_V2_HEADER_LENGTH + ext_length];
+    } else if (*payload_length <= available - DB_RAW_OFFSET) {
+        return &db_header[DB_RAW_V2_HEADER_LENGTH + DB_RAW_OFFSET];
+    }
+    return NULL;
+}
+
+/**
+ * Gets a pointer to the payload inside a received packet buffer of a raw socket (DB raw socket). No copy is made.
+ * Only returns the lower 8 bits of the sequence number. Use get_db_payload_pointer_seq() for the full one.
+ *
+ * @param receive_buffer: The buffer filled by the raw socket during recv() or a frame inside a TPACKET_V3 ring
+ * @param receive_length: The length of the received raw packet (return value of recv())
+ * @param payload_length: A pointer to the variable where we write the length of the DroneBridge payload into
+ * @param seq_num: A pointer to the variable where we write the sequence number of the packet into
+ * @param radiotap_length: A pointer to the variable where we write the radiotap header length into
+ * @return Pointer to the first byte of the DroneBridge payload inside receive_buffer or NULL if the payload length
+ * is invalid
+ */
+uint8_t *get_db_payload_pointer(uint8_t *receive_buffer, ssize_t receive_length, uint16_t *payload_length,
+                                uint8_t *seq_num, uint16_t *radiotap_length) {
+    db_seq_num_t full_seq_num;
+    uint8_t *payload = get_db_payload_pointer_seq(receive_buffer, receive_length, payload_length, &full_seq_num,
+                                                  radiotap_length);
+    *seq_num = (uint8_t) full_seq_num.seq_num;
+    return payload;
+}
+
 /**
  * Gets the payload from a received packet buffer of a raw socket (DB raw socket)
  *
  * @param receive_buffer: The buffer filled by the raw socket during recv()
  * @param receive_length: The length of the received raw packet (return value of recv())
  * @param payload_buffer: The buffer we write the DroneBridge payload into.
- * @param seq_num: A pointer to the variable where we write the sequence number of the packet into
+ * @param seq_num: A pointer to the variable where we write the sequence number, its width and the stream ID into
+ * @param radiotap_length: A pointer to the variable where we write the radiotap header length into
+ */
+uint16_t get_db_payload_seq(uint8_t *receive_buffer, ssize_t receive_length, uint8_t *payload_buffer,
+                            db_seq_num_t *seq_num, uint16_t *radiotap_length) {
+    uint16_t payload_length;
+    uint8_t *payload = get_db_payload_pointer_seq(receive_buffer, receive_length, &payload_length, seq_num,
+                                                  radiotap_length);
+    if (payload != NULL)
+        memcpy(payload_buffer, payload, payload_length);
+    return payload_length;
+}
+
+/**
+ * Gets the payload from a received packet buffer of a raw socket (DB raw socket)
+ *
+ * @param receive_buffer: The buffer filled by the raw socket during recv()
+ * @param receive_length: The length of the received raw packet (return value of recv())
+ * @param payload_buffer: The buffer we write the DroneBridge payload into.
+ * @param seq_num: A pointer to the variable where we write the lower 8 bits of the sequence number into
  * @param radiotap_length: A pointer to the variable where we write the radiotap header length into
  */
 uint16_t get_db_payload(uint8_t *receive_buffer, ssize_t receive_length, uint8_t *payload_buffer, uint8_t *seq_num,
                         uint16_t *radiotap_length) {
-    *radiotap_length = receive_buffer[2] | (receive_buffer[3] << 8);
-    *seq_num = receive_buffer[*radiotap_length + 9];
-    uint16_t payload_length =
-            receive_buffer[*radiotap_length + 7] | (receive_buffer[*radiotap_length + 8] << 8); // DB_v2
-    // estimate if the packet was sent with offset payload. 4 FCS bytes may or may not be supplied at end of frame.
-    if ((receive_length - *radiotap_length - DB_RAW_V2_HEADER_LENGTH) <= (payload_length + 4))
-        memcpy(payload_buffer, &receive_buffer[*radiotap_length + DB_RAW_V2_HEADER_LENGTH], payload_length);
-    else if (payload_length <= DATA_UNI_LENGTH)
-        memcpy(payload_buffer, &receive_buffer[*radiotap_length + DB_RAW_V2_HEADER_LENGTH + DB_RAW_OFFSET],
-               payload_length);
+    db_seq_num_t full_seq_num;
+    uint16_t payload_length = get_db_payload_seq(receive_buffer, receive_length, payload_buffer, &full_seq_num,
+                                                 radiotap_length);
+    *seq_num = (uint8_t) full_seq_num.seq_num;
     return payload_length;
 }
 
+/**
+ * Sets up a PACKET_MMAP (TPACKET_V3) receive ring on the socket. Once set up, received frames are no longer available
+ * via recv(). Use db_rx_ring_next_block() after select()/poll() signaled that the socket is readable.
+ *
+ * @param the_socketfd A bound DB raw socket with set BPF filter
+ * @param ring The ring structure to be filled
+ * @param block_size Size of a ring block in bytes. Must be a multiple of the page size
+ * @param block_nr Number of blocks of the ring
+ * @return 0 on success or -1 on failure
+ */
+int setup_rx_ring(int the_socketfd, db_rx_ring_t *ring, unsigned int block_size, unsigned int block_nr) {
+    int version = TPACKET_V3;
+    if (setsockopt(the_socketfd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+        perror("DB_RECEIVE: Could not set TPACKET_V3 ");
+        return -1;
+    }
+    struct tpacket_req3 req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = block_size;
+    req.tp_block_nr = block_nr;
+    req.tp_frame_size = MAX_DB_DATA_LENGTH + TPACKET3_HDRLEN; // frames are variable length with V3. Just a hint
+    req.tp_frame_size = TPACKET_ALIGN(req.tp_frame_size);
+    req.tp_frame_nr = (block_size / req.tp_frame_size) * block_nr;
+    req.tp_retire_blk_tov = DB_RX_RING_BLOCK_TIMEOUT;
+    if (setsockopt(the_socketfd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+        perror("DB_RECEIVE: Could not set up PACKET_RX_RING ");
+        return -1;
+    }
+    ring->map_length = (size_t) block_size * block_nr;
+    ring->map = mmap(NULL, ring->map_length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, the_socketfd, 0);
+    if (ring->map == MAP_FAILED) {
+        // MAP_LOCKED might fail due to RLIMIT_MEMLOCK
+        ring->map = mmap(NULL, ring->map_length, PROT_READ | PROT_WRITE, MAP_SHARED, the_socketfd, 0);
+        if (ring->map == MAP_FAILED) {
+            perror("DB_RECEIVE: Could not mmap receive ring ");
+            return -1;
+        }
+    }
+    ring->socket_fd = the_socketfd;
+    ring->block_size = block_size;
+    ring->block_nr = block_nr;
+    ring->current_block = 0;
+    return 0;
+}
+
+/**
+ * Checks if the current block of the ring was handed to user space by the kernel and prepares iterating its frames
+ *
+ * @param ring The receive ring
+ * @param iter Iterator that gets set to the first frame of the block
+ * @return 1 if a block with frames is available or 0 if the kernel still owns the block
+ */
+int db_rx_ring_next_block(db_rx_ring_t *ring, db_rx_block_iter_t *iter) {
+    struct tpacket_block_desc *block = (struct tpacket_block_desc *) (ring->map +
+                                                                      ring->current_block * ring->block_size);
+    if ((__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) == 0)
+        return 0;
+    iter->block = block;
+    iter->frames_left = block->hdr.bh1.num_pkts;
+    iter->frame_hdr = (struct tpacket3_hdr *) ((uint8_t *) block + block->hdr.bh1.offset_to_first_pkt);
+    return 1;
+}
+
+/**
+ * Returns a pointer to the next frame (starting with the radiotap header) of the block. Pointer stays valid until
+ * db_rx_ring_release_block() was called.
+ *
+ * @param iter Iterator set up by db_rx_ring_next_block()
+ * @param frame_length Length of the returned frame in bytes
+ * @return Pointer to the frame inside the ring or NULL if all frames of the block were processed
+ */
+uint8_t *db_rx_block_next_frame(db_rx_block_iter_t *iter, uint32_t *frame_length) {
+    if (iter->frames_left == 0)
+        return NULL;
+    struct tpacket3_hdr *frame_hdr = iter->frame_hdr;
+    *frame_length = frame_hdr->tp_snaplen;
+    iter->frames_left--;
+    iter->frame_hdr = (struct tpacket3_hdr *) ((uint8_t *) frame_hdr + frame_hdr->tp_next_offset);
+    return (uint8_t *) frame_hdr + frame_hdr->tp_mac;
+}
+
+/**
+ * Hands the block back to the kernel and advances the ring to the next block
+ *
+ * @param ring The receive ring
+ * @param iter Iterator of the block to be released
+ */
+void db_rx_ring_release_block(db_rx_ring_t *ring, db_rx_block_iter_t *iter) {
+    __atomic_store_n(&iter->block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+    ring->current_block = (ring->current_block + 1) % ring->block_nr;
+}
+
+/**
+ * Unmaps the receive ring. Socket must be closed separately
+ *
+ * @param ring The receive ring
+ */
+void close_rx_ring(db_rx_ring_t *ring) {
+    if (ring->map != NULL && ring->map != MAP_FAILED)
+        munmap(ring->map, ring->map_length);
+    ring->map = NULL;
+}
+
 /**
  * Extract RSSI value from radiotap header
  * 
  * @param payload_buffer Buffer containing the received packet data including radiotap header
  * @param radiotap_length Length of radiotap header
+ * @param plan Cached radiotap parse plan of the adapter that received the packet. NULL to always use the iterator
  * @return RSSI of received packet
  */
-int8_t get_rssi(uint8_t *payload_buffer, int radiotap_length) {
-    struct ieee80211_radiotap_iterator rti;
-    if (ieee80211_radiotap_iterator_init(&rti, (struct ieee80211_radiotap_header *) payload_buffer, radiotap_length,
-                                         NULL) < 0)
-        return 0;
-    while ((ieee80211_radiotap_iterator_next(&rti)) == 0) {
-        switch (rti.this_arg_index) {
-            case IEEE80211_RADIOTAP_DBM_ANTSIGNAL:
-                return (int8_t) (*rti.this_arg);
-            default:
-                break;
-        }
+int8_t get_rssi(uint8_t *payload_buffer, int radiotap_length, db_rt_plan_t *plan) {
+    db_rt_plan_t uncached_plan;
+    const db_rt_field_t *fields;
+    if (plan == NULL) {
+        db_rt_plan_init(&uncached_plan);
+        plan = &uncached_plan;
+    }
+    int num_fields = db_rt_get_fields(plan, payload_buffer, radiotap_length, &fields);
+    for (int i = 0; i < num_fields; i++) {
+        if (fields[i].index == IEEE80211_RADIOTAP_DBM_ANTSIGNAL)
+            return (int8_t) payload_buffer[fields[i].offset];
     }
     return 0;
 }
\ No newline at end of file
@@ -21,16 +21,54 @@
 #define STATUS_DB_RECEIVE_H
 
 #include <stdint.h>
+#include <sys/types.h>
 #include <net/if.h>
+#include <linux/if_packet.h>
+#include "db_protocol.h"
+#include "db_radiotap.h"
+
+#define DB_RX_RING_BLOCK_SIZE       (1 << 16)   // default size of a TPACKET_V3 ring block in bytes
+#define DB_RX_RING_BLOCK_NR         32          // default number of blocks of a TPACKET_V3 ring
+#define DB_RX_RING_BLOCK_TIMEOUT    1           // ms after which the kernel hands a not yet filled block to user space
+
+// PACKET_MMAP (TPACKET_V3) receive ring of a raw socket. Frames are read directly from the memory shared with the kernel
+typedef struct {
+    int socket_fd;
+    uint8_t *map;
+    size_t map_length;
+    unsigned int block_size;
+    unsigned int block_nr;
+    unsigned int current_block;
+} db_rx_ring_t;
+
+// Iterates over the frames of one ring block that is owned by user space
+typedef struct {
+    struct tpacket_block_desc *block;
+    struct tpacket3_hdr *frame_hdr;
+    uint32_t frames_left;
+} db_rx_block_iter_t;
 
 int setBPF(int newsocket, uint8_t new_comm_id, uint8_t direction, uint8_t port);
+int setBPF_all_ports(int newsocket, uint8_t new_comm_id, uint8_t direction);
 int bindsocket(int newsocket, char the_mode, char new_ifname[IFNAMSIZ]);
 void set_socket_nonblocking(int *the_socketfd);
 int set_socket_timeout(int the_socketfd, int time_out_s ,int time_out_us);
 uint16_t get_db_payload(uint8_t *receive_buffer, ssize_t receive_length, uint8_t *payload_buffer, uint8_t *seq_num,
         uint16_t *radiotap_length);
+uint8_t *get_db_payload_pointer(uint8_t *receive_buffer, ssize_t receive_length, uint16_t *payload_length,
+                                uint8_t *seq_num, uint16_t *radiotap_length);
+uint16_t get_db_payload_seq(uint8_t *receive_buffer, ssize_t receive_length, uint8_t *payload_buffer,
+                            db_seq_num_t *seq_num, uint16_t *radiotap_length);
+uint8_t *get_db_payload_pointer_seq(uint8_t *receive_buffer, ssize_t receive_length, uint16_t *payload_length,
+                                    db_seq_num_t *seq_num, uint16_t *radiotap_length);
+
+int setup_rx_ring(int the_socketfd, db_rx_ring_t *ring, unsigned int block_size, unsigned int block_nr);
+int db_rx_ring_next_block(db_rx_ring_t *ring, db_rx_block_iter_t *iter);
+uint8_t *db_rx_block_next_frame(db_rx_block_iter_t *iter, uint32_t *frame_length);
+void db_rx_ring_release_block(db_rx_ring_t *ring, db_rx_block_iter_t *iter);
+void close_rx_ring(db_rx_ring_t *ring);
 
-int8_t get_rssi(uint8_t *payload_buffer, int radiotap_length);
+int8_t get_rssi(uint8_t *payload_buffer, int radiotap_length, db_rt_plan_t *plan);
 uint8_t count_lost_packets(uint8_t last_seq_num, uint8_t received_seq_num);
 
 #endif //STATUS_DB_RECEIVE_H
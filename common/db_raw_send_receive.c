@@ -17,6 +17,7 @@
  *
  */
 
+#define _GNU_SOURCE // sendmmsg()
 #include <sys/socket.h>
 #include <stdint.h>
 #include <net/if.h>
@@ -28,11 +29,14 @@
 #include <linux/if_packet.h>
 #include <errno.h>
 #include <sys/ioctl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
 #include "db_protocol.h"
 #include "db_raw_send_receive.h"
 #include "db_raw_receive.h"
 #include "db_common.h"
 #include "db_utils.h"
+#include "db_emu.h"
 
 uint8_t radiotap_header_pre[] = {
         0x00, 0x00, // <-- radiotap version
@@ -43,6 +47,34 @@ uint8_t radiotap_header_pre[] = {
         0x00, 0x00, 0x00
 };
 
+static int raw_send_frames(void *transport_data, int socket_fd, struct mmsghdr *msgs, unsigned int num) {
+    if (num == 1)
+        return sendmsg(socket_fd, &msgs[0].msg_hdr, 0) > 0 ? 1 : -1;
+    return sendmmsg(socket_fd, msgs, num, 0);
+}
+
+static void raw_close(void *transport_data, int socket_fd) {
+    close(socket_fd);
+}
+
+// Injection via AF_PACKET socket bound to a WiFi adapter in monitor mode
+const db_transport_t db_transport_raw = {.name = "raw", .send_frames = raw_send_frames, .close = raw_close};
+
+static inline const db_transport_t *get_transport(const db_socket_t *a_db_socket) {
+    return a_db_socket->transport != NULL ? a_db_socket->transport : &db_transport_raw;
+}
+
+/**
+ * Checks if an optional socket feature based on AF_PACKET (rings, fanout) can be used with the transport of the socket
+ */
+static bool transport_supports_packet_mmap(const db_socket_t *a_db_socket, const char *feature) {
+    if (get_transport(a_db_socket) == &db_transport_raw)
+        return true;
+    LOG_SYS_STD(LOG_NOTICE, "DroneBridgeCommon: %s not supported by %s transport\n", feature,
+                get_transport(a_db_socket)->name);
+    return false;
+}
+
 const uint8_t frame_control_pre_rts[] =
         {
                 0xb4, 0x00, 0x00, 0x00
@@ -57,25 +89,16 @@ const uint8_t frame_control_pre_beacon[] =
                 0x80, 0x00, 0x00, 0x00
         };
 
-struct ifreq raw_if_idx;
-struct ifreq raw_if_mac;
-char interfaceName[IFNAMSIZ];
-struct sockaddr_ll socket_address;
-char mode = 'm';
-int db_raw_offset = 0; // offset between payload and DB raw header. Needed when drivers overwrite payload with 802.11 SQN
-
-// init packet structure
-uint8_t monitor_framebuffer[RADIOTAP_LENGTH + DB_RAW_V2_HEADER_LENGTH + DATA_UNI_LENGTH] = {0};
-struct radiotap_header *rth = (struct radiotap_header *) monitor_framebuffer;
-struct db_raw_v2_header_t *db_raw_header = (struct db_raw_v2_header_t *) (monitor_framebuffer + RADIOTAP_LENGTH);
-
 /**
- * Set the transmission bit rate in the radiotap header. Only works with ralink cards.
- * Can be used to change the bitrate before every transmission.
- * 
+ * Set the transmission bit rate in the radiotap header of the socket. Only works with ralink cards.
+ * Can be used to change the bitrate before every transmission. Must not be called while another thread sends on the
+ * same socket. Does not affect batches and TX rings that were already set up.
+ *
+ * @param a_db_socket The socket whose frame template gets updated
  * @param bitrate_option Bit rate in Mbps
  */
-void set_bitrate(int bitrate_option) {
+void set_bitrate(db_socket_t *a_db_socket, int bitrate_option) {
+    struct radiotap_header *rth = (struct radiotap_header *) a_db_socket->frame_template;
     switch (bitrate_option) {
         case 1:
             rth->bytes[8] = 0x02;
@@ -117,24 +140,25 @@ void set_bitrate(int bitrate_option) {
             rth->bytes[8] = 0x0c;
             LOG_SYS_STD(LOG_ERR, "DroneBridgeCommon: Wrong bitrate option. Setting to 6Mbps\n");
     }
+    memcpy(a_db_socket->frame_buffer, a_db_socket->frame_template, DB_FRAME_HEADER_LENGTH);
 }
 
 
 /**
- * Setup of the the DroneBridge raw protocol v2 header
- * 
- * @param comm_id
- * @param bitrate_option
- * @param frame_type
- * @param send_direction
+ * Sets up the frame template (radiotap + DroneBridge raw protocol v2 header) and the send buffer of a socket
+ *
+ * @param new_socket Socket whose frame template gets set up
+ * @param comm_id The communication ID
+ * @param bitrate_option Transmission bit rate
+ * @param send_direction Are the sent packets for the drone or the ground station
  * @param frame_type The type of raw frame being sent: 1=RTS, 2=DATA
- * @return The socket file descriptor in case of a success or -1 if we screwed up
  */
-int conf_monitor(int sockfd, uint8_t comm_id, int bitrate_option, uint8_t send_direction, uint8_t new_port,
-                 uint8_t frame_type) {
-    memset(monitor_framebuffer, 0, (RADIOTAP_LENGTH + DB_RAW_V2_HEADER_LENGTH + DATA_UNI_LENGTH));
-    memcpy(rth->bytes, radiotap_header_pre, RADIOTAP_LENGTH);
-    set_bitrate(bitrate_option);
+void init_frame_template(db_socket_t *new_socket, uint8_t comm_id, int bitrate_option, uint8_t send_direction,
+                         uint8_t frame_type) {
+    struct db_raw_v2_header_t *db_raw_header = (struct db_raw_v2_header_t *) (new_socket->frame_template +
+                                                                              RADIOTAP_LENGTH);
+    memcpy(new_socket->frame_template, radiotap_header_pre, RADIOTAP_LENGTH);
+    set_bitrate(new_socket, bitrate_option);
     // build custom DroneBridge v2 header
     switch (frame_type) {
         case DB_FRAMETYPE_RTS:
@@ -151,14 +175,34 @@ int conf_monitor(int sockfd, uint8_t comm_id, int bitrate_option, uint8_t send_d
     }
     db_raw_header->direction = send_direction;
     db_raw_header->comm_id = comm_id;
-    if (setsockopt(sockfd, SOL_SOCKET, SO_BINDTODEVICE, interfaceName, IFNAMSIZ) < 0) {
+    memcpy(new_socket->frame_buffer, new_socket->frame_template, DB_FRAME_HEADER_LENGTH);
+}
+
+/**
+ * Setup of the frame template (radiotap + DroneBridge raw protocol v2 header) of the socket
+ * 
+ * @param new_socket Socket whose frame template and address get set up
+ * @param sockfd
+ * @param ifName Name of the network interface the socket is bound to
+ * @param ifindex Index of the network interface
+ * @param comm_id
+ * @param bitrate_option
+ * @param send_direction
+ * @param new_port Port the BPF filter gets set to
+ * @param frame_type The type of raw frame being sent: 1=RTS, 2=DATA
+ * @return The socket file descriptor in case of a success or -1 if we screwed up
+ */
+int conf_monitor(db_socket_t *new_socket, int sockfd, char *ifName, int ifindex, uint8_t comm_id, int bitrate_option,
+                 uint8_t send_direction, uint8_t new_port, uint8_t frame_type) {
+    init_frame_template(new_socket, comm_id, bitrate_option, send_direction, frame_type);
+    if (setsockopt(sockfd, SOL_SOCKET, SO_BINDTODEVICE, ifName, (socklen_t) strnlen(ifName, IFNAMSIZ)) < 0) {
         LOG_SYS_STD(LOG_ERR,
                     "DroneBridgeCommon: Error binding monitor socket to interface. Closing socket. Please restart.\n");
         close(sockfd);
         return -1;
     }
     /* Index of the network device */
-    socket_address.sll_ifindex = raw_if_idx.ifr_ifindex;
+    new_socket->db_socket_addr.sll_ifindex = ifindex;
     uint8_t recv_direction = (uint8_t) ((send_direction == DB_DIREC_DRONE) ? DB_DIREC_GROUND : DB_DIREC_DRONE);
     sockfd = setBPF(sockfd, comm_id, recv_direction, new_port);
     clear_socket_buffer(sockfd);
@@ -176,14 +220,25 @@ int conf_monitor(int sockfd, uint8_t comm_id, int bitrate_option, uint8_t send_d
  * @param send_direction Are the sent packets for the drone or the ground station
  * @param receive_new_port Port the BPF filter gets set to. Port open for receiving data.
  * @param frame_type The type of raw frame being sent: 1=RTS, 2=DATA
- * @return the socket file descriptor or -1 if something went wrong
+ * @return The socket with its own frame template. db_socket is set to -1 if something went wrong
  */
 db_socket_t open_db_socket(char *ifName, uint8_t comm_id, char trans_mode, int bitrate_option,
                            uint8_t send_direction, uint8_t receive_new_port, uint8_t frame_type) {
-    mode = trans_mode;
+    struct ifreq raw_if_idx;
+    struct ifreq raw_if_mac;
     db_socket_t new_socket;
+    memset(&new_socket, 0, sizeof(db_socket_t));
+    new_socket.rx_ring = NULL;
+    new_socket.tx_ring = NULL;
+    new_socket.transport = &db_transport_raw;
+    if (db_emu_is_emu_if(ifName)) {
+        uint8_t recv_direction = (uint8_t) ((send_direction == DB_DIREC_DRONE) ? DB_DIREC_GROUND : DB_DIREC_DRONE);
+        init_frame_template(&new_socket, comm_id, bitrate_option, send_direction, frame_type);
+        new_socket.db_socket = db_emu_open(&new_socket, ifName, comm_id, recv_direction, receive_new_port);
+        return new_socket;
+    }
     int socket_fd;
-    if (mode == 'w') {
+    if (trans_mode == 'w') {
         // TODO: ignore for now. I will be UDP in future.
         if ((socket_fd = socket(AF_PACKET, SOCK_RAW, IPPROTO_RAW)) == -1) {
             perror("DroneBridgeCommon: Error opening raw interface for WiFi mode ");
@@ -222,13 +277,106 @@ db_socket_t open_db_socket(char *ifName, uint8_t comm_id, char trans_mode, int b
         return new_socket;
         //return conf_ethernet(dest_mac);
     } else {
-        new_socket.db_socket = conf_monitor(socket_fd, comm_id, bitrate_option, send_direction, receive_new_port,
-                                            frame_type);
-        new_socket.db_socket_addr = socket_address;
+        new_socket.db_socket = conf_monitor(&new_socket, socket_fd, ifName, raw_if_idx.ifr_ifindex, comm_id,
+                                            bitrate_option, send_direction, receive_new_port, frame_type);
         return new_socket;
     }
 }
 
+/**
+ * Closes a socket opened by open_db_socket() including its transport backend. Frames queued by the backend are sent
+ * first. Rings must be disabled/closed before.
+ *
+ * @param a_db_socket Socket returned by open_db_socket()
+ */
+void close_db_socket(db_socket_t *a_db_socket) {
+    if (a_db_socket->db_socket < 0)
+        return;
+    get_transport(a_db_socket)->close(a_db_socket->transport_data, a_db_socket->db_socket);
+    a_db_socket->db_socket = -1;
+    a_db_socket->transport_data = NULL;
+}
+
+/**
+ * Optional: Switches an opened DB raw socket to PACKET_MMAP (TPACKET_V3) receive mode. Frames are no longer received
+ * via recv() but read directly from the ring shared with the kernel (see db_rx_ring_next_block()). This saves one
+ * syscall per frame and the copy into a user space buffer. Sending is not affected.
+ *
+ * @param a_db_socket Socket returned by open_db_socket()
+ * @param block_size Size of a ring block in bytes (e.g. DB_RX_RING_BLOCK_SIZE). Must be a multiple of the page size
+ * @param block_nr Number of ring blocks (e.g. DB_RX_RING_BLOCK_NR)
+ * @return 0 on success or -1 on failure. Socket stays usable with recv() in case of a failure
+ */
+int db_socket_enable_rx_ring(db_socket_t *a_db_socket, unsigned int block_size, unsigned int block_nr) {
+    if (!transport_supports_packet_mmap(a_db_socket, "Receive ring"))
+        return -1;
+    db_rx_ring_t *ring = malloc(sizeof(db_rx_ring_t));
+    if (ring == NULL || setup_rx_ring(a_db_socket->db_socket, ring, block_size, block_nr) < 0) {
+        LOG_SYS_STD(LOG_ERR, "DroneBridgeCommon: Could not enable receive ring. Falling back to recv()\n");
+        free(ring);
+        return -1;
+    }
+    a_db_socket->rx_ring = ring;
+    return 0;
+}
+
+/**
+ * Optional: Stops the kernel from delivering received frames to the socket. The socket is then only used for sending.
+ * Used by modules that receive their frames from the link daemon (see db_link.h) so that received frames are not
+ * cloned to the socket of every module.
+ *
+ * @param a_db_socket Socket returned by open_db_socket()
+ * @return 0 on success or -1 on failure
+ */
+int db_socket_disable_rx(db_socket_t *a_db_socket) {
+    if (!transport_supports_packet_mmap(a_db_socket, "Disabling receive"))
+        return -1;
+    // binding to protocol 0 removes the socket from the receive path of the interface
+    struct sockaddr_ll sll = {.sll_family = AF_PACKET, .sll_protocol = 0,
+                              .sll_ifindex = a_db_socket->db_socket_addr.sll_ifindex};
+    if (bind(a_db_socket->db_socket, (struct sockaddr *) &sll, sizeof(sll)) == -1) {
+        LOG_SYS_STD(LOG_ERR, "DroneBridgeCommon: Could not disable receiving on socket: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Optional: Adds the socket to a PACKET_FANOUT group. The kernel then delivers every received frame to only one socket
+ * of the group, chosen by a classic BPF program (PACKET_FANOUT_CBPF) that returns the index of the socket in the group.
+ * Sockets get their index in the order they join. All sockets of a group must be bound to the same interface.
+ *
+ * @param a_db_socket Socket returned by open_db_socket()
+ * @param group_id ID of the group to join. Set to 0 to create a new group with an unused ID, the ID is returned
+ * @param steering_program Program run on every received frame. Returned value is taken modulo the group size
+ * @return 0 on success or -1 on failure
+ */
+int db_socket_join_fanout(db_socket_t *a_db_socket, uint16_t *group_id, const struct sock_fprog *steering_program) {
+    if (!transport_supports_packet_mmap(a_db_socket, "PACKET_FANOUT"))
+        return -1;
+    int fanout_arg = *group_id | (PACKET_FANOUT_CBPF << 16);
+    if (*group_id == 0)
+        fanout_arg |= PACKET_FANOUT_FLAG_UNIQUEID << 16;
+    if (setsockopt(a_db_socket->db_socket, SOL_PACKET, PACKET_FANOUT, &fanout_arg, sizeof(fanout_arg)) < 0) {
+        LOG_SYS_STD(LOG_ERR, "DroneBridgeCommon: Could not join fanout group: %s\n", strerror(errno));
+        return -1;
+    }
+    if (*group_id == 0) {
+        socklen_t arg_length = sizeof(fanout_arg);
+        if (getsockopt(a_db_socket->db_socket, SOL_PACKET, PACKET_FANOUT, &fanout_arg, &arg_length) < 0) {
+            LOG_SYS_STD(LOG_ERR, "DroneBridgeCommon: Could not get fanout group ID: %s\n", strerror(errno));
+            return -1;
+        }
+        *group_id = (uint16_t) (fanout_arg & 0xffff);
+    }
+    if (setsockopt(a_db_socket->db_socket, SOL_PACKET, PACKET_FANOUT_DATA, steering_program,
+                   sizeof(struct sock_fprog)) < 0) {
+        LOG_SYS_STD(LOG_ERR, "DroneBridgeCommon: Could not set fanout program: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
 /**
  * Increases/Updates an existing sequence number so that it can be used to send a new packet over long range socket.
  * Sequence numbers range from 0-255
@@ -241,23 +389,22 @@ uint8_t update_seq_num(uint8_t *old_seq_num) {
 }
 
 /**
- * Returns a pointer to the buffer that gets sent when calling send_packet_hp(..) or send_packet_hp_div(...)
+ * Returns a pointer to the payload inside the send buffer of the socket that gets sent when calling db_send_hp_div()
+ * @param a_db_socket: The socket owning the send buffer
  * @param adhere_to_80211_header: Set to 1 to enable. Offsets the payload by some bytes so that it sits outside the
  * 802.11 header. This is required since some drivers (Ubuntu Atheros drivers) write a sequence number to the 802.11
  * header on receive. Without offsetting the payload this sequence number would overwrite 2 bytes of the payload and
  * corrupt it. The receiver will be able to auto detect the offset. Set this to 1 if you are using a non DB-Rasp Kernel!
  * This will make the packet longer!
- * @return: A pointer to the buffer that gets sent when calling send_packet_hp(..) or send_packet_hp_div(...)
+ * @return: A pointer to the payload that gets sent when calling db_send_hp_div()
  */
-struct data_uni *get_hp_raw_buffer(int adhere_to_80211_header) {
-    if (adhere_to_80211_header) {
-        db_raw_offset = DB_RAW_OFFSET;
-        return (struct data_uni *) (monitor_framebuffer + RADIOTAP_LENGTH + DB_RAW_V2_HEADER_LENGTH + DB_RAW_OFFSET);
-    } else
-        return (struct data_uni *) (monitor_framebuffer + RADIOTAP_LENGTH + DB_RAW_V2_HEADER_LENGTH);
+struct data_uni *get_hp_raw_buffer(db_socket_t *a_db_socket, int adhere_to_80211_header) {
+    a_db_socket->payload_offset = adhere_to_80211_header ? DB_RAW_OFFSET : 0;
+    return (struct data_uni *) (a_db_socket->frame_buffer + DB_FRAME_HEADER_LENGTH + a_db_socket->payload_offset);
 }
 
-static inline void check_payload_length(const uint16_t *payload_length) {
+static inline void check_payload_length(const struct db_raw_v2_header_t *db_raw_header,
+                                        const uint16_t *payload_length) {
     if (*payload_length < DB_MIN_PAYLOAD_LENGTH_RTS && db_raw_header->fcf_duration[0] == 0xb4)
         LOG_SYS_STD(LOG_ERR, "DroneBridgeCommon: Payload too short (<%i) for specified frame type\n",
                     DB_MIN_PAYLOAD_LENGTH_RTS);
@@ -267,30 +414,80 @@ static inline void check_payload_length(const uint16_t *payload_length) {
                     DB_MIN_PAYLOAD_LENGTH_DATA_BEACON);
 }
 
+/**
+ * Sets the frame specific fields of a DroneBridge raw protocol v2 header
+ */
+static inline void set_db_raw_header(struct db_raw_v2_header_t *db_raw_header, uint8_t dest_port,
+                                     uint16_t payload_length, uint8_t new_seq_num) {
+    check_payload_length(db_raw_header, &payload_length);
+    db_raw_header->payload_length[0] = (uint8_t) (payload_length & (uint8_t) 0xFF);
+    db_raw_header->payload_length[1] = (uint8_t) ((payload_length >> (uint8_t) 8) & (uint8_t) 0xFF);
+    db_raw_header->port = dest_port;
+    db_raw_header->seq_num = new_seq_num;
+}
+
+/**
+ * Marks a DroneBridge raw protocol v2 header as extended and fills the extension that follows it with the stream ID and
+ * the upper 24 bit of the sequence number. Call after set_db_raw_header().
+ */
+static inline void set_db_raw_ext_header(struct db_raw_v2_header_t *db_raw_header, uint8_t stream_id,
+                                         uint32_t new_seq_num) {
+    struct db_raw_v2_ext_header_t *ext_header = (struct db_raw_v2_ext_header_t *) (db_raw_header + 1);
+    db_raw_header->payload_length[1] |= (uint8_t) (DB_RAW_EXT_SEQ_FLAG >> 8u);
+    ext_header->stream_id = stream_id;
+    ext_header->seq_num_high[0] = (uint8_t) (new_seq_num >> 8u);
+    ext_header->seq_num_high[1] = (uint8_t) (new_seq_num >> 16u);
+    ext_header->seq_num_high[2] = (uint8_t) (new_seq_num >> 24u);
+}
+
+/**
+ * Enables/Disables the extended DB raw header for frames sent with db_send_div() on this socket. The extended header
+ * carries the full 32 bit sequence number. Receivers (get_db_payload_pointer_seq()) detect it automatically.
+ * db_send_hp_div(), batches and the TX ring always send 8 bit sequence numbers.
+ *
+ * @param a_db_socket The socket
+ * @param enable true to send 32 bit sequence numbers
+ * @param stream_id DB_STREAM_DEFAULT or, if more than one module sends to the destination port, a unique DB_STREAM_*
+ */
+void db_socket_set_ext_seq_num(db_socket_t *a_db_socket, bool enable, uint8_t stream_id) {
+    a_db_socket->ext_seq_num = enable;
+    a_db_socket->stream_id = stream_id;
+}
+
 /**
  * This function works the same as send_packet with the difference that it allows for soft. diversity transmission.
  * You can specify a socket (bound to an interface) that should be used to send the packet.
- * Overwrites payload set inside monitor_framebuffer with the provided payload.
- * @param payload: The payload bytes of the message to be sent. Does use memcpy to write payload into buffer.
+ * The frame header is built on the stack from the frame template of the socket and sent together with the payload
+ * (scatter/gather), so the payload is not copied and the function can be called from multiple threads in parallel.
+ * @param payload: The payload bytes of the message to be sent. Not copied. The same buffer can be sent on all sockets
  * @param dest_port: The DroneBridge destination port of the message (see db_protocol.h)
  * @param payload_length: The length of the payload in bytes
- * @param new_seq_num: Specify the sequence number of the packet
+ * @param new_seq_num: Specify the sequence number of the packet. Only the lower 8 bits are sent unless the extended
+ *                      header is enabled on the socket (see db_socket_set_ext_seq_num()). Send the same sequence number
+ *                      on all sockets so that receivers can detect the duplicates
  * @param adhere_80211_header: Set to 1 to enable. Offsets the payload by some bytes so that it sits outside the
  *                               802.11 header. Set this to 1 if you are using a non DB-Rasp Kernel!
  * @return: 0 on success or -1 on failure
  */
 int db_send_div(db_socket_t *a_db_socket, uint8_t *payload, uint8_t dest_port, uint16_t payload_length,
-                uint8_t new_seq_num, int adhere_80211_header) {
-    check_payload_length(&payload_length);
-    db_raw_header->payload_length[0] = (uint8_t) (payload_length & (uint8_t) 0xFF);
-    db_raw_header->payload_length[1] = (uint8_t) ((payload_length >> (uint8_t) 8) & (uint8_t) 0xFF);
-    db_raw_header->port = dest_port;
-    db_raw_header->seq_num = new_seq_num;
-    struct data_uni *monitor_databuffer_internal = get_hp_raw_buffer(adhere_80211_header);
-    memcpy(monitor_databuffer_internal->bytes, payload, payload_length);
-    if (sendto(a_db_socket->db_socket, monitor_framebuffer, (size_t) (RADIOTAP_LENGTH + DB_RAW_V2_HEADER_LENGTH +
-                                                                      payload_length + db_raw_offset), 0,
-               (struct sockaddr *) &a_db_socket->db_socket_addr, sizeof(struct sockaddr_ll)) <= 0) {
+                uint32_t new_seq_num, int adhere_80211_header) {
+    uint8_t frame_header[DB_FRAME_HEADER_LENGTH + DB_RAW_OFFSET] = {0};
+    memcpy(frame_header, a_db_socket->frame_template, DB_FRAME_HEADER_LENGTH);
+    struct db_raw_v2_header_t *db_raw_header = (struct db_raw_v2_header_t *) (frame_header + RADIOTAP_LENGTH);
+    set_db_raw_header(db_raw_header, dest_port, payload_length, (uint8_t) new_seq_num);
+    size_t header_length = DB_FRAME_HEADER_LENGTH + (adhere_80211_header ? DB_RAW_OFFSET : 0);
+    if (a_db_socket->ext_seq_num) {
+        set_db_raw_ext_header(db_raw_header, a_db_socket->stream_id, new_seq_num);
+        if (!adhere_80211_header)   // otherwise the extension sits inside the offset
+            header_length += DB_RAW_EXT_HEADER_LENGTH;
+    }
+    struct iovec iov[2] = {
+            {.iov_base = frame_header, .iov_len = header_length},
+            {.iov_base = payload, .iov_len = payload_length}
+    };
+    struct mmsghdr msg = {.msg_hdr = {.msg_name = &a_db_socket->db_socket_addr,
+                                      .msg_namelen = sizeof(struct sockaddr_ll), .msg_iov = iov, .msg_iovlen = 2}};
+    if (get_transport(a_db_socket)->send_frames(a_db_socket->transport_data, a_db_socket->db_socket, &msg, 1) <= 0) {
         LOG_SYS_STD(LOG_ERR, "DroneBridgeCommon: Send failed (monitor): %s\n", strerror(errno));
         return -1;
     }
@@ -300,32 +497,319 @@ int db_send_div(db_socket_t *a_db_socket, uint8_t *payload, uint8_t dest_port, u
 /**
  * This function works the same as send_packet_hp with the difference that it allows for soft. diversity transmission.
  * You can specify a socket (bound to an interface) that should be used to send the packet.
- * Use this function for maximum performance. No memcpy used. Create a pointer directly pointing inside the
- * monitor_framebuffer array in your script. Fill that with your payload and call this function.
- * This function only sends the monitor_framebuffer. You need to make sure you get the payload inside it.
- * E.g. This will create such a pointer structure:
+ * No memcpy used. Sends the send buffer of the socket in one piece. Get a pointer to the payload inside the send
+ * buffer with get_hp_raw_buffer(), fill it with your payload and call this function. Every socket has its own send
+ * buffer, use db_send_div() to send the same payload on multiple sockets. E.g.:
  *
- *     struct data_uni *data_uni_to_ground = (struct data_uni *)
- *           (monitor_framebuffer + RADIOTAP_LENGTH + DB_RAW_V2_HEADER_LENGTH);
+ *     struct data_uni *data_uni_to_ground = get_hp_raw_buffer(&a_db_socket, 0);
  *     memset(data_uni_to_ground->bytes, 0xff, DATA_UNI_LENGTH); // set some payload
  *
- * Make sure you update your data every time before sending.
+ * Make sure you update your data every time before sending. Only one thread may use this function per socket.
+ * @param a_db_socket The socket the send buffer of which gets sent
  * @param dest_port The DroneBridge destination port of the message (see db_protocol.h)
  * @param payload_length The length of the payload in bytes
  * @param new_seq_num Specify the sequence number of the packet
  * @return 0 on success or -1 on failure
  */
 int db_send_hp_div(db_socket_t *a_db_socket, uint8_t dest_port, uint16_t payload_length, uint8_t new_seq_num) {
-    check_payload_length(&payload_length);
-    db_raw_header->payload_length[0] = (uint8_t) (payload_length & (uint8_t) 0xFF);
-    db_raw_header->payload_length[1] = (uint8_t) ((payload_length >> (uint8_t) 8) & (uint8_t) 0xFF);
-    db_raw_header->port = dest_port;
-    db_raw_header->seq_num = new_seq_num;
-    if (sendto(a_db_socket->db_socket, monitor_framebuffer,
-               (size_t) (RADIOTAP_LENGTH + DB_RAW_V2_HEADER_LENGTH + payload_length + db_raw_offset), 0,
-               (struct sockaddr *) &a_db_socket->db_socket_addr, sizeof(struct sockaddr_ll)) <= 0) {
+    if (payload_length > DATA_UNI_LENGTH)
+        return -1;
+    set_db_raw_header((struct db_raw_v2_header_t *) (a_db_socket->frame_buffer + RADIOTAP_LENGTH), dest_port,
+                      payload_length, new_seq_num);
+    struct iovec iov = {.iov_base = a_db_socket->frame_buffer,
+                        .iov_len = DB_FRAME_HEADER_LENGTH + a_db_socket->payload_offset + payload_length};
+    struct mmsghdr msg = {.msg_hdr = {.msg_name = &a_db_socket->db_socket_addr,
+                                      .msg_namelen = sizeof(struct sockaddr_ll), .msg_iov = &iov, .msg_iovlen = 1}};
+    if (get_transport(a_db_socket)->send_frames(a_db_socket->transport_data, a_db_socket->db_socket, &msg, 1) <= 0) {
         LOG_SYS_STD(LOG_ERR, "DroneBridgeCommon: Send failed (monitor): %s\n", strerror(errno));
         return -1;
     }
     return 0;
-}
\ No newline at end of file
+}
+
+/**
+ * Prepares a batch of frames for db_send_batch_div(). Copies the frame template (radiotap header and DroneBridge raw
+ * protocol v2 header) of the socket into every frame header. The batch can be sent on all sockets that were opened
+ * with the same comm id, direction and frame type.
+ *
+ * @param batch The batch to be initialized
+ * @param a_db_socket Socket opened by open_db_socket() providing the frame template
+ * @param adhere_80211_header Set to 1 to enable. Offsets the payload by some bytes so that it sits outside the
+ *                            802.11 header. Set this to 1 if you are using a non DB-Rasp Kernel!
+ */
+void db_batch_init(db_frame_batch_t *batch, db_socket_t *a_db_socket, int adhere_80211_header) {
+    memset(batch, 0, sizeof(db_frame_batch_t));
+    batch->payload_offset = adhere_80211_header ? DB_RAW_OFFSET : 0;
+    for (int i = 0; i < DB_MAX_BATCH_FRAMES; i++) {
+        memcpy(batch->frame_headers[i], a_db_socket->frame_template, DB_FRAME_HEADER_LENGTH);
+        batch->iov[i][0].iov_base = batch->frame_headers[i];
+    }
+}
+
+/**
+ * Removes all frames from the batch. Frame headers stay initialized.
+ *
+ * @param batch The batch to be reset
+ */
+void db_batch_reset(db_frame_batch_t *batch) {
+    batch->num_frames = 0;
+}
+
+/**
+ * Adds a frame to the batch. The DroneBridge raw header is built inside the pre-allocated frame header of the batch.
+ * The payload is not copied. It must stay valid until db_send_batch_div() was called for all sockets.
+ *
+ * @param batch The batch the frame gets added to
+ * @param dest_port The DroneBridge destination port of the frame (see db_protocol.h)
+ * @param new_seq_num Sequence number of the DroneBridge raw header
+ * @param prefix Optional module specific header that is copied in front of the payload (e.g. video_packet_header_t).
+ *               Can be NULL
+ * @param prefix_length Length of prefix in bytes. Max DB_BATCH_MAX_PREFIX_LENGTH
+ * @param payload The payload of the frame
+ * @param payload_length Length of the payload in bytes
+ * @return 0 on success or -1 if the batch is full, the prefix is too long or prefix and payload exceed
+ *         DATA_UNI_LENGTH
+ */
+int db_batch_add(db_frame_batch_t *batch, uint8_t dest_port, uint8_t new_seq_num, const uint8_t *prefix,
+                 uint16_t prefix_length, uint8_t *payload, uint16_t payload_length) {
+    if (batch->num_frames >= DB_MAX_BATCH_FRAMES || prefix_length > DB_BATCH_MAX_PREFIX_LENGTH) {
+        LOG_SYS_STD(LOG_ERR, "DroneBridgeCommon: Can not add frame to batch (full or prefix too long)\n");
+        return -1;
+    }
+    if (prefix_length + payload_length > DATA_UNI_LENGTH) {
+        LOG_SYS_STD(LOG_ERR, "DroneBridgeCommon: Can not add frame to batch (payload too long: %i bytes)\n",
+                    prefix_length + payload_length);
+        return -1;
+    }
+    uint8_t *frame_header = batch->frame_headers[batch->num_frames];
+    struct db_raw_v2_header_t *batch_raw_header = (struct db_raw_v2_header_t *) (frame_header + RADIOTAP_LENGTH);
+    uint16_t db_payload_length = prefix_length + payload_length;
+    check_payload_length(batch_raw_header, &db_payload_length);
+    batch_raw_header->payload_length[0] = (uint8_t) (db_payload_length & (uint8_t) 0xFF);
+    batch_raw_header->payload_length[1] = (uint8_t) ((db_payload_length >> (uint8_t) 8) & (uint8_t) 0xFF);
+    batch_raw_header->port = dest_port;
+    batch_raw_header->seq_num = new_seq_num;
+    if (prefix_length > 0)
+        memcpy(frame_header + RADIOTAP_LENGTH + DB_RAW_V2_HEADER_LENGTH + batch->payload_offset, prefix,
+               prefix_length);
+
+    batch->iov[batch->num_frames][0].iov_len = (size_t) (RADIOTAP_LENGTH + DB_RAW_V2_HEADER_LENGTH +
+                                                         batch->payload_offset + prefix_length);
+    batch->iov[batch->num_frames][1].iov_base = payload;
+    batch->iov[batch->num_frames][1].iov_len = payload_length;
+    batch->num_frames++;
+    return 0;
+}
+
+/**
+ * Injects all frames of the batch on the specified socket using as few sendmmsg() calls as possible. Call once per
+ * socket (adapter) for soft. diversity transmission. Each call increases batch->syscall_cnt.
+ *
+ * @param a_db_socket The socket (bound to an interface) the frames get sent on
+ * @param batch The batch of frames to be injected
+ * @return Number of frames that were sent or -1 on failure
+ */
+int db_send_batch_div(db_socket_t *a_db_socket, db_frame_batch_t *batch) {
+    if (batch->num_frames == 0)
+        return 0;
+    struct mmsghdr msgs[batch->num_frames];
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < batch->num_frames; i++) {
+        msgs[i].msg_hdr.msg_name = &a_db_socket->db_socket_addr;
+        msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_ll);
+        msgs[i].msg_hdr.msg_iov = batch->iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 2;
+    }
+    int sent = 0;
+    while (sent < batch->num_frames) {
+        int ret = get_transport(a_db_socket)->send_frames(a_db_socket->transport_data, a_db_socket->db_socket,
+                                                          &msgs[sent], (unsigned int) (batch->num_frames - sent));
+        batch->syscall_cnt++;
+        if (ret <= 0) {
+            LOG_SYS_STD(LOG_ERR, "DroneBridgeCommon: Batch send failed (monitor) after %i/%i frames: %s\n", sent,
+                        batch->num_frames, strerror(errno));
+            return sent > 0 ? sent : -1;
+        }
+        sent += ret;
+    }
+    return sent;
+}
+
+static inline struct tpacket2_hdr *tx_ring_frame(db_tx_ring_t *ring, unsigned int index) {
+    return (struct tpacket2_hdr *) (ring->map + ((ring->current_frame + index) % ring->frame_nr) * ring->frame_size);
+}
+
+static inline uint8_t *tx_ring_frame_data(struct tpacket2_hdr *frame) {
+    return (uint8_t *) frame + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll);
+}
+
+/**
+ * Optional: Sets up a PACKET_MMAP (TPACKET_V2) transmit ring on an opened DB raw socket. Every frame slot gets
+ * pre-stamped with the frame template (radiotap header and DroneBridge raw protocol v2 header) of the socket. Fill the payload of the frames
+ * directly inside the ring (db_tx_ring_get_payload()), commit them and send all committed frames with a single
+ * syscall (db_send_tx_ring()). Can not be combined with a TPACKET_V3 receive ring on the same socket.
+ *
+ * @param a_db_socket Socket returned by open_db_socket()
+ * @param frame_nr Number of frames of the ring (e.g. DB_TX_RING_FRAME_NR)
+ * @param adhere_80211_header Set to 1 to enable. Offsets the payload by some bytes so that it sits outside the
+ *                            802.11 header. Set this to 1 if you are using a non DB-Rasp Kernel!
+ * @return 0 on success or -1 on failure. Socket can still be used with the other send functions in case of a failure
+ */
+int db_socket_enable_tx_ring(db_socket_t *a_db_socket, unsigned int frame_nr, int adhere_80211_header) {
+    if (!transport_supports_packet_mmap(a_db_socket, "Transmit ring"))
+        return -1;
+    int version = TPACKET_V2, discard_malformed = 1;
+    if (setsockopt(a_db_socket->db_socket, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0 ||
+        setsockopt(a_db_socket->db_socket, SOL_PACKET, PACKET_LOSS, &discard_malformed, sizeof(discard_malformed)) < 0) {
+        LOG_SYS_STD(LOG_ERR, "DroneBridgeCommon: Could not configure socket for TX ring: %s\n", strerror(errno));
+        return -1;
+    }
+    // one frame per page. Biggest DB raw frame + TPACKET header fits easily
+    unsigned int frame_size = (unsigned int) getpagesize();
+    while (frame_size < TPACKET2_HDRLEN + MAX_DB_DATA_LENGTH + DB_RAW_OFFSET)
+        frame_size *= 2;
+    struct tpacket_req req;
+    req.tp_block_size = frame_size;
+    req.tp_block_nr = frame_nr;
+    req.tp_frame_size = frame_size;
+    req.tp_frame_nr = frame_nr;
+    if (setsockopt(a_db_socket->db_socket, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) < 0) {
+        LOG_SYS_STD(LOG_ERR, "DroneBridgeCommon: Could not set up PACKET_TX_RING: %s\n", strerror(errno));
+        return -1;
+    }
+    db_tx_ring_t *ring = malloc(sizeof(db_tx_ring_t));
+    if (ring == NULL)
+        return -1;
+    ring->map_length = (size_t) frame_size * frame_nr;
+    ring->map = mmap(NULL, ring->map_length, PROT_READ | PROT_WRITE, MAP_SHARED, a_db_socket->db_socket, 0);
+    if (ring->map == MAP_FAILED) {
+        LOG_SYS_STD(LOG_ERR, "DroneBridgeCommon: Could not mmap TX ring: %s\n", strerror(errno));
+        memset(&req, 0, sizeof(req));
+        setsockopt(a_db_socket->db_socket, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req));
+        free(ring);
+        return -1;
+    }
+    ring->socket_fd = a_db_socket->db_socket;
+    ring->frame_size = frame_size;
+    ring->frame_nr = frame_nr;
+    ring->current_frame = 0;
+    ring->payload_offset = adhere_80211_header ? DB_RAW_OFFSET : 0;
+    // pre-stamp all frames with the frame template of the socket
+    for (unsigned int i = 0; i < frame_nr; i++) {
+        uint8_t *frame_data = tx_ring_frame_data(tx_ring_frame(ring, i));
+        memset(frame_data, 0, DB_FRAME_HEADER_LENGTH + DB_RAW_OFFSET);
+        memcpy(frame_data, a_db_socket->frame_template, DB_FRAME_HEADER_LENGTH);
+    }
+    a_db_socket->tx_ring = ring;
+    return 0;
+}
+
+/**
+ * Returns a pointer to the payload area of a frame of the TX ring. Waits for the kernel to release the frame in case
+ * it was not sent yet.
+ *
+ * @param ring The TX ring
+ * @param index Index of the frame relative to the first frame that was not yet sent (0 for the next frame to be sent)
+ * @return Pointer to the payload area (max DATA_UNI_LENGTH bytes) or NULL if the kernel did not release the frame
+ * within DB_TX_RING_WAIT_US
+ */
+uint8_t *db_tx_ring_get_payload(db_tx_ring_t *ring, unsigned int index) {
+    struct tpacket2_hdr *frame = tx_ring_frame(ring, index);
+    int waited_us = 0;
+    uint32_t status;
+    while ((status = __atomic_load_n(&frame->tp_status, __ATOMIC_ACQUIRE)) != TP_STATUS_AVAILABLE) {
+        if (status & TP_STATUS_WRONG_FORMAT) {
+            LOG_SYS_STD(LOG_ERR, "DroneBridgeCommon: Kernel rejected malformed frame in TX ring\n");
+            __atomic_store_n(&frame->tp_status, TP_STATUS_AVAILABLE, __ATOMIC_RELEASE);
+            break;
+        }
+        if (waited_us >= DB_TX_RING_WAIT_US)
+            return NULL;
+        send(ring->socket_fd, NULL, 0, MSG_DONTWAIT); // make sure the kernel works on pending frames
+        usleep(50);
+        waited_us += 50;
+    }
+    return tx_ring_frame_data(frame) + RADIOTAP_LENGTH + DB_RAW_V2_HEADER_LENGTH + ring->payload_offset;
+}
+
+/**
+ * Marks a frame of the TX ring as ready to be sent. The payload must be written via db_tx_ring_get_payload() before.
+ * Frame gets sent with the next call of db_send_tx_ring().
+ *
+ * @param ring The TX ring
+ * @param index Index of the frame relative to the first frame that was not yet sent
+ * @param dest_port The DroneBridge destination port of the frame (see db_protocol.h)
+ * @param payload_length Length of the payload in bytes
+ * @param new_seq_num Sequence number of the DroneBridge raw header
+ * @return 0 on success or -1 if payload is too long
+ */
+int db_tx_ring_commit(db_tx_ring_t *ring, unsigned int index, uint8_t dest_port, uint16_t payload_length,
+                      uint8_t new_seq_num) {
+    if (payload_length > DATA_UNI_LENGTH)
+        return -1;
+    struct tpacket2_hdr *frame = tx_ring_frame(ring, index);
+    struct db_raw_v2_header_t *ring_raw_header = (struct db_raw_v2_header_t *) (tx_ring_frame_data(frame) +
+                                                                                RADIOTAP_LENGTH);
+    check_payload_length(ring_raw_header, &payload_length);
+    ring_raw_header->payload_length[0] = (uint8_t) (payload_length & (uint8_t) 0xFF);
+    ring_raw_header->payload_length[1] = (uint8_t) ((payload_length >> (uint8_t) 8) & (uint8_t) 0xFF);
+    ring_raw_header->port = dest_port;
+    ring_raw_header->seq_num = new_seq_num;
+    frame->tp_len = (uint32_t) (RADIOTAP_LENGTH + DB_RAW_V2_HEADER_LENGTH + ring->payload_offset + payload_length);
+    __atomic_store_n(&frame->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/**
+ * Copies a committed frame of one TX ring to the same position of another TX ring and commits it there. Used for
+ * soft. diversity transmission where every adapter has its own ring.
+ *
+ * @param dst_ring The ring the frame gets copied to
+ * @param src_ring The ring containing the committed frame
+ * @param index Index of the frame relative to the first frame that was not yet sent
+ * @return 0 on success or -1 if the frame of the destination ring was not released by the kernel
+ */
+int db_tx_ring_copy_frame(db_tx_ring_t *dst_ring, db_tx_ring_t *src_ring, unsigned int index) {
+    if (db_tx_ring_get_payload(dst_ring, index) == NULL)
+        return -1;
+    struct tpacket2_hdr *src_frame = tx_ring_frame(src_ring, index);
+    struct tpacket2_hdr *dst_frame = tx_ring_frame(dst_ring, index);
+    memcpy(tx_ring_frame_data(dst_frame), tx_ring_frame_data(src_frame), src_frame->tp_len);
+    dst_frame->tp_len = src_frame->tp_len;
+    __atomic_store_n(&dst_frame->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/**
+ * Hands all committed frames to the kernel with a single syscall and advances the ring by num_frames. Does not wait
+ * for the frames to be sent.
+ *
+ * @param ring The TX ring
+ * @param num_frames Number of frames that were committed since the last call
+ * @return 0 on success or -1 on failure
+ */
+int db_send_tx_ring(db_tx_ring_t *ring, unsigned int num_frames) {
+    ring->current_frame = (ring->current_frame + num_frames) % ring->frame_nr;
+    if (send(ring->socket_fd, NULL, 0, MSG_DONTWAIT) < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        LOG_SYS_STD(LOG_ERR, "DroneBridgeCommon: Send failed (TX ring): %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Removes the TX ring from the socket. Frames are then sent via the regular send functions again.
+ *
+ * @param a_db_socket Socket with a TX ring set up by db_socket_enable_tx_ring()
+ */
+void db_socket_disable_tx_ring(db_socket_t *a_db_socket) {
+    if (a_db_socket->tx_ring == NULL)
+        return;
+    struct tpacket_req req;
+    memset(&req, 0, sizeof(req));
+    munmap(a_db_socket->tx_ring->map, a_db_socket->tx_ring->map_length);
+    if (setsockopt(a_db_socket->db_socket, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) < 0)
+        LOG_SYS_STD(LOG_NOTICE, "DroneBridgeCommon: Could not release TX ring: %s\n", strerror(errno));
+    free(a_db_socket->tx_ring);
+    a_db_socket->tx_ring = NULL;
+}
@@ -21,31 +21,121 @@
 #define CONTROL_DB_RAW_SEND_H
 
 #include "db_protocol.h"
+#include "db_raw_receive.h"
 #include <stdint.h>
+#include <stdbool.h>
+#include <sys/uio.h>
 #include <linux/if_packet.h>
+#include <linux/filter.h>
 
-// That is the buffer that will be sent over the socket. Create a pointer to a part of this array and fill it with your
-// data, like e.g.:
-// struct uav_rc_status_update_message_t *rc_status_update_data = (struct uav_rc_status_update_message_t *) (monitor_framebuffer + RADIOTAP_LENGTH + DB_RAW_V2_HEADER_LENGTH);
-extern uint8_t monitor_framebuffer[RADIOTAP_LENGTH + DB_RAW_V2_HEADER_LENGTH + DATA_UNI_LENGTH];
+struct mmsghdr;
 
+#define DB_MAX_BATCH_FRAMES         64  // max number of frames that can be injected with a single db_send_batch_div()
+#define DB_BATCH_MAX_PREFIX_LENGTH  16  // max length of a module specific header stored with the frame header
+#define DB_BATCH_HEADER_LENGTH      (RADIOTAP_LENGTH + DB_RAW_V2_HEADER_LENGTH + DB_RAW_OFFSET + DB_BATCH_MAX_PREFIX_LENGTH)
+#define DB_TX_RING_FRAME_NR     256     // default number of frames in a PACKET_TX_RING
+#define DB_TX_RING_WAIT_US      200000  // max time to wait for the kernel to release a frame of the TX ring
+#define DB_FRAME_HEADER_LENGTH  (RADIOTAP_LENGTH + DB_RAW_V2_HEADER_LENGTH)
+
+// PACKET_MMAP (TPACKET_V2) transmit ring. Every frame slot is pre-stamped with radiotap and DB raw v2 header
+typedef struct {
+    int socket_fd;
+    uint8_t *map;
+    size_t map_length;
+    unsigned int frame_size;
+    unsigned int frame_nr;
+    unsigned int current_frame;  // first frame of the ring that was not yet handed to the kernel
+    int payload_offset;          // 0 or DB_RAW_OFFSET in case the payload must not be overwritten by driver SQN
+} db_tx_ring_t;
+
+// Backend that gets the frames of a DB socket on air. Frames start with the radiotap header of the frame template.
+// The raw backend injects via the AF_PACKET socket, the link emulator (db_emu.h) delivers them to other processes.
+// Receiving is done on the socket file descriptor for all backends (select()/recv())
+typedef struct {
+    const char *name;
+    // Sends num frames (one frame per msg_hdr). Returns the number of frames sent or -1 and errno on failure
+    int (*send_frames)(void *transport_data, int socket_fd, struct mmsghdr *msgs, unsigned int num);
+    void (*close)(void *transport_data, int socket_fd);
+} db_transport_t;
+
+extern const db_transport_t db_transport_raw;
+
+// Every socket owns its frame template and send buffer. Sockets can be used in parallel by different threads (one
+// thread per socket for db_send_hp_div(), any number of threads for db_send_div())
 typedef struct {
     int db_socket;  // socket file descriptor
+    const db_transport_t *transport;    // set by open_db_socket(). NULL is taken as db_transport_raw
+    void *transport_data;               // state of the transport backend
     struct sockaddr_ll db_socket_addr;
+    db_rx_ring_t *rx_ring;  // TPACKET_V3 receive ring. NULL if frames are received via recv()
+    db_tx_ring_t *tx_ring;  // TPACKET_V2 transmit ring. NULL if not enabled
+    // radiotap header (bit rate) + DB raw v2 header (fcf, direction, comm id) set up by open_db_socket(). Only read
+    // by the send functions. Frame specific fields (port, length, seq. num.) are set in a copy
+    uint8_t frame_template[DB_FRAME_HEADER_LENGTH];
+    // Send arena of db_send_hp_div(). Pre-stamped with the template. Payload is written via get_hp_raw_buffer()
+    uint8_t frame_buffer[DB_FRAME_HEADER_LENGTH + DB_RAW_OFFSET + DATA_UNI_LENGTH];
+    int payload_offset;     // 0 or DB_RAW_OFFSET. Offset of the payload inside frame_buffer (see get_hp_raw_buffer())
+    bool ext_seq_num;       // db_send_div() sends the extended DB raw header (32 bit seq. num.)
+    uint8_t stream_id;      // stream ID of the extended DB raw header
 } db_socket_t;
 
-void set_bitrate(int bitrate_option);
+// A set of frames that gets injected using one sendmmsg() call per socket. Every frame consists of a pre-allocated
+// header (radiotap + DB raw v2 header + optional module header) and a pointer to the payload. Payload is not copied.
+typedef struct {
+    uint8_t frame_headers[DB_MAX_BATCH_FRAMES][DB_BATCH_HEADER_LENGTH];
+    struct iovec iov[DB_MAX_BATCH_FRAMES][2];
+    int num_frames;
+    int payload_offset;     // 0 or DB_RAW_OFFSET in case the payload must not be overwritten by driver SQN
+    uint32_t syscall_cnt;   // number of sendmmsg() calls done with this batch since init
+} db_frame_batch_t;
+
+void set_bitrate(db_socket_t *a_db_socket, int bitrate_option);
+
+void init_frame_template(db_socket_t *new_socket, uint8_t comm_id, int bitrate_option, uint8_t send_direction,
+                         uint8_t frame_type);
 
 db_socket_t open_db_socket(char *ifName, uint8_t comm_id, char trans_mode, int bitrate_option,
                            uint8_t send_direction, uint8_t receive_new_port, uint8_t frame_type);
 
+void close_db_socket(db_socket_t *a_db_socket);
+
+int db_socket_enable_rx_ring(db_socket_t *a_db_socket, unsigned int block_size, unsigned int block_nr);
+
+int db_socket_disable_rx(db_socket_t *a_db_socket);
+
+int db_socket_join_fanout(db_socket_t *a_db_socket, uint16_t *group_id, const struct sock_fprog *steering_program);
+
+void db_socket_set_ext_seq_num(db_socket_t *a_db_socket, bool enable, uint8_t stream_id);
+
+int db_socket_enable_tx_ring(db_socket_t *a_db_socket, unsigned int frame_nr, int adhere_80211_header);
+
+uint8_t *db_tx_ring_get_payload(db_tx_ring_t *ring, unsigned int index);
+
+int db_tx_ring_commit(db_tx_ring_t *ring, unsigned int index, uint8_t dest_port, uint16_t payload_length,
+                      uint8_t new_seq_num);
+
+int db_tx_ring_copy_frame(db_tx_ring_t *dst_ring, db_tx_ring_t *src_ring, unsigned int index);
+
+int db_send_tx_ring(db_tx_ring_t *ring, unsigned int num_frames);
+
+void db_socket_disable_tx_ring(db_socket_t *a_db_socket);
+
 uint8_t update_seq_num(uint8_t *old_seq_num);
 
-struct data_uni *get_hp_raw_buffer(int adhere_to_80211_header);
+struct data_uni *get_hp_raw_buffer(db_socket_t *a_db_socket, int adhere_to_80211_header);
 
 int db_send_div(db_socket_t *a_db_socket, uint8_t *payload, uint8_t dest_port, uint16_t payload_length,
-                uint8_t new_seq_num, int adhere_80211_header);
+                uint32_t new_seq_num, int adhere_80211_header);
 
 int db_send_hp_div(db_socket_t *a_db_socket, uint8_t dest_port, uint16_t payload_length, uint8_t new_seq_num);
 
+void db_batch_init(db_frame_batch_t *batch, db_socket_t *a_db_socket, int adhere_80211_header);
+
+void db_batch_reset(db_frame_batch_t *batch);
+
+int db_batch_add(db_frame_batch_t *batch, uint8_t dest_port, uint8_t new_seq_num, const uint8_t *prefix,
+                 uint16_t prefix_length, uint8_t *payload, uint16_t payload_length);
+
+int db_send_batch_div(db_socket_t *a_db_socket, db_frame_batch_t *batch);
+
 #endif //CONTROL_DB_RAW_SEND_H
\ No newline at end of file
@@ -0,0 +1,330 @@
+/*
+ *   This file is part of DroneBridge: https://github.com/seeul8er/DroneBridge
+ *
+ *   Copyright 2020 Wolfgang Christl
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include "db_recorder.h"
+#include "db_pcap.h"
+#include "db_common.h"
+
+#define RING_MASK   ((uint64_t) DB_RECORDER_RING_SIZE - 1)
+#define EPB_HEADER_LENGTH   28  // block type, length, interface ID, timestamp (high, low), captured & original length
+
+static inline uint32_t pad4(uint32_t length) {
+    return (length + 3u) & ~3u;
+}
+
+static inline uint64_t monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static inline void ring_copy(db_recorder_ring_t *ring, uint64_t pos, const void *data, uint32_t length) {
+    uint32_t offset = (uint32_t) (pos & RING_MASK);
+    uint32_t first = DB_RECORDER_RING_SIZE - offset < length ? DB_RECORDER_RING_SIZE - offset : length;
+    memcpy(ring->buf + offset, data, first);
+    memcpy(ring->buf, (const uint8_t *) data + first, length - first);
+}
+
+/**
+ * Appends a pcapng option to buf
+ *
+ * @return Length of the option incl. padding
+ */
+static uint32_t put_option(uint8_t *buf, uint16_t code, const void *value, uint16_t length) {
+    memcpy(buf, &code, sizeof(code));
+    memcpy(buf + 2, &length, sizeof(length));
+    memset(buf + 4, 0, pad4(length));
+    memcpy(buf + 4, value, length);
+    return 4 + pad4(length);
+}
+
+/**
+ * Writes the section header and one interface description block per adapter to the current file
+ */
+static int write_file_header(db_recorder_t *recorder) {
+    uint8_t buf[2048];
+    uint32_t length = 0, block_length;
+    const char comment[] = "DroneBridge flight recorder. Time stamps are CLOCK_MONOTONIC";
+    uint32_t shb_start = length;
+    uint32_t shb[] = {PCAPNG_BLOCK_SHB, 0, PCAPNG_BYTE_ORDER_MAGIC};
+    memcpy(buf + length, shb, sizeof(shb));
+    length += sizeof(shb);
+    uint16_t version[] = {1, 0};
+    int64_t section_length = -1;
+    memcpy(buf + length, version, sizeof(version));
+    memcpy(buf + length + 4, &section_length, sizeof(section_length));
+    length += 12;
+    length += put_option(buf + length, PCAPNG_OPT_COMMENT, comment, sizeof(comment) - 1);
+    length += put_option(buf + length, PCAPNG_OPT_END, NULL, 0);
+    block_length = length - shb_start + 4;
+    memcpy(buf + shb_start + 4, &block_length, sizeof(block_length));
+    memcpy(buf + length, &block_length, sizeof(block_length));
+    length += 4;
+    for (int i = 0; i < recorder->num_adapters; i++) {
+        uint32_t idb_start = length;
+        uint32_t idb[] = {PCAPNG_BLOCK_IDB, 0, DB_PCAP_LINKTYPE_RADIOTAP, DB_PCAP_MAX_FRAME};
+        memcpy(buf + length, idb, sizeof(idb));
+        length += sizeof(idb);
+        uint8_t tsresol = 9;    // nanoseconds
+        length += put_option(buf + length, PCAPNG_OPT_IF_NAME, recorder->adapter_names[i],
+                             (uint16_t) strnlen(recorder->adapter_names[i], IFNAMSIZ));
+        length += put_option(buf + length, PCAPNG_OPT_IF_TSRESOL, &tsresol, 1);
+        length += put_option(buf + length, PCAPNG_OPT_END, NULL, 0);
+        block_length = length - idb_start + 4;
+        memcpy(buf + idb_start + 4, &block_length, sizeof(block_length));
+        memcpy(buf + length, &block_length, sizeof(block_length));
+        length += 4;
+    }
+    if (write(recorder->fd, buf, length) != (ssize_t) length)
+        return -1;
+    recorder->file_size = length;
+    return 0;
+}
+
+static void file_name(db_recorder_t *recorder, uint32_t file_no, char *name, size_t name_length) {
+    snprintf(name, name_length, "%s/%s_%s_%04u.pcapng", recorder->dir, recorder->prefix, recorder->start_time,
+             file_no);
+}
+
+/**
+ * Closes the current file and starts the next one. Deletes the oldest file if there are more than
+ * DB_RECORDER_MAX_FILES.
+ *
+ * @return 0 on success, -1 if the new file could not be created
+ */
+static int next_file(db_recorder_t *recorder) {
+    char name[sizeof(recorder->dir) + sizeof(recorder->prefix) + sizeof(recorder->start_time) + 24];
+    if (recorder->fd >= 0) {
+        close(recorder->fd);
+        recorder->file_no++;
+    }
+    if (recorder->file_no >= DB_RECORDER_MAX_FILES) {
+        file_name(recorder, recorder->file_no - DB_RECORDER_MAX_FILES, name, sizeof(name));
+        unlink(name);
+    }
+    file_name(recorder, recorder->file_no, name, sizeof(name));
+    recorder->fd = open(name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (recorder->fd < 0 || write_file_header(recorder) < 0) {
+        LOG_SYS_STD(LOG_ERR, "DB_RECORDER: Could not create %s: %s\n", name, strerror(errno));
+        if (recorder->fd >= 0)
+            close(recorder->fd);
+        recorder->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Writes the pending blocks of a ring to the current file with one writev()
+ */
+static void flush_ring(db_recorder_t *recorder, db_recorder_ring_t *ring, uint64_t head) {
+    uint64_t tail = ring->tail;
+    uint32_t length = (uint32_t) (head - tail), offset = (uint32_t) (tail & RING_MASK);
+    struct iovec iov[2];
+    int iov_cnt = 1;
+    iov[0].iov_base = ring->buf + offset;
+    iov[0].iov_len = length;
+    if (offset + length > DB_RECORDER_RING_SIZE) {
+        iov[0].iov_len = DB_RECORDER_RING_SIZE - offset;
+        iov[1].iov_base = ring->buf;
+        iov[1].iov_len = length - iov[0].iov_len;
+        iov_cnt = 2;
+    }
+    if (recorder->fd >= 0) {
+        ssize_t ret = writev(recorder->fd, iov, iov_cnt);
+        if (ret != (ssize_t) length) {
+            LOG_SYS_STD(LOG_ERR, "DB_RECORDER: Could not write capture file: %s. Recording stopped\n",
+                        ret < 0 ? strerror(errno) : "disk full");
+            close(recorder->fd);
+            recorder->fd = -1;
+        } else {
+            recorder->file_size += length;
+            recorder->written_bytes += length;
+        }
+    }
+    __atomic_store_n(&ring->tail, head, __ATOMIC_RELEASE);
+    if (recorder->fd >= 0 && recorder->file_size >= DB_RECORDER_FILE_SIZE)
+        next_file(recorder);
+}
+
+static void *writer_thread(void *arg) {
+    db_recorder_t *recorder = arg;
+    uint64_t last_flush[DB_RECORDER_MAX_RINGS];
+    uint64_t now = monotonic_ns();
+    for (int i = 0; i < recorder->num_rings; i++)
+        last_flush[i] = now;
+    struct timespec poll_interval = {.tv_sec = 0, .tv_nsec = 20000000};
+    while (true) {
+        bool running = recorder->running;
+        now = monotonic_ns();
+        for (int i = 0; i < recorder->num_rings; i++) {
+            db_recorder_ring_t *ring = &recorder->rings[i];
+            uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+            uint64_t pending = head - ring->tail;
+            if (pending == 0) {
+                last_flush[i] = now;
+                continue;
+            }
+            if (pending >= DB_RECORDER_MIN_WRITE || now - last_flush[i] >= DB_RECORDER_FLUSH_MS * 1000000ULL ||
+                !running) {
+                flush_ring(recorder, ring, head);
+                last_flush[i] = now;
+            }
+        }
+        uint32_t overrun_cnt = db_recorder_overrun_cnt(recorder);
+        if (overrun_cnt != recorder->reported_overrun_cnt) {
+            LOG_SYS_STD(LOG_NOTICE, "DB_RECORDER: Writer can not keep up. %u frames not recorded\n",
+                        overrun_cnt - recorder->reported_overrun_cnt);
+            recorder->reported_overrun_cnt = overrun_cnt;
+        }
+        if (!running)
+            break;
+        nanosleep(&poll_interval, NULL);
+    }
+    return NULL;
+}
+
+/**
+ * Starts a flight recorder. Files are named <dir>/<prefix>_<start time>_<file no>.pcapng
+ *
+ * @param dir Directory to write the capture files to. Gets created if it does not exist
+ * @param prefix Prefix of the file names, e.g. the name of the module
+ * @param adapter_names Names of the adapters. Written to the interface description blocks
+ * @param num_adapters
+ * @param num_rings Number of threads that record frames. Every thread uses its own ring
+ * @return The recorder or NULL on failure
+ */
+db_recorder_t *db_recorder_open(const char *dir, const char *prefix, char adapter_names[][IFNAMSIZ],
+                                int num_adapters, int num_rings) {
+    if (num_rings < 1 || num_rings > DB_RECORDER_MAX_RINGS || num_adapters > DB_MAX_ADAPTERS) {
+        LOG_SYS_STD(LOG_ERR, "DB_RECORDER: Invalid number of rings or adapters\n");
+        return NULL;
+    }
+    db_recorder_t *recorder = calloc(1, sizeof(db_recorder_t));
+    if (recorder == NULL)
+        return NULL;
+    snprintf(recorder->dir, sizeof(recorder->dir), "%s", dir);
+    snprintf(recorder->prefix, sizeof(recorder->prefix), "%s", prefix);
+    time_t t = time(NULL);
+    strftime(recorder->start_time, sizeof(recorder->start_time), "%Y%m%d-%H%M%S", localtime(&t));
+    for (int i = 0; i < num_adapters; i++)
+        strncpy(recorder->adapter_names[i], adapter_names[i], IFNAMSIZ - 1);
+    recorder->num_adapters = num_adapters;
+    recorder->num_rings = num_rings;
+    recorder->fd = -1;
+    for (int i = 0; i < num_rings; i++) {
+        if (posix_memalign((void **) &recorder->rings[i].buf, DB_CACHE_LINE_SIZE, DB_RECORDER_RING_SIZE) != 0) {
+            LOG_SYS_STD(LOG_ERR, "DB_RECORDER: Could not allocate ring\n");
+            recorder->num_rings = i;
+            db_recorder_close(recorder);
+            return NULL;
+        }
+    }
+    mkdir(dir, 0755);
+    if (next_file(recorder) < 0) {
+        db_recorder_close(recorder);
+        return NULL;
+    }
+    recorder->running = true;
+    if (pthread_create(&recorder->writer, NULL, writer_thread, recorder) != 0) {
+        LOG_SYS_STD(LOG_ERR, "DB_RECORDER: Could not start writer thread\n");
+        recorder->running = false;
+        db_recorder_close(recorder);
+        return NULL;
+    }
+    LOG_SYS_STD(LOG_NOTICE, "DB_RECORDER: Recording to %s/%s_%s_*.pcapng\n", recorder->dir, recorder->prefix,
+                recorder->start_time);
+    return recorder;
+}
+
+/**
+ * Records a received frame. Only copies the frame into the ring of the calling thread. Never blocks.
+ *
+ * @param recorder
+ * @param ring_no Ring of the calling thread. Every ring must only be used by one thread at a time
+ * @param adapter_no Index of the adapter that received the frame
+ * @param frame Received frame starting with the radiotap header
+ * @param length Length of the frame
+ * @return false if the frame was dropped because the ring is full
+ */
+bool db_recorder_write(db_recorder_t *recorder, int ring_no, uint8_t adapter_no, const uint8_t *frame,
+                       uint32_t length) {
+    db_recorder_ring_t *ring = &recorder->rings[ring_no];
+    uint32_t block_length = EPB_HEADER_LENGTH + pad4(length) + 4;
+    uint64_t head = ring->head;
+    if (block_length > DB_RECORDER_RING_SIZE - (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE))) {
+        ring->overrun_cnt++;
+        return false;
+    }
+    uint64_t timestamp = monotonic_ns();
+    uint32_t header[] = {PCAPNG_BLOCK_EPB, block_length, adapter_no, (uint32_t) (timestamp >> 32u),
+                         (uint32_t) timestamp, length, length};
+    const uint8_t padding[4] = {0};
+    ring_copy(ring, head, header, EPB_HEADER_LENGTH);
+    ring_copy(ring, head + EPB_HEADER_LENGTH, frame, length);
+    ring_copy(ring, head + EPB_HEADER_LENGTH + length, padding, pad4(length) - length);
+    ring_copy(ring, head + block_length - 4, &block_length, 4);
+    ring->frame_cnt++;
+    __atomic_store_n(&ring->head, head + block_length, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * @return Number of frames that were not recorded because the writer could not keep up
+ */
+uint32_t db_recorder_overrun_cnt(db_recorder_t *recorder) {
+    uint32_t overrun_cnt = 0;
+    for (int i = 0; i < recorder->num_rings; i++)
+        overrun_cnt += __atomic_load_n(&recorder->rings[i].overrun_cnt, __ATOMIC_RELAXED);
+    return overrun_cnt;
+}
+
+/**
+ * Writes all recorded frames to disk, stops the writer and frees the recorder
+ */
+void db_recorder_close(db_recorder_t *recorder) {
+    if (recorder == NULL)
+        return;
+    if (recorder->running) {
+        recorder->running = false;
+        pthread_join(recorder->writer, NULL);
+    }
+    uint32_t frame_cnt = 0;
+    for (int i = 0; i < recorder->num_rings; i++) {
+        frame_cnt += recorder->rings[i].frame_cnt;
+        free(recorder->rings[i].buf);
+    }
+    if (recorder->fd >= 0) {
+        close(recorder->fd);
+        LOG_SYS_STD(LOG_NOTICE, "DB_RECORDER: Recorded %u frames (%llu bytes, %u files). %u frames dropped\n",
+                    frame_cnt, (unsigned long long) recorder->written_bytes, recorder->file_no + 1,
+                    db_recorder_overrun_cnt(recorder));
+    }
+    free(recorder);
+}
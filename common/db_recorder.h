@@ -0,0 +1,77 @@
+/*
+ *   This file is part of DroneBridge: https://github.com/seeul8er/DroneBridge
+ *
+ *   Copyright 2020 Wolfgang Christl
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+#ifndef DRONEBRIDGE_DB_RECORDER_H
+#define DRONEBRIDGE_DB_RECORDER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <net/if.h>
+#include "db_protocol.h"
+#include "db_spsc_ring.h"
+
+#define DB_RECORDER_MAX_RINGS       16                  // max. number of threads that record frames
+#define DB_RECORDER_RING_SIZE       (4 * 1024 * 1024)   // bytes per ring. Power of two
+#define DB_RECORDER_MIN_WRITE       (256 * 1024)        // writer collects at least that much before writing
+#define DB_RECORDER_FLUSH_MS        500                 // ... or writes whatever is there after that time
+#define DB_RECORDER_FILE_SIZE       (64 * 1024 * 1024)  // a new file is started once a file reaches that size
+#define DB_RECORDER_MAX_FILES       16                  // oldest file gets deleted if there are more
+
+// Byte ring of one recording thread. Holds complete pcapng enhanced packet blocks, so the writer can pass the ring
+// memory to writev() as it is
+typedef struct {
+    uint8_t *buf;
+    _Alignas(DB_CACHE_LINE_SIZE) uint64_t head;     // bytes written. Only written by the recording thread
+    uint32_t frame_cnt;                             // recorded frames
+    uint32_t overrun_cnt;                           // frames dropped because the ring was full
+    _Alignas(DB_CACHE_LINE_SIZE) uint64_t tail;     // bytes written to file. Only written by the writer thread
+} db_recorder_ring_t;
+
+// Flight recorder: Writes every received frame (incl. radiotap header) with the index of the adapter and a
+// CLOCK_MONOTONIC time stamp to rotating pcapng files. Every adapter is a pcapng interface. Recording threads only copy
+// the frame into their ring and never block. A background thread writes the rings to disk in large chunks
+typedef struct {
+    char dir[256];
+    char prefix[32];
+    char start_time[32];
+    char adapter_names[DB_MAX_ADAPTERS][IFNAMSIZ];
+    int num_adapters;
+    int num_rings;
+    db_recorder_ring_t rings[DB_RECORDER_MAX_RINGS];
+    int fd;                 // current file
+    uint64_t file_size;
+    uint32_t file_no;
+    uint64_t written_bytes;
+    uint32_t reported_overrun_cnt;
+    volatile bool running;
+    pthread_t writer;
+} db_recorder_t;
+
+db_recorder_t *db_recorder_open(const char *dir, const char *prefix, char adapter_names[][IFNAMSIZ],
+                                int num_adapters, int num_rings);
+
+bool db_recorder_write(db_recorder_t *recorder, int ring_no, uint8_t adapter_no, const uint8_t *frame,
+                       uint32_t length);
+
+uint32_t db_recorder_overrun_cnt(db_recorder_t *recorder);
+
+void db_recorder_close(db_recorder_t *recorder);
+
+#endif //DRONEBRIDGE_DB_RECORDER_H
@@ -0,0 +1,126 @@
+/*
+ *   This file is part of DroneBridge: https://github.com/seeul8er/DroneBridge
+ *
+ *   Copyright 2020 Wolfgang Christl
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+#include <string.h>
+#include <time.h>
+#include "db_seq_tracker.h"
+
+static inline uint64_t now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + (uint64_t) ts.tv_nsec / 1000000;
+}
+
+static inline uint32_t window_bit(const db_seq_tracker_t *tracker, uint32_t seq_num) {
+    return seq_num & (tracker->window_size - 1);
+}
+
+static inline bool is_received(const db_seq_tracker_t *tracker, uint32_t seq_num) {
+    uint32_t bit = window_bit(tracker, seq_num);
+    return (tracker->received[bit / 64] >> (bit % 64)) & 1u;
+}
+
+static inline void set_received(db_seq_tracker_t *tracker, uint32_t seq_num, bool received) {
+    uint32_t bit = window_bit(tracker, seq_num);
+    if (received)
+        tracker->received[bit / 64] |= (uint64_t) 1 << (bit % 64);
+    else
+        tracker->received[bit / 64] &= ~((uint64_t) 1 << (bit % 64));
+}
+
+/**
+ * Forgets all received frames and restarts tracking with seq_num as first frame. Statistics are kept.
+ */
+static void restart(db_seq_tracker_t *tracker, uint32_t seq_num, uint8_t seq_num_bits, uint64_t now) {
+    tracker->seq_num_bits = seq_num_bits;
+    tracker->window_size = (seq_num_bits <= 11) ? (1u << (seq_num_bits - 1)) : DB_SEQ_WINDOW;
+    memset(tracker->received, 0, sizeof(tracker->received));
+    tracker->first = seq_num;
+    tracker->highest = seq_num;
+    set_received(tracker, seq_num, true);
+    tracker->unique_cnt++;
+    tracker->last_new_ms = now;
+}
+
+void db_seq_tracker_init(db_seq_tracker_t *tracker) {
+    memset(tracker, 0, sizeof(db_seq_tracker_t));
+}
+
+/**
+ * Checks if a received frame is new or a duplicate of a frame that was already received (e.g. via another adapter)
+ * and updates the statistics. A sequence number that jumps back by more than the window restarts the tracking (sender
+ * restarted with a lower sequence number). The window also expires if no new frame arrived for DB_SEQ_RESTART_GAP_MS:
+ * After a pause of the sender or a link outage the sequence number may land anywhere behind the highest one (8 bit
+ * wraps every 256 frames), so the first frame that does not move the window forward restarts the tracking. Copies
+ * delivered in bursts by a lagging adapter follow new frames closely and stay duplicates.
+ *
+ * @param tracker Tracker of the sender. Init with db_seq_tracker_init()
+ * @param received Sequence number of the received frame (see get_db_payload_pointer_seq())
+ * @return true if the frame is new and must be processed, false if it is a duplicate
+ */
+bool db_seq_tracker_check(db_seq_tracker_t *tracker, const db_seq_num_t *received) {
+    uint32_t seq_num = received->seq_num;
+    uint8_t seq_num_bits = received->seq_num_bits;
+    uint64_t now = now_ms();
+    if (seq_num_bits != tracker->seq_num_bits) {
+        // first frame or the sender switched between DB raw v2 header and extended header
+        restart(tracker, seq_num, seq_num_bits, now);
+        return true;
+    }
+    // distance to the highest received seq. num. in the (wrapping) sequence number space
+    int32_t delta;
+    if (seq_num_bits >= 32) {
+        delta = (int32_t) (seq_num - tracker->highest);
+    } else {
+        uint32_t span = 1u << seq_num_bits;
+        uint32_t diff = (seq_num - tracker->highest) & (span - 1);
+        delta = (diff >= span / 2) ? (int32_t) diff - (int32_t) span : (int32_t) diff;
+    }
+    uint32_t unwrapped = tracker->highest + (uint32_t) delta;
+
+    if (delta > 0) {
+        // window moves forward. Frames leaving it that were never received are lost
+        uint32_t steps = ((uint32_t) delta < tracker->window_size) ? (uint32_t) delta : tracker->window_size;
+        for (uint32_t i = 1; i <= steps; i++) {
+            uint32_t leaving = tracker->highest + i - tracker->window_size;
+            if ((int32_t) (leaving - tracker->first) >= 0 && !is_received(tracker, leaving))
+                tracker->lost_cnt++;
+            set_received(tracker, leaving, false);
+        }
+        if ((uint32_t) delta > tracker->window_size)
+            tracker->lost_cnt += (uint32_t) delta - tracker->window_size;
+        tracker->highest = unwrapped;
+    } else if ((uint32_t) -delta >= tracker->window_size || now - tracker->last_new_ms >= DB_SEQ_RESTART_GAP_MS) {
+        // too old for the window or window expired: sender restarted or link was down
+        tracker->restart_cnt++;
+        restart(tracker, seq_num, seq_num_bits, now);
+        return true;
+    } else if (is_received(tracker, unwrapped)) {
+        tracker->duplicate_cnt++;
+        return false;
+    } else {
+        tracker->reordered_cnt++;
+        if ((int32_t) (unwrapped - tracker->first) < 0)
+            tracker->first = unwrapped;
+    }
+    set_received(tracker, unwrapped, true);
+    tracker->unique_cnt++;
+    tracker->last_new_ms = now;
+    return true;
+}
@@ -0,0 +1,54 @@
+/*
+ *   This file is part of DroneBridge: https://github.com/seeul8er/DroneBridge
+ *
+ *   Copyright 2020 Wolfgang Christl
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+#ifndef DRONEBRIDGE_DB_SEQ_TRACKER_H
+#define DRONEBRIDGE_DB_SEQ_TRACKER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "db_protocol.h"
+
+#define DB_SEQ_WINDOW       1024    // max. number of sequence numbers remembered. Must be a power of two
+#define DB_SEQ_RESTART_GAP_MS 200   // window expires if no new frame arrived for that long. Adapters lag less than that
+
+// Sliding window duplicate filter with loss/reorder statistics for the frames of one sender (one DB port). With
+// diversity every frame is received once per adapter, all copies carrying the same sequence number. The first copy
+// that arrives is reported as new, all others as duplicates - no matter the order the adapters deliver them in.
+// Works with 8 bit (DB raw v2 header) and 32 bit (extended header) sequence numbers. The window is limited to half the
+// sequence number space (128 frames with 8 bit). Sequence numbers are unwrapped internally. Use one tracker per sender
+// (port and stream ID of the extended header). Not thread safe.
+typedef struct {
+    uint8_t seq_num_bits;       // width of the tracked sequence numbers. 0 until the first frame was checked
+    uint32_t window_size;
+    uint32_t first;             // unwrapped seq. num. of the first frame since (re)start
+    uint32_t highest;           // highest unwrapped seq. num. received
+    uint64_t last_new_ms;       // time the last frame was reported as new (CLOCK_MONOTONIC)
+    uint64_t received[DB_SEQ_WINDOW / 64];  // bit (seq. num. % window_size) is set if the frame was received
+    uint32_t unique_cnt;        // frames reported as new
+    uint32_t duplicate_cnt;     // copies of frames that were already reported as new
+    uint32_t lost_cnt;          // sequence numbers that left the window without being received
+    uint32_t reordered_cnt;     // new frames that arrived after a frame with a higher sequence number
+    uint32_t restart_cnt;       // detected sender restarts
+} db_seq_tracker_t;
+
+void db_seq_tracker_init(db_seq_tracker_t *tracker);
+
+bool db_seq_tracker_check(db_seq_tracker_t *tracker, const db_seq_num_t *seq_num);
+
+#endif //DRONEBRIDGE_DB_SEQ_TRACKER_H
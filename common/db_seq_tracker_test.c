@@ -0,0 +1,140 @@
+/*
+ *   This file is part of DroneBridge: https://github.com/seeul8er/DroneBridge
+ *
+ *   Copyright 2020 Wolfgang Christl
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+/**
+ * Checks the duplicate filter of db_seq_tracker.c with the delivery patterns seen in the field: Adapters that deliver
+ * their copies in bursts (recv() batches, TPACKET_V3 blocks), sender restarts after a pause, link outages and sequence
+ * numbers that jump back by more than the window. Returns the number of failed checks.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "db_seq_tracker.h"
+
+static int errors = 0;
+
+static void expect(bool ok, const char *name, const char *what) {
+    printf("%-44s %-40s %s\n", name, what, ok ? "OK" : "FAILED");
+    if (!ok)
+        errors++;
+}
+
+static bool check(db_seq_tracker_t *tracker, uint32_t seq_num, uint8_t seq_num_bits) {
+    db_seq_num_t received = {.seq_num = seq_num & (seq_num_bits >= 32 ? 0xffffffffu : (1u << seq_num_bits) - 1),
+                             .seq_num_bits = seq_num_bits, .stream_id = DB_STREAM_DEFAULT};
+    return db_seq_tracker_check(tracker, &received);
+}
+
+/**
+ * Two adapters receive every frame. Each one is read in bursts of burst_len frames, the second adapter lags one burst
+ * behind the first one. Every frame must be reported as new exactly once.
+ */
+static void test_interleaved_bursts(uint8_t seq_num_bits, uint32_t burst_len, uint32_t num_frames) {
+    char name[64];
+    snprintf(name, sizeof(name), "2 adapters, bursts of %u, %u bit", burst_len, seq_num_bits);
+    db_seq_tracker_t tracker;
+    db_seq_tracker_init(&tracker);
+    uint32_t new_cnt = 0, processed_twice = 0;
+    for (uint32_t start = 0; start < num_frames; start += burst_len) {
+        for (uint32_t adapter = 0; adapter < 2; adapter++) {
+            for (uint32_t seq = start; seq < start + burst_len && seq < num_frames; seq++) {
+                if (check(&tracker, seq, seq_num_bits)) {
+                    if (adapter == 1)
+                        processed_twice++;
+                    new_cnt++;
+                }
+            }
+        }
+    }
+    expect(new_cnt == num_frames && processed_twice == 0, name, "every frame processed once");
+    expect(tracker.duplicate_cnt == num_frames && tracker.lost_cnt == 0, name, "duplicates counted, none lost");
+    expect(tracker.restart_cnt == 0, name, "no restart detected");
+}
+
+static void pause_ms(long ms) {
+    struct timespec pause = {.tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000L};
+    nanosleep(&pause, NULL);
+}
+
+/**
+ * Sender pauses, restarts and sends sequence numbers that were already received shortly before. The window expired
+ * during the pause, so all of its frames must be processed again.
+ */
+static void test_restart_after_pause() {
+    const char *name = "sender restart after a pause, 32 bit";
+    db_seq_tracker_t tracker;
+    db_seq_tracker_init(&tracker);
+    for (uint32_t seq = 0; seq < 500; seq++)
+        check(&tracker, seq, 32);
+    pause_ms(DB_SEQ_RESTART_GAP_MS + 50);
+    uint32_t new_cnt = 0;
+    for (uint32_t seq = 400; seq < 500; seq++)
+        new_cnt += check(&tracker, seq, 32);
+    expect(tracker.restart_cnt == 1, name, "restart detected");
+    expect(new_cnt == 100, name, "all frames after the restart processed");
+}
+
+/**
+ * Link outage of 300 ms with 180 missed frames. 8 bit sequence numbers wrap, so the frames after the outage land
+ * 76 frames behind the highest one received before. None of them may be taken as duplicate. Received by two adapters,
+ * on a lossy link every frame with seq % loss_mod == 0 is lost on both adapters (loss_mod 0: clean link).
+ */
+static void test_outage(uint32_t loss_mod) {
+    char name[64];
+    snprintf(name, sizeof(name), "outage of 180 frames, %s link, 8 bit", loss_mod ? "lossy" : "clean");
+    db_seq_tracker_t tracker;
+    db_seq_tracker_init(&tracker);
+    for (uint32_t seq = 0; seq < 500; seq++)
+        check(&tracker, seq, 8);
+    pause_ms(300);
+    uint32_t new_cnt = 0, sent_cnt = 0;
+    for (uint32_t seq = 680; seq < 880; seq++) {
+        if (loss_mod && seq % loss_mod == 0)
+            continue;
+        sent_cnt++;
+        for (int adapter = 0; adapter < 2; adapter++)
+            new_cnt += check(&tracker, seq, 8);
+    }
+    expect(new_cnt == sent_cnt, name, "every frame after the outage processed");
+}
+
+/**
+ * Sequence number jumps back by more than the window: immediate restart
+ */
+static void test_backward_jump() {
+    const char *name = "backward jump beyond the window, 32 bit";
+    db_seq_tracker_t tracker;
+    db_seq_tracker_init(&tracker);
+    for (uint32_t seq = 0; seq < 3 * DB_SEQ_WINDOW; seq++)
+        check(&tracker, seq, 32);
+    expect(check(&tracker, 0, 32) && tracker.restart_cnt == 1, name, "first frame after the jump processed");
+}
+
+int main() {
+    test_interleaved_bursts(8, 40, 2000);
+    test_interleaved_bursts(32, 64, 20000);
+    test_interleaved_bursts(32, 512, 20000);
+    test_restart_after_pause();
+    test_outage(0);
+    test_outage(3);
+    test_backward_jump();
+    printf("%s\n", errors == 0 ? "All checks passed" : "Some checks FAILED");
+    return errors == 0 ? 0 : 1;
+}
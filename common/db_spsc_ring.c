@@ -0,0 +1,89 @@
+/*
+ *   This file is part of DroneBridge: https://github.com/seeul8er/DroneBridge
+ *
+ *   Copyright 2020 Wolfgang Christl
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+#include <stdlib.h>
+#include "db_spsc_ring.h"
+
+/**
+ * Allocates the slots of a single producer/single consumer ring
+ *
+ * @param ring Ring to init
+ * @param slot_nr Number of slots. Gets rounded up to the next power of two
+ * @param slot_size Size of a single slot in bytes
+ * @return 0 on success, -1 on failure
+ */
+int db_spsc_ring_init(db_spsc_ring_t *ring, uint32_t slot_nr, size_t slot_size) {
+    uint32_t rounded_slot_nr = 1;
+    while (rounded_slot_nr < slot_nr)
+        rounded_slot_nr <<= 1u;
+    // keep slots cache line aligned so that producer and consumer do not write to the same line
+    slot_size = (slot_size + DB_CACHE_LINE_SIZE - 1) & ~((size_t) DB_CACHE_LINE_SIZE - 1);
+    if (posix_memalign((void **) &ring->slots, DB_CACHE_LINE_SIZE, slot_size * rounded_slot_nr) != 0)
+        return -1;
+    ring->slot_size = slot_size;
+    ring->slot_mask = rounded_slot_nr - 1;
+    ring->head = 0;
+    ring->tail = 0;
+    return 0;
+}
+
+void db_spsc_ring_free(db_spsc_ring_t *ring) {
+    free(ring->slots);
+    ring->slots = NULL;
+}
+
+/**
+ * Producer side: Returns the next free slot. Slot is handed to the consumer with db_spsc_ring_push()
+ *
+ * @param ring The ring
+ * @return Pointer to a free slot or NULL if the ring is full
+ */
+void *db_spsc_ring_producer_slot(db_spsc_ring_t *ring) {
+    uint32_t head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) > ring->slot_mask)
+        return NULL;
+    return ring->slots + (head & ring->slot_mask) * ring->slot_size;
+}
+
+/**
+ * Producer side: Hands the slot returned by db_spsc_ring_producer_slot() to the consumer
+ */
+void db_spsc_ring_push(db_spsc_ring_t *ring) {
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Consumer side: Returns the oldest slot that was pushed by the producer. Slot is released with db_spsc_ring_pop()
+ *
+ * @param ring The ring
+ * @return Pointer to the slot or NULL if ring is empty
+ */
+void *db_spsc_ring_consumer_slot(db_spsc_ring_t *ring) {
+    uint32_t tail = ring->tail;
+    if (tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))
+        return NULL;
+    return ring->slots + (tail & ring->slot_mask) * ring->slot_size;
+}
+
+/**
+ * Consumer side: Releases the slot returned by db_spsc_ring_consumer_slot() so the producer can reuse it
+ */
+void db_spsc_ring_pop(db_spsc_ring_t *ring) {
+    __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+}
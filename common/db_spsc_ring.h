@@ -0,0 +1,50 @@
+/*
+ *   This file is part of DroneBridge: https://github.com/seeul8er/DroneBridge
+ *
+ *   Copyright 2020 Wolfgang Christl
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+#ifndef DRONEBRIDGE_DB_SPSC_RING_H
+#define DRONEBRIDGE_DB_SPSC_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define DB_CACHE_LINE_SIZE  64
+
+// Lock-free single producer/single consumer ring of fixed size slots. Producer fills a slot in place and pushes it,
+// consumer processes the slot in place and pops it. No copies inside the ring.
+typedef struct {
+    uint8_t *slots;
+    size_t slot_size;
+    uint32_t slot_mask;     // number of slots - 1. Number of slots is a power of two
+    _Alignas(DB_CACHE_LINE_SIZE) uint32_t head;  // next slot to be written. Only written by producer
+    _Alignas(DB_CACHE_LINE_SIZE) uint32_t tail;  // next slot to be read. Only written by consumer
+} db_spsc_ring_t;
+
+int db_spsc_ring_init(db_spsc_ring_t *ring, uint32_t slot_nr, size_t slot_size);
+
+void db_spsc_ring_free(db_spsc_ring_t *ring);
+
+void *db_spsc_ring_producer_slot(db_spsc_ring_t *ring);
+
+void db_spsc_ring_push(db_spsc_ring_t *ring);
+
+void *db_spsc_ring_consumer_slot(db_spsc_ring_t *ring);
+
+void db_spsc_ring_pop(db_spsc_ring_t *ring);
+
+#endif //DRONEBRIDGE_DB_SPSC_RING_H
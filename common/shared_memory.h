@@ -56,6 +56,12 @@ typedef struct {
     uint32_t kbitrate; // video stream
     uint32_t wifi_adapter_cnt; // video stream
     db_adapter_status adapter[8];
+    uint32_t fec_inv_cache_hit_cnt; // video stream: decoded blocks that reused a cached inverted FEC matrix
+    uint32_t fec_inv_cache_miss_cnt; // video stream: decoded blocks that had to invert their FEC matrix
+    uint32_t recorder_overrun_cnt; // video stream: received frames the flight recorder could not keep
+    uint32_t early_release_cnt; // video stream: blocks decoded once k packets arrived, before the block was complete
+    uint32_t late_packet_cnt; // video stream: packets that arrived after their block was already released
+    uint32_t block_release_us; // video stream: avg. time from the first packet of a block to its release
 } __attribute__((packed)) db_gnd_status_t;
 
 typedef struct {
@@ -86,6 +92,14 @@ typedef struct {
     uint8_t undervolt; // 1 = too low voltage
     uint32_t wifi_adapter_cnt; // video stream
     db_adapter_status adapter[8];
+    uint16_t injection_batch_size; // number of frames injected per sendmmsg() batch (one FEC block)
+    uint32_t injection_syscall_cnt; // number of send syscalls done for injection on all adapters
+    uint32_t flushed_block_cnt; // blocks sent with less DATA packets because their max. age expired
+    uint32_t protected_block_cnt; // blocks with SPS/PPS/IDR data sent with a stronger FEC ratio
+    uint8_t fec_per_block; // FEC packets currently sent with a full block. Changes with adaptive FEC
+    uint32_t feedback_report_cnt; // loss reports received from the ground station (adaptive FEC)
+    uint8_t interleave_depth; // blocks sent interleaved. 1 = no interleaving
+    uint32_t interleave_delay_us; // avg. time an encoded block waits in the interleaver for the other blocks
 } __attribute__((packed)) db_uav_status_t;
 
 
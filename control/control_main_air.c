@@ -37,6 +37,7 @@
 #include "../common/radiotap/radiotap_iter.h"
 #include "../common/db_common.h"
 #include "../common/db_unix.h"
+#include "../common/db_seq_tracker.h"
 
 
 #define ETHER_TYPE        0x88ab
@@ -86,7 +87,7 @@ speed_t interpret_baud(int user_baud) {
  * @param proxy_seq_number
  * @param raw_interfaces_telem
  */
-void send_buffered_mavlink(int length_message, mavlink_message_t *mav_message, uint8_t *proxy_seq_number,
+void send_buffered_mavlink(int length_message, mavlink_message_t *mav_message, uint32_t *proxy_seq_number,
                            db_socket_t *raw_interfaces_telem) {
     mav_tel_message_counter++;  // Number of messages in buffer
     mavlink_msg_to_send_buffer(mavlink_message_buf, mav_message);   // Get over the wire representation of message
@@ -94,10 +95,10 @@ void send_buffered_mavlink(int length_message, mavlink_message_t *mav_message, u
     memcpy(&mavlink_telemetry_buf[mav_tel_buf_length], mavlink_message_buf, (size_t) length_message);
     mav_tel_buf_length += length_message;   // Overall length of buffer
     if (mav_tel_message_counter == 5) {
+        (*proxy_seq_number)++;  // same seq. num. on all adapters so that the receiver can drop the duplicates
         for (int i = 0; i < num_inf; i++) {
             db_send_div(&raw_interfaces_telem[i], mavlink_telemetry_buf, DB_PORT_PROXY,
-                        (u_int16_t) mav_tel_buf_length, update_seq_num(proxy_seq_number),
-                        cont_adhere_80211);
+                        (u_int16_t) mav_tel_buf_length, *proxy_seq_number, cont_adhere_80211);
         }
         mav_tel_message_counter = 0;
         mav_tel_buf_length = 0;
@@ -153,7 +154,7 @@ uint8_t get_cpu_temp() {
  * @param rc_status_update_data
  * @return
  */
-uint8_t send_status_update(uint8_t *status_seq_number, db_socket_t *raw_interfaces_telem, int8_t rssi, long *start,
+uint8_t send_status_update(uint32_t *status_seq_number, db_socket_t *raw_interfaces_telem, int8_t rssi, long *start,
                            long *start_rc, uint8_t *rc_packets_tmp, uint8_t rc_packets_cnt,
                            struct uav_rc_status_update_message_t *rc_status_update_data, const long *rightnow) {
     struct timeval time_check;
@@ -170,9 +171,10 @@ uint8_t send_status_update(uint8_t *status_seq_number, db_socket_t *raw_interfac
         rc_status_update_data->cpu_usage_uav = get_cpu_usage();
         rc_status_update_data->cpu_temp_uav = get_cpu_temp();
         rc_status_update_data->uav_is_low_V = get_undervolt();
+        (*status_seq_number)++;
         for (int i = 0; i < num_inf; i++) {
-            db_send_hp_div(&raw_interfaces_telem[i], DB_PORT_STATUS,
-                           (u_int16_t) 14, update_seq_num(status_seq_number));
+            db_send_div(&raw_interfaces_telem[i], (uint8_t *) rc_status_update_data, DB_PORT_STATUS,
+                        (u_int16_t) 14, *status_seq_number, cont_adhere_80211);
         }
 
         gettimeofday(&time_check, NULL);
@@ -292,7 +294,9 @@ int main(int argc, char *argv[]) {
     char sumd_interface[IFNAMSIZ];
     char telem_inf[IFNAMSIZ];
     uint8_t comm_id = DEFAULT_V2_COMMID, frame_type = DB_FRAMETYPE_DEFAULT;
-    uint8_t status_seq_number = 0, proxy_seq_number = 0, serial_byte;
+    uint8_t serial_byte;
+    uint32_t status_seq_number = 0, proxy_seq_number = 0;
+    bool ext_seq_num = false;
     char db_mode = 'm';
     char adapters[DB_MAX_ADAPTERS][IFNAMSIZ];
 
@@ -303,7 +307,7 @@ int main(int argc, char *argv[]) {
     strcpy(sumd_interface, UART_IF);
     cont_adhere_80211 = 0;
     opterr = 0;
-    while ((c = getopt(argc, argv, "n:u:m:c:b:v:l:e:s:r:t:a:")) != -1) {
+    while ((c = getopt(argc, argv, "n:u:m:c:b:v:l:e:s:r:t:a:x:")) != -1) {
         switch (c) {
             case 'n':
                 if (num_inf < DB_MAX_ADAPTERS) {
@@ -343,6 +347,10 @@ int main(int argc, char *argv[]) {
                 break;
             case 'a':
                 cont_adhere_80211 = (int) strtol(optarg, NULL, 10);
+                break;
+            case 'x':
+                ext_seq_num = strtol(optarg, NULL, 10) != 0;
+                break;
             case '?':
                 printf("Invalid commandline arguments. Use "
                        "\n\t-n <Network interface name - multiple <-n interface> possible> "
@@ -367,7 +375,9 @@ int main(int argc, char *argv[]) {
                        "\n\t-b bit rate:\tin Mbps (1|2|5|6|9|11|12|18|24|36|48|54)\n\t\t(bitrate option only "
                        "supported with Ralink chipsets)"
                        "\n\t-a [0|1] to disable/enable. Offsets the payload by some bytes so that it sits outside "
-                       "then 802.11 header. Set this to 1 if you are using a non DB-Rasp Kernel!",
+                       "then 802.11 header. Set this to 1 if you are using a non DB-Rasp Kernel!"
+                       "\n\t-x [0|1] to disable/enable. Send 32 bit sequence numbers (extended DB raw header) so that "
+                       "duplicates are detected reliably. Receivers detect it automatically",
                        chucksize, baud_rate);
                 break;
             default:
@@ -382,11 +392,14 @@ int main(int argc, char *argv[]) {
 // -------------------------------
     db_socket_t raw_interfaces_rc[DB_MAX_ADAPTERS] = {0};
     db_socket_t raw_interfaces_telem[DB_MAX_ADAPTERS] = {0};
+    db_rt_plan_t radiotap_plans[DB_MAX_ADAPTERS];   // RC and control frames of an adapter share the radiotap layout
     for (int i = 0; i < num_inf; ++i) {
         raw_interfaces_rc[i] = open_db_socket(adapters[i], comm_id, db_mode, bitrate_op, DB_DIREC_GROUND, DB_PORT_RC,
                                               frame_type);
         raw_interfaces_telem[i] = open_db_socket(adapters[i], comm_id, db_mode, bitrate_op, DB_DIREC_GROUND,
                                                  DB_PORT_CONTROLLER, frame_type);
+        db_socket_set_ext_seq_num(&raw_interfaces_telem[i], ext_seq_num, DB_STREAM_DEFAULT);
+        db_rt_plan_init(&radiotap_plans[i]);
     }
 
 // -------------------------------
@@ -416,12 +429,20 @@ int main(int argc, char *argv[]) {
     int sentbytes = 0, command_length = 0, errsv, select_return, continue_reading, serial_read_bytes = 0, max_sd = 0;
     uint16_t radiotap_lenght;
     uint8_t serial_bytes[DB_TRANSPARENT_READBUF];
-    int8_t rssi = -128, last_recv_rc_seq_num = 0, last_recv_cont_seq_num = 0;
+    int8_t rssi = -128;
     unsigned int addrlen = sizeof(struct sockaddr);
     long start; // start time for status report update
     long start_rc; // start time for measuring the recv RC packets/second
 
-    uint8_t rc_packets_tmp = 0, rc_packets_cnt = 0, seq_num_rc = 0, seq_num_cont = 0;
+    uint8_t rc_packets_tmp = 0, rc_packets_cnt = 0, last_recv_cont_seq_num = 0;
+    db_seq_num_t seq_num;
+    // diversity duplicate protection: every frame is processed once no matter how many adapters received it.
+    // DB_PORT_CONTROLLER is shared by ground control (RC via MSP/MAVLink) and proxy: one tracker per stream
+    db_seq_tracker_t rc_seq_tracker, cont_seq_trackers[DB_RAW_EXT_MAX_STREAMS];
+    db_seq_tracker_init(&rc_seq_tracker);
+    for (int i = 0; i < DB_RAW_EXT_MAX_STREAMS; i++)
+        db_seq_tracker_init(&cont_seq_trackers[i]);
+    bool is_new_frame;
     mavlink_message_t mavlink_message;
     mavlink_status_t mavlink_status;
     mspPort_t db_msp_port;
@@ -437,8 +458,9 @@ int main(int argc, char *argv[]) {
     uint8_t commandBuf[COMMAND_BUF_SIZE];
     struct timeval timecheck;
 
-    // create our data pointer directly inside the buffer (monitor_framebuffer) that is sent over the socket
-    struct data_uni *raw_buffer = get_hp_raw_buffer(cont_adhere_80211);
+    // payload buffer for all adapters. db_send_div() sends it without copying
+    struct data_uni telem_buffer;
+    struct data_uni *raw_buffer = &telem_buffer;
     struct uav_rc_status_update_message_t *rc_status_update_data = (struct uav_rc_status_update_message_t *) raw_buffer;
     memset(raw_buffer->bytes, 0, DATA_UNI_LENGTH);
 
@@ -497,10 +519,9 @@ int main(int argc, char *argv[]) {
                     length = recv(raw_interfaces_rc[i].db_socket, buf, BUF_SIZ, 0);
                     if (length > 0) {
                         rc_packets_cnt++;
-                        get_db_payload(buf, length, commandBuf, &seq_num_rc, &radiotap_lenght);
-                        rssi = get_rssi(buf, radiotap_lenght);
-                        if (last_recv_rc_seq_num != seq_num_rc) {  // diversity duplicate protection
-                            last_recv_rc_seq_num = seq_num_rc;
+                        get_db_payload_seq(buf, length, commandBuf, &seq_num, &radiotap_lenght);
+                        rssi = get_rssi(buf, radiotap_lenght, &radiotap_plans[i]);
+                        if (db_seq_tracker_check(&rc_seq_tracker, &seq_num)) {
                             command_length = generate_rc_serial_message(commandBuf);
                             write_to_serial(rc_serial_socket, serial_data_buffer, command_length, "RC");
                         }
@@ -515,10 +536,17 @@ int main(int argc, char *argv[]) {
                     // --------------------------------
                     length = recv(raw_interfaces_telem[i].db_socket, buf, BUF_SIZ, 0);
                     if (length > 0) {
-                        rssi = get_rssi(buf, buf[2]);
-                        if (last_recv_cont_seq_num != seq_num_cont) {  // diversity duplicate protection
-                            last_recv_cont_seq_num = seq_num_cont;
-                            command_length = get_db_payload(buf, length, commandBuf, &seq_num_cont, &radiotap_lenght);
+                        rssi = get_rssi(buf, buf[2], &radiotap_plans[i]);
+                        command_length = get_db_payload_seq(buf, length, commandBuf, &seq_num, &radiotap_lenght);
+                        if (seq_num.seq_num_bits == 8) {
+                            // without stream ID the two senders can not be told apart: only drop direct repetitions
+                            is_new_frame = last_recv_cont_seq_num != (uint8_t) seq_num.seq_num;
+                            last_recv_cont_seq_num = (uint8_t) seq_num.seq_num;
+                        } else {
+                            is_new_frame = db_seq_tracker_check(
+                                    &cont_seq_trackers[seq_num.stream_id % DB_RAW_EXT_MAX_STREAMS], &seq_num);
+                        }
+                        if (is_new_frame) {
                             write_to_serial(socket_control_serial, commandBuf, command_length, "MSP/MAVLink");
                         }
                     }
@@ -548,10 +576,11 @@ int main(int argc, char *argv[]) {
                                     raw_buffer->bytes[(serial_read_bytes - 1)] = serial_byte;
                                     if (db_msp_port.c_state == MSP_COMMAND_RECEIVED) {
                                         continue_reading = 0; // stop reading from serial port --> got a complete message!
+                                        proxy_seq_number++;
                                         for (int i = 0; i < num_inf; i++) {
-                                            db_send_hp_div(&raw_interfaces_telem[i], DB_PORT_PROXY,
-                                                           (u_int16_t) serial_read_bytes,
-                                                           update_seq_num(&proxy_seq_number));
+                                            db_send_div(&raw_interfaces_telem[i], raw_buffer->bytes, DB_PORT_PROXY,
+                                                        (u_int16_t) serial_read_bytes, proxy_seq_number,
+                                                        cont_adhere_80211);
                                         }
                                         write_to_unix(unix_server_clients, raw_buffer->bytes, serial_read_bytes);
                                     }
@@ -579,9 +608,10 @@ int main(int argc, char *argv[]) {
                                                        &mavlink_status)) {
                                     continue_reading = 0; // stop reading from serial port --> got a complete message!
                                     mavlink_msg_to_send_buffer(raw_buffer->bytes, &mavlink_message);
+                                    proxy_seq_number++;
                                     for (int i = 0; i < num_inf; i++) {
-                                        db_send_hp_div(&raw_interfaces_telem[i], DB_PORT_PROXY, serial_read_bytes,
-                                                update_seq_num(&proxy_seq_number));
+                                        db_send_div(&raw_interfaces_telem[i], raw_buffer->bytes, DB_PORT_PROXY,
+                                                    serial_read_bytes, proxy_seq_number, cont_adhere_80211);
                                     }
                                     write_to_unix(unix_server_clients, raw_buffer->bytes, serial_read_bytes);
                                 }
@@ -595,13 +625,14 @@ int main(int argc, char *argv[]) {
                             memcpy(&transparent_buffer[serial_read_bytes], &serial_bytes, read_bytes);
                             serial_read_bytes += read_bytes;
                             if (serial_read_bytes >= chucksize) {
+                                // retransmissions are copies: ground drops them like the copies of other adapters
+                                proxy_seq_number++;
                                 for (int i = 0; i < num_inf; i++) {
                                     //LOG_SYS_STD(LOG_DEBUG, "DB_CONTROL_AIR: Sending transparent packet %i\n",
                                     //            serial_read_bytes);
                                     for (int r = 0; r < RETRANSMISSION_RATE; r++) {
                                         db_send_div(&raw_interfaces_telem[i], transparent_buffer, DB_PORT_PROXY,
-                                                    serial_read_bytes, update_seq_num(&proxy_seq_number),
-                                                    cont_adhere_80211);
+                                                    serial_read_bytes, proxy_seq_number, cont_adhere_80211);
                                     }
                                     write_to_unix(unix_server_clients, raw_buffer->bytes, serial_read_bytes);
                                 }
@@ -28,7 +28,8 @@
 
 
 int rc_protocol;
-uint8_t crc_mspv2, crc8, rc_seq_number = 0;
+uint8_t crc_mspv2, crc8;
+uint32_t rc_seq_number = 0;   // same seq. num. is sent on all adapters
 crc_t crc_rc;
 int i_crc, i_rc, num_interfaces = 0;
 unsigned int rc_crc_tbl_idx, mspv2_tbl_idx;
@@ -37,8 +38,10 @@ db_rc_overwrite_values_t *shm_rc_overwrite = NULL;
 struct timespec timestamp;
 bool en_rc_overwrite = false;
 
-// pointing right into the sockets send buffer for max performance
-struct data_uni *monitor_databuffer;
+// payload buffer that gets sent on all adapters via db_send_div() (no copy)
+struct data_uni rc_databuffer;
+struct data_uni *monitor_databuffer = &rc_databuffer;
+int rc_adhere_80211 = 0;
 
 // DroneBridge raw interfaces. One per adapter
 db_socket_t raw_interfaces_rc[DB_MAX_ADAPTERS] = {0};
@@ -244,16 +247,19 @@ void do_calibration(char *calibrate_comm, int joy_interface_indx) {
  * Sets the desired RC protocol. Opens DroneBridge raw protocol sockets for transmission
  * @param new_rc_protocol 1:MSPv1, 2:MSPv2, 3:MAVLink v1, 4:MAVLink v2, 5:DB-RC
  * @param allow_rc_overwrite Set to 'Y' if you want to allow the overwrite of RC channels via a shm/external app
+ * @param ext_seq_num Send 32 bit sequence numbers (extended DB raw header)
  * @return
  */
 void conf_rc(char adapters[DB_MAX_ADAPTERS][IFNAMSIZ], int num_inf_rc, int comm_id, char db_mode, int bitrate_op,
-            int frame_type, int new_rc_protocol, char allow_rc_overwrite, int adhere_80211) {
+            int frame_type, int new_rc_protocol, char allow_rc_overwrite, int adhere_80211, bool ext_seq_num) {
     rc_protocol = new_rc_protocol;
     en_rc_overwrite = allow_rc_overwrite == 'Y' ? true : false;
-    monitor_databuffer = get_hp_raw_buffer(adhere_80211);
+    rc_adhere_80211 = adhere_80211;
     for (int i = 0; i < num_inf_rc; i++) {
         raw_interfaces_rc[i] = open_db_socket(adapters[i], comm_id, db_mode, bitrate_op, DB_DIREC_DRONE,
                                               DB_PORT_CONTROLLER, frame_type);
+        // RC via MSP/MAVLink shares DB_PORT_CONTROLLER with the proxy module
+        db_socket_set_ext_seq_num(&raw_interfaces_rc[i], ext_seq_num, DB_STREAM_RC);
     }
     num_interfaces = num_inf_rc;
 }
@@ -290,27 +296,29 @@ int send_rc_packet(uint16_t channel_data[]) {
         shm_rc_values->ch[i_rc] = channel_data[i_rc];
     }
 
+    rc_seq_number++;
     if (rc_protocol == 1) {
         generate_msp(channel_data);
         for (int i = 0; i < num_interfaces; i++) {
-            db_send_hp_div(&raw_interfaces_rc[i], DB_PORT_CONTROLLER, MSP_DATA_LENTH,
-                           update_seq_num(&rc_seq_number));
+            db_send_div(&raw_interfaces_rc[i], monitor_databuffer->bytes, DB_PORT_CONTROLLER, MSP_DATA_LENTH,
+                        rc_seq_number, rc_adhere_80211);
         }
     } else if (rc_protocol == 2) {
         generate_mspv2(channel_data);
         for (int i = 0; i < num_interfaces; i++) {
-            db_send_hp_div(&raw_interfaces_rc[i], DB_PORT_CONTROLLER, MSP_V2_DATA_LENGTH,
-                           update_seq_num(&rc_seq_number));
+            db_send_div(&raw_interfaces_rc[i], monitor_databuffer->bytes, DB_PORT_CONTROLLER, MSP_V2_DATA_LENGTH,
+                        rc_seq_number, rc_adhere_80211);
         }
     } else if (rc_protocol == 4) {
         for (int i = 0; i < num_interfaces; i++) {
-            db_send_hp_div(&raw_interfaces_rc[i], DB_PORT_CONTROLLER, generate_mavlinkv2_rc_overwrite(channel_data),
-                           update_seq_num(&rc_seq_number));
+            db_send_div(&raw_interfaces_rc[i], monitor_databuffer->bytes, DB_PORT_CONTROLLER,
+                        generate_mavlinkv2_rc_overwrite(channel_data), rc_seq_number, rc_adhere_80211);
         }
     } else if (rc_protocol == 5) {
         generate_db_rc_message(channel_data);
         for (int i = 0; i < num_interfaces; i++) {
-            db_send_hp_div(&raw_interfaces_rc[i], DB_PORT_RC, DB_RC_DATA_LENGTH, update_seq_num(&rc_seq_number));
+            db_send_div(&raw_interfaces_rc[i], monitor_databuffer->bytes, DB_PORT_RC, DB_RC_DATA_LENGTH,
+                        rc_seq_number, rc_adhere_80211);
         }
     }
     return 0;
@@ -20,6 +20,7 @@
 #ifndef CONTROL_TX_H
 #define CONTROL_TX_H
 
+#include <stdbool.h>
 #include "../common/db_protocol.h"
 
 int send_rc_packet(uint16_t channel_data[]);
@@ -29,7 +30,7 @@ void get_joy_interface_path(char *dst_joy_interface_path, int joy_interface_indx
 void do_calibration(char *calibrate_comm, int joy_interface_indx);
 
 void conf_rc(char adapters[DB_MAX_ADAPTERS][IFNAMSIZ], int num_inf_rc, int comm_id, char db_mode, int bitrate_op,
-            int frame_type, int new_rc_protocol, char allow_rc_overwrite, int adhere_80211);
+            int frame_type, int new_rc_protocol, char allow_rc_overwrite, int adhere_80211, bool ext_seq_num);
 
 void open_rc_shm();
 
@@ -0,0 +1,434 @@
+/*
+ *   This file is part of DroneBridge: https://github.com/seeul8er/DroneBridge
+ *
+ *   Copyright 2020 Wolfgang Christl
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+/*
+ * Link daemon: Owns one DroneBridge raw socket per adapter and distributes the received frames by their DroneBridge
+ * port to the modules. Every module gets its own shared memory ring and an eventfd (see common/db_link.h). The kernel
+ * only has to deliver every frame to a single socket instead of one socket per module and adapter.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+#include "../common/db_common.h"
+#include "../common/db_protocol.h"
+#include "../common/db_raw_receive.h"
+#include "../common/db_raw_send_receive.h"
+#include "../common/db_link.h"
+
+#define MAX_LINK_CLIENTS        16
+#define MAX_RECV_PER_WAKEUP     64  // max. frames read via recv() from one socket before the other sockets are served
+#define LINK_POLL_TIMEOUT_MS    500
+#define LINK_REGISTER_TIMEOUT_MS 1000   // modules that did not send their registration by then get disconnected
+
+typedef struct {
+    int conn;                   // unix domain connection to the module. -1 if unused
+    bool registered;            // false while the registration request of the module is pending
+    uint64_t connect_ms;        // time the module connected (CLOCK_MONOTONIC)
+    int event_fd;
+    uint8_t port;
+    db_link_ring_t *ring;
+    size_t ring_length;
+    bool pending_notify;        // frames were pushed since the last notification
+    uint32_t delivered_frame_cnt;
+} link_client_t;
+
+volatile bool keeprunning = true;
+uint8_t comm_id = DEFAULT_V2_COMMID;
+uint8_t send_direction = DB_DIREC_DRONE;
+int num_interfaces = 0;
+char adapters[DB_MAX_ADAPTERS][IFNAMSIZ];
+db_socket_t raw_sockets[DB_MAX_ADAPTERS];
+link_client_t clients[MAX_LINK_CLIENTS];
+link_client_t *port_clients[DB_LINK_NUM_PORTS];    // module registered for a port. NULL if none
+uint32_t unclaimed_frame_cnt = 0;                   // frames for ports no module is registered for
+uint8_t recv_buffer[DB_LINK_MAX_FRAME_SIZE];
+
+void int_handler(int dummy) {
+    (void) dummy;
+    keeprunning = false;
+}
+
+static uint64_t now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + (uint64_t) ts.tv_nsec / 1000000;
+}
+
+void process_command_line_args(int argc, char *argv[]) {
+    int c;
+    opterr = 0;
+    while ((c = getopt(argc, argv, "n:c:d:?")) != -1) {
+        switch (c) {
+            case 'n':
+                if (num_interfaces < DB_MAX_ADAPTERS) {
+                    strncpy(adapters[num_interfaces], optarg, IFNAMSIZ - 1);
+                    num_interfaces++;
+                }
+                break;
+            case 'c':
+                comm_id = (uint8_t) strtol(optarg, NULL, 10);
+                break;
+            case 'd':
+                send_direction = (uint8_t) (*optarg == 'a' ? DB_DIREC_GROUND : DB_DIREC_DRONE);
+                break;
+            case '?':
+                printf("DroneBridge link daemon. Receives all DroneBridge frames and hands them to the modules via "
+                       "shared memory rings. Use"
+                       "\n\t-n <network_IF> Adapter to receive on. Use multiple -n for multiple adapters"
+                       "\n\t-c <communication_id> Choose 0-255"
+                       "\n\t-d [g|a] Side the daemon runs on: g=ground station (default), a=air/UAV\n");
+                exit(0);
+            default:
+                abort();
+        }
+    }
+}
+
+/**
+ * Creates the unix domain socket modules register at
+ *
+ * @return The listening socket or -1 on failure
+ */
+int open_link_server() {
+    int server = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (server == -1) {
+        perror("DB_LINK: Could not create unix socket");
+        return -1;
+    }
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(struct sockaddr_un));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, DB_LINK_UNIX_PATH, sizeof(addr.sun_path) - 1);
+    unlink(DB_LINK_UNIX_PATH);
+    if (bind(server, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(server, MAX_LINK_CLIENTS) != 0) {
+        LOG_SYS_STD(LOG_ERR, "DB_LINK: Could not listen on %s - %s\n", DB_LINK_UNIX_PATH, strerror(errno));
+        close(server);
+        return -1;
+    }
+    return server;
+}
+
+/**
+ * Frees the ring, the eventfd and the connection of a client and marks its slot as unused
+ */
+void release_client(link_client_t *client) {
+    if (port_clients[client->port] == client)
+        port_clients[client->port] = NULL;
+    if (client->ring != NULL)
+        munmap(client->ring, client->ring_length);
+    if (client->event_fd >= 0)
+        close(client->event_fd);
+    close(client->conn);
+    memset(client, 0, sizeof(link_client_t));
+    client->conn = -1;
+    client->event_fd = -1;
+}
+
+void remove_client(link_client_t *client) {
+    if (client->registered)
+        LOG_SYS_STD(LOG_INFO, "DB_LINK: Module of port %u left. Delivered %u frames, dropped %u (ring full)\n",
+                    client->port, client->delivered_frame_cnt, client->ring->dropped_frame_cnt);
+    release_client(client);
+}
+
+void refuse_registration(int conn) {
+    LOG_SYS_STD(LOG_ERR, "DB_LINK: Refused module registration (no free slot, bad request or port taken)\n");
+    db_link_register_reply_t reply = {.status = -1, .ring_length = 0};
+    send(conn, &reply, sizeof(reply), MSG_NOSIGNAL);
+}
+
+/**
+ * Creates the shared memory ring and the eventfd of a module and hands both file descriptors to it
+ *
+ * @param client Unused client slot. conn must be set
+ * @param request Registration sent by the module
+ * @return 0 on success, -1 on failure
+ */
+int setup_client(link_client_t *client, db_link_register_t *request) {
+    uint32_t slot_nr = 1;
+    while (slot_nr < request->slot_nr && slot_nr < DB_LINK_MAX_RING_SLOTS)
+        slot_nr <<= 1u;
+    client->port = request->port;
+    client->ring_length = db_link_ring_length(slot_nr);
+    char shm_name[32];
+    snprintf(shm_name, sizeof(shm_name), DB_LINK_SHM_NAME, request->port);
+    int shm_fd = shm_open(shm_name, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (shm_fd < 0) {
+        LOG_SYS_STD(LOG_ERR, "DB_LINK: shm_open %s failed - %s\n", shm_name, strerror(errno));
+        return -1;
+    }
+    shm_unlink(shm_name);   // memory is only shared via the passed file descriptor
+    if (ftruncate(shm_fd, (off_t) client->ring_length) == -1 ||
+        (client->ring = mmap(NULL, client->ring_length, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0)) ==
+        MAP_FAILED) {
+        LOG_SYS_STD(LOG_ERR, "DB_LINK: Could not create ring of port %u - %s\n", request->port, strerror(errno));
+        client->ring = NULL;
+        close(shm_fd);
+        return -1;
+    }
+    db_link_ring_init(client->ring, slot_nr, (uint32_t) num_interfaces, adapters);
+    if ((client->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+        LOG_SYS_STD(LOG_ERR, "DB_LINK: Could not create eventfd - %s\n", strerror(errno));
+        close(shm_fd);
+        return -1;
+    }
+    db_link_register_reply_t reply = {.status = 0, .ring_length = (uint32_t) client->ring_length};
+    union {
+        struct cmsghdr align;
+        uint8_t buf[CMSG_SPACE(2 * sizeof(int))];
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct iovec iov = {.iov_base = &reply, .iov_len = sizeof(reply)};
+    struct msghdr msg = {.msg_iov = &iov, .msg_iovlen = 1, .msg_control = control.buf,
+                         .msg_controllen = sizeof(control.buf)};
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(2 * sizeof(int));
+    int fds[2] = {shm_fd, client->event_fd};
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    ssize_t sent = sendmsg(client->conn, &msg, 0);
+    close(shm_fd);
+    if (sent != sizeof(reply)) {
+        LOG_SYS_STD(LOG_ERR, "DB_LINK: Could not answer module of port %u - %s\n", request->port, strerror(errno));
+        return -1;
+    }
+    port_clients[client->port] = client;
+    LOG_SYS_STD(LOG_INFO, "DB_LINK: Module registered for port %u (%u slots)\n", client->port, slot_nr);
+    return 0;
+}
+
+/**
+ * Accepts a module connection. The connection is non-blocking and stays pending until the registration request of the
+ * module arrives (see register_client()), so a slow module does not stall the frame delivery to all others.
+ */
+void accept_client(int server) {
+    int conn = accept(server, NULL, NULL);
+    if (conn < 0) {
+        perror("DB_LINK: Accepting module connection failed");
+        return;
+    }
+    link_client_t *client = NULL;
+    for (int i = 0; i < MAX_LINK_CLIENTS && client == NULL; i++) {
+        if (clients[i].conn == -1)
+            client = &clients[i];
+    }
+    if (client == NULL) {
+        refuse_registration(conn);
+        close(conn);
+        return;
+    }
+    set_socket_nonblocking(&conn);
+    client->conn = conn;
+    client->registered = false;
+    client->connect_ms = now_ms();
+}
+
+/**
+ * Handles the registration request of a pending module once its connection is readable
+ */
+void register_client(link_client_t *client) {
+    db_link_register_t request;
+    ssize_t l = recv(client->conn, &request, sizeof(request), MSG_DONTWAIT);
+    if (l < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return;
+    if (l != sizeof(request) || port_clients[request.port] != NULL || setup_client(client, &request) < 0) {
+        refuse_registration(client->conn);
+        release_client(client);
+        return;
+    }
+    client->registered = true;
+}
+
+/**
+ * Disconnects modules that connected but did not send their registration within LINK_REGISTER_TIMEOUT_MS
+ */
+void expire_pending_clients() {
+    uint64_t now = now_ms();
+    for (int i = 0; i < MAX_LINK_CLIENTS; i++) {
+        if (clients[i].conn != -1 && !clients[i].registered &&
+            now - clients[i].connect_ms >= LINK_REGISTER_TIMEOUT_MS) {
+            LOG_SYS_STD(LOG_ERR, "DB_LINK: Module did not register within %i ms\n", LINK_REGISTER_TIMEOUT_MS);
+            release_client(&clients[i]);
+        }
+    }
+}
+
+/**
+ * Copies a received frame into the ring of the module registered for the DroneBridge port of the frame
+ *
+ * @param frame Received frame starting with the radiotap header
+ * @param frame_length Length of the frame
+ * @param adapter_no Index of the adapter that received the frame
+ */
+void dispatch_frame(const uint8_t *frame, uint32_t frame_length, int adapter_no) {
+    if (frame_length < 4)
+        return;
+    uint16_t radiotap_length = (uint16_t) (frame[2] | (frame[3] << 8u));
+    if (frame_length < (uint32_t) radiotap_length + DB_RAW_V2_HEADER_LENGTH || frame_length > DB_LINK_MAX_FRAME_SIZE)
+        return;
+    const struct db_raw_v2_header_t *db_header = (const struct db_raw_v2_header_t *) (frame + radiotap_length);
+    link_client_t *client = port_clients[db_header->port];
+    if (client == NULL) {
+        unclaimed_frame_cnt++;
+        return;
+    }
+    db_link_slot_t *slot = db_link_ring_producer_slot(client->ring);
+    if (slot == NULL)
+        return;
+    slot->frame_length = (uint16_t) frame_length;
+    slot->adapter_no = (uint8_t) adapter_no;
+    memcpy(slot->frame, frame, frame_length);
+    db_link_ring_push(client->ring);
+    client->delivered_frame_cnt++;
+    client->pending_notify = true;
+}
+
+/**
+ * Reads all frames that are waiting on the socket of an adapter
+ */
+void receive_frames(db_socket_t *raw_socket, int adapter_no) {
+    if (raw_socket->rx_ring != NULL) {
+        db_rx_block_iter_t iter;
+        uint8_t *frame;
+        uint32_t frame_length;
+        while (db_rx_ring_next_block(raw_socket->rx_ring, &iter)) {
+            while ((frame = db_rx_block_next_frame(&iter, &frame_length)) != NULL)
+                dispatch_frame(frame, frame_length, adapter_no);
+            db_rx_ring_release_block(raw_socket->rx_ring, &iter);
+        }
+    } else {
+        for (int i = 0; i < MAX_RECV_PER_WAKEUP; i++) {
+            ssize_t l = recv(raw_socket->db_socket, recv_buffer, sizeof(recv_buffer), MSG_DONTWAIT);
+            if (l <= 0) {
+                if (l < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+                    LOG_SYS_STD(LOG_ERR, "DB_LINK: Received an error: %s\n", strerror(errno));
+                break;
+            }
+            dispatch_frame(recv_buffer, (uint32_t) l, adapter_no);
+        }
+    }
+}
+
+/**
+ * Wakes up the modules that got new frames since the last call. One eventfd write per module and wake up at most
+ */
+void notify_clients() {
+    for (int i = 0; i < MAX_LINK_CLIENTS; i++) {
+        if (clients[i].conn != -1 && clients[i].pending_notify) {
+            db_link_ring_notify(clients[i].ring, clients[i].event_fd);
+            clients[i].pending_notify = false;
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    signal(SIGINT, int_handler);
+    signal(SIGTERM, int_handler);
+    signal(SIGPIPE, SIG_IGN);
+    process_command_line_args(argc, argv);
+    for (int i = 0; i < MAX_LINK_CLIENTS; i++) {
+        clients[i].conn = -1;
+        clients[i].event_fd = -1;
+    }
+
+    uint8_t recv_direction = (uint8_t) ((send_direction == DB_DIREC_DRONE) ? DB_DIREC_GROUND : DB_DIREC_DRONE);
+    for (int i = 0; i < num_interfaces; i++) {
+        raw_sockets[i] = open_db_socket(adapters[i], comm_id, 'm', 11, send_direction, DB_PORT_CONTROLLER,
+                                        DB_FRAMETYPE_DATA);
+        if (raw_sockets[i].db_socket < 0 || setBPF_all_ports(raw_sockets[i].db_socket, comm_id, recv_direction) < 0) {
+            LOG_SYS_STD(LOG_ERR, "DB_LINK: Could not open socket on %s\n", adapters[i]);
+            exit(-1);
+        }
+        db_socket_enable_rx_ring(&raw_sockets[i], DB_RX_RING_BLOCK_SIZE, DB_RX_RING_BLOCK_NR);
+    }
+    int server = open_link_server();
+    if (server < 0)
+        exit(-1);
+
+    LOG_SYS_STD(LOG_INFO, "DB_LINK: Started on %i adapters. Modules register at %s\n", num_interfaces,
+                DB_LINK_UNIX_PATH);
+    struct pollfd poll_fds[DB_MAX_ADAPTERS + 1 + MAX_LINK_CLIENTS];
+    link_client_t *poll_clients[MAX_LINK_CLIENTS];
+    while (keeprunning) {
+        expire_pending_clients();
+        int nfds = 0;
+        for (int i = 0; i < num_interfaces; i++)
+            poll_fds[nfds++] = (struct pollfd) {.fd = raw_sockets[i].db_socket, .events = POLLIN};
+        poll_fds[nfds++] = (struct pollfd) {.fd = server, .events = POLLIN};
+        int num_poll_clients = 0;
+        for (int i = 0; i < MAX_LINK_CLIENTS; i++) {
+            if (clients[i].conn != -1) {
+                poll_clients[num_poll_clients++] = &clients[i];
+                poll_fds[nfds++] = (struct pollfd) {.fd = clients[i].conn, .events = POLLIN};
+            }
+        }
+        int ret = poll(poll_fds, (nfds_t) nfds, LINK_POLL_TIMEOUT_MS);
+        if (ret < 0) {
+            if (errno != EINTR)
+                perror("DB_LINK: poll");
+            continue;
+        } else if (ret == 0) {
+            continue;
+        }
+        for (int i = 0; i < num_interfaces; i++) {
+            if (poll_fds[i].revents & POLLIN)
+                receive_frames(&raw_sockets[i], i);
+        }
+        notify_clients();
+        // pending modules send their registration. Registered ones never send, readable means the module left
+        for (int i = 0; i < num_poll_clients; i++) {
+            short revents = poll_fds[num_interfaces + 1 + i].revents;
+            if (!poll_clients[i]->registered && revents == POLLIN)
+                register_client(poll_clients[i]);
+            else if (revents)
+                remove_client(poll_clients[i]);
+        }
+        if (poll_fds[num_interfaces].revents & POLLIN)
+            accept_client(server);
+    }
+
+    for (int i = 0; i < MAX_LINK_CLIENTS; i++) {
+        if (clients[i].conn != -1)
+            remove_client(&clients[i]);
+    }
+    for (int i = 0; i < num_interfaces; i++) {
+        if (raw_sockets[i].rx_ring != NULL)
+            close_rx_ring(raw_sockets[i].rx_ring);
+        close(raw_sockets[i].db_socket);
+    }
+    close(server);
+    unlink(DB_LINK_UNIX_PATH);
+    LOG_SYS_STD(LOG_INFO, "DB_LINK: Terminated. %u frames for ports without module\n", unclaimed_frame_cnt);
+    return 0;
+}
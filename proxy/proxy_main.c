@@ -34,9 +34,12 @@
 #include "../common/db_protocol.h"
 #include "../common/db_raw_receive.h"
 #include "../common/db_raw_send_receive.h"
+#include "../common/db_link.h"
+#include "../common/db_seq_tracker.h"
 #include "../common/tcp_server.h"
 #include "../common/mavlink/c_library_v2/mavlink_types.h"
 #include "../common/db_common.h"
+#include "../common/db_recorder.h"
 
 #define TCP_BUFFER_SIZE (DATA_UNI_LENGTH-DB_RAW_V2_HEADER_LENGTH)
 #define MAX_TCP_CLIENTS 10
@@ -48,8 +51,10 @@ bool volatile keeprunning = true;
 char db_mode, write_to_osdfifo;
 uint8_t comm_id = DEFAULT_V2_COMMID, frame_type;
 int bitrate_op, prox_adhere_80211, num_interfaces;
+bool use_link, ext_seq_num;
 char adapters[DB_MAX_ADAPTERS][IFNAMSIZ];
 char log_path[MAX_PATH_LENGTH];
+char *recorder_dir = NULL;
 uint8_t tel_msg_log_buff[MAVLINK_MAX_PACKET_LEN + sizeof(uint64_t)];
 
 void int_handler(int dummy) {
@@ -70,10 +75,13 @@ void process_command_line_args(int argc, char *argv[]) {
     num_interfaces = 0;
     bitrate_op = 1;
     prox_adhere_80211 = 0;
+    use_link = false;
+    ext_seq_num = false;
+    recorder_dir = NULL;
     frame_type = DB_FRAMETYPE_DEFAULT;
     strcpy(log_path, DEFAULT_LOG_PATH);
     int c;
-    while ((c = getopt(argc, argv, "n:m:c:b:o:f:a:l:?")) != -1) {
+    while ((c = getopt(argc, argv, "n:m:c:b:o:f:a:l:Lx:C:?")) != -1) {
         switch (c) {
             case 'n':
                 if (num_interfaces < DB_MAX_ADAPTERS) {
@@ -102,6 +110,15 @@ void process_command_line_args(int argc, char *argv[]) {
             case 'a':
                 prox_adhere_80211 = (int) strtol(optarg, NULL, 10);
                 break;
+            case 'L':
+                use_link = true;
+                break;
+            case 'x':
+                ext_seq_num = strtol(optarg, NULL, 10) != 0;
+                break;
+            case 'C':
+                recorder_dir = optarg;
+                break;
             case '?':
                 LOG_SYS_STD(LOG_INFO,
                             "DroneBridge Proxy module is used to do any UDP <-> DB_CONTROL_AIR routing. UDP IP given by "
@@ -115,7 +132,11 @@ void process_command_line_args(int argc, char *argv[]) {
                             "\n\t-b bit rate:\tin Mbps (1|2|5|6|9|11|12|18|24|36|48|54)\n\t\t(bitrate option only "
                             "supported with Ralink chipsets)"
                             "\n\t-a [0|1] to disable/enable. Offsets the payload by some bytes so that it sits outside "
-                            "then 802.11 header. Set this to 1 if you are using a non DB-Rasp Kernel!");
+                            "then 802.11 header. Set this to 1 if you are using a non DB-Rasp Kernel!"
+                            "\n\t-L Receive via the link daemon (db_link) instead of own raw sockets. Sockets are "
+                            "only used for sending"
+                            "\n\t-x [0|1] to disable/enable. Send 32 bit sequence numbers (extended DB raw header)"
+                            "\n\t-C <dir> Flight recorder: Write all received frames to rotating pcapng files in <dir>");
                 break;
             default:
                 abort();
@@ -169,6 +190,34 @@ int log_telem_to_file(FILE *file_pnt, uint8_t tel_bytes[], int tel_bytes_length)
     return 0;
 }
 
+/**
+ * Writes the payload of a frame received via the long range link to the log file, the OSD FIFO and all TCP clients.
+ * Frames that were already received via another adapter (diversity duplicates) are ignored.
+ *
+ * @param frame Received frame starting with the radiotap header
+ * @param frame_length Length of the frame
+ * @param payload_buffer Buffer for the extracted payload
+ * @param seq_tracker Duplicate filter of the proxy port. Gets updated
+ * @param log_file Telemetry log file. May be NULL
+ * @param tcp_clients List of connected TCP clients
+ * @param fifo_osd OSD FIFO or -1
+ */
+void forward_lr_frame(uint8_t *frame, ssize_t frame_length, uint8_t *payload_buffer, db_seq_tracker_t *seq_tracker,
+                      FILE *log_file, int *tcp_clients, int fifo_osd) {
+    db_seq_num_t seq_num_proxy;
+    uint16_t radiotap_length = 0;
+    size_t payload_length = get_db_payload_seq(frame, frame_length, payload_buffer, &seq_num_proxy, &radiotap_length);
+    if (db_seq_tracker_check(seq_tracker, &seq_num_proxy)) {
+        log_telem_to_file(log_file, payload_buffer, payload_length);
+        send_to_all_tcp_clients(tcp_clients, payload_buffer, payload_length);
+        if (fifo_osd != -1 && write_to_osdfifo == 'Y') {
+            ssize_t written = write(fifo_osd, payload_buffer, payload_length);
+            if (written < 1)
+                perror("DB_PROXY_GROUND: Could not write to OSD FIFO");
+        }
+    }
+}
+
 int open_osd_fifo() {
     int tries = 0;
     char fifoname[100];
@@ -203,6 +252,16 @@ int main(int argc, char *argv[]) {
     for (int i = 0; i < num_interfaces; ++i) {
         raw_interfaces[i] = open_db_socket(adapters[i], comm_id, db_mode, bitrate_op, DB_DIREC_DRONE, DB_PORT_PROXY,
                                            frame_type);
+        db_socket_set_ext_seq_num(&raw_interfaces[i], ext_seq_num, DB_STREAM_DEFAULT);
+    }
+    db_link_client_t link_client;
+    if (use_link) {
+        if (db_link_connect(&link_client, DB_PORT_PROXY, DB_LINK_RING_SLOTS) < 0) {
+            LOG_SYS_STD(LOG_ERR, "DB_PROXY_GROUND: Could not register at link daemon\n");
+            exit(-1);
+        }
+        for (int i = 0; i < num_interfaces; ++i)
+            db_socket_disable_rx(&raw_interfaces[i]);
     }
     int fifo_osd = -1, new_tcp_client;
     int tcp_clients[MAX_TCP_CLIENTS] = {0};
@@ -211,7 +270,6 @@ int main(int argc, char *argv[]) {
     }
 
     // init variables
-    uint16_t radiotap_length = 0;
     fd_set fd_socket_set;
     struct timeval select_timeout;
     size_t recv_length = 0;
@@ -223,11 +281,14 @@ int main(int argc, char *argv[]) {
     // open log file for messages incoming from long range link
     struct log_file_t log_file = open_telemetry_log_file();
 
-    struct data_uni *data_uni_to_drone = get_hp_raw_buffer(prox_adhere_80211);
-    uint8_t seq_num = 0, seq_num_proxy = 0, last_recv_seq_num = 0;
+    uint32_t seq_num = 0;
+    db_seq_tracker_t seq_tracker;
+    db_seq_tracker_init(&seq_tracker);
     uint8_t lr_buffer[DATA_UNI_LENGTH];
     uint8_t tcp_buffer[TCP_BUFFER_SIZE];
-    size_t payload_length = 0;
+    db_recorder_t *recorder = NULL;
+    if (recorder_dir != NULL && (recorder = db_recorder_open(recorder_dir, "proxy", adapters, num_interfaces, 1)) == NULL)
+        exit(-1);
 
     LOG_SYS_STD(LOG_INFO, "DB_PROXY_GROUND: started! Enabled diversity on %i adapters.\n", num_interfaces);
     while (keeprunning) {
@@ -236,11 +297,22 @@ int main(int argc, char *argv[]) {
         FD_ZERO (&fd_socket_set);
         FD_SET (tcp_server_info.sock_fd, &fd_socket_set);
         int max_sd = tcp_server_info.sock_fd;
-        // add raw DroneBridge sockets
-        for (int i = 0; i < num_interfaces; i++) {
-            FD_SET (raw_interfaces[i].db_socket, &fd_socket_set);
-            if (raw_interfaces[i].db_socket > max_sd)
-                max_sd = raw_interfaces[i].db_socket;
+        // add raw DroneBridge sockets or the link daemon connection
+        if (use_link) {
+            if (db_link_arm(&link_client))
+                select_timeout.tv_sec = 0;  // frames are already waiting
+            FD_SET (link_client.event_fd, &fd_socket_set);
+            FD_SET (link_client.control_socket, &fd_socket_set);
+            if (link_client.event_fd > max_sd)
+                max_sd = link_client.event_fd;
+            if (link_client.control_socket > max_sd)
+                max_sd = link_client.control_socket;
+        } else {
+            for (int i = 0; i < num_interfaces; i++) {
+                FD_SET (raw_interfaces[i].db_socket, &fd_socket_set);
+                if (raw_interfaces[i].db_socket > max_sd)
+                    max_sd = raw_interfaces[i].db_socket;
+            }
         }
         // add child sockets (tcp connection sockets) to set
         for (int i = 0; i < MAX_TCP_CLIENTS; i++) {
@@ -255,27 +327,37 @@ int main(int argc, char *argv[]) {
         int select_return = select(max_sd + 1, &fd_socket_set, NULL, NULL, &select_timeout);
         if (select_return == -1) {
             perror("DB_PROXY_GROUND: select() returned error: ");
-        } else if (select_return > 0) {
-            for (int i = 0; i < num_interfaces; i++) {
+        } else {    // also on timeout: frames might have been waiting in the link daemon ring
+            // ---------------
+            // incoming form long range proxy port - write data to OSD-FIFO and pass on to connected TCP clients
+            // ---------------
+            if (use_link) {
+                // frames of all adapters are waiting in the ring of the proxy port. Processed in place
+                db_link_slot_t *slot;
+                while ((slot = db_link_next_frame(&link_client)) != NULL) {
+                    // same max. length as with recv() into lr_buffer
+                    ssize_t l = slot->frame_length < DATA_UNI_LENGTH ? slot->frame_length : DATA_UNI_LENGTH;
+                    if (recorder != NULL)
+                        db_recorder_write(recorder, 0, slot->adapter_no, slot->frame, slot->frame_length);
+                    forward_lr_frame(slot->frame, l, tcp_buffer, &seq_tracker, log_file.file_pntr,
+                                     tcp_clients, fifo_osd);
+                    db_link_release_frame(&link_client);
+                }
+                if (FD_ISSET(link_client.control_socket, &fd_socket_set)) {
+                    LOG_SYS_STD(LOG_ERR, "DB_PROXY_GROUND: Lost connection to link daemon\n");
+                    keeprunning = false;
+                }
+            }
+            for (int i = 0; i < num_interfaces && !use_link; i++) {
                 if (FD_ISSET(raw_interfaces[i].db_socket, &fd_socket_set)) {
-                    // ---------------
-                    // incoming form long range proxy port - write data to OSD-FIFO and pass on to connected TCP clients
-                    // ---------------
                     ssize_t l = recv(raw_interfaces[i].db_socket, lr_buffer, DATA_UNI_LENGTH, 0);
                     int err = errno;
-                    if (l > 0) {
-                        payload_length = get_db_payload(lr_buffer, l, tcp_buffer, &seq_num_proxy, &radiotap_length);
-                        if (seq_num_proxy != last_recv_seq_num) {
-                            last_recv_seq_num = seq_num_proxy;
-                            log_telem_to_file(log_file.file_pntr, tcp_buffer, payload_length);
-                            send_to_all_tcp_clients(tcp_clients, tcp_buffer, payload_length);
-                            if (fifo_osd != -1 && write_to_osdfifo == 'Y') {
-                                ssize_t written = write(fifo_osd, tcp_buffer, payload_length);
-                                if (written < 1)
-                                    perror("DB_PROXY_GROUND: Could not write to OSD FIFO");
-                            }
-                        }
-                    } else
+                    if (l > 0 && recorder != NULL)
+                        db_recorder_write(recorder, 0, (uint8_t) i, lr_buffer, (uint32_t) l);
+                    if (l > 0)
+                        forward_lr_frame(lr_buffer, l, tcp_buffer, &seq_tracker, log_file.file_pntr,
+                                         tcp_clients, fifo_osd);
+                    else
                         LOG_SYS_STD(LOG_ERR, "DB_PROXY_GROUND: Long range socket received an error: %s\n", strerror(err));
                 }
             }
@@ -311,10 +393,10 @@ int main(int argc, char *argv[]) {
                         tcp_clients[i] = 0;
                     } else {
                         // client sent us some information. Process it...
-                        memcpy(data_uni_to_drone->bytes, tcp_buffer, recv_length);
+                        seq_num++;
                         for (int j = 0; j < num_interfaces; j++)
-                            db_send_hp_div(&raw_interfaces[j], DB_PORT_CONTROLLER, (u_int16_t) recv_length,
-                                           update_seq_num(&seq_num));
+                            db_send_div(&raw_interfaces[j], tcp_buffer, DB_PORT_CONTROLLER, (u_int16_t) recv_length,
+                                        seq_num, prox_adhere_80211);
                     }
                 }
             }
@@ -324,6 +406,9 @@ int main(int argc, char *argv[]) {
         if (raw_interfaces[i].db_socket > 0)
             close(raw_interfaces[i].db_socket);
     }
+    if (use_link)
+        db_link_close(&link_client);
+    db_recorder_close(recorder);
     for (int i = 0; i < MAX_TCP_CLIENTS; i++) {
         if (tcp_clients[i] > 0)
             close(tcp_clients[i]);
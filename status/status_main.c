@@ -37,6 +37,8 @@
 #include "../common/tcp_server.h"
 #include "../common/db_raw_send_receive.h"
 #include "../common/db_common.h"
+#include "../common/db_seq_tracker.h"
+#include "../common/db_recorder.h"
 
 #define NET_BUFF_SIZE 2048
 #define MAX_TCP_CLIENTS 10
@@ -46,6 +48,7 @@ int num_inf_status = 0;
 char db_mode;
 uint8_t comm_id = DEFAULT_V2_COMMID;
 char adapters[DB_MAX_ADAPTERS][IFNAMSIZ];
+char *recorder_dir = NULL;
 
 void int_handler(int dummy) {
     keeprunning = false;
@@ -55,7 +58,7 @@ int process_command_line_args(int argc, char *argv[]) {
     db_mode = DEFAULT_DB_MODE;
     opterr = 0;
     int c;
-    while ((c = getopt(argc, argv, "n:m:c:?")) != -1) {
+    while ((c = getopt(argc, argv, "n:m:c:C:?")) != -1) {
         switch (c) {
             case 'n':
                 if (num_inf_status < DB_MAX_ADAPTERS) {
@@ -69,12 +72,16 @@ int process_command_line_args(int argc, char *argv[]) {
             case 'c':
                 comm_id = (uint8_t) strtol(optarg, NULL, 10);
                 break;
+            case 'C':
+                recorder_dir = optarg;
+                break;
             case '?':
                 printf("This tool sends extra information about the video stream and RC via UDP to IP given by "
                        "IP-checker module. Use"
                        "\n\t-n Name of network interface"
                        "\n\t-m [w|m] default is <m>"
-                       "\n\t-c <communication id> Choose a number from 0-255. Same on ground station and drone!");
+                       "\n\t-c <communication id> Choose a number from 0-255. Same on ground station and drone!"
+                       "\n\t-C <dir> Flight recorder: Write all received frames to rotating pcapng files in <dir>");
                 break;
             default:
                 abort();
@@ -87,12 +94,14 @@ int main(int argc, char *argv[]) {
     signal(SIGINT, int_handler);
     signal(SIGTERM, int_handler);
     struct timespec timestamp;
-    int restarts = 0, cardcounter = 0, select_return, max_sd, new_tcp_client, prev_seq_num_status = 0;
+    int restarts = 0, cardcounter = 0, select_return, max_sd, new_tcp_client;
     struct timeval timecheck;
     long start, rightnow, status_message_update_rate = 100; // send status messages every 100ms (10Hz)
     int8_t best_dbm = 0;
     ssize_t l;
-    uint8_t seq_num_status = 0;
+    db_seq_num_t seq_num_status;
+    db_seq_tracker_t status_seq_tracker;  // status frames arrive once per adapter of the UAV
+    db_seq_tracker_init(&status_seq_tracker);
     uint16_t radiotap_length;
     uint8_t lr_buffer[DATA_UNI_LENGTH];
     memset(lr_buffer, 0, DATA_UNI_LENGTH);
@@ -135,6 +144,10 @@ int main(int argc, char *argv[]) {
         raw_interfaces_status[i] = open_db_socket(adapters[i], comm_id, db_mode, 6, DB_DIREC_DRONE,
                 DB_PORT_STATUS, DB_FRAMETYPE_DEFAULT);
     }
+    db_recorder_t *recorder = NULL;
+    if (recorder_dir != NULL &&
+        (recorder = db_recorder_open(recorder_dir, "status", adapters, num_inf_status, 1)) == NULL)
+        exit(-1);
 
     fd_set fd_socket_set;
     struct timeval socket_timeout;
@@ -177,9 +190,10 @@ int main(int argc, char *argv[]) {
                     // ---------------
                     l = recv(raw_interfaces_status[i].db_socket, lr_buffer, DATA_UNI_LENGTH, 0);
                     if (l > 0) {
-                        get_db_payload(lr_buffer, l, message_buff, &seq_num_status, &radiotap_length);
-                        if (prev_seq_num_status != seq_num_status) {
-                            prev_seq_num_status = seq_num_status;
+                        if (recorder != NULL)
+                            db_recorder_write(recorder, 0, (uint8_t) i, lr_buffer, (uint32_t) l);
+                        get_db_payload_seq(lr_buffer, l, message_buff, &seq_num_status, &radiotap_length);
+                        if (db_seq_tracker_check(&status_seq_tracker, &seq_num_status)) {
                             // process payload (currently only one type of raw status frame is supported: RC_AIR --> STATUS_GROUND)
                             // must be a uav_rc_status_update_message_t
                             struct uav_rc_status_update_message_t *rc_status_message = (struct uav_rc_status_update_message_t *) message_buff;
@@ -290,6 +304,7 @@ int main(int argc, char *argv[]) {
         if (raw_interfaces_status[i].db_socket > 0)
             close(raw_interfaces_status[i].db_socket);
     }
+    db_recorder_close(recorder);
     LOG_SYS_STD(LOG_INFO, "DB_STATUS_GND: Terminated!\n");
     exit(0);
 }
\ No newline at end of file
@@ -502,7 +502,8 @@ void fec_init(void) {
 /* We do the matrix multiplication columns by column, instead of the
  * usual row-by-row, in order to capitalize on the cache freshness of
  * each data block . The data block only needs to be fetched once, and
- * can be used to be addmull'ed into all FEC blocks at once. No need
+ * can be used to be addmull'ed into all FEC blocks at once (single pass
+ * over the data block, see gf256_muladd_multi_mem()). No need
  * to worry about evicting FEC blocks from the cache: those are so
  * few (typically, 4 or 8) that they will fit easily in the cache (even
  * in the L2 cache...)
@@ -514,6 +515,7 @@ void fec_encode(int blockSize,
                 unsigned int nrFecBlocks) {
     unsigned int blockNo; /* loop for block counter */
     unsigned int row, col;
+    uint8_t coefficients[128];
 
     assert(fec_initialized);
     assert(nrDataBlocks <= 128);
@@ -527,7 +529,8 @@ void fec_encode(int blockSize,
 
     for (col = 129, blockNo = 1; blockNo < nrDataBlocks; col++, blockNo++) {
         for (row = 0; row < nrFecBlocks; row++)
-            gf256_muladd_mem(fec_blocks[row], inverse[row ^ col], data_blocks[blockNo], blockSize);
+            coefficients[row] = inverse[row ^ col];
+        gf256_muladd_multi_mem((void *const *) fec_blocks, coefficients, nrFecBlocks, data_blocks[blockNo], blockSize);
     }
 }
 
@@ -546,6 +549,7 @@ static inline void reduce(int blockSize,
                           unsigned short nr_fec_blocks) {
     int erasedIdx = 0;
     unsigned int col;
+    uint8_t coefficients[128];
 
     /* First we reduce the code vector by substracting all known elements
      * (non-erased data packets) */
@@ -557,8 +561,9 @@ static inline void reduce(int blockSize,
             int j;
             for (j = 0; j < nr_fec_blocks; j++) {
                 unsigned int blno = fec_block_nos[j];
-                gf256_muladd_mem(fec_blocks[j], inverse[blno ^ col ^ 128], src, blockSize);
+                coefficients[j] = inverse[blno ^ col ^ 128];
             }
+            gf256_muladd_multi_mem((void *const *) fec_blocks, coefficients, nr_fec_blocks, src, blockSize);
         }
     }
 
@@ -578,6 +583,80 @@ long long resolveTime =0;
 long long invTime =0;
 #endif
 
+/*
+ * Cache of inverted decode matrices. With fixed k/n the same combinations of
+ * erased data blocks and used FEC blocks recur constantly on a lossy link, so
+ * most damaged blocks can skip invert_mat(). Entries are replaced least recently
+ * used first. Every thread has its own cache so that several threads can
+ * decode in parallel (video_gnd fanout workers).
+ */
+#define FEC_INV_CACHE_SIZE 16
+#define FEC_INV_CACHE_MAX_DIM 32    /* bigger systems are inverted every time */
+
+typedef struct {
+    unsigned short nr_fec_blocks;   /* 0 = unused entry */
+    uint32_t last_used;
+    uint8_t fec_block_nos[FEC_INV_CACHE_MAX_DIM];
+    uint8_t erased_blocks[FEC_INV_CACHE_MAX_DIM];
+    unsigned char matrix[FEC_INV_CACHE_MAX_DIM * FEC_INV_CACHE_MAX_DIM];
+} fec_inv_cache_entry_t;
+
+static __thread fec_inv_cache_entry_t inv_cache[FEC_INV_CACHE_SIZE];
+static __thread uint32_t inv_cache_clock = 0;
+static unsigned int inv_cache_hits = 0, inv_cache_misses = 0;  /* of all threads */
+
+/**
+ * Looks up the inverted matrix for an erasure pattern. On a miss the least recently used entry is returned with its
+ * nr_fec_blocks set to 0, ready to be filled by the caller.
+ * @param fec_block_nos Indices of the FEC blocks used for decoding
+ * @param erased_blocks Indices of the erased data blocks
+ * @param nr_fec_blocks Number of erased blocks/used FEC blocks. Must not exceed FEC_INV_CACHE_MAX_DIM
+ * @param hit Set to 1 if the returned entry holds the inverted matrix for this pattern
+ * @return Cache entry of the pattern or the entry to replace
+ */
+static fec_inv_cache_entry_t *inv_cache_lookup(const unsigned int *fec_block_nos, const unsigned int *erased_blocks,
+                                               unsigned short nr_fec_blocks, int *hit) {
+    uint8_t fec_key[FEC_INV_CACHE_MAX_DIM], erased_key[FEC_INV_CACHE_MAX_DIM];
+    fec_inv_cache_entry_t *victim = &inv_cache[0];
+    int i;
+
+    for (i = 0; i < nr_fec_blocks; i++) {
+        fec_key[i] = (uint8_t) fec_block_nos[i];
+        erased_key[i] = (uint8_t) erased_blocks[i];
+    }
+    inv_cache_clock++;
+    for (i = 0; i < FEC_INV_CACHE_SIZE; i++) {
+        fec_inv_cache_entry_t *entry = &inv_cache[i];
+        if (entry->nr_fec_blocks == nr_fec_blocks && memcmp(entry->erased_blocks, erased_key, nr_fec_blocks) == 0 &&
+            memcmp(entry->fec_block_nos, fec_key, nr_fec_blocks) == 0) {
+            entry->last_used = inv_cache_clock;
+            __atomic_add_fetch(&inv_cache_hits, 1, __ATOMIC_RELAXED);
+            *hit = 1;
+            return entry;
+        }
+        if (entry->nr_fec_blocks == 0 ||
+            (victim->nr_fec_blocks != 0 && entry->last_used - victim->last_used > UINT32_MAX / 2))
+            victim = entry;     /* unused or older (wrap around safe) */
+    }
+    __atomic_add_fetch(&inv_cache_misses, 1, __ATOMIC_RELAXED);
+    victim->nr_fec_blocks = 0;
+    victim->last_used = inv_cache_clock;
+    memcpy(victim->fec_block_nos, fec_key, nr_fec_blocks);
+    memcpy(victim->erased_blocks, erased_key, nr_fec_blocks);
+    *hit = 0;
+    return victim;
+}
+
+/**
+ * Statistics of the inverted matrix cache used by fec_decode()
+ * @param hits Number of decoded blocks that reused a cached inverted matrix
+ * @param misses Number of decoded blocks that had to invert their matrix
+ */
+void fec_get_inv_cache_stats(unsigned int *hits, unsigned int *misses) {
+    *hits = __atomic_load_n(&inv_cache_hits, __ATOMIC_RELAXED);
+    *misses = __atomic_load_n(&inv_cache_misses, __ATOMIC_RELAXED);
+}
+
 /**
  * Resolves reduced system. Constructs "mini" encoding matrix, inverts
  * it, and multiply reduced vector by it.
@@ -593,9 +672,19 @@ static inline void resolve(int blockSize,
 #endif
     /* construct matrix */
     int row;
-    unsigned char matrix[nr_fec_blocks * nr_fec_blocks];
+    unsigned char matrix_buf[nr_fec_blocks * nr_fec_blocks];
+    unsigned char *matrix = matrix_buf;
+    fec_inv_cache_entry_t *cached = NULL;
+    int hit = 0;
     int ptr;
-    int r;
+    int r = 0;
+
+    if (nr_fec_blocks <= FEC_INV_CACHE_MAX_DIM) {
+        cached = inv_cache_lookup(fec_block_nos, erased_blocks, nr_fec_blocks, &hit);
+        matrix = cached->matrix;
+        if (hit)
+            goto multiply;
+    }
 
     /* we pick the submatrix of code that keeps colums corresponding to
      * the erased data blocks, and rows corresponding to the present FEC
@@ -618,6 +707,8 @@ static inline void resolve(int blockSize,
 #ifdef PROFILE
     invTime += rdtsc()-begin;
 #endif
+    if (cached != NULL && !r)
+        cached->nr_fec_blocks = nr_fec_blocks;
 
     if (r) {
         int col;
@@ -634,6 +725,7 @@ static inline void resolve(int blockSize,
     }
 
     /* do the multiplication with the reduced code vector */
+    multiply:
     for (row = 0, ptr = 0; row < nr_fec_blocks; row++) {
         int col;
         unsigned char *target = data_blocks[erased_blocks[row]];
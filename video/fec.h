@@ -24,6 +24,8 @@ void fec_decode(int blockSize,
                 unsigned int *erased_blocks,
                 unsigned short nr_fec_blocks  /* how many blocks per stripe */);
 
+void fec_get_inv_cache_stats(unsigned int *hits, unsigned int *misses);
+
 void fec_print(fec_code_t code, int width);
 
 void fec_license(void);
\ No newline at end of file
@@ -17,184 +17,543 @@
  *
  */
 
+/**
+ * Benchmark harness for the FEC implementations (fec.c, fec_old.c, legacy/fec.c) and the gf256 kernels.
+ * Sweeps data/FEC packets per block and packet sizes, measures encode and decode (random, burst and worst case erasure
+ * patterns) with warm-up and reports mean/percentiles, MB/s, ns/byte and cycles per block as text, CSV or JSON.
+ * Decoded data is verified against the original data for every sample.
+ */
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
-#include <bits/time.h>
 #include <string.h>
+#include <getopt.h>
+#include <stdbool.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLE_COUNTER 1
+#endif
 
 #include "fec_speed_test.h"
 #include "gf256.h"
 #include "fec_old.h"
 #include "fec.h"
 
-#define KNRM  "\x1B[0m"
-#define KRED  "\x1B[31m"
-#define KGRN  "\x1B[32m"
-#define KYEL  "\x1B[33m"
-#define KBLU  "\x1B[34m"
-#define KMAG  "\x1B[35m"
-#define KCYN  "\x1B[36m"
-#define KWHT  "\x1B[37m"
+static const char *pattern_names[ERASURE_PATTERN_CNT] = {"random", "burst", "worst"};
 
-int main(int argc, char *argv[]) {
-    int packet_size = 1024;
-    int num_data_blocks = 8;
-    unsigned int num_fec_blocks = 4;
-    struct timespec start_time, end_time;
-    fec_init_old();
-    fec_init();
-
-    int size = packet_size;
-    uint8_t multiplier = 56;
-    uint8_t src[size];
-    uint8_t dsto[size];
-    uint8_t dst_mul[size];
-    uint8_t dst_addmul[size];
-
-    int equal = 1;
-    srand(time(NULL));
-    for (int i = 0; i < size; i++)
-        src[i] = (rand() % (254 - 0 + 1)) + 0;
-
-    int iter = 500;
-    printf("Doing %i iterations on %i FEC blocks\n", iter, num_fec_blocks);
-    clock_gettime(CLOCK_MONOTONIC, &start_time);
-    for (int j = 0; j < iter; j++) {
-        for (int i = 0; i < num_fec_blocks; i++)
-            slow_mul1(dsto, src, multiplier, size);
-    }
-    clock_gettime(CLOCK_MONOTONIC, &end_time);
-    printf("\tDone original in %.02f microseconds\n", TimeSpecToUSeconds(&end_time) - TimeSpecToUSeconds(&start_time));
-    clock_gettime(CLOCK_MONOTONIC, &start_time);
-    for (int j = 0; j < 1000; j++) {
-        for (int i = 0; i < num_fec_blocks; i++)
-//            moep_gf.mulrc(dst_mul, multiplier, size);
-            gf256_mul_mem(dst_mul, src, multiplier, size);
-//            gf.multiply_region.w32(&gf, src, dst_mul, multiplier, size, 0);
-    }
-    clock_gettime(CLOCK_MONOTONIC, &end_time);
-    printf("\tDone new in %.02f microseconds\n", TimeSpecToUSeconds(&end_time) - TimeSpecToUSeconds(&start_time));
-    if (memcmp(dsto, dst_mul, size) == 0) {
-    } else {
-        equal = 0;
-    }
-    if (equal) {
-        printf(KGRN"Both mul functions produce equal results!\n"KNRM);
-    } else {
-        printf(KRED "Multiplication results not byte-equal!\n"KNRM);
-    }
-
-    printf("\n");
-    srand(time(NULL));
-    for (int i = 0; i < size; i++)
-        src[i] = (rand() % (254 - 0 + 1)) + 0;
-    memset(dsto, 15, size);
-    memset(dst_addmul, 15, size);
-    clock_gettime(CLOCK_MONOTONIC, &start_time);
-    for (int i = 0; i < (num_fec_blocks * num_data_blocks); i++)
-        slow_addmul1(dsto, src, multiplier, size);
-    clock_gettime(CLOCK_MONOTONIC, &end_time);
-    printf("Done original in %.02f microseconds\n", TimeSpecToUSeconds(&end_time) - TimeSpecToUSeconds(&start_time));
-    clock_gettime(CLOCK_MONOTONIC, &start_time);
-    for (int i = 0; i < (num_fec_blocks * num_data_blocks); i++) {
-        gf256_muladd_mem(dst_addmul, multiplier, src, size);
-//        moep_gf.maddrc(dst_addmul, multiplier, src, size);
-//        gf.multiply_region.w32(&gf, src, dst_addmul, multiplier, size, 1);
-    }
-    clock_gettime(CLOCK_MONOTONIC, &end_time);
-    printf("Done new in %.02f microseconds\n", TimeSpecToUSeconds(&end_time) - TimeSpecToUSeconds(&start_time));
-    if (memcmp(dsto, dst_addmul, size) == 0) {
-        printf(KGRN"Both addmul functions produce equal results!\n"KNRM);
-    } else {
-        printf(KRED "Add-Multiplication results not byte-equal!\n"KNRM);
-    }
-
-    const int test_data_buff_size = packet_size * 12;   //10s video with 6Mbps
-    uint8_t test_data[test_data_buff_size];
-    uint8_t *data_blocks[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
-    uint8_t *data_blocks_old[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
-    uint8_t fec_pool[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK][MAX_USER_PACKET_LENGTH];
-    uint8_t fec_pool_old[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK][MAX_USER_PACKET_LENGTH];
-    uint8_t *fec_blocks[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
-    uint8_t *fec_blocks_old[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
-    for (int i = 0; i < num_fec_blocks; ++i) {
+unsigned int data_counts[MAX_SWEEP_VALUES], fec_counts[MAX_SWEEP_VALUES], packet_sizes[MAX_SWEEP_VALUES];
+int num_data_counts, num_fec_counts, num_packet_sizes;
+unsigned int iterations = 200, warmup = 20;
+double cpu_mhz = 0;
+output_format_t output_format = OUTPUT_TEXT;
+FILE *out;
+int results_written = 0;
+unsigned int total_errors = 0;
+uint64_t rand_state = 0x2545F4914F6CDD1DULL;
+
+uint8_t data_pool[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK][MAX_BENCH_PACKET_SIZE];
+uint8_t data_work_pool[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK][MAX_BENCH_PACKET_SIZE];
+uint8_t fec_pool[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK][MAX_BENCH_PACKET_SIZE];
+uint8_t fec_work_pool[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK][MAX_BENCH_PACKET_SIZE];
+uint64_t sample_ns[4096], sample_cycles[4096];
+
+static void encode_new(int block_size, uint8_t **data_blocks, unsigned int nr_data_blocks, uint8_t **fec_blocks,
+                       unsigned int nr_fec_blocks) {
+    fec_encode(block_size, data_blocks, nr_data_blocks, fec_blocks, nr_fec_blocks);
+}
+
+static void decode_new(int block_size, uint8_t **data_blocks, unsigned int nr_data_blocks, uint8_t **fec_blocks,
+                       unsigned int *fec_block_nos, unsigned int *erased_blocks, unsigned short nr_fec_blocks) {
+    fec_decode(block_size, data_blocks, nr_data_blocks, fec_blocks, fec_block_nos, erased_blocks, nr_fec_blocks);
+}
+
+static void encode_old(int block_size, uint8_t **data_blocks, unsigned int nr_data_blocks, uint8_t **fec_blocks,
+                       unsigned int nr_fec_blocks) {
+    fec_encode_old((unsigned int) block_size, data_blocks, nr_data_blocks, fec_blocks, nr_fec_blocks);
+}
+
+static void decode_old(int block_size, uint8_t **data_blocks, unsigned int nr_data_blocks, uint8_t **fec_blocks,
+                       unsigned int *fec_block_nos, unsigned int *erased_blocks, unsigned short nr_fec_blocks) {
+    fec_decode_old((unsigned int) block_size, data_blocks, nr_data_blocks, fec_blocks, fec_block_nos, erased_blocks,
+                   nr_fec_blocks);
+}
+
+static void encode_legacy(int block_size, uint8_t **data_blocks, unsigned int nr_data_blocks, uint8_t **fec_blocks,
+                          unsigned int nr_fec_blocks) {
+    fec_encode_legacy((unsigned int) block_size, data_blocks, nr_data_blocks, fec_blocks, nr_fec_blocks);
+}
+
+static void decode_legacy(int block_size, uint8_t **data_blocks, unsigned int nr_data_blocks, uint8_t **fec_blocks,
+                          unsigned int *fec_block_nos, unsigned int *erased_blocks, unsigned short nr_fec_blocks) {
+    fec_decode_legacy((unsigned int) block_size, data_blocks, nr_data_blocks, fec_blocks, fec_block_nos,
+                      erased_blocks, nr_fec_blocks);
+}
+
+static fec_impl_t fec_impls[] = {
+        {"fec",        true,  fec_init,        encode_new,    decode_new},
+        {"fec_old",    false, fec_init_old,    encode_old,    decode_old},
+        {"fec_legacy", false, fec_init_legacy, encode_legacy, decode_legacy},
+};
+#define NUM_FEC_IMPLS (sizeof(fec_impls) / sizeof(fec_impls[0]))
+bool impl_enabled[NUM_FEC_IMPLS] = {true, true, true};
+bool kernels_enabled = true;
+// gf256 kernels to sweep with -K, in the order of gf256_select_kernel() preference
+static const char *kernel_names[] = {"gfni_avx512", "avx512", "gfni_avx2", "avx2", "ssse3", "neon", "scalar"};
+const char *bench_kernels_list[MAX_BENCH_KERNELS];
+int num_bench_kernels = 0;
+
+static inline uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static inline uint64_t now_cycles() {
+#ifdef HAVE_CYCLE_COUNTER
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static uint32_t bench_rand() {
+    // xorshift64*: reproducible across platforms
+    rand_state ^= rand_state >> 12;
+    rand_state ^= rand_state << 25;
+    rand_state ^= rand_state >> 27;
+    return (uint32_t) ((rand_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+static int compare_uint(const void *a, const void *b) {
+    unsigned int x = *(const unsigned int *) a, y = *(const unsigned int *) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Parses a list like "1,2,4-8,16" into values
+ *
+ * @return Number of values or -1 on parse error
+ */
+static int parse_list(const char *arg, unsigned int *values, unsigned int min, unsigned int max) {
+    int cnt = 0;
+    const char *p = arg;
+    while (*p) {
+        char *end;
+        long first = strtol(p, &end, 10), last;
+        if (end == p) return -1;
+        last = first;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p) return -1;
+        }
+        for (long v = first; v <= last; v++) {
+            if (v < min || v > max || cnt >= MAX_SWEEP_VALUES) return -1;
+            values[cnt++] = (unsigned int) v;
+        }
+        p = (*end == ',') ? end + 1 : end;
+        if (*end != ',' && *end != '\0') return -1;
+    }
+    return cnt;
+}
+
+/**
+ * Calculates statistics of the collected samples and writes the result
+ */
+static void finish_result(bench_result_t *result, unsigned int samples, uint64_t data_bytes) {
+    uint64_t total_ns = 0, total_cycles = 0;
+    for (unsigned int i = 0; i < samples; i++) {
+        total_ns += sample_ns[i];
+        total_cycles += sample_cycles[i];
+    }
+    qsort(sample_ns, samples, sizeof(uint64_t), compare_u64);
+    result->samples = samples;
+    result->mean_ns = (double) total_ns / samples;
+    result->min_ns = (double) sample_ns[0];
+    result->p50_ns = (double) sample_ns[samples / 2];
+    result->p90_ns = (double) sample_ns[(samples * 90) / 100];
+    result->p99_ns = (double) sample_ns[(samples * 99) / 100];
+    result->max_ns = (double) sample_ns[samples - 1];
+    result->mb_per_s = result->mean_ns > 0 ? (double) data_bytes / result->mean_ns * 1000.0 : 0;
+    result->ns_per_byte = result->mean_ns / (double) data_bytes;
+#ifdef HAVE_CYCLE_COUNTER
+    result->cycles_per_block = (double) total_cycles / samples;
+#else
+    result->cycles_per_block = result->mean_ns * cpu_mhz / 1000.0;
+#endif
+
+    switch (output_format) {
+        case OUTPUT_CSV:
+            if (results_written == 0)
+                fprintf(out, "impl,kernel,operation,pattern,k,m,packet_size,avg_erasures,samples,mean_ns,min_ns,p50_ns,p90_ns,"
+                             "p99_ns,max_ns,mb_per_s,ns_per_byte,cycles_per_block,errors\n");
+            fprintf(out, "%s,%s,%s,%s,%u,%u,%u,%.2f,%u,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.2f,%.4f,%.0f,%u\n",
+                    result->impl, result->kernel, result->operation, result->pattern, result->k, result->m, result->packet_size,
+                    result->avg_erasures, result->samples, result->mean_ns, result->min_ns, result->p50_ns,
+                    result->p90_ns, result->p99_ns, result->max_ns, result->mb_per_s, result->ns_per_byte,
+                    result->cycles_per_block, result->errors);
+            break;
+        case OUTPUT_JSON:
+            fprintf(out, "%s\n  {\"impl\": \"%s\", \"kernel\": \"%s\", \"operation\": \"%s\", \"pattern\": \"%s\", \"k\": %u, \"m\": %u, "
+                         "\"packet_size\": %u, \"avg_erasures\": %.2f, \"samples\": %u, \"mean_ns\": %.1f, "
+                         "\"min_ns\": %.1f, \"p50_ns\": %.1f, \"p90_ns\": %.1f, \"p99_ns\": %.1f, \"max_ns\": %.1f, "
+                         "\"mb_per_s\": %.2f, \"ns_per_byte\": %.4f, \"cycles_per_block\": %.0f, \"errors\": %u}",
+                    results_written == 0 ? "[" : ",", result->impl, result->kernel, result->operation, result->pattern, result->k,
+                    result->m, result->packet_size, result->avg_erasures, result->samples, result->mean_ns,
+                    result->min_ns, result->p50_ns, result->p90_ns, result->p99_ns, result->max_ns,
+                    result->mb_per_s, result->ns_per_byte, result->cycles_per_block, result->errors);
+            break;
+        default:
+            if (results_written == 0)
+                fprintf(out, "%-11s %-12s %-14s %-7s %3s %3s %5s %6s %10s %10s %10s %10s %9s %8s %10s %s\n",
+                        "impl", "kernel", "operation", "pattern", "k", "m", "size", "erased", "mean_ns", "p50_ns", "p90_ns", "p99_ns",
+                        "MB/s", "ns/byte", "cyc/block", "errors");
+            fprintf(out, "%-11s %-12s %-14s %-7s %3u %3u %5u %6.2f %10.0f %10.0f %10.0f %10.0f %9.1f %8.3f %10.0f %u\n",
+                    result->impl, result->kernel, result->operation, result->pattern, result->k, result->m, result->packet_size,
+                    result->avg_erasures, result->mean_ns, result->p50_ns, result->p90_ns, result->p99_ns,
+                    result->mb_per_s, result->ns_per_byte, result->cycles_per_block, result->errors);
+            break;
+    }
+    fflush(out);
+    results_written++;
+    total_errors += result->errors;
+}
+
+static const char *impl_kernel(const fec_impl_t *impl) {
+    return impl->uses_gf256 ? gf256_kernel_name() : "-";
+}
+
+/**
+ * Parses the -K argument: "all" selects every kernel supported by this CPU, otherwise a comma separated list of names
+ */
+static void parse_kernels(const char *arg) {
+    num_bench_kernels = 0;
+    for (int i = 0; i < sizeof(kernel_names) / sizeof(kernel_names[0]); i++) {
+        size_t len = strlen(kernel_names[i]);
+        bool wanted = strcmp(arg, "all") == 0;
+        for (const char *hit = strstr(arg, kernel_names[i]); !wanted && hit != NULL;
+             hit = strstr(hit + 1, kernel_names[i])) {
+            // match whole names only: "avx2" must not enable "gfni_avx2"
+            wanted = (hit == arg || hit[-1] == ',') && (hit[len] == ',' || hit[len] == '\0');
+        }
+        if (wanted && num_bench_kernels < MAX_BENCH_KERNELS)
+            bench_kernels_list[num_bench_kernels++] = kernel_names[i];
+    }
+}
+
+static void init_test_data() {
+    for (int i = 0; i < MAX_DATA_OR_FEC_PACKETS_PER_BLOCK; i++)
+        for (int j = 0; j < MAX_BENCH_PACKET_SIZE; j++)
+            data_pool[i][j] = (uint8_t) bench_rand();
+}
+
+static void bench_encode(fec_impl_t *impl, unsigned int k, unsigned int m, unsigned int size) {
+    uint8_t *data_blocks[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK], *fec_blocks[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
+    for (unsigned int i = 0; i < MAX_DATA_OR_FEC_PACKETS_PER_BLOCK; i++) {
+        data_blocks[i] = data_pool[i];
         fec_blocks[i] = fec_pool[i];
-        fec_blocks_old[i] = fec_pool_old[i];
     }
-    srand(time(NULL));
-    for (int i = 0; i < test_data_buff_size; i++)
-        test_data[i] = (rand() % (254 - 0 + 1)) + 0;
+    for (unsigned int i = 0; i < warmup; i++)
+        impl->encode(size, data_blocks, k, fec_blocks, m);
+    for (unsigned int i = 0; i < iterations; i++) {
+        uint64_t start = now_ns(), start_cycles = now_cycles();
+        impl->encode(size, data_blocks, k, fec_blocks, m);
+        sample_cycles[i] = now_cycles() - start_cycles;
+        sample_ns[i] = now_ns() - start;
+    }
+    bench_result_t result = {.impl = impl->name, .kernel = impl_kernel(impl), .operation = "encode", .pattern = "-", .k = k, .m = m,
+                             .packet_size = size};
+    finish_result(&result, iterations, (uint64_t) k * size);
+}
 
-    printf("\nTesting FEC encode\n");
-    clock_gettime(CLOCK_MONOTONIC, &start_time);
-    for (int i = 0; i < num_data_blocks; ++i) {
-        data_blocks_old[i] = &test_data[i * packet_size];
+/**
+ * Chooses lost data packets and the FEC packets used to repair them
+ *
+ * @return Number of erased data packets
+ */
+static unsigned int make_erasures(erasure_pattern_t pattern, unsigned int k, unsigned int m,
+                                  unsigned int *erased_blocks, unsigned int *fec_block_nos) {
+    unsigned int max_erasures = k < m ? k : m, erasures = max_erasures, i;
+    unsigned int candidates[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
+    if (pattern == ERASURE_RANDOM)
+        erasures = 1 + bench_rand() % max_erasures;
+    if (pattern == ERASURE_BURST) {
+        unsigned int start = bench_rand() % (k - erasures + 1);
+        for (i = 0; i < erasures; i++) {
+            erased_blocks[i] = start + i;
+            fec_block_nos[i] = i;
+        }
+        return erasures;
     }
-    fec_encode_old(packet_size, data_blocks_old, num_data_blocks, (unsigned char **) fec_blocks_old, num_fec_blocks);
-    clock_gettime(CLOCK_MONOTONIC, &end_time);
-    printf("FEC old encode took %.02f microseconds\n", TimeSpecToUSeconds(&end_time) - TimeSpecToUSeconds(&start_time));
+    // random positions (partial Fisher-Yates shuffle)
+    for (i = 0; i < k; i++) candidates[i] = i;
+    for (i = 0; i < erasures; i++) {
+        unsigned int j = i + bench_rand() % (k - i);
+        unsigned int t = candidates[i];
+        candidates[i] = candidates[j];
+        candidates[j] = t;
+        erased_blocks[i] = candidates[i];
+    }
+    qsort(erased_blocks, erasures, sizeof(unsigned int), compare_uint);
+    for (i = 0; i < m; i++) candidates[i] = i;
+    for (i = 0; i < erasures; i++) {
+        unsigned int j = i + bench_rand() % (m - i);
+        unsigned int t = candidates[i];
+        candidates[i] = candidates[j];
+        candidates[j] = t;
+        fec_block_nos[i] = candidates[i];
+    }
+    return erasures;
+}
 
-    clock_gettime(CLOCK_MONOTONIC, &start_time);
-    for (int i = 0; i < num_data_blocks; ++i) {
-        data_blocks[i] = &test_data[i * packet_size];
+static void bench_decode(fec_impl_t *impl, erasure_pattern_t pattern, unsigned int k, unsigned int m,
+                         unsigned int size) {
+    uint8_t *data_blocks[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK], *fec_blocks[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
+    uint8_t *used_fec_blocks[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
+    unsigned int erased_blocks[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK], fec_block_nos[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
+    unsigned int errors = 0;
+    uint64_t total_erasures = 0;
+
+    for (unsigned int i = 0; i < MAX_DATA_OR_FEC_PACKETS_PER_BLOCK; i++) {
+        data_blocks[i] = data_pool[i];
+        fec_blocks[i] = fec_pool[i];
     }
-    fec_encode(packet_size, data_blocks, num_data_blocks, (unsigned char **) fec_blocks, num_fec_blocks);
-    clock_gettime(CLOCK_MONOTONIC, &end_time);
-    printf("FEC new encode took %.02f microseconds\n", TimeSpecToUSeconds(&end_time) - TimeSpecToUSeconds(&start_time));
+    impl->encode(size, data_blocks, k, fec_blocks, m);
+    for (unsigned int i = 0; i < MAX_DATA_OR_FEC_PACKETS_PER_BLOCK; i++)
+        data_blocks[i] = data_work_pool[i];
 
-    int invalid = 0;
-    for (int i = 0; i < num_fec_blocks; i++) {
-        if (memcmp(fec_pool_old[i], fec_pool[i], packet_size) != 0) {
-            invalid = 1;
+    for (unsigned int i = 0; i < warmup + iterations; i++) {
+        // prepare a damaged block. Not part of the measurement
+        unsigned int erasures = make_erasures(pattern, k, m, erased_blocks, fec_block_nos);
+        for (unsigned int d = 0; d < k; d++)
+            memcpy(data_work_pool[d], data_pool[d], size);
+        for (unsigned int e = 0; e < erasures; e++) {
+            memset(data_work_pool[erased_blocks[e]], 0, size);
+            memcpy(fec_work_pool[e], fec_pool[fec_block_nos[e]], size);
+            used_fec_blocks[e] = fec_work_pool[e];
+        }
+
+        uint64_t start = now_ns(), start_cycles = now_cycles();
+        impl->decode(size, data_blocks, k, used_fec_blocks, fec_block_nos, erased_blocks, (unsigned short) erasures);
+        uint64_t cycles = now_cycles() - start_cycles, duration = now_ns() - start;
+
+        for (unsigned int e = 0; e < erasures; e++) {
+            if (memcmp(data_work_pool[erased_blocks[e]], data_pool[erased_blocks[e]], size) != 0) {
+                errors++;
+                break;
+            }
+        }
+        if (i >= warmup) {
+            sample_ns[i - warmup] = duration;
+            sample_cycles[i - warmup] = cycles;
+            total_erasures += erasures;
         }
     }
-    if (invalid == 0) {
-        printf(KGRN"Both FEC encode functions produce equal results!\n"KNRM);
-    } else {
-        printf(KRED "FEC encode results not byte-equal!\n"KNRM);
-    }
-
-
-    unsigned int fec_block_nos[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
-    unsigned int erased_blocks[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
-    int number_applied_fec_packs = 1;
-    int index_erased_data_block = 1; // second data packet is missing
-    int index_repairing_fec_block = 0; // first FEC packet used to repair data
-    erased_blocks[0] = index_erased_data_block;
-    fec_block_nos[0] = index_repairing_fec_block;
-    uint8_t erased_data[packet_size];
-
-    memcpy(erased_data, data_blocks_old[index_erased_data_block], packet_size);
-    memset(data_blocks[index_erased_data_block], 0, packet_size);     // create missing data packet
-    memset(data_blocks_old[index_erased_data_block], 0, packet_size); // create missing data packet
-
-    printf("\nTesting FEC decode\n");
-    clock_gettime(CLOCK_MONOTONIC, &start_time);
-    fec_decode_old((unsigned int) packet_size, data_blocks_old, num_data_blocks, fec_blocks_old, fec_block_nos,
-                   erased_blocks, number_applied_fec_packs);
-    clock_gettime(CLOCK_MONOTONIC, &end_time);
-    printf("Old FEC decode took %.02f microseconds\n", TimeSpecToUSeconds(&end_time) - TimeSpecToUSeconds(&start_time));
-    if (memcmp(data_blocks_old[index_erased_data_block], erased_data, packet_size) == 0) {
-        printf(KGRN"Old FEC decode works!\n"KNRM);
-    } else {
-        printf(KRED "Old FEC decode produces wrong result!\n"KNRM);
-    }
-
-    memcpy(erased_data, data_blocks[index_erased_data_block], packet_size);
-    memset(data_blocks[index_erased_data_block], 0, packet_size);     // create missing data packet
-    memset(data_blocks_old[index_erased_data_block], 0, packet_size); // create missing data packet
-
-    clock_gettime(CLOCK_MONOTONIC, &start_time);
-    fec_decode(packet_size, data_blocks, num_data_blocks, fec_blocks, fec_block_nos,
-               erased_blocks, number_applied_fec_packs);
-    clock_gettime(CLOCK_MONOTONIC, &end_time);
-    printf("New FEC decode took %.02f microseconds\n", TimeSpecToUSeconds(&end_time) - TimeSpecToUSeconds(&start_time));
-    if (memcmp(data_blocks[index_erased_data_block], erased_data, packet_size) == 0) {
-        printf(KGRN"New FEC decode works!\n"KNRM);
-    } else {
-        printf(KRED "New FEC decode produces wrong result!\n"KNRM);
+    bench_result_t result = {.impl = impl->name, .kernel = impl_kernel(impl), .operation = "decode", .pattern = pattern_names[pattern], .k = k,
+                             .m = m, .packet_size = size, .avg_erasures = (double) total_erasures / iterations,
+                             .errors = errors};
+    finish_result(&result, iterations, (uint64_t) k * size);
+}
+
+/**
+ * Benchmarks the gf256 kernels used by fec.c: Adding one data block to m FEC blocks row by row vs. in a single pass
+ */
+static void bench_kernels(unsigned int m, unsigned int size) {
+    uint8_t coefficients[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
+    void *rows[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
+    unsigned int errors = 0;
+    for (unsigned int r = 0; r < m; r++) {
+        coefficients[r] = (uint8_t) (2 + bench_rand() % 254);
+        rows[r] = fec_work_pool[r];
+        memset(fec_pool[r], (int) r, size);
+        memset(fec_work_pool[r], (int) r, size);
+    }
+    for (unsigned int i = 0; i < warmup + iterations; i++) {
+        uint64_t start = now_ns(), start_cycles = now_cycles();
+        for (unsigned int r = 0; r < m; r++)
+            gf256_muladd_mem(fec_pool[r], coefficients[r], data_pool[0], size);
+        uint64_t cycles = now_cycles() - start_cycles, duration = now_ns() - start;
+        if (i >= warmup) {
+            sample_ns[i - warmup] = duration;
+            sample_cycles[i - warmup] = cycles;
+        }
     }
+    bench_result_t result_rows = {.impl = "gf256", .kernel = gf256_kernel_name(), .operation = "muladd_rows", .pattern = "-", .k = 1, .m = m,
+                                  .packet_size = size};
+    finish_result(&result_rows, iterations, (uint64_t) size);
 
+    for (unsigned int i = 0; i < warmup + iterations; i++) {
+        uint64_t start = now_ns(), start_cycles = now_cycles();
+        gf256_muladd_multi_mem(rows, coefficients, (int) m, data_pool[0], size);
+        uint64_t cycles = now_cycles() - start_cycles, duration = now_ns() - start;
+        if (i >= warmup) {
+            sample_ns[i - warmup] = duration;
+            sample_cycles[i - warmup] = cycles;
+        }
+    }
+    for (unsigned int r = 0; r < m; r++) {
+        if (memcmp(fec_pool[r], fec_work_pool[r], size) != 0)
+            errors++;
+    }
+    bench_result_t result_multi = {.impl = "gf256", .kernel = gf256_kernel_name(), .operation = "muladd_multi", .pattern = "-", .k = 1, .m = m,
+                                   .packet_size = size, .errors = errors};
+    finish_result(&result_multi, iterations, (uint64_t) size);
+}
+
+static void print_usage() {
+    printf("FEC benchmark harness. Compares fec.c, fec_old.c, legacy/fec.c and the gf256 kernels.\n"
+           "\n\t-k <list> Data packets per block to sweep, e.g. 1,4,8-12,32 (default 1,4,8,16,32)"
+           "\n\t-m <list> FEC packets per block to sweep, 0..%i (default 0,1,2,4,8,16,32)"
+           "\n\t-s <list> Packet sizes to sweep, 1..%i (default 256,512,1024,1450,2048)"
+           "\n\t-n <iterations> Measured iterations per configuration (default 200, max 4096)"
+           "\n\t-w <iterations> Warm-up iterations per configuration (default 20)"
+           "\n\t-I <list> Implementations: fec,fec_old,fec_legacy,gf256 (default all)"
+           "\n\t-K <list|all> gf256 kernels to compare: gfni_avx512,avx512,gfni_avx2,avx2,ssse3,neon,scalar or all"
+           "\n\t          supported by this CPU. fec and gf256 run once per kernel (default: automatic selection)"
+           "\n\t-o <text|csv|json> Output format (default text)"
+           "\n\t-f <file> Write results to file instead of stdout"
+           "\n\t-c <MHz> CPU clock to estimate cycles/block on platforms without user space cycle counter"
+           "\n\t-S <seed> Seed for test data and erasure patterns\n", MAX_DATA_OR_FEC_PACKETS_PER_BLOCK,
+           MAX_BENCH_PACKET_SIZE);
+}
+
+static void process_command_line_args(int argc, char *argv[]) {
+    num_data_counts = parse_list("1,4,8,16,32", data_counts, 1, MAX_DATA_OR_FEC_PACKETS_PER_BLOCK);
+    num_fec_counts = parse_list("0,1,2,4,8,16,32", fec_counts, 0, MAX_DATA_OR_FEC_PACKETS_PER_BLOCK);
+    num_packet_sizes = parse_list("256,512,1024,1450,2048", packet_sizes, 1, MAX_BENCH_PACKET_SIZE);
+    out = stdout;
+    int c;
+    while ((c = getopt(argc, argv, "k:m:s:n:w:I:K:o:f:c:S:")) != -1) {
+        switch (c) {
+            case 'k':
+                num_data_counts = parse_list(optarg, data_counts, 1, MAX_DATA_OR_FEC_PACKETS_PER_BLOCK);
+                break;
+            case 'm':
+                num_fec_counts = parse_list(optarg, fec_counts, 0, MAX_DATA_OR_FEC_PACKETS_PER_BLOCK);
+                break;
+            case 's':
+                num_packet_sizes = parse_list(optarg, packet_sizes, 1, MAX_BENCH_PACKET_SIZE);
+                break;
+            case 'n':
+                iterations = (unsigned int) strtol(optarg, NULL, 10);
+                break;
+            case 'w':
+                warmup = (unsigned int) strtol(optarg, NULL, 10);
+                break;
+            case 'I':
+                kernels_enabled = strstr(optarg, "gf256") != NULL;
+                for (int i = 0; i < NUM_FEC_IMPLS; i++) {
+                    // match whole names only: "fec" must not enable "fec_old"
+                    char *hit = strstr(optarg, fec_impls[i].name);
+                    impl_enabled[i] = false;
+                    while (hit != NULL) {
+                        char after = hit[strlen(fec_impls[i].name)];
+                        if ((hit == optarg || hit[-1] == ',') && (after == ',' || after == '\0')) {
+                            impl_enabled[i] = true;
+                            break;
+                        }
+                        hit = strstr(hit + 1, fec_impls[i].name);
+                    }
+                }
+                break;
+            case 'K':
+                parse_kernels(optarg);
+                if (num_bench_kernels == 0) {
+                    fprintf(stderr, "fec_speed_test: No known gf256 kernel in \"%s\"\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'o':
+                if (strcmp(optarg, "csv") == 0)
+                    output_format = OUTPUT_CSV;
+                else if (strcmp(optarg, "json") == 0)
+                    output_format = OUTPUT_JSON;
+                else
+                    output_format = OUTPUT_TEXT;
+                break;
+            case 'f':
+                out = fopen(optarg, "w");
+                if (out == NULL) {
+                    perror("fec_speed_test: Could not open output file");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'c':
+                cpu_mhz = strtod(optarg, NULL);
+                break;
+            case 'S':
+                rand_state = strtoull(optarg, NULL, 10) | 1u;
+                break;
+            default:
+                print_usage();
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (num_data_counts < 1 || num_fec_counts < 1 || num_packet_sizes < 1 || iterations < 1 ||
+        iterations > sizeof(sample_ns) / sizeof(sample_ns[0])) {
+        fprintf(stderr, "fec_speed_test: Invalid sweep parameters\n");
+        print_usage();
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    process_command_line_args(argc, argv);
+    for (int i = 0; i < NUM_FEC_IMPLS; i++)
+        fec_impls[i].init();
+    init_test_data();
+    if (num_bench_kernels == 0)
+        bench_kernels_list[num_bench_kernels++] = gf256_kernel_name();
+
+    int kernel_runs = 0;
+    for (int kernel = 0; kernel < num_bench_kernels; kernel++) {
+        if (gf256_select_kernel(bench_kernels_list[kernel]) != 0) {
+            // not an error with "-K all": it only lists kernels compiled in, some may need CPU features we lack
+            fprintf(stderr, "fec_speed_test: Skipping %s GF(256) kernel, not supported by this CPU\n",
+                    bench_kernels_list[kernel]);
+            continue;
+        }
+        fprintf(stderr, "fec_speed_test: Using %s GF(256) kernel\n", gf256_kernel_name());
+        for (int i = 0; i < NUM_FEC_IMPLS; i++) {
+            // implementations with their own arithmetic do not change with the kernel: only benchmark them once
+            if (!impl_enabled[i] || (kernel_runs > 0 && !fec_impls[i].uses_gf256)) continue;
+            for (int s = 0; s < num_packet_sizes; s++) {
+                for (int d = 0; d < num_data_counts; d++) {
+                    for (int f = 0; f < num_fec_counts; f++) {
+                        bench_encode(&fec_impls[i], data_counts[d], fec_counts[f], packet_sizes[s]);
+                        if (fec_counts[f] == 0)
+                            continue;
+                        for (int p = 0; p < ERASURE_PATTERN_CNT; p++)
+                            bench_decode(&fec_impls[i], p, data_counts[d], fec_counts[f], packet_sizes[s]);
+                    }
+                }
+            }
+        }
+        if (kernels_enabled) {
+            for (int s = 0; s < num_packet_sizes; s++)
+                for (int f = 0; f < num_fec_counts; f++)
+                    if (fec_counts[f] > 0)
+                        bench_kernels(fec_counts[f], packet_sizes[s]);
+        }
+        kernel_runs++;
+    }
+    unsigned int inv_cache_hits, inv_cache_misses;
+    fec_get_inv_cache_stats(&inv_cache_hits, &inv_cache_misses);
+    fprintf(stderr, "fec_speed_test: fec_decode() inverted matrix cache: %u hits, %u misses\n", inv_cache_hits,
+            inv_cache_misses);
+    if (output_format == OUTPUT_JSON)
+        fprintf(out, results_written ? "\n]\n" : "[]\n");
+    if (out != stdout)
+        fclose(out);
+    if (total_errors > 0) {
+        fprintf(stderr, "fec_speed_test: %u samples produced wrong results!\n", total_errors);
+        return EXIT_FAILURE;
+    }
     return 0;
-}
\ No newline at end of file
+}
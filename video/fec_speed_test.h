@@ -21,13 +21,62 @@
 #ifndef DRONEBRIDGE_FEC_SPEED_TEST_H
 #define DRONEBRIDGE_FEC_SPEED_TEST_H
 
+#include <stdint.h>
+#include <stdbool.h>
 
-#define MAX_PACKET_LENGTH (DATA_UNI_LENGTH + RADIOTAP_LENGTH + DB_RAW_V2_HEADER_LENGTH)
 #define MAX_DATA_OR_FEC_PACKETS_PER_BLOCK 32
-#define MAX_USER_PACKET_LENGTH 1450
+#define MAX_BENCH_PACKET_SIZE 2048
+#define MAX_SWEEP_VALUES 64
+#define MAX_BENCH_KERNELS 16
 
-static inline float TimeSpecToUSeconds(struct timespec *ts) {
-    return (float) (ts->tv_sec + ts->tv_nsec / 1000.0);
-}
+typedef enum {
+    OUTPUT_TEXT,
+    OUTPUT_CSV,
+    OUTPUT_JSON
+} output_format_t;
+
+typedef enum {
+    ERASURE_RANDOM,     // random number (1..min(k, m)) of erasures at random positions
+    ERASURE_BURST,      // min(k, m) consecutive data packets lost
+    ERASURE_WORST,      // max. number of erasures: min(k, m) lost at random positions, random FEC packets used
+    ERASURE_PATTERN_CNT
+} erasure_pattern_t;
+
+// Common interface for all benchmarked FEC implementations
+typedef struct {
+    const char *name;
+    bool uses_gf256;        // runs on the selected gf256 kernel, benchmarked once per kernel with -K
+    void (*init)(void);
+    void (*encode)(int block_size, uint8_t **data_blocks, unsigned int nr_data_blocks, uint8_t **fec_blocks,
+                   unsigned int nr_fec_blocks);
+    void (*decode)(int block_size, uint8_t **data_blocks, unsigned int nr_data_blocks, uint8_t **fec_blocks,
+                   unsigned int *fec_block_nos, unsigned int *erased_blocks, unsigned short nr_fec_blocks);
+} fec_impl_t;
+
+// Result of one benchmark configuration
+typedef struct {
+    const char *impl;
+    const char *kernel;     // gf256 kernel or "-" for implementations with their own arithmetic
+    const char *operation;
+    const char *pattern;
+    unsigned int k, m, packet_size;
+    double avg_erasures;
+    unsigned int samples;
+    double mean_ns, min_ns, p50_ns, p90_ns, p99_ns, max_ns;
+    double mb_per_s;        // data bytes (k * packet_size) per second
+    double ns_per_byte;
+    double cycles_per_block;
+    unsigned int errors;    // decoded data not equal to original data
+} bench_result_t;
+
+// legacy/fec.c gets compiled with renamed symbols so it can be linked next to fec.c (see CMakeLists.txt)
+void fec_init_legacy(void);
+
+void fec_encode_legacy(unsigned int blockSize, unsigned char **data_blocks, unsigned int nrDataBlocks,
+                       unsigned char **fec_blocks, unsigned int nrFecBlocks);
+
+void fec_decode_legacy(unsigned int blockSize, unsigned char **data_blocks, unsigned int nr_data_blocks,
+                       unsigned char **fec_blocks, unsigned int *fec_block_nos, unsigned int *erased_blocks,
+                       unsigned short nr_fec_blocks);
 
 #endif //DRONEBRIDGE_FEC_SPEED_TEST_H
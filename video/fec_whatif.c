@@ -0,0 +1,828 @@
+/*
+ *   This file is part of DroneBridge: https://github.com/DroneBridge/DroneBridge
+ *
+ *   Copyright 2020 Wolfgang Christl
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+/**
+ * Offline FEC what-if analyzer. Extracts the loss pattern of the video stream from capture files (pcap/pcapng, e.g.
+ * flight recordings of video_gnd -C) or reads a loss trace and replays it against other FEC configurations: data and
+ * FEC packets per block (video_blocks, video_fecs), packet size (video_blocklength) and block interleaving depth.
+ * Blocks are judged like video_gnd does (a block is repaired if no more DATA packets are lost than FEC packets
+ * arrived). Reports residual block and data loss, added latency, byte overhead, airtime and the CPU time fec_decode()
+ * takes for the erasure patterns that actually occur. Configurations are simulated in parallel on all cores.
+ *
+ * The loss trace is modelled in time: a frame of a candidate configuration is lost if the captured frame that was on
+ * air at the same moment got lost. This keeps fade and interference durations when frame rates differ. It does not
+ * model that longer frames are more likely to be hit by bit errors.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include "fec.h"
+#include "gf256.h"
+#include "video_lib.h"
+#include "../common/db_protocol.h"
+#include "../common/db_pcap.h"
+#include "../common/db_radiotap.h"
+#include "../common/db_raw_receive.h"
+#include "../common/radiotap/radiotap_iter.h"
+
+#define MAX_DATA_OR_FEC_PACKETS_PER_BLOCK 32
+#define MAX_USER_PACKET_LENGTH 1450
+#define MAX_SWEEP_VALUES 64
+#define MAX_CAPTURE_FILES DB_MAX_ADAPTERS
+#define MIN_PACKET_SIZE 8               // video_packet_data_t length field + some data
+// bytes on air next to the FEC block: DB raw v2 header, video header, FCS
+#define FRAME_OVERHEAD (DB_RAW_V2_HEADER_LENGTH + sizeof(video_packet_header_t) + 4)
+// 802.11a/g OFDM: preamble + SIGNAL, symbol duration, SERVICE + tail bits, DIFS + mean backoff (CWmin 15, 9 us slots)
+#define OFDM_PREAMBLE_US 20.0
+#define OFDM_SYMBOL_US 4.0
+#define OFDM_EXTRA_BITS 22
+#define MEDIUM_ACCESS_US (34.0 + 7.5 * 9.0)
+
+typedef enum {
+    OUTPUT_TEXT,
+    OUTPUT_CSV
+} output_format_t;
+
+typedef struct {
+    unsigned int k, m, packet_size, depth;
+} whatif_config_t;
+
+typedef struct {
+    uint64_t blocks;
+    uint64_t failed_blocks;         // more DATA packets lost than FEC packets received
+    uint64_t repaired_blocks;       // lost DATA packets recovered by fec_decode()
+    uint64_t data_packets;
+    uint64_t lost_data_packets;     // before FEC
+    uint64_t residual_data_packets; // still missing after FEC
+    double latency_ms;              // worst case delay added by the block: filling all interleaved blocks + airtime
+    double overhead_pct;            // bytes on air per video byte (FEC + headers)
+    double airtime_pct;             // share of the channel used at the observed video bitrate
+    double decode_ns;               // mean fec_decode() time of a repaired block
+    double cpu_pct;                 // of one core, for decoding at the repaired block rate
+    unsigned int decode_samples;
+    unsigned int decode_errors;     // decoded data not equal to original data
+} whatif_result_t;
+
+// Per thread FEC buffers. pristine holds the original DATA packets of the configuration followed by its FEC packets.
+// fec_decode() works in place on the DATA and FEC packets it gets, data and fec are the received copies
+typedef struct {
+    uint8_t pristine[2 * MAX_DATA_OR_FEC_PACKETS_PER_BLOCK][MAX_USER_PACKET_LENGTH];
+    uint8_t data[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK][MAX_USER_PACKET_LENGTH];
+    uint8_t fec[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK][MAX_USER_PACKET_LENGTH];
+    uint64_t rand_state;
+} whatif_worker_t;
+
+char *capture_files[MAX_CAPTURE_FILES];
+int num_capture_files = 0;
+char *trace_file = NULL;
+int comm_id = -1;
+unsigned int obs_k = 8, obs_m = 4, obs_packet_size = 0;
+double bitrate_kbps = 0, phy_rate_mbps = 0;
+unsigned int data_counts[MAX_SWEEP_VALUES], fec_counts[MAX_SWEEP_VALUES], packet_sizes[MAX_SWEEP_VALUES],
+        depths[MAX_SWEEP_VALUES];
+int num_data_counts, num_fec_counts, num_packet_sizes, num_depths;
+double target_block_loss_pct = 0.1, max_latency_ms = 0, max_airtime_pct = 100;
+unsigned int max_decode_samples = 256;
+int num_threads = 0;
+output_format_t output_format = OUTPUT_TEXT;
+FILE *out;
+
+// loss trace: one entry per captured on-air slot (video sequence number), 1 if the frame got lost or arrived corrupt
+#define TRACE_RECEIVED 0
+#define TRACE_LOST 1
+#define TRACE_UNUSED 2  // sequence number of a block that got flushed early by video_air (less packets than k + m)
+uint8_t *trace;
+uint64_t trace_len = 0, trace_capacity = 0;
+double trace_duration_s = 0;
+
+whatif_config_t *configs;
+whatif_result_t *results;
+unsigned int num_configs, next_config = 0;
+
+static inline uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static uint32_t worker_rand(whatif_worker_t *worker) {
+    // xorshift64*: reproducible across platforms
+    worker->rand_state ^= worker->rand_state >> 12;
+    worker->rand_state ^= worker->rand_state << 25;
+    worker->rand_state ^= worker->rand_state >> 27;
+    return (uint32_t) ((worker->rand_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+/**
+ * Parses a list like "1,2,4-8,16" into values
+ *
+ * @return Number of values or -1 on parse error
+ */
+static int parse_list(const char *arg, unsigned int *values, unsigned int min, unsigned int max) {
+    int cnt = 0;
+    const char *p = arg;
+    while (*p) {
+        char *end;
+        long first = strtol(p, &end, 10), last;
+        if (end == p) return -1;
+        last = first;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p) return -1;
+        }
+        for (long v = first; v <= last; v++) {
+            if (v < min || v > max || cnt >= MAX_SWEEP_VALUES) return -1;
+            values[cnt++] = (unsigned int) v;
+        }
+        p = (*end == ',') ? end + 1 : end;
+        if (*end != ',' && *end != '\0') return -1;
+    }
+    return cnt;
+}
+
+/**
+ * Sets the state of a slot of the loss trace. Grows the trace as needed, new slots start as lost.
+ *
+ * @param value TRACE_RECEIVED or TRACE_UNUSED
+ * @return 0 on success, -1 if out of memory
+ */
+static int trace_set(uint64_t slot, uint8_t value) {
+    if (slot >= trace_capacity) {
+        uint64_t capacity = trace_capacity ? trace_capacity : 65536;
+        while (capacity <= slot)
+            capacity *= 2;
+        uint8_t *grown = realloc(trace, capacity);
+        if (grown == NULL) {
+            perror("fec_whatif: Could not grow loss trace");
+            return -1;
+        }
+        memset(grown + trace_capacity, TRACE_LOST, capacity - trace_capacity);
+        trace = grown;
+        trace_capacity = capacity;
+    }
+    trace[slot] = value;
+    if (slot >= trace_len)
+        trace_len = slot + 1;
+    return 0;
+}
+
+static int trace_set_received(uint64_t slot) {
+    return trace_set(slot, TRACE_RECEIVED);
+}
+
+/**
+ * Removes the slots of early flushed blocks that never got sent (TRACE_UNUSED) so that the trace only holds frames
+ * that went on air
+ */
+static void trace_compact() {
+    uint64_t len = 0;
+    for (uint64_t i = 0; i < trace_len; i++) {
+        if (trace[i] != TRACE_UNUSED)
+            trace[len++] = trace[i];
+    }
+    trace_len = len;
+}
+
+/**
+ * Reads the video frames of all capture files (merged by time stamp, every file is one adapter) into the loss trace.
+ * A slot counts as received if any adapter got its frame with correct FCS. Corrupt frames are not used since their
+ * sequence number can not be trusted. Transmitter restarts continue the trace after the last slot. Sequence numbers
+ * left unused by blocks that were flushed early are removed from the trace.
+ * Also derives the packet size, video bitrate and PHY rate of the capture unless set on the command line.
+ *
+ * @return 0 on success, -1 on error
+ */
+static int load_captures() {
+    db_pcap_reader_t readers[MAX_CAPTURE_FILES];
+    db_pcap_frame_t frames[MAX_CAPTURE_FILES];
+    db_rt_plan_t plans[MAX_CAPTURE_FILES];
+    bool pending[MAX_CAPTURE_FILES];
+    for (int f = 0; f < num_capture_files; f++) {
+        if (db_pcap_open(&readers[f], capture_files[f]) < 0)
+            return -1;
+        db_rt_plan_init(&plans[f]);
+        pending[f] = db_pcap_next(&readers[f], &frames[f]) > 0;
+    }
+    const int64_t restart_window = 128 * (int64_t) (obs_k + obs_m);
+    uint64_t first_ts = 0, last_ts = 0, video_frames = 0, corrupt_frames = 0, video_bytes = 0;
+    int64_t seq_offset = 0, max_slot = -1;
+    bool have_first = false;
+    uint32_t first_seq = 0, packet_size = 0;
+    uint8_t rate = 0;
+    while (true) {
+        int next = -1;
+        for (int f = 0; f < num_capture_files; f++) {
+            if (pending[f] && (next < 0 || frames[f].timestamp_ns < frames[next].timestamp_ns))
+                next = f;
+        }
+        if (next < 0)
+            break;
+        db_pcap_frame_t *frame = &frames[next];
+        uint8_t *data = (uint8_t *) frame->data;
+        uint16_t radiotap_length = (uint16_t) (frame->length >= 4 ? data[2] | (data[3] << 8) : 0);
+        if (frame->length >= (uint32_t) radiotap_length + DB_RAW_V2_HEADER_LENGTH + sizeof(video_packet_header_t) &&
+            radiotap_length > 0) {
+            struct db_raw_v2_header_t *db_header = (struct db_raw_v2_header_t *) (data + radiotap_length);
+            uint16_t payload_length;
+            db_seq_num_t db_seq_num;
+            uint8_t *payload = NULL;
+            if (db_header->port == DB_PORT_VIDEO && (comm_id < 0 || db_header->comm_id == comm_id))
+                payload = get_db_payload_pointer_seq(data, frame->length, &payload_length, &db_seq_num,
+                                                     &radiotap_length);
+            if (payload != NULL && payload_length > sizeof(video_packet_header_t) &&
+                payload + payload_length <= data + frame->length) {
+                const db_rt_field_t *rt_fields;
+                int checksum_correct = 1;
+                int num_rt_fields = db_rt_get_fields(&plans[next], data, radiotap_length, &rt_fields);
+                for (int i = 0; i < num_rt_fields; i++) {
+                    if (rt_fields[i].index == IEEE80211_RADIOTAP_FLAGS)
+                        checksum_correct = (data[rt_fields[i].offset] & IEEE80211_RADIOTAP_F_BADFCS) == 0;
+                    else if (rt_fields[i].index == IEEE80211_RADIOTAP_RATE && data[rt_fields[i].offset] != 0)
+                        rate = data[rt_fields[i].offset];
+                }
+                video_frames++;
+                if (!checksum_correct) {
+                    corrupt_frames++;
+                } else {
+                    video_packet_header_t *video_header = (video_packet_header_t *) payload;
+                    uint32_t seq = video_header->sequence_number;
+                    if (!have_first) {
+                        first_seq = seq;
+                        first_ts = frame->timestamp_ns;
+                        have_first = true;
+                    }
+                    // DATA packets are sent only up to their data length, FEC packets have the full packet size
+                    if (payload_length - sizeof(video_packet_header_t) > packet_size)
+                        packet_size = payload_length - (uint16_t) sizeof(video_packet_header_t);
+                    int64_t slot = (int64_t) seq - first_seq + seq_offset;
+                    if (slot + restart_window < max_slot || slot > max_slot + (1 << 20)) {
+                        // transmitter restart (or a jump no real gap explains): continue behind the known slots
+                        seq_offset += max_slot + 1 - slot;
+                        slot = max_slot + 1;
+                    }
+                    if (slot >= 0) {
+                        unsigned int position = seq % (obs_k + obs_m), k = video_header->num_data,
+                                m = video_header->num_fec;
+                        bool is_data = position < 2 * (k < m ? k : m) ? position % 2 == 0 : k > m;
+                        bool duplicate = (uint64_t) slot < trace_len && trace[slot] == TRACE_RECEIVED;
+                        if (is_data && !duplicate && payload_length >= sizeof(video_packet_header_t) + 4) {
+                            video_packet_data_t *video_data =
+                                    (video_packet_data_t *) (payload + sizeof(video_packet_header_t));
+                            uint32_t data_length = video_data->data_length;
+                            if (data_length >= 4 && data_length <= payload_length - sizeof(video_packet_header_t))
+                                video_bytes += data_length - 4;
+                        }
+                        if (trace_set_received((uint64_t) slot) < 0)
+                            return -1;
+                        // blocks always span k + m sequence numbers, short blocks leave the end of the span unused
+                        int64_t block_start = slot - seq % (obs_k + obs_m);
+                        for (unsigned int p = video_header->num_data + video_header->num_fec; p < obs_k + obs_m; p++) {
+                            if (block_start + p >= 0 && ((uint64_t) (block_start + p) >= trace_len ||
+                                                         trace[block_start + p] != TRACE_RECEIVED) &&
+                                trace_set((uint64_t) (block_start + p), TRACE_UNUSED) < 0)
+                                return -1;
+                        }
+                        if (slot > max_slot)
+                            max_slot = slot;
+                    }
+                    last_ts = frame->timestamp_ns;
+                }
+            }
+        }
+        int ret = db_pcap_next(&readers[next], frame);
+        pending[next] = ret > 0;
+        if (ret < 0)
+            fprintf(stderr, "fec_whatif: Stopped reading %s\n", capture_files[next]);
+    }
+    for (int f = 0; f < num_capture_files; f++)
+        db_pcap_close(&readers[f]);
+    trace_compact();
+    if (trace_len == 0) {
+        fprintf(stderr, "fec_whatif: No intact video frames found in the capture files\n");
+        return -1;
+    }
+    if (obs_packet_size == 0)
+        obs_packet_size = packet_size;
+    if (phy_rate_mbps == 0 && rate != 0)
+        phy_rate_mbps = rate / 2.0;
+    trace_duration_s = (double) (last_ts - first_ts) / 1e9;
+    if (bitrate_kbps == 0) {
+        if (trace_duration_s <= 0) {
+            fprintf(stderr, "fec_whatif: Capture too short to derive the video bitrate. Set it using -b\n");
+            return -1;
+        }
+        // video data of the captured DATA packets, scaled up by the loss of the capture
+        uint64_t received = 0;
+        for (uint64_t i = 0; i < trace_len; i++)
+            received += trace[i] == TRACE_RECEIVED;
+        bitrate_kbps = (double) video_bytes * trace_len / received * 8 / trace_duration_s / 1000;
+    }
+    fprintf(stderr, "fec_whatif: %llu video frames (%llu with bad FCS) from %i capture file(s)\n",
+            (unsigned long long) video_frames, (unsigned long long) corrupt_frames, num_capture_files);
+    return 0;
+}
+
+/**
+ * Reads a loss trace: one character per on-air frame in sending order. '1' or '.' for a received frame, '0', 'x' or
+ * 'X' for a lost one. Everything else is ignored, '#' starts a comment that runs until the end of the line.
+ *
+ * @return 0 on success, -1 on error
+ */
+static int load_trace() {
+    FILE *file = fopen(trace_file, "r");
+    if (file == NULL) {
+        perror("fec_whatif: Could not open loss trace");
+        return -1;
+    }
+    int c;
+    bool comment = false;
+    uint64_t slot = 0;
+    while ((c = fgetc(file)) != EOF) {
+        if (comment) {
+            comment = c != '\n';
+        } else if (c == '#') {
+            comment = true;
+        } else if (c == '1' || c == '.') {
+            if (trace_set_received(slot++) < 0) {
+                fclose(file);
+                return -1;
+            }
+        } else if (c == '0' || c == 'x' || c == 'X') {
+            slot++;
+            trace_len = slot;
+        }
+    }
+    fclose(file);
+    if (trace_len > trace_capacity) {
+        // trace ends with lost frames that were never written
+        uint64_t len = trace_len;
+        if (trace_set_received(len - 1) < 0)
+            return -1;
+        trace[len - 1] = TRACE_LOST;
+    }
+    if (trace_len == 0) {
+        fprintf(stderr, "fec_whatif: Loss trace %s is empty\n", trace_file);
+        return -1;
+    }
+    if (obs_packet_size == 0)
+        obs_packet_size = 1024;
+    if (bitrate_kbps == 0) {
+        fprintf(stderr, "fec_whatif: Loss traces carry no time. Set the video bitrate using -b\n");
+        return -1;
+    }
+    trace_duration_s = (double) trace_len * obs_k / (obs_k + obs_m) * (obs_packet_size - 4) * 8 /
+                       (bitrate_kbps * 1000);
+    return 0;
+}
+
+/**
+ * Airtime of one video frame incl. medium access for the configured PHY rate (802.11a/g OFDM)
+ *
+ * @param packet_size FEC block size (video_blocklength)
+ * @return Airtime in us
+ */
+static double frame_airtime_us(unsigned int packet_size) {
+    double bits = OFDM_EXTRA_BITS + 8.0 * (packet_size + FRAME_OVERHEAD);
+    return MEDIUM_ACCESS_US + OFDM_PREAMBLE_US + OFDM_SYMBOL_US * ceil(bits / (OFDM_SYMBOL_US * phy_rate_mbps));
+}
+
+/**
+ * Frames per second a configuration sends at the video bitrate
+ */
+static double frame_rate(unsigned int k, unsigned int m, unsigned int packet_size) {
+    return bitrate_kbps * 1000 / 8 / (packet_size - 4) * (k + m) / k;
+}
+
+/**
+ * Encodes random DATA packets of the configuration so that the erasure patterns can be decoded for real
+ */
+static void prepare_decode(whatif_worker_t *worker, const whatif_config_t *config) {
+    uint8_t *data_blocks[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK], *fec_blocks[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
+    for (unsigned int i = 0; i < config->k; i++) {
+        for (unsigned int b = 0; b < config->packet_size; b++)
+            worker->pristine[i][b] = (uint8_t) worker_rand(worker);
+        data_blocks[i] = worker->pristine[i];
+        memcpy(worker->data[i], worker->pristine[i], config->packet_size);
+    }
+    for (unsigned int i = 0; i < config->m; i++)
+        fec_blocks[i] = worker->pristine[config->k + i];
+    if (config->m > 0)
+        fec_encode((int) config->packet_size, data_blocks, config->k, fec_blocks, config->m);
+}
+
+/**
+ * Repairs a block with fec_decode() the way video_gnd does: every lost DATA packet gets replaced by the next received
+ * FEC packet. Verifies the result against the original data.
+ *
+ * @return Time fec_decode() took in ns
+ */
+static uint64_t decode_block(whatif_worker_t *worker, const whatif_config_t *config, const bool *data_lost,
+                             const bool *fec_lost, whatif_result_t *result) {
+    uint8_t *data_blocks[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK], *fec_blocks[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
+    unsigned int fec_block_nos[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK], erased_blocks[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
+    unsigned short nr_fec_blocks = 0;
+    unsigned int fi = 0;
+    for (unsigned int di = 0; di < config->k; di++) {
+        data_blocks[di] = worker->data[di];
+        if (!data_lost[di])
+            continue;
+        while (fec_lost[fi])
+            fi++;
+        memset(worker->data[di], 0, config->packet_size);
+        erased_blocks[nr_fec_blocks] = di;
+        fec_block_nos[nr_fec_blocks] = fi;
+        memcpy(worker->fec[nr_fec_blocks], worker->pristine[config->k + fi], config->packet_size);
+        fec_blocks[nr_fec_blocks] = worker->fec[nr_fec_blocks];
+        nr_fec_blocks++;
+        fi++;
+    }
+    uint64_t start = now_ns();
+    fec_decode((int) config->packet_size, data_blocks, config->k, fec_blocks, fec_block_nos, erased_blocks,
+               nr_fec_blocks);
+    uint64_t duration = now_ns() - start;
+    for (unsigned int i = 0; i < nr_fec_blocks; i++) {
+        if (memcmp(worker->data[erased_blocks[i]], worker->pristine[erased_blocks[i]], config->packet_size) != 0) {
+            result->decode_errors++;
+            memcpy(worker->data[erased_blocks[i]], worker->pristine[erased_blocks[i]], config->packet_size);
+        }
+    }
+    return duration;
+}
+
+/**
+ * Replays the loss trace against a configuration. DATA and FEC packets of a block are sent alternating like
+ * video_air does (see calc_block_slots()). With an interleaving depth D > 1 the packets of D consecutive blocks are
+ * sent round robin so that a burst is spread over D blocks.
+ *
+ * @param decode_stride Decode every n-th repaired block using fec_decode(). 0 to only count
+ */
+static void simulate(whatif_worker_t *worker, const whatif_config_t *config, whatif_result_t *result,
+                     uint64_t decode_stride) {
+    const unsigned int n = config->k + config->m;
+    bool is_data[2 * MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
+    unsigned int di = 0, fi = 0, slot = 0;
+    while (di < config->k || fi < config->m) {
+        if (di < config->k) is_data[slot++] = true, di++;
+        if (fi < config->m) is_data[slot++] = false, fi++;
+    }
+    // candidate frame j was on air at the same time as captured frame j * step
+    const double step = frame_rate(obs_k, obs_m, obs_packet_size) / frame_rate(config->k, config->m,
+                                                                                config->packet_size);
+    const uint64_t group_frames = (uint64_t) n * config->depth;
+    const uint64_t num_groups = (uint64_t) (trace_len / step) / group_frames;
+    uint64_t repaired = 0, decode_ns = 0;
+    result->blocks = result->failed_blocks = result->repaired_blocks = 0;
+    result->data_packets = result->lost_data_packets = result->residual_data_packets = 0;
+    result->decode_samples = 0;
+
+    for (uint64_t g = 0; g < num_groups; g++) {
+        const uint64_t group_start = g * group_frames;
+        for (unsigned int b = 0; b < config->depth; b++) {
+            bool data_lost[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK], fec_lost[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
+            unsigned int lost_data = 0, good_fecs = 0;
+            di = fi = 0;
+            for (unsigned int s = 0; s < n; s++) {
+                uint64_t frame = group_start + (uint64_t) s * config->depth + b;
+                uint64_t captured = (uint64_t) (frame * step);
+                bool lost = captured >= trace_len || trace[captured];
+                if (is_data[s]) {
+                    data_lost[di++] = lost;
+                    lost_data += lost;
+                } else {
+                    fec_lost[fi++] = lost;
+                    good_fecs += !lost;
+                }
+            }
+            result->blocks++;
+            result->data_packets += config->k;
+            result->lost_data_packets += lost_data;
+            if (lost_data == 0)
+                continue;
+            if (lost_data > good_fecs) {
+                result->failed_blocks++;
+                result->residual_data_packets += lost_data;
+                continue;
+            }
+            result->repaired_blocks++;
+            if (decode_stride > 0 && repaired++ % decode_stride == 0) {
+                decode_ns += decode_block(worker, config, data_lost, fec_lost, result);
+                result->decode_samples++;
+            }
+        }
+    }
+    result->decode_ns = result->decode_samples ? (double) decode_ns / result->decode_samples : 0;
+}
+
+/**
+ * Simulates one configuration and derives latency, overhead, airtime and CPU load
+ */
+static void evaluate(whatif_worker_t *worker, const whatif_config_t *config, whatif_result_t *result) {
+    memset(result, 0, sizeof(whatif_result_t));
+    simulate(worker, config, result, 0);
+    if (result->repaired_blocks > 0 && max_decode_samples > 0) {
+        prepare_decode(worker, config);
+        uint64_t stride = (result->repaired_blocks + max_decode_samples - 1) / max_decode_samples;
+        simulate(worker, config, result, stride);
+    }
+    double airtime_us = frame_airtime_us(config->packet_size);
+    double fill_s = (double) config->depth * config->k * (config->packet_size - 4) * 8 / (bitrate_kbps * 1000);
+    result->latency_ms = fill_s * 1e3 + config->depth * (config->k + config->m) * airtime_us / 1e3;
+    result->overhead_pct = 100.0 * ((double) (config->k + config->m) * (config->packet_size + FRAME_OVERHEAD) /
+                                    ((double) config->k * (config->packet_size - 4)) - 1);
+    result->airtime_pct = frame_rate(config->k, config->m, config->packet_size) * airtime_us / 1e4;
+    if (trace_duration_s > 0 && result->blocks > 0) {
+        // repaired blocks per second of video
+        double block_rate = (double) result->repaired_blocks / result->blocks *
+                            frame_rate(config->k, config->m, config->packet_size) / (config->k + config->m);
+        result->cpu_pct = block_rate * result->decode_ns / 1e7;
+    }
+}
+
+static void *sweep_worker(void *arg) {
+    whatif_worker_t *worker = malloc(sizeof(whatif_worker_t));
+    if (worker == NULL) {
+        perror("fec_whatif: Could not allocate worker buffers");
+        return NULL;
+    }
+    worker->rand_state = 0x2545F4914F6CDD1DULL + (uintptr_t) arg;
+    unsigned int c;
+    while ((c = __atomic_fetch_add(&next_config, 1, __ATOMIC_RELAXED)) < num_configs)
+        evaluate(worker, &configs[c], &results[c]);
+    free(worker);
+    return NULL;
+}
+
+static double pct(uint64_t part, uint64_t total) {
+    return total ? 100.0 * part / total : 0;
+}
+
+static void print_trace_summary() {
+    uint64_t lost = 0, bursts = 0, max_burst = 0, burst = 0;
+    for (uint64_t i = 0; i < trace_len; i++) {
+        if (trace[i]) {
+            lost++;
+            if (burst++ == 0)
+                bursts++;
+            if (burst > max_burst)
+                max_burst = burst;
+        } else {
+            burst = 0;
+        }
+    }
+    fprintf(stderr, "fec_whatif: Trace of %llu frames (%.1f s): %.2f %% lost in %llu bursts (mean %.1f, max %llu "
+                    "frames)\n", (unsigned long long) trace_len, trace_duration_s, pct(lost, trace_len),
+            (unsigned long long) bursts, bursts ? (double) lost / bursts : 0, (unsigned long long) max_burst);
+    fprintf(stderr, "fec_whatif: Captured with %u/%u/%u, video %.0f kbit/s, PHY %.1f Mbit/s, %i threads, GF(256) "
+                    "kernel %s\n", obs_k, obs_m, obs_packet_size, bitrate_kbps, phy_rate_mbps, num_threads,
+            gf256_kernel_name());
+}
+
+static void print_results() {
+    if (output_format == OUTPUT_CSV) {
+        fprintf(out, "k,m,packet_size,depth,blocks,failed_blocks,repaired_blocks,residual_block_loss_pct,"
+                     "data_loss_pct,residual_data_loss_pct,latency_ms,overhead_pct,airtime_pct,decode_ns,cpu_pct,"
+                     "decode_samples,decode_errors\n");
+    } else {
+        fprintf(out, "%3s %3s %5s %3s | %9s %10s %10s | %9s %9s %9s | %9s %7s\n", "k", "m", "size", "D",
+                "blk.loss%", "data.loss%", "resid.dat%", "lat. ms", "overhd.%", "airtime%", "decode us", "CPU %");
+    }
+    for (unsigned int c = 0; c < num_configs; c++) {
+        const whatif_config_t *cfg = &configs[c];
+        const whatif_result_t *r = &results[c];
+        if (output_format == OUTPUT_CSV) {
+            fprintf(out, "%u,%u,%u,%u,%llu,%llu,%llu,%.4f,%.4f,%.4f,%.2f,%.2f,%.2f,%.0f,%.4f,%u,%u\n", cfg->k, cfg->m,
+                    cfg->packet_size, cfg->depth, (unsigned long long) r->blocks,
+                    (unsigned long long) r->failed_blocks, (unsigned long long) r->repaired_blocks,
+                    pct(r->failed_blocks, r->blocks), pct(r->lost_data_packets, r->data_packets),
+                    pct(r->residual_data_packets, r->data_packets), r->latency_ms, r->overhead_pct, r->airtime_pct,
+                    r->decode_ns, r->cpu_pct, r->decode_samples, r->decode_errors);
+        } else {
+            fprintf(out, "%3u %3u %5u %3u | %9.3f %10.3f %10.3f | %9.2f %9.1f %8.1f%s | %9.2f %7.3f%s\n", cfg->k,
+                    cfg->m, cfg->packet_size, cfg->depth, pct(r->failed_blocks, r->blocks),
+                    pct(r->lost_data_packets, r->data_packets), pct(r->residual_data_packets, r->data_packets),
+                    r->latency_ms, r->overhead_pct, r->airtime_pct, r->airtime_pct > 100 ? "!" : " ",
+                    r->decode_ns / 1e3, r->cpu_pct, r->decode_errors ? " DECODE ERRORS" : "");
+        }
+    }
+}
+
+/**
+ * Suggests the configuration with the least airtime that meets the residual block loss target, latency and airtime
+ * limits
+ */
+static void print_suggestion() {
+    int best = -1;
+    for (unsigned int c = 0; c < num_configs; c++) {
+        const whatif_result_t *r = &results[c];
+        if (r->blocks == 0 || pct(r->failed_blocks, r->blocks) > target_block_loss_pct ||
+            r->airtime_pct > max_airtime_pct || (max_latency_ms > 0 && r->latency_ms > max_latency_ms))
+            continue;
+        if (best < 0 || r->airtime_pct < results[best].airtime_pct ||
+            (r->airtime_pct == results[best].airtime_pct && r->latency_ms < results[best].latency_ms))
+            best = (int) c;
+    }
+    if (best < 0) {
+        fprintf(stderr, "fec_whatif: No configuration reaches %.3f %% residual block loss within the limits\n",
+                target_block_loss_pct);
+        return;
+    }
+    fprintf(stderr, "fec_whatif: Suggested: video_blocks=%u video_fecs=%u video_blocklength=%u (interleaving depth "
+                    "%u): %.3f %% block loss, %.2f ms, %.1f %% airtime\n", configs[best].k, configs[best].m,
+            configs[best].packet_size, configs[best].depth,
+            pct(results[best].failed_blocks, results[best].blocks), results[best].latency_ms,
+            results[best].airtime_pct);
+}
+
+static void print_usage() {
+    printf("Offline FEC what-if analyzer. Replays the loss pattern of captured video traffic against other FEC "
+           "configurations.\n"
+           "\n\t-r <file> pcap/pcapng capture of video frames (radiotap). Repeat for captures of several adapters"
+           "\n\t-l <file> Loss trace instead of captures: one char per frame, 1/. received, 0/x lost, # comments"
+           "\n\t-c <comm id> Only use frames of this communication ID (default all)"
+           "\n\t-K <k> -M <m> Data and FEC packets per block used in the capture (default 8 and 4)"
+           "\n\t-P <size> Packet size used in the capture (default from capture or 1024)"
+           "\n\t-b <kbit/s> Video bitrate (default derived from the capture, required for loss traces)"
+           "\n\t-p <Mbit/s> PHY rate for airtime (default from the capture's radiotap header or 24)"
+           "\n\t-k <list> Data packets per block to sweep, e.g. 4,8-12 (default 4,6,8,12,16)"
+           "\n\t-m <list> FEC packets per block to sweep (default 0-8)"
+           "\n\t-s <list> Packet sizes to sweep, %i..%i (default 512,1024,1400)"
+           "\n\t-D <list> Block interleaving depths to sweep, 1..%i (default 1,2,4)"
+           "\n\t-t <%%> Residual block loss target for the suggestion (default %.1f)"
+           "\n\t-L <ms> Max. added latency for the suggestion (default none)"
+           "\n\t-A <%%> Max. airtime for the suggestion (default %.0f)"
+           "\n\t-n <blocks> Blocks to decode per configuration to measure CPU cost (default %u)"
+           "\n\t-j <threads> Worker threads (default: all cores)"
+           "\n\t-o <text|csv> Output format (default text)"
+           "\n\t-f <file> Write results to file instead of stdout\n", MIN_PACKET_SIZE, MAX_USER_PACKET_LENGTH,
+           MAX_INTERLEAVE_DEPTH, target_block_loss_pct, max_airtime_pct, max_decode_samples);
+}
+
+static void process_command_line_args(int argc, char *argv[]) {
+    num_data_counts = parse_list("4,6,8,12,16", data_counts, 1, MAX_DATA_OR_FEC_PACKETS_PER_BLOCK);
+    num_fec_counts = parse_list("0-8", fec_counts, 0, MAX_DATA_OR_FEC_PACKETS_PER_BLOCK);
+    num_packet_sizes = parse_list("512,1024,1400", packet_sizes, MIN_PACKET_SIZE, MAX_USER_PACKET_LENGTH);
+    num_depths = parse_list("1,2,4", depths, 1, MAX_INTERLEAVE_DEPTH);
+    out = stdout;
+    int c;
+    while ((c = getopt(argc, argv, "r:l:c:K:M:P:b:p:k:m:s:D:t:L:A:n:j:o:f:")) != -1) {
+        switch (c) {
+            case 'r':
+                if (num_capture_files < MAX_CAPTURE_FILES)
+                    capture_files[num_capture_files++] = optarg;
+                break;
+            case 'l':
+                trace_file = optarg;
+                break;
+            case 'c':
+                comm_id = (int) strtol(optarg, NULL, 10);
+                break;
+            case 'K':
+                obs_k = (unsigned int) strtoul(optarg, NULL, 10);
+                break;
+            case 'M':
+                obs_m = (unsigned int) strtoul(optarg, NULL, 10);
+                break;
+            case 'P':
+                obs_packet_size = (unsigned int) strtoul(optarg, NULL, 10);
+                break;
+            case 'b':
+                bitrate_kbps = strtod(optarg, NULL);
+                break;
+            case 'p':
+                phy_rate_mbps = strtod(optarg, NULL);
+                break;
+            case 'k':
+                num_data_counts = parse_list(optarg, data_counts, 1, MAX_DATA_OR_FEC_PACKETS_PER_BLOCK);
+                break;
+            case 'm':
+                num_fec_counts = parse_list(optarg, fec_counts, 0, MAX_DATA_OR_FEC_PACKETS_PER_BLOCK);
+                break;
+            case 's':
+                num_packet_sizes = parse_list(optarg, packet_sizes, MIN_PACKET_SIZE, MAX_USER_PACKET_LENGTH);
+                break;
+            case 'D':
+                num_depths = parse_list(optarg, depths, 1, MAX_INTERLEAVE_DEPTH);
+                break;
+            case 't':
+                target_block_loss_pct = strtod(optarg, NULL);
+                break;
+            case 'L':
+                max_latency_ms = strtod(optarg, NULL);
+                break;
+            case 'A':
+                max_airtime_pct = strtod(optarg, NULL);
+                break;
+            case 'n':
+                max_decode_samples = (unsigned int) strtoul(optarg, NULL, 10);
+                break;
+            case 'j':
+                num_threads = (int) strtol(optarg, NULL, 10);
+                break;
+            case 'o':
+                output_format = strcmp(optarg, "csv") == 0 ? OUTPUT_CSV : OUTPUT_TEXT;
+                break;
+            case 'f':
+                out = fopen(optarg, "w");
+                if (out == NULL) {
+                    perror("fec_whatif: Could not open output file");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            default:
+                print_usage();
+                exit(EXIT_FAILURE);
+        }
+    }
+    if ((num_capture_files == 0) == (trace_file == NULL) || num_data_counts < 1 || num_fec_counts < 1 ||
+        num_packet_sizes < 1 || num_depths < 1 || obs_k < 1 || obs_k > MAX_DATA_OR_FEC_PACKETS_PER_BLOCK ||
+        obs_m > MAX_DATA_OR_FEC_PACKETS_PER_BLOCK || (obs_packet_size != 0 && obs_packet_size < MIN_PACKET_SIZE)) {
+        fprintf(stderr, "fec_whatif: Need either captures (-r) or a loss trace (-l) and valid sweep parameters\n");
+        print_usage();
+        exit(EXIT_FAILURE);
+    }
+    if (num_threads <= 0)
+        num_threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_threads <= 0)
+        num_threads = 1;
+}
+
+int main(int argc, char *argv[]) {
+    process_command_line_args(argc, argv);
+    if ((trace_file != NULL ? load_trace() : load_captures()) < 0)
+        exit(EXIT_FAILURE);
+    if (obs_packet_size < MIN_PACKET_SIZE) {
+        fprintf(stderr, "fec_whatif: Invalid packet size %u of the capture\n", obs_packet_size);
+        exit(EXIT_FAILURE);
+    }
+    if (phy_rate_mbps <= 0)
+        phy_rate_mbps = 24;
+    fec_init();
+    print_trace_summary();
+
+    num_configs = (unsigned int) (num_data_counts * num_fec_counts * num_packet_sizes * num_depths);
+    configs = calloc(num_configs, sizeof(whatif_config_t));
+    results = calloc(num_configs, sizeof(whatif_result_t));
+    if (configs == NULL || results == NULL) {
+        perror("fec_whatif: Could not allocate sweep");
+        exit(EXIT_FAILURE);
+    }
+    unsigned int c = 0;
+    for (int k = 0; k < num_data_counts; k++)
+        for (int m = 0; m < num_fec_counts; m++)
+            for (int s = 0; s < num_packet_sizes; s++)
+                for (int d = 0; d < num_depths; d++)
+                    configs[c++] = (whatif_config_t) {data_counts[k], fec_counts[m], packet_sizes[s], depths[d]};
+
+    uint64_t start = now_ns();
+    pthread_t threads[num_threads];
+    int started = 0;
+    for (int t = 0; t < num_threads; t++) {
+        if (pthread_create(&threads[t], NULL, sweep_worker, (void *) (uintptr_t) t) != 0) {
+            perror("fec_whatif: Could not start worker thread");
+            break;
+        }
+        started++;
+    }
+    if (started == 0)
+        sweep_worker(NULL);
+    for (int t = 0; t < started; t++)
+        pthread_join(threads[t], NULL);
+    fprintf(stderr, "fec_whatif: Simulated %u configurations in %.2f s\n", num_configs, (now_ns() - start) / 1e9);
+
+    print_results();
+    print_suggestion();
+    unsigned int decode_errors = 0;
+    for (c = 0; c < num_configs; c++)
+        decode_errors += results[c].decode_errors;
+    if (out != stdout)
+        fclose(out);
+    free(configs);
+    free(results);
+    free(trace);
+    return decode_errors == 0 ? 0 : 1;
+}
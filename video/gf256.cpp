@@ -27,6 +27,8 @@
     POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include "gf256.h"
 
@@ -37,6 +39,15 @@
 #include <linux/auxvec.h>
 #endif
 
+// Compiles a single function for the given instruction set (x86). The library
+// itself is built for the baseline ISA and only runs such functions if the CPU
+// supports them
+#if defined(__GNUC__) || defined(__clang__)
+    #define GF256_TARGET(isa) __attribute__((target(isa)))
+#else
+    #define GF256_TARGET(isa)
+#endif
+
 //------------------------------------------------------------------------------
 // Workaround for ARMv7 that doesn't provide vqtbl1_*
 // This comes from linux-raid (https://www.spinics.net/lists/raid/msg58403.html)
@@ -204,15 +215,30 @@ static bool CpuHasNeon64 = false;   // And we don't have ASIMD
 
 #ifdef GF256_TRY_AVX2
 static bool CpuHasAVX2 = false;
+static bool UseAVX2 = false; // Add operations use AVX2, set when an AVX2 multiply kernel got selected
+#endif
+#ifdef GF256_TRY_AVX512
+static bool CpuHasAVX512 = false;
+#endif
+#ifdef GF256_TRY_GFNI
+static bool CpuHasGFNI = false;     // GFNI usable with 256-bit vectors
+static bool CpuHasGFNI512 = false;  // GFNI usable with 512-bit vectors
 #endif
 static bool CpuHasSSSE3 = false;
 
-#define CPUID_EBX_AVX2    0x00000020
-#define CPUID_ECX_SSSE3   0x00000200
+#define CPUID_EBX_AVX2      0x00000020
+#define CPUID_EBX_AVX512F   0x00010000
+#define CPUID_EBX_AVX512BW  0x40000000
+#define CPUID_ECX_SSSE3     0x00000200
+#define CPUID_ECX_GFNI      0x00000100
+#define CPUID_ECX_OSXSAVE   0x08000000
+
+#define XCR0_AVX_STATE      0x00000006 // XMM + YMM registers saved by the OS
+#define XCR0_AVX512_STATE   0x000000e0 // opmask + ZMM registers saved by the OS
 
 static void _cpuid(unsigned int cpu_info[4U], const unsigned int cpu_info_type) {
 #if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_AMD64) || defined(_M_IX86))
-    __cpuid((int *) cpu_info, cpu_info_type);
+    __cpuidex((int *) cpu_info, cpu_info_type, 0);
 #else //if defined(HAVE_CPUID)
     cpu_info[0] = cpu_info[1] = cpu_info[2] = cpu_info[3] = 0;
 # ifdef __i386__
@@ -246,6 +272,17 @@ static void _cpuid(unsigned int cpu_info[4U], const unsigned int cpu_info_type)
 #endif
 }
 
+// Reads the XCR0 register: Tells which register sets the OS saves on context switches
+static uint64_t _xgetbv0() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ __volatile__ (".byte 0x0f, 0x01, 0xd0" : "=a" (eax), "=d" (edx) : "c" (0U));
+    return ((uint64_t) edx << 32) | eax;
+#endif
+}
+
 #else
 #if defined(LINUX_ARM)
 static void checkLinuxARMNeonCapabilities( bool& cpuHasNeon )
@@ -302,12 +339,29 @@ static void gf256_architecture_init() {
 #if !defined(GF256_TARGET_MOBILE)
     unsigned int cpu_info[4];
 
+    _cpuid(cpu_info, 0);
+    const unsigned int max_leaf = cpu_info[0];
+
     _cpuid(cpu_info, 1);
     CpuHasSSSE3 = ((cpu_info[2] & CPUID_ECX_SSSE3) != 0);
 
 #if defined(GF256_TRY_AVX2)
-    _cpuid(cpu_info, 7);
-    CpuHasAVX2 = ((cpu_info[1] & CPUID_EBX_AVX2) != 0);
+    // AVX registers can only be used if the OS saves them
+    const uint64_t xcr0 = (cpu_info[2] & CPUID_ECX_OSXSAVE) ? _xgetbv0() : 0;
+    if (max_leaf >= 7 && (xcr0 & XCR0_AVX_STATE) == XCR0_AVX_STATE) {
+        _cpuid(cpu_info, 7);
+        CpuHasAVX2 = ((cpu_info[1] & CPUID_EBX_AVX2) != 0);
+# if defined(GF256_TRY_AVX512)
+        CpuHasAVX512 = CpuHasAVX2 && (xcr0 & XCR0_AVX512_STATE) == XCR0_AVX512_STATE &&
+                       (cpu_info[1] & CPUID_EBX_AVX512F) != 0 && (cpu_info[1] & CPUID_EBX_AVX512BW) != 0;
+# endif
+# if defined(GF256_TRY_GFNI)
+        CpuHasGFNI = CpuHasAVX2 && (cpu_info[2] & CPUID_ECX_GFNI) != 0;
+        CpuHasGFNI512 = CpuHasGFNI && CpuHasAVX512;
+# endif
+    }
+#else
+    (void) max_leaf;
 #endif // GF256_TRY_AVX2
 
     // When AVX2 and SSSE3 are unavailable, Siamese takes 4x longer to decode
@@ -550,13 +604,26 @@ static void gf256_mul_mem_init() {
         _mm_storeu_si128(GF256Ctx.MM128.TABLE_LO_Y + y, table_lo);
         _mm_storeu_si128(GF256Ctx.MM128.TABLE_HI_Y + y, table_hi);
 # ifdef GF256_TRY_AVX2
-        if (CpuHasAVX2) {
-            const GF256_M256 table_lo2 = _mm256_broadcastsi128_si256(table_lo);
-            const GF256_M256 table_hi2 = _mm256_broadcastsi128_si256(table_hi);
-            _mm256_storeu_si256(GF256Ctx.MM256.TABLE_LO_Y + y, table_lo2);
-            _mm256_storeu_si256(GF256Ctx.MM256.TABLE_HI_Y + y, table_hi2);
-        }
+        // Same table in both 128-bit lanes. Plain copies: This code must not require AVX2
+        uint8_t *lo2 = reinterpret_cast<uint8_t *>(GF256Ctx.MM256.TABLE_LO_Y + y);
+        uint8_t *hi2 = reinterpret_cast<uint8_t *>(GF256Ctx.MM256.TABLE_HI_Y + y);
+        memcpy(lo2, lo, 16);
+        memcpy(lo2 + 16, lo, 16);
+        memcpy(hi2, hi, 16);
+        memcpy(hi2 + 16, hi, 16);
 # endif // GF256_TRY_AVX2
+# ifdef GF256_TRY_GFNI
+        // Multiplication by y is linear over GF(2): Input bit j contributes y * 2^j.
+        // GF2P8AFFINEQB computes result bit i as parity(x & matrix byte [7 - i])
+        uint64_t matrix = 0;
+        for (unsigned i = 0; i < 8; ++i) {
+            unsigned row = 0;
+            for (unsigned j = 0; j < 8; ++j)
+                row |= ((gf256_mul(static_cast<uint8_t>(1 << j), static_cast<uint8_t>(y)) >> i) & 1) << j;
+            matrix |= (uint64_t) row << (8 * (7 - i));
+        }
+        GF256Ctx.GFNI_MATRIX[y] = matrix;
+# endif // GF256_TRY_GFNI
 #endif // GF256_TARGET_MOBILE
     }
 }
@@ -565,6 +632,8 @@ static void gf256_mul_mem_init() {
 //------------------------------------------------------------------------------
 // Initialization
 
+static bool gf256_kernel_init();
+
 static unsigned char kLittleEndianTestData[4] = {4, 3, 2, 1};
 
 union UnionType {
@@ -599,6 +668,9 @@ extern "C" int gf256_init_(int version) {
     gf256_sqr_init();
     gf256_mul_mem_init();
 
+    if (!gf256_kernel_init())
+        return -3; // No multiply kernel passed its self-test
+
     if (!gf256_self_test())
         return -3; // Self-test failed (perhaps untested configuration)
 
@@ -609,6 +681,97 @@ extern "C" int gf256_init_(int version) {
 //------------------------------------------------------------------------------
 // Operations
 
+#if defined(GF256_TRY_AVX2)
+// AVX2 parts of the XOR operations. Kept in separate functions so only they get compiled for AVX2.
+// They advance the pointers and byte count passed in by the amount they processed.
+
+GF256_TARGET("avx2")
+static void gf256_add_mem_avx2(GF256_M128 *GF256_RESTRICT &x16, const GF256_M128 *GF256_RESTRICT &y16, int &bytes) {
+    GF256_M256 *GF256_RESTRICT x32 = reinterpret_cast<GF256_M256 *>(x16);
+    const GF256_M256 *GF256_RESTRICT y32 = reinterpret_cast<const GF256_M256 *>(y16);
+
+    while (bytes >= 128) {
+        GF256_M256 x0 = _mm256_loadu_si256(x32);
+        GF256_M256 y0 = _mm256_loadu_si256(y32);
+        x0 = _mm256_xor_si256(x0, y0);
+        GF256_M256 x1 = _mm256_loadu_si256(x32 + 1);
+        GF256_M256 y1 = _mm256_loadu_si256(y32 + 1);
+        x1 = _mm256_xor_si256(x1, y1);
+        GF256_M256 x2 = _mm256_loadu_si256(x32 + 2);
+        GF256_M256 y2 = _mm256_loadu_si256(y32 + 2);
+        x2 = _mm256_xor_si256(x2, y2);
+        GF256_M256 x3 = _mm256_loadu_si256(x32 + 3);
+        GF256_M256 y3 = _mm256_loadu_si256(y32 + 3);
+        x3 = _mm256_xor_si256(x3, y3);
+
+        _mm256_storeu_si256(x32, x0);
+        _mm256_storeu_si256(x32 + 1, x1);
+        _mm256_storeu_si256(x32 + 2, x2);
+        _mm256_storeu_si256(x32 + 3, x3);
+
+        bytes -= 128, x32 += 4, y32 += 4;
+    }
+
+    // Handle multiples of 32 bytes
+    while (bytes >= 32) {
+        // x[i] = x[i] xor y[i]
+        _mm256_storeu_si256(x32,
+                            _mm256_xor_si256(
+                                    _mm256_loadu_si256(x32),
+                                    _mm256_loadu_si256(y32)));
+
+        bytes -= 32, ++x32, ++y32;
+    }
+
+    x16 = reinterpret_cast<GF256_M128 *>(x32);
+    y16 = reinterpret_cast<const GF256_M128 *>(y32);
+}
+
+GF256_TARGET("avx2")
+static void gf256_add2_mem_avx2(GF256_M128 *GF256_RESTRICT &z16, const GF256_M128 *GF256_RESTRICT &x16,
+                                const GF256_M128 *GF256_RESTRICT &y16, int &bytes) {
+    GF256_M256 *GF256_RESTRICT z32 = reinterpret_cast<GF256_M256 *>(z16);
+    const GF256_M256 *GF256_RESTRICT x32 = reinterpret_cast<const GF256_M256 *>(x16);
+    const GF256_M256 *GF256_RESTRICT y32 = reinterpret_cast<const GF256_M256 *>(y16);
+
+    const unsigned count = bytes / 32;
+    for (unsigned i = 0; i < count; ++i) {
+        _mm256_storeu_si256(z32 + i,
+                            _mm256_xor_si256(
+                                    _mm256_loadu_si256(z32 + i),
+                                    _mm256_xor_si256(
+                                            _mm256_loadu_si256(x32 + i),
+                                            _mm256_loadu_si256(y32 + i))));
+    }
+
+    bytes -= count * 32;
+    z16 = reinterpret_cast<GF256_M128 *>(z32 + count);
+    x16 = reinterpret_cast<const GF256_M128 *>(x32 + count);
+    y16 = reinterpret_cast<const GF256_M128 *>(y32 + count);
+}
+
+GF256_TARGET("avx2")
+static void gf256_addset_mem_avx2(GF256_M128 *GF256_RESTRICT &z16, const GF256_M128 *GF256_RESTRICT &x16,
+                                  const GF256_M128 *GF256_RESTRICT &y16, int &bytes) {
+    GF256_M256 *GF256_RESTRICT z32 = reinterpret_cast<GF256_M256 *>(z16);
+    const GF256_M256 *GF256_RESTRICT x32 = reinterpret_cast<const GF256_M256 *>(x16);
+    const GF256_M256 *GF256_RESTRICT y32 = reinterpret_cast<const GF256_M256 *>(y16);
+
+    const unsigned count = bytes / 32;
+    for (unsigned i = 0; i < count; ++i) {
+        _mm256_storeu_si256(z32 + i,
+                            _mm256_xor_si256(
+                                    _mm256_loadu_si256(x32 + i),
+                                    _mm256_loadu_si256(y32 + i)));
+    }
+
+    bytes -= count * 32;
+    z16 = reinterpret_cast<GF256_M128 *>(z32 + count);
+    x16 = reinterpret_cast<const GF256_M128 *>(x32 + count);
+    y16 = reinterpret_cast<const GF256_M128 *>(y32 + count);
+}
+#endif // GF256_TRY_AVX2
+
 extern "C" void gf256_add_mem(void *GF256_RESTRICT vx,
                               const void *GF256_RESTRICT vy, int bytes) {
     GF256_M128 *GF256_RESTRICT x16 = reinterpret_cast<GF256_M128 *>(vx);
@@ -666,46 +829,9 @@ extern "C" void gf256_add_mem(void *GF256_RESTRICT vx,
     }
 #else // GF256_TARGET_MOBILE
 # if defined(GF256_TRY_AVX2)
-    if (CpuHasAVX2) {
-        GF256_M256 *GF256_RESTRICT x32 = reinterpret_cast<GF256_M256 *>(x16);
-        const GF256_M256 *GF256_RESTRICT y32 = reinterpret_cast<const GF256_M256 *>(y16);
-
-        while (bytes >= 128) {
-            GF256_M256 x0 = _mm256_loadu_si256(x32);
-            GF256_M256 y0 = _mm256_loadu_si256(y32);
-            x0 = _mm256_xor_si256(x0, y0);
-            GF256_M256 x1 = _mm256_loadu_si256(x32 + 1);
-            GF256_M256 y1 = _mm256_loadu_si256(y32 + 1);
-            x1 = _mm256_xor_si256(x1, y1);
-            GF256_M256 x2 = _mm256_loadu_si256(x32 + 2);
-            GF256_M256 y2 = _mm256_loadu_si256(y32 + 2);
-            x2 = _mm256_xor_si256(x2, y2);
-            GF256_M256 x3 = _mm256_loadu_si256(x32 + 3);
-            GF256_M256 y3 = _mm256_loadu_si256(y32 + 3);
-            x3 = _mm256_xor_si256(x3, y3);
-
-            _mm256_storeu_si256(x32, x0);
-            _mm256_storeu_si256(x32 + 1, x1);
-            _mm256_storeu_si256(x32 + 2, x2);
-            _mm256_storeu_si256(x32 + 3, x3);
-
-            bytes -= 128, x32 += 4, y32 += 4;
-        }
-
-        // Handle multiples of 32 bytes
-        while (bytes >= 32) {
-            // x[i] = x[i] xor y[i]
-            _mm256_storeu_si256(x32,
-                                _mm256_xor_si256(
-                                        _mm256_loadu_si256(x32),
-                                        _mm256_loadu_si256(y32)));
-
-            bytes -= 32, ++x32, ++y32;
-        }
-
-        x16 = reinterpret_cast<GF256_M128 *>(x32);
-        y16 = reinterpret_cast<const GF256_M128 *>(y32);
-    } else
+    if (UseAVX2)
+        gf256_add_mem_avx2(x16, y16, bytes);
+    else
 # endif // GF256_TRY_AVX2
     {
         while (bytes >= 64) {
@@ -822,26 +948,8 @@ extern "C" void gf256_add2_mem(void *GF256_RESTRICT vz, const void *GF256_RESTRI
     }
 #else // GF256_TARGET_MOBILE
 # if defined(GF256_TRY_AVX2)
-    if (CpuHasAVX2) {
-        GF256_M256 *GF256_RESTRICT z32 = reinterpret_cast<GF256_M256 *>(z16);
-        const GF256_M256 *GF256_RESTRICT x32 = reinterpret_cast<const GF256_M256 *>(x16);
-        const GF256_M256 *GF256_RESTRICT y32 = reinterpret_cast<const GF256_M256 *>(y16);
-
-        const unsigned count = bytes / 32;
-        for (unsigned i = 0; i < count; ++i) {
-            _mm256_storeu_si256(z32 + i,
-                                _mm256_xor_si256(
-                                        _mm256_loadu_si256(z32 + i),
-                                        _mm256_xor_si256(
-                                                _mm256_loadu_si256(x32 + i),
-                                                _mm256_loadu_si256(y32 + i))));
-        }
-
-        bytes -= count * 32;
-        z16 = reinterpret_cast<GF256_M128 *>(z32 + count);
-        x16 = reinterpret_cast<const GF256_M128 *>(x32 + count);
-        y16 = reinterpret_cast<const GF256_M128 *>(y32 + count);
-    }
+    if (UseAVX2)
+        gf256_add2_mem_avx2(z16, x16, y16, bytes);
 # endif // GF256_TRY_AVX2
 
     // Handle multiples of 16 bytes
@@ -955,24 +1063,9 @@ extern "C" void gf256_addset_mem(void *GF256_RESTRICT vz, const void *GF256_REST
     }
 #else // GF256_TARGET_MOBILE
 # if defined(GF256_TRY_AVX2)
-    if (CpuHasAVX2) {
-        GF256_M256 *GF256_RESTRICT z32 = reinterpret_cast<GF256_M256 *>(z16);
-        const GF256_M256 *GF256_RESTRICT x32 = reinterpret_cast<const GF256_M256 *>(x16);
-        const GF256_M256 *GF256_RESTRICT y32 = reinterpret_cast<const GF256_M256 *>(y16);
-
-        const unsigned count = bytes / 32;
-        for (unsigned i = 0; i < count; ++i) {
-            _mm256_storeu_si256(z32 + i,
-                                _mm256_xor_si256(
-                                        _mm256_loadu_si256(x32 + i),
-                                        _mm256_loadu_si256(y32 + i)));
-        }
-
-        bytes -= count * 32;
-        z16 = reinterpret_cast<GF256_M128 *>(z32 + count);
-        x16 = reinterpret_cast<const GF256_M128 *>(x32 + count);
-        y16 = reinterpret_cast<const GF256_M128 *>(y32 + count);
-    } else
+    if (UseAVX2)
+        gf256_addset_mem_avx2(z16, x16, y16, bytes);
+    else
 # endif // GF256_TRY_AVX2
     {
         // Handle multiples of 64 bytes
@@ -1043,103 +1136,82 @@ extern "C" void gf256_addset_mem(void *GF256_RESTRICT vz, const void *GF256_REST
     }
 }
 
-extern "C" void gf256_mul_mem(void *GF256_RESTRICT vz, const void *GF256_RESTRICT vx, uint8_t y, int bytes) {
-    // Use a single if-statement to handle special cases
-    if (y <= 1) {
-        if (y == 0)
-            memset(vz, 0, bytes);
-        else if (vz != vx)
-            memcpy(vz, vx, bytes);
-        return;
-    }
-
-    GF256_M128 *GF256_RESTRICT z16 = reinterpret_cast<GF256_M128 *>(vz);
-    const GF256_M128 *GF256_RESTRICT x16 = reinterpret_cast<const GF256_M128 *>(vx);
+//------------------------------------------------------------------------------
+// Multiply Kernels
+//
+// The bulk multiply operations are implemented once per instruction set. All
+// kernels get compiled into the library (on x86 with per-function target
+// attributes, so no -mssse3/-mavx2 compiler flags are required) and gf256_init()
+// selects the fastest one the CPU supports and that passes its self-test.
+// The environment variable GF256_KERNEL overrides the selection.
+//
+// Every kernel provides:
+//   MulMem:         z[] = x[] * y
+//   MulAddMem:      z[] += x[] * y
+//   MulAddMulti[i]: z[r][] += x[] * y[r] for N = 2 * (i + 1) rows in a single pass
+//                   over x[]. Returns the number of bytes processed, the remaining
+//                   bytes (less than a vector) are done with MulAddMem.
+// All of them work for any y (including 0 and 1) and any number of bytes.
+
+// Local copy of the destination pointers: Stores to z[] can then not alias the pointer array
+template<int N>
+static GF256_FORCE_INLINE void gf256_copy_rows(uint8_t *(&z)[N], void *const *vz) {
+    for (int r = 0; r < N; ++r)
+        z[r] = reinterpret_cast<uint8_t *>(vz[r]);
+}
 
-#if defined(GF256_TARGET_MOBILE)
-#if defined(GF256_TRY_NEON)
-    if (bytes >= 16 && CpuHasNeon)
-    {
-        // Partial product tables; see above
-        const GF256_M128 table_lo_y = vld1q_u8((uint8_t*)(GF256Ctx.MM128.TABLE_LO_Y + y));
-        const GF256_M128 table_hi_y = vld1q_u8((uint8_t*)(GF256Ctx.MM128.TABLE_HI_Y + y));
+//------------------------------------------------------------------------------
+// Scalar Kernel (table lookups, also used for the tails of the SIMD kernels)
 
-        // clr_mask = 0x0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f
-        const GF256_M128 clr_mask = vdupq_n_u8(0x0f);
+static void gf256_mul_mem_scalar(void *GF256_RESTRICT vz, const void *GF256_RESTRICT vx, uint8_t y, int bytes) {
+    uint8_t *GF256_RESTRICT z1 = reinterpret_cast<uint8_t *>(vz);
+    const uint8_t *GF256_RESTRICT x1 = reinterpret_cast<const uint8_t *>(vx);
+    const uint8_t *GF256_RESTRICT table = GF256Ctx.GF256_MUL_TABLE + ((unsigned) y << 8);
 
-        // Handle multiples of 16 bytes
-        do
-        {
-            // See above comments for details
-            GF256_M128 x0 = vld1q_u8((uint8_t*)x16);
-            GF256_M128 l0 = vandq_u8(x0, clr_mask);
-            x0 = vshrq_n_u8(x0, 4);
-            GF256_M128 h0 = vandq_u8(x0, clr_mask);
-            l0 = vqtbl1q_u8(table_lo_y, l0);
-            h0 = vqtbl1q_u8(table_hi_y, h0);
-            vst1q_u8((uint8_t*)z16, veorq_u8(l0, h0));
+    // Handle blocks of 8 bytes
+    while (bytes >= 8) {
+        uint64_t *GF256_RESTRICT z8 = reinterpret_cast<uint64_t *>(z1);
+        uint64_t word = table[x1[0]];
+        word |= (uint64_t) table[x1[1]] << 8;
+        word |= (uint64_t) table[x1[2]] << 16;
+        word |= (uint64_t) table[x1[3]] << 24;
+        word |= (uint64_t) table[x1[4]] << 32;
+        word |= (uint64_t) table[x1[5]] << 40;
+        word |= (uint64_t) table[x1[6]] << 48;
+        word |= (uint64_t) table[x1[7]] << 56;
+        *z8 = word;
 
-            bytes -= 16, ++x16, ++z16;
-        } while (bytes >= 16);
+        bytes -= 8, x1 += 8, z1 += 8;
     }
-#endif
-#else
-# if defined(GF256_TRY_AVX2)
-    if (bytes >= 32 && CpuHasAVX2) {
-        // Partial product tables; see above
-        const GF256_M256 table_lo_y = _mm256_loadu_si256(GF256Ctx.MM256.TABLE_LO_Y + y);
-        const GF256_M256 table_hi_y = _mm256_loadu_si256(GF256Ctx.MM256.TABLE_HI_Y + y);
-
-        // clr_mask = 0x0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f
-        const GF256_M256 clr_mask = _mm256_set1_epi8(0x0f);
-
-        GF256_M256 *GF256_RESTRICT z32 = reinterpret_cast<GF256_M256 *>(vz);
-        const GF256_M256 *GF256_RESTRICT x32 = reinterpret_cast<const GF256_M256 *>(vx);
-
-        // Handle multiples of 32 bytes
-        do {
-            // See above comments for details
-            GF256_M256 x0 = _mm256_loadu_si256(x32);
-            GF256_M256 l0 = _mm256_and_si256(x0, clr_mask);
-            x0 = _mm256_srli_epi64(x0, 4);
-            GF256_M256 h0 = _mm256_and_si256(x0, clr_mask);
-            l0 = _mm256_shuffle_epi8(table_lo_y, l0);
-            h0 = _mm256_shuffle_epi8(table_hi_y, h0);
-            _mm256_storeu_si256(z32, _mm256_xor_si256(l0, h0));
-
-            bytes -= 32, ++x32, ++z32;
-        } while (bytes >= 32);
 
-        z16 = reinterpret_cast<GF256_M128 *>(z32);
-        x16 = reinterpret_cast<const GF256_M128 *>(x32);
+    // Handle a block of 4 bytes
+    const int four = bytes & 4;
+    if (four) {
+        uint32_t *GF256_RESTRICT z4 = reinterpret_cast<uint32_t *>(z1);
+        uint32_t word = table[x1[0]];
+        word |= (uint32_t) table[x1[1]] << 8;
+        word |= (uint32_t) table[x1[2]] << 16;
+        word |= (uint32_t) table[x1[3]] << 24;
+        *z4 = word;
     }
-# endif // GF256_TRY_AVX2
-    if (bytes >= 16 && CpuHasSSSE3) {
-        // Partial product tables; see above
-        const GF256_M128 table_lo_y = _mm_loadu_si128(GF256Ctx.MM128.TABLE_LO_Y + y);
-        const GF256_M128 table_hi_y = _mm_loadu_si128(GF256Ctx.MM128.TABLE_HI_Y + y);
-
-        // clr_mask = 0x0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f
-        const GF256_M128 clr_mask = _mm_set1_epi8(0x0f);
-
-        // Handle multiples of 16 bytes
-        do {
-            // See above comments for details
-            GF256_M128 x0 = _mm_loadu_si128(x16);
-            GF256_M128 l0 = _mm_and_si128(x0, clr_mask);
-            x0 = _mm_srli_epi64(x0, 4);
-            GF256_M128 h0 = _mm_and_si128(x0, clr_mask);
-            l0 = _mm_shuffle_epi8(table_lo_y, l0);
-            h0 = _mm_shuffle_epi8(table_hi_y, h0);
-            _mm_storeu_si128(z16, _mm_xor_si128(l0, h0));
 
-            bytes -= 16, ++x16, ++z16;
-        } while (bytes >= 16);
+    // Handle single bytes
+    const int offset = four;
+    switch (bytes & 3) {
+        case 3:
+            z1[offset + 2] = table[x1[offset + 2]];
+        case 2:
+            z1[offset + 1] = table[x1[offset + 1]];
+        case 1:
+            z1[offset] = table[x1[offset]];
+        default:
+            break;
     }
-#endif
+}
 
-    uint8_t *GF256_RESTRICT z1 = reinterpret_cast<uint8_t *>(z16);
-    const uint8_t *GF256_RESTRICT x1 = reinterpret_cast<const uint8_t *>(x16);
+static void gf256_muladd_mem_scalar(void *GF256_RESTRICT vz, uint8_t y, const void *GF256_RESTRICT vx, int bytes) {
+    uint8_t *GF256_RESTRICT z1 = reinterpret_cast<uint8_t *>(vz);
+    const uint8_t *GF256_RESTRICT x1 = reinterpret_cast<const uint8_t *>(vx);
     const uint8_t *GF256_RESTRICT table = GF256Ctx.GF256_MUL_TABLE + ((unsigned) y << 8);
 
     // Handle blocks of 8 bytes
@@ -1153,7 +1225,7 @@ extern "C" void gf256_mul_mem(void *GF256_RESTRICT vz, const void *GF256_RESTRIC
         word |= (uint64_t) table[x1[5]] << 40;
         word |= (uint64_t) table[x1[6]] << 48;
         word |= (uint64_t) table[x1[7]] << 56;
-        *z8 = word;
+        *z8 ^= word;
 
         bytes -= 8, x1 += 8, z1 += 8;
     }
@@ -1166,38 +1238,72 @@ extern "C" void gf256_mul_mem(void *GF256_RESTRICT vz, const void *GF256_RESTRIC
         word |= (uint32_t) table[x1[1]] << 8;
         word |= (uint32_t) table[x1[2]] << 16;
         word |= (uint32_t) table[x1[3]] << 24;
-        *z4 = word;
+        *z4 ^= word;
     }
 
     // Handle single bytes
     const int offset = four;
     switch (bytes & 3) {
         case 3:
-            z1[offset + 2] = table[x1[offset + 2]];
+            z1[offset + 2] ^= table[x1[offset + 2]];
         case 2:
-            z1[offset + 1] = table[x1[offset + 1]];
+            z1[offset + 1] ^= table[x1[offset + 1]];
         case 1:
-            z1[offset] = table[x1[offset]];
+            z1[offset] ^= table[x1[offset]];
         default:
             break;
     }
 }
 
-extern "C" void gf256_muladd_mem(void *GF256_RESTRICT vz, uint8_t y,
-                                 const void *GF256_RESTRICT vx, int bytes) {
-    // Use a single if-statement to handle special cases
-    if (y <= 1) {
-        if (y == 1)
-            gf256_add_mem(vz, vx, bytes);
-        return;
+// Table lookups gain nothing from sharing the loads of x[]: All rows are done by gf256_muladd_mem_scalar()
+template<int N>
+static int gf256_muladd_multi_scalar(void *const *, const uint8_t *, const uint8_t *GF256_RESTRICT, int) {
+    return 0;
+}
+
+#if defined(GF256_TRY_NEON)
+//------------------------------------------------------------------------------
+// NEON Kernel
+
+static void gf256_mul_mem_neon(void *GF256_RESTRICT vz, const void *GF256_RESTRICT vx, uint8_t y, int bytes)
+{
+    GF256_M128 *GF256_RESTRICT z16 = reinterpret_cast<GF256_M128 *>(vz);
+    const GF256_M128 *GF256_RESTRICT x16 = reinterpret_cast<const GF256_M128 *>(vx);
+
+    if (bytes >= 16)
+    {
+        // Partial product tables; see above
+        const GF256_M128 table_lo_y = vld1q_u8((uint8_t*)(GF256Ctx.MM128.TABLE_LO_Y + y));
+        const GF256_M128 table_hi_y = vld1q_u8((uint8_t*)(GF256Ctx.MM128.TABLE_HI_Y + y));
+
+        // clr_mask = 0x0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f
+        const GF256_M128 clr_mask = vdupq_n_u8(0x0f);
+
+        // Handle multiples of 16 bytes
+        do
+        {
+            // See above comments for details
+            GF256_M128 x0 = vld1q_u8((uint8_t*)x16);
+            GF256_M128 l0 = vandq_u8(x0, clr_mask);
+            x0 = vshrq_n_u8(x0, 4);
+            GF256_M128 h0 = vandq_u8(x0, clr_mask);
+            l0 = vqtbl1q_u8(table_lo_y, l0);
+            h0 = vqtbl1q_u8(table_hi_y, h0);
+            vst1q_u8((uint8_t*)z16, veorq_u8(l0, h0));
+
+            bytes -= 16, ++x16, ++z16;
+        } while (bytes >= 16);
     }
 
+    gf256_mul_mem_scalar(z16, x16, y, bytes);
+}
+
+static void gf256_muladd_mem_neon(void *GF256_RESTRICT vz, uint8_t y, const void *GF256_RESTRICT vx, int bytes)
+{
     GF256_M128 *GF256_RESTRICT z16 = reinterpret_cast<GF256_M128 *>(vz);
     const GF256_M128 *GF256_RESTRICT x16 = reinterpret_cast<const GF256_M128 *>(vx);
 
-#if defined(GF256_TARGET_MOBILE)
-#if defined(GF256_TRY_NEON)
-    if (bytes >= 16 && CpuHasNeon)
+    if (bytes >= 16)
     {
         // Partial product tables; see above
         const GF256_M128 table_lo_y = vld1q_u8((uint8_t*)(GF256Ctx.MM128.TABLE_LO_Y + y));
@@ -1224,69 +1330,82 @@ extern "C" void gf256_muladd_mem(void *GF256_RESTRICT vz, uint8_t y,
             bytes -= 16, ++x16, ++z16;
         } while (bytes >= 16);
     }
-#endif
-#else // GF256_TARGET_MOBILE
-# if defined(GF256_TRY_AVX2)
-    if (bytes >= 32 && CpuHasAVX2) {
-        // Partial product tables; see above
-        const GF256_M256 table_lo_y = _mm256_loadu_si256(GF256Ctx.MM256.TABLE_LO_Y + y);
-        const GF256_M256 table_hi_y = _mm256_loadu_si256(GF256Ctx.MM256.TABLE_HI_Y + y);
 
-        // clr_mask = 0x0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f
-        const GF256_M256 clr_mask = _mm256_set1_epi8(0x0f);
+    gf256_muladd_mem_scalar(z16, y, x16, bytes);
+}
 
-        GF256_M256 *GF256_RESTRICT z32 = reinterpret_cast<GF256_M256 *>(z16);
-        const GF256_M256 *GF256_RESTRICT x32 = reinterpret_cast<const GF256_M256 *>(x16);
+template<int N>
+static int gf256_muladd_multi_neon(void *const *vz, const uint8_t *y, const uint8_t *GF256_RESTRICT x, int bytes)
+{
+    uint8_t *z[N];
+    gf256_copy_rows<N>(z, vz);
 
-        // On my Reed Solomon codec, the encoder unit test runs in 640 usec without and 550 usec with the optimization (86% of the original time)
-        const unsigned count = bytes / 64;
-        for (unsigned i = 0; i < count; ++i) {
-            // See above comments for details
-            GF256_M256 x0 = _mm256_loadu_si256(x32 + i * 2);
-            GF256_M256 l0 = _mm256_and_si256(x0, clr_mask);
-            x0 = _mm256_srli_epi64(x0, 4);
-            const GF256_M256 z0 = _mm256_loadu_si256(z32 + i * 2);
-            GF256_M256 h0 = _mm256_and_si256(x0, clr_mask);
-            l0 = _mm256_shuffle_epi8(table_lo_y, l0);
-            h0 = _mm256_shuffle_epi8(table_hi_y, h0);
-            const GF256_M256 p0 = _mm256_xor_si256(l0, h0);
-            _mm256_storeu_si256(z32 + i * 2, _mm256_xor_si256(p0, z0));
+    GF256_M128 table_lo_y[N], table_hi_y[N];
+    for (int r = 0; r < N; ++r)
+    {
+        table_lo_y[r] = vld1q_u8((uint8_t*)(GF256Ctx.MM128.TABLE_LO_Y + y[r]));
+        table_hi_y[r] = vld1q_u8((uint8_t*)(GF256Ctx.MM128.TABLE_HI_Y + y[r]));
+    }
+    const GF256_M128 clr_mask = vdupq_n_u8(0x0f);
 
-            GF256_M256 x1 = _mm256_loadu_si256(x32 + i * 2 + 1);
-            GF256_M256 l1 = _mm256_and_si256(x1, clr_mask);
-            x1 = _mm256_srli_epi64(x1, 4);
-            const GF256_M256 z1 = _mm256_loadu_si256(z32 + i * 2 + 1);
-            GF256_M256 h1 = _mm256_and_si256(x1, clr_mask);
-            l1 = _mm256_shuffle_epi8(table_lo_y, l1);
-            h1 = _mm256_shuffle_epi8(table_hi_y, h1);
-            const GF256_M256 p1 = _mm256_xor_si256(l1, h1);
-            _mm256_storeu_si256(z32 + i * 2 + 1, _mm256_xor_si256(p1, z1));
+    int offset = 0;
+    for (; offset + 16 <= bytes; offset += 16)
+    {
+        GF256_M128 x0 = vld1q_u8(x + offset);
+        const GF256_M128 l0 = vandq_u8(x0, clr_mask);
+        x0 = (GF256_M128)vshrq_n_u64( (uint64x2_t)x0, 4);
+        const GF256_M128 h0 = vandq_u8(x0, clr_mask);
+        for (int r = 0; r < N; ++r)
+        {
+            const GF256_M128 p0 = veorq_u8(vqtbl1q_u8(table_lo_y[r], l0), vqtbl1q_u8(table_hi_y[r], h0));
+            vst1q_u8(z[r] + offset, veorq_u8(p0, vld1q_u8(z[r] + offset)));
         }
-        bytes -= count * 64;
-        z32 += count * 2;
-        x32 += count * 2;
+    }
+    return offset;
+}
+#endif // GF256_TRY_NEON
 
-        if (bytes >= 32) {
-            GF256_M256 x0 = _mm256_loadu_si256(x32);
-            GF256_M256 l0 = _mm256_and_si256(x0, clr_mask);
-            x0 = _mm256_srli_epi64(x0, 4);
-            GF256_M256 h0 = _mm256_and_si256(x0, clr_mask);
-            l0 = _mm256_shuffle_epi8(table_lo_y, l0);
-            h0 = _mm256_shuffle_epi8(table_hi_y, h0);
-            const GF256_M256 p0 = _mm256_xor_si256(l0, h0);
-            const GF256_M256 z0 = _mm256_loadu_si256(z32);
-            _mm256_storeu_si256(z32, _mm256_xor_si256(p0, z0));
+#if !defined(GF256_TARGET_MOBILE)
+//------------------------------------------------------------------------------
+// SSSE3 Kernel
 
-            bytes -= 32;
-            z32++;
-            x32++;
-        }
+GF256_TARGET("ssse3")
+static void gf256_mul_mem_ssse3(void *GF256_RESTRICT vz, const void *GF256_RESTRICT vx, uint8_t y, int bytes) {
+    GF256_M128 *GF256_RESTRICT z16 = reinterpret_cast<GF256_M128 *>(vz);
+    const GF256_M128 *GF256_RESTRICT x16 = reinterpret_cast<const GF256_M128 *>(vx);
+
+    if (bytes >= 16) {
+        // Partial product tables; see above
+        const GF256_M128 table_lo_y = _mm_loadu_si128(GF256Ctx.MM128.TABLE_LO_Y + y);
+        const GF256_M128 table_hi_y = _mm_loadu_si128(GF256Ctx.MM128.TABLE_HI_Y + y);
+
+        // clr_mask = 0x0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f
+        const GF256_M128 clr_mask = _mm_set1_epi8(0x0f);
+
+        // Handle multiples of 16 bytes
+        do {
+            // See above comments for details
+            GF256_M128 x0 = _mm_loadu_si128(x16);
+            GF256_M128 l0 = _mm_and_si128(x0, clr_mask);
+            x0 = _mm_srli_epi64(x0, 4);
+            GF256_M128 h0 = _mm_and_si128(x0, clr_mask);
+            l0 = _mm_shuffle_epi8(table_lo_y, l0);
+            h0 = _mm_shuffle_epi8(table_hi_y, h0);
+            _mm_storeu_si128(z16, _mm_xor_si128(l0, h0));
 
-        z16 = reinterpret_cast<GF256_M128 *>(z32);
-        x16 = reinterpret_cast<const GF256_M128 *>(x32);
+            bytes -= 16, ++x16, ++z16;
+        } while (bytes >= 16);
     }
-# endif // GF256_TRY_AVX2
-    if (bytes >= 16 && CpuHasSSSE3) {
+
+    gf256_mul_mem_scalar(z16, x16, y, bytes);
+}
+
+GF256_TARGET("ssse3")
+static void gf256_muladd_mem_ssse3(void *GF256_RESTRICT vz, uint8_t y, const void *GF256_RESTRICT vx, int bytes) {
+    GF256_M128 *GF256_RESTRICT z16 = reinterpret_cast<GF256_M128 *>(vz);
+    const GF256_M128 *GF256_RESTRICT x16 = reinterpret_cast<const GF256_M128 *>(vx);
+
+    if (bytes >= 16) {
         // Partial product tables; see above
         const GF256_M128 table_lo_y = _mm_loadu_si128(GF256Ctx.MM128.TABLE_LO_Y + y);
         const GF256_M128 table_hi_y = _mm_loadu_si128(GF256Ctx.MM128.TABLE_HI_Y + y);
@@ -1339,51 +1458,710 @@ extern "C" void gf256_muladd_mem(void *GF256_RESTRICT vz, uint8_t y,
             bytes -= 16, ++x16, ++z16;
         }
     }
+
+    gf256_muladd_mem_scalar(z16, y, x16, bytes);
+}
+
+template<int N>
+GF256_TARGET("ssse3")
+static int gf256_muladd_multi_ssse3(void *const *vz, const uint8_t *y, const uint8_t *GF256_RESTRICT x, int bytes) {
+    uint8_t *z[N];
+    gf256_copy_rows<N>(z, vz);
+
+    GF256_M128 table_lo_y[N], table_hi_y[N];
+    for (int r = 0; r < N; ++r) {
+        table_lo_y[r] = _mm_loadu_si128(GF256Ctx.MM128.TABLE_LO_Y + y[r]);
+        table_hi_y[r] = _mm_loadu_si128(GF256Ctx.MM128.TABLE_HI_Y + y[r]);
+    }
+    const GF256_M128 clr_mask = _mm_set1_epi8(0x0f);
+
+    int offset = 0;
+    for (; offset + 16 <= bytes; offset += 16) {
+        GF256_M128 x0 = _mm_loadu_si128(reinterpret_cast<const GF256_M128 *>(x + offset));
+        const GF256_M128 l0 = _mm_and_si128(x0, clr_mask);
+        x0 = _mm_srli_epi64(x0, 4);
+        const GF256_M128 h0 = _mm_and_si128(x0, clr_mask);
+        for (int r = 0; r < N; ++r) {
+            GF256_M128 *z16 = reinterpret_cast<GF256_M128 *>(z[r] + offset);
+            const GF256_M128 p0 = _mm_xor_si128(_mm_shuffle_epi8(table_lo_y[r], l0),
+                                                _mm_shuffle_epi8(table_hi_y[r], h0));
+            _mm_storeu_si128(z16, _mm_xor_si128(p0, _mm_loadu_si128(z16)));
+        }
+    }
+    return offset;
+}
 #endif // GF256_TARGET_MOBILE
 
-    uint8_t *GF256_RESTRICT z1 = reinterpret_cast<uint8_t *>(z16);
-    const uint8_t *GF256_RESTRICT x1 = reinterpret_cast<const uint8_t *>(x16);
-    const uint8_t *GF256_RESTRICT table = GF256Ctx.GF256_MUL_TABLE + ((unsigned) y << 8);
+#if defined(GF256_TRY_AVX2)
+//------------------------------------------------------------------------------
+// AVX2 Kernel
 
-    // Handle blocks of 8 bytes
-    while (bytes >= 8) {
-        uint64_t *GF256_RESTRICT z8 = reinterpret_cast<uint64_t *>(z1);
-        uint64_t word = table[x1[0]];
-        word |= (uint64_t) table[x1[1]] << 8;
-        word |= (uint64_t) table[x1[2]] << 16;
-        word |= (uint64_t) table[x1[3]] << 24;
-        word |= (uint64_t) table[x1[4]] << 32;
-        word |= (uint64_t) table[x1[5]] << 40;
-        word |= (uint64_t) table[x1[6]] << 48;
-        word |= (uint64_t) table[x1[7]] << 56;
-        *z8 ^= word;
+GF256_TARGET("avx2")
+static void gf256_mul_mem_avx2(void *GF256_RESTRICT vz, const void *GF256_RESTRICT vx, uint8_t y, int bytes) {
+    GF256_M256 *GF256_RESTRICT z32 = reinterpret_cast<GF256_M256 *>(vz);
+    const GF256_M256 *GF256_RESTRICT x32 = reinterpret_cast<const GF256_M256 *>(vx);
 
-        bytes -= 8, x1 += 8, z1 += 8;
+    if (bytes >= 32) {
+        // Partial product tables; see above
+        const GF256_M256 table_lo_y = _mm256_loadu_si256(GF256Ctx.MM256.TABLE_LO_Y + y);
+        const GF256_M256 table_hi_y = _mm256_loadu_si256(GF256Ctx.MM256.TABLE_HI_Y + y);
+
+        // clr_mask = 0x0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f
+        const GF256_M256 clr_mask = _mm256_set1_epi8(0x0f);
+
+        // Handle multiples of 32 bytes
+        do {
+            // See above comments for details
+            GF256_M256 x0 = _mm256_loadu_si256(x32);
+            GF256_M256 l0 = _mm256_and_si256(x0, clr_mask);
+            x0 = _mm256_srli_epi64(x0, 4);
+            GF256_M256 h0 = _mm256_and_si256(x0, clr_mask);
+            l0 = _mm256_shuffle_epi8(table_lo_y, l0);
+            h0 = _mm256_shuffle_epi8(table_hi_y, h0);
+            _mm256_storeu_si256(z32, _mm256_xor_si256(l0, h0));
+
+            bytes -= 32, ++x32, ++z32;
+        } while (bytes >= 32);
     }
 
-    // Handle a block of 4 bytes
-    const int four = bytes & 4;
-    if (four) {
-        uint32_t *GF256_RESTRICT z4 = reinterpret_cast<uint32_t *>(z1);
-        uint32_t word = table[x1[0]];
-        word |= (uint32_t) table[x1[1]] << 8;
-        word |= (uint32_t) table[x1[2]] << 16;
-        word |= (uint32_t) table[x1[3]] << 24;
-        *z4 ^= word;
+    // Remaining bytes: SSSE3 for a last 16 byte vector, then scalar
+    gf256_mul_mem_ssse3(z32, x32, y, bytes);
+}
+
+GF256_TARGET("avx2")
+static void gf256_muladd_mem_avx2(void *GF256_RESTRICT vz, uint8_t y, const void *GF256_RESTRICT vx, int bytes) {
+    GF256_M256 *GF256_RESTRICT z32 = reinterpret_cast<GF256_M256 *>(vz);
+    const GF256_M256 *GF256_RESTRICT x32 = reinterpret_cast<const GF256_M256 *>(vx);
+
+    if (bytes >= 32) {
+        // Partial product tables; see above
+        const GF256_M256 table_lo_y = _mm256_loadu_si256(GF256Ctx.MM256.TABLE_LO_Y + y);
+        const GF256_M256 table_hi_y = _mm256_loadu_si256(GF256Ctx.MM256.TABLE_HI_Y + y);
+
+        // clr_mask = 0x0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f
+        const GF256_M256 clr_mask = _mm256_set1_epi8(0x0f);
+
+        // On my Reed Solomon codec, the encoder unit test runs in 640 usec without and 550 usec with the optimization (86% of the original time)
+        const unsigned count = bytes / 64;
+        for (unsigned i = 0; i < count; ++i) {
+            // See above comments for details
+            GF256_M256 x0 = _mm256_loadu_si256(x32 + i * 2);
+            GF256_M256 l0 = _mm256_and_si256(x0, clr_mask);
+            x0 = _mm256_srli_epi64(x0, 4);
+            const GF256_M256 z0 = _mm256_loadu_si256(z32 + i * 2);
+            GF256_M256 h0 = _mm256_and_si256(x0, clr_mask);
+            l0 = _mm256_shuffle_epi8(table_lo_y, l0);
+            h0 = _mm256_shuffle_epi8(table_hi_y, h0);
+            const GF256_M256 p0 = _mm256_xor_si256(l0, h0);
+            _mm256_storeu_si256(z32 + i * 2, _mm256_xor_si256(p0, z0));
+
+            GF256_M256 x1 = _mm256_loadu_si256(x32 + i * 2 + 1);
+            GF256_M256 l1 = _mm256_and_si256(x1, clr_mask);
+            x1 = _mm256_srli_epi64(x1, 4);
+            const GF256_M256 z1 = _mm256_loadu_si256(z32 + i * 2 + 1);
+            GF256_M256 h1 = _mm256_and_si256(x1, clr_mask);
+            l1 = _mm256_shuffle_epi8(table_lo_y, l1);
+            h1 = _mm256_shuffle_epi8(table_hi_y, h1);
+            const GF256_M256 p1 = _mm256_xor_si256(l1, h1);
+            _mm256_storeu_si256(z32 + i * 2 + 1, _mm256_xor_si256(p1, z1));
+        }
+        bytes -= count * 64;
+        z32 += count * 2;
+        x32 += count * 2;
+
+        if (bytes >= 32) {
+            GF256_M256 x0 = _mm256_loadu_si256(x32);
+            GF256_M256 l0 = _mm256_and_si256(x0, clr_mask);
+            x0 = _mm256_srli_epi64(x0, 4);
+            GF256_M256 h0 = _mm256_and_si256(x0, clr_mask);
+            l0 = _mm256_shuffle_epi8(table_lo_y, l0);
+            h0 = _mm256_shuffle_epi8(table_hi_y, h0);
+            const GF256_M256 p0 = _mm256_xor_si256(l0, h0);
+            const GF256_M256 z0 = _mm256_loadu_si256(z32);
+            _mm256_storeu_si256(z32, _mm256_xor_si256(p0, z0));
+
+            bytes -= 32;
+            z32++;
+            x32++;
+        }
     }
 
-    // Handle single bytes
-    const int offset = four;
-    switch (bytes & 3) {
-        case 3:
-            z1[offset + 2] ^= table[x1[offset + 2]];
-        case 2:
-            z1[offset + 1] ^= table[x1[offset + 1]];
-        case 1:
-            z1[offset] ^= table[x1[offset]];
-        default:
-            break;
+    // Remaining bytes: SSSE3 for a last 16 byte vector, then scalar
+    gf256_muladd_mem_ssse3(z32, y, x32, bytes);
+}
+
+template<int N>
+GF256_TARGET("avx2")
+static int gf256_muladd_multi_avx2(void *const *vz, const uint8_t *y, const uint8_t *GF256_RESTRICT x, int bytes) {
+    uint8_t *z[N];
+    gf256_copy_rows<N>(z, vz);
+
+    GF256_M256 table_lo_y[N], table_hi_y[N];
+    for (int r = 0; r < N; ++r) {
+        table_lo_y[r] = _mm256_loadu_si256(GF256Ctx.MM256.TABLE_LO_Y + y[r]);
+        table_hi_y[r] = _mm256_loadu_si256(GF256Ctx.MM256.TABLE_HI_Y + y[r]);
+    }
+    const GF256_M256 clr_mask = _mm256_set1_epi8(0x0f);
+
+    int offset = 0;
+    // Few rows leave enough registers to process two vectors per iteration
+    if (N <= 4) {
+        for (; offset + 64 <= bytes; offset += 64) {
+            GF256_M256 x0 = _mm256_loadu_si256(reinterpret_cast<const GF256_M256 *>(x + offset));
+            GF256_M256 x1 = _mm256_loadu_si256(reinterpret_cast<const GF256_M256 *>(x + offset + 32));
+            const GF256_M256 l0 = _mm256_and_si256(x0, clr_mask);
+            const GF256_M256 l1 = _mm256_and_si256(x1, clr_mask);
+            x0 = _mm256_srli_epi64(x0, 4);
+            x1 = _mm256_srli_epi64(x1, 4);
+            const GF256_M256 h0 = _mm256_and_si256(x0, clr_mask);
+            const GF256_M256 h1 = _mm256_and_si256(x1, clr_mask);
+            for (int r = 0; r < N; ++r) {
+                GF256_M256 *z32 = reinterpret_cast<GF256_M256 *>(z[r] + offset);
+                const GF256_M256 p0 = _mm256_xor_si256(_mm256_shuffle_epi8(table_lo_y[r], l0),
+                                                       _mm256_shuffle_epi8(table_hi_y[r], h0));
+                const GF256_M256 p1 = _mm256_xor_si256(_mm256_shuffle_epi8(table_lo_y[r], l1),
+                                                       _mm256_shuffle_epi8(table_hi_y[r], h1));
+                _mm256_storeu_si256(z32, _mm256_xor_si256(p0, _mm256_loadu_si256(z32)));
+                _mm256_storeu_si256(z32 + 1, _mm256_xor_si256(p1, _mm256_loadu_si256(z32 + 1)));
+            }
+        }
+    }
+    for (; offset + 32 <= bytes; offset += 32) {
+        GF256_M256 x0 = _mm256_loadu_si256(reinterpret_cast<const GF256_M256 *>(x + offset));
+        const GF256_M256 l0 = _mm256_and_si256(x0, clr_mask);
+        x0 = _mm256_srli_epi64(x0, 4);
+        const GF256_M256 h0 = _mm256_and_si256(x0, clr_mask);
+        for (int r = 0; r < N; ++r) {
+            GF256_M256 *z32 = reinterpret_cast<GF256_M256 *>(z[r] + offset);
+            const GF256_M256 p0 = _mm256_xor_si256(_mm256_shuffle_epi8(table_lo_y[r], l0),
+                                                   _mm256_shuffle_epi8(table_hi_y[r], h0));
+            _mm256_storeu_si256(z32, _mm256_xor_si256(p0, _mm256_loadu_si256(z32)));
+        }
+    }
+    return offset;
+}
+#endif // GF256_TRY_AVX2
+
+#if defined(GF256_TRY_AVX512)
+//------------------------------------------------------------------------------
+// AVX-512 Kernel
+//
+// Same nibble table approach with 64 byte vectors. The last partial vector is
+// done with masked loads/stores, these do not touch memory beyond the end.
+
+#define GF256_AVX512_ISA "avx512f,avx512bw"
+
+// GCC 12 warns about _mm512_undefined_epi32() inside its own intrinsics
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+// Mask selecting the first 1..63 bytes of a vector
+static GF256_FORCE_INLINE uint64_t gf256_avx512_tail_mask(int bytes) {
+    return ~0ULL >> (64 - bytes);
+}
+
+GF256_TARGET(GF256_AVX512_ISA)
+static void gf256_mul_mem_avx512(void *GF256_RESTRICT vz, const void *GF256_RESTRICT vx, uint8_t y, int bytes) {
+    uint8_t *GF256_RESTRICT z = reinterpret_cast<uint8_t *>(vz);
+    const uint8_t *GF256_RESTRICT x = reinterpret_cast<const uint8_t *>(vx);
+
+    // Partial product tables; see above
+    const GF256_M512 table_lo_y = _mm512_broadcast_i32x4(_mm_loadu_si128(GF256Ctx.MM128.TABLE_LO_Y + y));
+    const GF256_M512 table_hi_y = _mm512_broadcast_i32x4(_mm_loadu_si128(GF256Ctx.MM128.TABLE_HI_Y + y));
+    const GF256_M512 clr_mask = _mm512_set1_epi8(0x0f);
+
+    int offset = 0;
+    for (; offset + 64 <= bytes; offset += 64) {
+        GF256_M512 x0 = _mm512_loadu_si512(x + offset);
+        const GF256_M512 l0 = _mm512_and_si512(x0, clr_mask);
+        x0 = _mm512_srli_epi64(x0, 4);
+        const GF256_M512 h0 = _mm512_and_si512(x0, clr_mask);
+        _mm512_storeu_si512(z + offset, _mm512_xor_si512(_mm512_shuffle_epi8(table_lo_y, l0),
+                                                         _mm512_shuffle_epi8(table_hi_y, h0)));
+    }
+    if (offset < bytes) {
+        const __mmask64 mask = gf256_avx512_tail_mask(bytes - offset);
+        GF256_M512 x0 = _mm512_maskz_loadu_epi8(mask, x + offset);
+        const GF256_M512 l0 = _mm512_and_si512(x0, clr_mask);
+        x0 = _mm512_srli_epi64(x0, 4);
+        const GF256_M512 h0 = _mm512_and_si512(x0, clr_mask);
+        _mm512_mask_storeu_epi8(z + offset, mask, _mm512_xor_si512(_mm512_shuffle_epi8(table_lo_y, l0),
+                                                                   _mm512_shuffle_epi8(table_hi_y, h0)));
+    }
+}
+
+GF256_TARGET(GF256_AVX512_ISA)
+static void gf256_muladd_mem_avx512(void *GF256_RESTRICT vz, uint8_t y, const void *GF256_RESTRICT vx, int bytes) {
+    uint8_t *GF256_RESTRICT z = reinterpret_cast<uint8_t *>(vz);
+    const uint8_t *GF256_RESTRICT x = reinterpret_cast<const uint8_t *>(vx);
+
+    // Partial product tables; see above
+    const GF256_M512 table_lo_y = _mm512_broadcast_i32x4(_mm_loadu_si128(GF256Ctx.MM128.TABLE_LO_Y + y));
+    const GF256_M512 table_hi_y = _mm512_broadcast_i32x4(_mm_loadu_si128(GF256Ctx.MM128.TABLE_HI_Y + y));
+    const GF256_M512 clr_mask = _mm512_set1_epi8(0x0f);
+
+    int offset = 0;
+    for (; offset + 64 <= bytes; offset += 64) {
+        GF256_M512 x0 = _mm512_loadu_si512(x + offset);
+        const GF256_M512 l0 = _mm512_and_si512(x0, clr_mask);
+        x0 = _mm512_srli_epi64(x0, 4);
+        const GF256_M512 h0 = _mm512_and_si512(x0, clr_mask);
+        const GF256_M512 p0 = _mm512_xor_si512(_mm512_shuffle_epi8(table_lo_y, l0),
+                                               _mm512_shuffle_epi8(table_hi_y, h0));
+        _mm512_storeu_si512(z + offset, _mm512_xor_si512(p0, _mm512_loadu_si512(z + offset)));
+    }
+    if (offset < bytes) {
+        const __mmask64 mask = gf256_avx512_tail_mask(bytes - offset);
+        GF256_M512 x0 = _mm512_maskz_loadu_epi8(mask, x + offset);
+        const GF256_M512 l0 = _mm512_and_si512(x0, clr_mask);
+        x0 = _mm512_srli_epi64(x0, 4);
+        const GF256_M512 h0 = _mm512_and_si512(x0, clr_mask);
+        const GF256_M512 p0 = _mm512_xor_si512(_mm512_shuffle_epi8(table_lo_y, l0),
+                                               _mm512_shuffle_epi8(table_hi_y, h0));
+        const GF256_M512 z0 = _mm512_maskz_loadu_epi8(mask, z + offset);
+        _mm512_mask_storeu_epi8(z + offset, mask, _mm512_xor_si512(p0, z0));
+    }
+}
+
+template<int N>
+GF256_TARGET(GF256_AVX512_ISA)
+static int gf256_muladd_multi_avx512(void *const *vz, const uint8_t *y, const uint8_t *GF256_RESTRICT x, int bytes) {
+    uint8_t *z[N];
+    gf256_copy_rows<N>(z, vz);
+
+    GF256_M512 table_lo_y[N], table_hi_y[N];
+    for (int r = 0; r < N; ++r) {
+        table_lo_y[r] = _mm512_broadcast_i32x4(_mm_loadu_si128(GF256Ctx.MM128.TABLE_LO_Y + y[r]));
+        table_hi_y[r] = _mm512_broadcast_i32x4(_mm_loadu_si128(GF256Ctx.MM128.TABLE_HI_Y + y[r]));
+    }
+    const GF256_M512 clr_mask = _mm512_set1_epi8(0x0f);
+
+    int offset = 0;
+    for (; offset + 64 <= bytes; offset += 64) {
+        GF256_M512 x0 = _mm512_loadu_si512(x + offset);
+        const GF256_M512 l0 = _mm512_and_si512(x0, clr_mask);
+        x0 = _mm512_srli_epi64(x0, 4);
+        const GF256_M512 h0 = _mm512_and_si512(x0, clr_mask);
+        for (int r = 0; r < N; ++r) {
+            const GF256_M512 p0 = _mm512_xor_si512(_mm512_shuffle_epi8(table_lo_y[r], l0),
+                                                   _mm512_shuffle_epi8(table_hi_y[r], h0));
+            _mm512_storeu_si512(z[r] + offset, _mm512_xor_si512(p0, _mm512_loadu_si512(z[r] + offset)));
+        }
+    }
+    if (offset < bytes) {
+        const __mmask64 mask = gf256_avx512_tail_mask(bytes - offset);
+        GF256_M512 x0 = _mm512_maskz_loadu_epi8(mask, x + offset);
+        const GF256_M512 l0 = _mm512_and_si512(x0, clr_mask);
+        x0 = _mm512_srli_epi64(x0, 4);
+        const GF256_M512 h0 = _mm512_and_si512(x0, clr_mask);
+        for (int r = 0; r < N; ++r) {
+            const GF256_M512 p0 = _mm512_xor_si512(_mm512_shuffle_epi8(table_lo_y[r], l0),
+                                                   _mm512_shuffle_epi8(table_hi_y[r], h0));
+            const GF256_M512 z0 = _mm512_maskz_loadu_epi8(mask, z[r] + offset);
+            _mm512_mask_storeu_epi8(z[r] + offset, mask, _mm512_xor_si512(p0, z0));
+        }
+    }
+    return bytes;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif // GF256_TRY_AVX512
+
+#if defined(GF256_TRY_GFNI)
+//------------------------------------------------------------------------------
+// GFNI Kernels
+//
+// GF2P8AFFINEQB multiplies every byte by an 8x8 bit matrix, so one instruction
+// does the GF(256) multiplication by a constant (GFNI_MATRIX, see
+// gf256_mul_mem_init()) for a whole vector. GF2P8MULB would be simpler but is
+// fixed to the AES polynomial 0x11B and this library uses a different one.
+
+#define GF256_GFNI_AVX2_ISA "avx2,gfni"
+#define GF256_GFNI_AVX512_ISA "avx512f,avx512bw,gfni"
+
+GF256_TARGET(GF256_GFNI_AVX2_ISA)
+static void gf256_mul_mem_gfni_avx2(void *GF256_RESTRICT vz, const void *GF256_RESTRICT vx, uint8_t y, int bytes) {
+    uint8_t *GF256_RESTRICT z = reinterpret_cast<uint8_t *>(vz);
+    const uint8_t *GF256_RESTRICT x = reinterpret_cast<const uint8_t *>(vx);
+    const GF256_M256 matrix = _mm256_set1_epi64x((long long) GF256Ctx.GFNI_MATRIX[y]);
+
+    int offset = 0;
+    for (; offset + 32 <= bytes; offset += 32) {
+        const GF256_M256 x0 = _mm256_loadu_si256(reinterpret_cast<const GF256_M256 *>(x + offset));
+        _mm256_storeu_si256(reinterpret_cast<GF256_M256 *>(z + offset), _mm256_gf2p8affine_epi64_epi8(x0, matrix, 0));
+    }
+
+    // Remaining bytes: SSSE3 for a last 16 byte vector, then scalar
+    gf256_mul_mem_ssse3(z + offset, x + offset, y, bytes - offset);
+}
+
+GF256_TARGET(GF256_GFNI_AVX2_ISA)
+static void gf256_muladd_mem_gfni_avx2(void *GF256_RESTRICT vz, uint8_t y, const void *GF256_RESTRICT vx, int bytes) {
+    uint8_t *GF256_RESTRICT z = reinterpret_cast<uint8_t *>(vz);
+    const uint8_t *GF256_RESTRICT x = reinterpret_cast<const uint8_t *>(vx);
+    const GF256_M256 matrix = _mm256_set1_epi64x((long long) GF256Ctx.GFNI_MATRIX[y]);
+
+    int offset = 0;
+    for (; offset + 64 <= bytes; offset += 64) {
+        GF256_M256 *z32 = reinterpret_cast<GF256_M256 *>(z + offset);
+        const GF256_M256 x0 = _mm256_loadu_si256(reinterpret_cast<const GF256_M256 *>(x + offset));
+        const GF256_M256 x1 = _mm256_loadu_si256(reinterpret_cast<const GF256_M256 *>(x + offset + 32));
+        const GF256_M256 p0 = _mm256_gf2p8affine_epi64_epi8(x0, matrix, 0);
+        const GF256_M256 p1 = _mm256_gf2p8affine_epi64_epi8(x1, matrix, 0);
+        _mm256_storeu_si256(z32, _mm256_xor_si256(p0, _mm256_loadu_si256(z32)));
+        _mm256_storeu_si256(z32 + 1, _mm256_xor_si256(p1, _mm256_loadu_si256(z32 + 1)));
+    }
+    if (offset + 32 <= bytes) {
+        GF256_M256 *z32 = reinterpret_cast<GF256_M256 *>(z + offset);
+        const GF256_M256 x0 = _mm256_loadu_si256(reinterpret_cast<const GF256_M256 *>(x + offset));
+        const GF256_M256 p0 = _mm256_gf2p8affine_epi64_epi8(x0, matrix, 0);
+        _mm256_storeu_si256(z32, _mm256_xor_si256(p0, _mm256_loadu_si256(z32)));
+        offset += 32;
+    }
+
+    // Remaining bytes: SSSE3 for a last 16 byte vector, then scalar
+    gf256_muladd_mem_ssse3(z + offset, y, x + offset, bytes - offset);
+}
+
+template<int N>
+GF256_TARGET(GF256_GFNI_AVX2_ISA)
+static int gf256_muladd_multi_gfni_avx2(void *const *vz, const uint8_t *y, const uint8_t *GF256_RESTRICT x,
+                                        int bytes) {
+    uint8_t *z[N];
+    gf256_copy_rows<N>(z, vz);
+
+    GF256_M256 matrix[N];
+    for (int r = 0; r < N; ++r)
+        matrix[r] = _mm256_set1_epi64x((long long) GF256Ctx.GFNI_MATRIX[y[r]]);
+
+    // One matrix register per row leaves enough registers to always process two vectors per iteration
+    int offset = 0;
+    for (; offset + 64 <= bytes; offset += 64) {
+        const GF256_M256 x0 = _mm256_loadu_si256(reinterpret_cast<const GF256_M256 *>(x + offset));
+        const GF256_M256 x1 = _mm256_loadu_si256(reinterpret_cast<const GF256_M256 *>(x + offset + 32));
+        for (int r = 0; r < N; ++r) {
+            GF256_M256 *z32 = reinterpret_cast<GF256_M256 *>(z[r] + offset);
+            const GF256_M256 p0 = _mm256_gf2p8affine_epi64_epi8(x0, matrix[r], 0);
+            const GF256_M256 p1 = _mm256_gf2p8affine_epi64_epi8(x1, matrix[r], 0);
+            _mm256_storeu_si256(z32, _mm256_xor_si256(p0, _mm256_loadu_si256(z32)));
+            _mm256_storeu_si256(z32 + 1, _mm256_xor_si256(p1, _mm256_loadu_si256(z32 + 1)));
+        }
+    }
+    for (; offset + 32 <= bytes; offset += 32) {
+        const GF256_M256 x0 = _mm256_loadu_si256(reinterpret_cast<const GF256_M256 *>(x + offset));
+        for (int r = 0; r < N; ++r) {
+            GF256_M256 *z32 = reinterpret_cast<GF256_M256 *>(z[r] + offset);
+            const GF256_M256 p0 = _mm256_gf2p8affine_epi64_epi8(x0, matrix[r], 0);
+            _mm256_storeu_si256(z32, _mm256_xor_si256(p0, _mm256_loadu_si256(z32)));
+        }
     }
+    return offset;
+}
+
+// GCC 12 warns about _mm512_undefined_epi32() inside its own intrinsics
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+GF256_TARGET(GF256_GFNI_AVX512_ISA)
+static void gf256_mul_mem_gfni_avx512(void *GF256_RESTRICT vz, const void *GF256_RESTRICT vx, uint8_t y, int bytes) {
+    uint8_t *GF256_RESTRICT z = reinterpret_cast<uint8_t *>(vz);
+    const uint8_t *GF256_RESTRICT x = reinterpret_cast<const uint8_t *>(vx);
+    const GF256_M512 matrix = _mm512_set1_epi64((long long) GF256Ctx.GFNI_MATRIX[y]);
+
+    int offset = 0;
+    for (; offset + 64 <= bytes; offset += 64)
+        _mm512_storeu_si512(z + offset, _mm512_gf2p8affine_epi64_epi8(_mm512_loadu_si512(x + offset), matrix, 0));
+    if (offset < bytes) {
+        const __mmask64 mask = gf256_avx512_tail_mask(bytes - offset);
+        const GF256_M512 x0 = _mm512_maskz_loadu_epi8(mask, x + offset);
+        _mm512_mask_storeu_epi8(z + offset, mask, _mm512_gf2p8affine_epi64_epi8(x0, matrix, 0));
+    }
+}
+
+GF256_TARGET(GF256_GFNI_AVX512_ISA)
+static void gf256_muladd_mem_gfni_avx512(void *GF256_RESTRICT vz, uint8_t y, const void *GF256_RESTRICT vx,
+                                         int bytes) {
+    uint8_t *GF256_RESTRICT z = reinterpret_cast<uint8_t *>(vz);
+    const uint8_t *GF256_RESTRICT x = reinterpret_cast<const uint8_t *>(vx);
+    const GF256_M512 matrix = _mm512_set1_epi64((long long) GF256Ctx.GFNI_MATRIX[y]);
+
+    int offset = 0;
+    for (; offset + 128 <= bytes; offset += 128) {
+        const GF256_M512 p0 = _mm512_gf2p8affine_epi64_epi8(_mm512_loadu_si512(x + offset), matrix, 0);
+        const GF256_M512 p1 = _mm512_gf2p8affine_epi64_epi8(_mm512_loadu_si512(x + offset + 64), matrix, 0);
+        _mm512_storeu_si512(z + offset, _mm512_xor_si512(p0, _mm512_loadu_si512(z + offset)));
+        _mm512_storeu_si512(z + offset + 64, _mm512_xor_si512(p1, _mm512_loadu_si512(z + offset + 64)));
+    }
+    for (; offset + 64 <= bytes; offset += 64) {
+        const GF256_M512 p0 = _mm512_gf2p8affine_epi64_epi8(_mm512_loadu_si512(x + offset), matrix, 0);
+        _mm512_storeu_si512(z + offset, _mm512_xor_si512(p0, _mm512_loadu_si512(z + offset)));
+    }
+    if (offset < bytes) {
+        const __mmask64 mask = gf256_avx512_tail_mask(bytes - offset);
+        const GF256_M512 p0 = _mm512_gf2p8affine_epi64_epi8(_mm512_maskz_loadu_epi8(mask, x + offset), matrix, 0);
+        const GF256_M512 z0 = _mm512_maskz_loadu_epi8(mask, z + offset);
+        _mm512_mask_storeu_epi8(z + offset, mask, _mm512_xor_si512(p0, z0));
+    }
+}
+
+template<int N>
+GF256_TARGET(GF256_GFNI_AVX512_ISA)
+static int gf256_muladd_multi_gfni_avx512(void *const *vz, const uint8_t *y, const uint8_t *GF256_RESTRICT x,
+                                          int bytes) {
+    uint8_t *z[N];
+    gf256_copy_rows<N>(z, vz);
+
+    GF256_M512 matrix[N];
+    for (int r = 0; r < N; ++r)
+        matrix[r] = _mm512_set1_epi64((long long) GF256Ctx.GFNI_MATRIX[y[r]]);
+
+    int offset = 0;
+    for (; offset + 128 <= bytes; offset += 128) {
+        const GF256_M512 x0 = _mm512_loadu_si512(x + offset);
+        const GF256_M512 x1 = _mm512_loadu_si512(x + offset + 64);
+        for (int r = 0; r < N; ++r) {
+            const GF256_M512 p0 = _mm512_gf2p8affine_epi64_epi8(x0, matrix[r], 0);
+            const GF256_M512 p1 = _mm512_gf2p8affine_epi64_epi8(x1, matrix[r], 0);
+            _mm512_storeu_si512(z[r] + offset, _mm512_xor_si512(p0, _mm512_loadu_si512(z[r] + offset)));
+            _mm512_storeu_si512(z[r] + offset + 64, _mm512_xor_si512(p1, _mm512_loadu_si512(z[r] + offset + 64)));
+        }
+    }
+    for (; offset + 64 <= bytes; offset += 64) {
+        const GF256_M512 x0 = _mm512_loadu_si512(x + offset);
+        for (int r = 0; r < N; ++r) {
+            const GF256_M512 p0 = _mm512_gf2p8affine_epi64_epi8(x0, matrix[r], 0);
+            _mm512_storeu_si512(z[r] + offset, _mm512_xor_si512(p0, _mm512_loadu_si512(z[r] + offset)));
+        }
+    }
+    if (offset < bytes) {
+        const __mmask64 mask = gf256_avx512_tail_mask(bytes - offset);
+        const GF256_M512 x0 = _mm512_maskz_loadu_epi8(mask, x + offset);
+        for (int r = 0; r < N; ++r) {
+            const GF256_M512 p0 = _mm512_gf2p8affine_epi64_epi8(x0, matrix[r], 0);
+            const GF256_M512 z0 = _mm512_maskz_loadu_epi8(mask, z[r] + offset);
+            _mm512_mask_storeu_epi8(z[r] + offset, mask, _mm512_xor_si512(p0, z0));
+        }
+    }
+    return bytes;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif // GF256_TRY_GFNI
+
+//------------------------------------------------------------------------------
+// Kernel Selection
+
+typedef int (*gf256_muladd_multi_fn)(void *const *vz, const uint8_t *y, const uint8_t *GF256_RESTRICT x, int bytes);
+
+struct gf256_kernel_t {
+    const char *Name;
+    const bool *CpuFlag;    // Kernel can be used if *CpuFlag is set. Always usable if NULL
+    bool UsesAVX2;          // Add operations may use AVX2 as well when this kernel is selected
+    void (*MulMem)(void *GF256_RESTRICT vz, const void *GF256_RESTRICT vx, uint8_t y, int bytes);
+    void (*MulAddMem)(void *GF256_RESTRICT vz, uint8_t y, const void *GF256_RESTRICT vx, int bytes);
+    gf256_muladd_multi_fn MulAddMulti[4]; // 2, 4, 6 and 8 rows
+};
+
+#define GF256_KERNEL(isa, cpu_flag, uses_avx2) \
+    { #isa, cpu_flag, uses_avx2, gf256_mul_mem_##isa, gf256_muladd_mem_##isa, \
+      { gf256_muladd_multi_##isa<2>, gf256_muladd_multi_##isa<4>, \
+        gf256_muladd_multi_##isa<6>, gf256_muladd_multi_##isa<8> } }
+
+// Ordered from fastest to slowest
+static const gf256_kernel_t Kernels[] = {
+#if defined(GF256_TRY_GFNI)
+        GF256_KERNEL(gfni_avx512, &CpuHasGFNI512, true),
+        GF256_KERNEL(gfni_avx2, &CpuHasGFNI, true),
+#endif
+#if defined(GF256_TRY_AVX512)
+        GF256_KERNEL(avx512, &CpuHasAVX512, true),
+#endif
+#if defined(GF256_TRY_AVX2)
+        GF256_KERNEL(avx2, &CpuHasAVX2, true),
+#endif
+#if !defined(GF256_TARGET_MOBILE)
+        GF256_KERNEL(ssse3, &CpuHasSSSE3, false),
+#endif
+#if defined(GF256_TRY_NEON)
+        GF256_KERNEL(neon, &CpuHasNeon, false),
+#endif
+        GF256_KERNEL(scalar, nullptr, false)
+};
+static const int KernelCount = sizeof(Kernels) / sizeof(Kernels[0]);
+
+// Selected by gf256_init()
+static const gf256_kernel_t *Kernel = &Kernels[KernelCount - 1];
+
+static void gf256_muladd_multi_kernel(const gf256_kernel_t *kernel, void *const *vz, const uint8_t *y, int count,
+                                      const void *GF256_RESTRICT vx, int bytes) {
+    const uint8_t *GF256_RESTRICT x = reinterpret_cast<const uint8_t *>(vx);
+
+    // Split rows into groups of the specialised sizes (8, 6, 4, 2, 1)
+    while (count > 0) {
+        if (count == 1) {
+            kernel->MulAddMem(vz[0], y[0], x, bytes);
+            return;
+        }
+        const int n = count >= 8 ? 8 : (count & ~1);
+        const int offset = kernel->MulAddMulti[n / 2 - 1](vz, y, x, bytes);
+
+        // Remaining bytes that do not fill a full vector
+        if (offset < bytes)
+            for (int r = 0; r < n; ++r)
+                kernel->MulAddMem(reinterpret_cast<uint8_t *>(vz[r]) + offset, y[r], x + offset, bytes - offset);
+        vz += n, y += n, count -= n;
+    }
+}
+
+// Per kernel self-test: Compares against the multiplication table using
+// misaligned buffers, lengths that leave all kinds of tails and all row counts
+static const int kKernelTestBytes = 200;
+struct KernelTestBuffersT {
+    uint8_t X[kKernelTestBytes + 1];
+    uint8_t Z[8][kKernelTestBytes + 2];
+    uint8_t Expected[8][kKernelTestBytes + 2];
+};
+static KernelTestBuffersT m_KernelTestBuffers;
+
+static bool gf256_kernel_self_test(const gf256_kernel_t *kernel) {
+    static const int kLengths[] = {1, 7, 15, 16, 17, 31, 32, 33, 63, 64, 65, 100, 127, 128, 129, kKernelTestBytes - 1};
+    static const uint8_t kRowFactors[8] = {0x6c, 0x00, 0x01, 0xa2, 0x02, 0xff, 0x8e, 0x35};
+    KernelTestBuffersT &buf = m_KernelTestBuffers;
+    void *rows[8];
+
+    for (const int bytes : kLengths) {
+        const uint8_t *x = buf.X + 1;
+        for (int i = 0; i <= kKernelTestBytes; ++i)
+            buf.X[i] = static_cast<uint8_t>(i * 37 + bytes);
+
+        // Test MulAddMem and MulAddMulti through all row counts. One guard byte before and after each row
+        for (int count = 1; count <= 8; ++count) {
+            for (int r = 0; r < count; ++r) {
+                for (int i = 0; i < kKernelTestBytes + 2; ++i)
+                    buf.Z[r][i] = buf.Expected[r][i] = static_cast<uint8_t>(i * 11 + r);
+                for (int i = 0; i < bytes; ++i)
+                    buf.Expected[r][i + 1] ^= gf256_mul(x[i], kRowFactors[r]);
+                rows[r] = buf.Z[r] + 1;
+            }
+            gf256_muladd_multi_kernel(kernel, rows, kRowFactors, count, x, bytes);
+            for (int r = 0; r < count; ++r)
+                if (memcmp(buf.Z[r], buf.Expected[r], bytes + 2) != 0)
+                    return false;
+        }
+
+        // Test MulMem
+        for (int i = 0; i < kKernelTestBytes + 2; ++i)
+            buf.Z[0][i] = buf.Expected[0][i] = static_cast<uint8_t>(i * 11);
+        for (int i = 0; i < bytes; ++i)
+            buf.Expected[0][i + 1] = gf256_mul(x[i], 0xa2);
+        kernel->MulMem(buf.Z[0] + 1, x, 0xa2, bytes);
+        if (memcmp(buf.Z[0], buf.Expected[0], bytes + 2) != 0)
+            return false;
+    }
+    return true;
+}
+
+static bool gf256_kernel_usable(const gf256_kernel_t *kernel) {
+    return (kernel->CpuFlag == nullptr || *kernel->CpuFlag) && gf256_kernel_self_test(kernel);
+}
+
+static void gf256_use_kernel(const gf256_kernel_t *kernel) {
+    Kernel = kernel;
+#if defined(GF256_TRY_AVX2)
+    UseAVX2 = kernel->UsesAVX2;
+#endif
+}
+
+static const gf256_kernel_t *gf256_find_kernel(const char *name) {
+    for (int i = 0; i < KernelCount; ++i)
+        if (strcmp(Kernels[i].Name, name) == 0)
+            return &Kernels[i];
+    return nullptr;
+}
+
+// Selects the kernel requested by the GF256_KERNEL environment variable or else the fastest usable one
+static bool gf256_kernel_init() {
+    const char *requested = getenv("GF256_KERNEL");
+    if (requested != nullptr && requested[0] != '\0') {
+        const gf256_kernel_t *kernel = gf256_find_kernel(requested);
+        if (kernel != nullptr && gf256_kernel_usable(kernel)) {
+            gf256_use_kernel(kernel);
+            return true;
+        }
+        fprintf(stderr, "gf256: GF256_KERNEL=%s is unknown, not supported by this CPU or failed its self-test. "
+                        "Selecting kernel automatically\n", requested);
+    }
+
+    for (int i = 0; i < KernelCount; ++i) {
+        if (gf256_kernel_usable(&Kernels[i])) {
+            gf256_use_kernel(&Kernels[i]);
+            return true;
+        }
+    }
+    return false;
+}
+
+extern "C" const char *gf256_kernel_name() {
+    return Kernel->Name;
+}
+
+extern "C" int gf256_select_kernel(const char *name) {
+    if (!Initialized)
+        return -1;
+
+    const gf256_kernel_t *kernel = gf256_find_kernel(name);
+    if (kernel == nullptr || !gf256_kernel_usable(kernel))
+        return -1;
+    gf256_use_kernel(kernel);
+    return 0;
+}
+
+extern "C" void gf256_mul_mem(void *GF256_RESTRICT vz, const void *GF256_RESTRICT vx, uint8_t y, int bytes) {
+    // Use a single if-statement to handle special cases
+    if (y <= 1) {
+        if (y == 0)
+            memset(vz, 0, bytes);
+        else if (vz != vx)
+            memcpy(vz, vx, bytes);
+        return;
+    }
+
+    Kernel->MulMem(vz, vx, y, bytes);
+}
+
+extern "C" void gf256_muladd_mem(void *GF256_RESTRICT vz, uint8_t y,
+                                 const void *GF256_RESTRICT vx, int bytes) {
+    // Use a single if-statement to handle special cases
+    if (y <= 1) {
+        if (y == 1)
+            gf256_add_mem(vz, vx, bytes);
+        return;
+    }
+
+    Kernel->MulAddMem(vz, y, vx, bytes);
+}
+
+//------------------------------------------------------------------------------
+// Multi-Row Multiply-Add
+//
+// Multiplies one source block into N destination blocks in a single pass: Every
+// vector of x is loaded and split into nibbles once, the partial product tables
+// of all N rows stay in registers. This is what the FEC encoder needs (one data
+// block is added to all parity blocks). Specialised for N = 2, 4, 6, 8.
+
+extern "C" void gf256_muladd_multi_mem(void *const *vz, const uint8_t *y, int count,
+                                       const void *GF256_RESTRICT vx, int bytes) {
+    gf256_muladd_multi_kernel(Kernel, vz, y, count, vx, bytes);
 }
 
 extern "C" void gf256_memswap(void *GF256_RESTRICT vx, void *GF256_RESTRICT vy, int bytes) {
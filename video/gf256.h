@@ -56,7 +56,9 @@
     #define GF256_TARGET_MOBILE
 #endif // ANDROID
 
-#if defined(__AVX2__) || (defined (_MSC_VER) && _MSC_VER >= 1900)
+// On x86 the AVX2 and AVX-512 kernels are always built (using per-function target
+// attributes) and selected at runtime, so no -mavx2 etc. is needed for the library
+#if !defined(GF256_TARGET_MOBILE) && (defined(__AVX2__) || defined(__GNUC__) || (defined (_MSC_VER) && _MSC_VER >= 1900))
     #define GF256_TRY_AVX2 /* 256-bit */
     #include <immintrin.h>
     #define GF256_ALIGN_BYTES 32
@@ -64,6 +66,14 @@
     #define GF256_ALIGN_BYTES 16
 #endif // __AVX2__
 
+#if defined(GF256_TRY_AVX2) && (defined(__AVX512BW__) || defined(__clang__) || __GNUC__ >= 5 || (defined (_MSC_VER) && _MSC_VER >= 1920))
+    #define GF256_TRY_AVX512 /* 512-bit, AVX-512F + AVX-512BW */
+#endif
+
+#if defined(GF256_TRY_AVX512) && (defined(__GFNI__) || defined(__clang__) || __GNUC__ >= 8)
+    #define GF256_TRY_GFNI /* GF2P8AFFINEQB with 256-bit (VEX) and 512-bit (EVEX) vectors */
+#endif
+
 #if !defined(GF256_TARGET_MOBILE)
     // Note: MSVC currently only supports SSSE3 but not AVX2
     #include <tmmintrin.h> // SSSE3: _mm_shuffle_epi8
@@ -102,6 +112,11 @@
     #define GF256_M256 __m256i
 #endif
 
+#ifdef GF256_TRY_AVX512
+    // Compiler-specific 512-bit SIMD register keyword
+    #define GF256_M512 __m512i
+#endif
+
 // Compiler-specific C++11 restrict keyword
 #define GF256_RESTRICT __restrict
 
@@ -157,6 +172,10 @@ struct gf256_ctx
         GF256_ALIGNED GF256_M256 TABLE_HI_Y[256];
     } MM256;
 #endif // GF256_TRY_AVX2
+#ifdef GF256_TRY_GFNI
+    /// GF2P8AFFINEQB bit matrices for the multiplication by y
+    uint64_t GFNI_MATRIX[256];
+#endif // GF256_TRY_GFNI
 
     /// Mul/Div/Inv/Sqr tables
     uint8_t GF256_MUL_TABLE[256 * 256];
@@ -203,6 +222,28 @@ extern struct gf256_ctx GF256Ctx;
 extern int gf256_init_(int version);
 #define gf256_init() gf256_init_(GF256_VERSION)
 
+/**
+    Bulk multiply kernels
+
+    gf256_init() selects the fastest multiply kernel (mul/muladd/muladd_multi)
+    that the CPU supports and that passes its self-test. The selection can be
+    overridden by setting the environment variable GF256_KERNEL to one of the
+    kernel names: "gfni_avx512", "avx512", "gfni_avx2", "avx2", "ssse3", "neon"
+    or "scalar".
+*/
+
+/// Returns the name of the multiply kernel currently in use
+extern const char *gf256_kernel_name(void);
+
+/**
+    Switch to another multiply kernel, e.g. for benchmarking.
+    Must not be called while other threads use the library.
+
+    Returns 0 on success, -1 if the kernel is unknown, not supported by the CPU,
+    failed its self-test or gf256_init() was not called yet.
+*/
+extern int gf256_select_kernel(const char *name);
+
 
 //------------------------------------------------------------------------------
 // Math Operations
@@ -263,6 +304,10 @@ extern void gf256_mul_mem(void * GF256_RESTRICT vz,
 extern void gf256_muladd_mem(void * GF256_RESTRICT vz, uint8_t y,
                              const void * GF256_RESTRICT vx, int bytes);
 
+/// Performs "z[i][] += x[] * y[i]" for i = 0..count-1 in a single pass over x[]
+extern void gf256_muladd_multi_mem(void * const * vz, const uint8_t * y, int count,
+                                   const void * GF256_RESTRICT vx, int bytes);
+
 /// Performs "x[] /= y" bulk memory operation
 static GF256_FORCE_INLINE void gf256_div_mem(void * GF256_RESTRICT vz,
                                              const void * GF256_RESTRICT vx, uint8_t y, int bytes)
@@ -0,0 +1,234 @@
+/*
+ *   This file is part of DroneBridge: https://github.com/DroneBridge/DroneBridge
+ *
+ *   Copyright 2020 Wolfgang Christl
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+/**
+ * Microbenchmark of the radiotap parsing done for every received frame (see parse_frame() in video_main_gnd.c).
+ * Compares the radiotap iterator with the cached parse plans of db_radiotap.c on radiotap headers as captured from
+ * Atheros (ath9k_htc), Ralink (rt2800usb) and Realtek (rtl8812au) adapters. Verifies that both return the same fields.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include "../common/db_radiotap.h"
+#include "../common/radiotap/radiotap_iter.h"
+
+typedef struct {
+    const char *name;
+    const uint8_t *header;
+    int length;
+} rt_capture_t;
+
+// ath9k_htc (AR9271): TSFT, FLAGS, RATE, CHANNEL, DBM_ANTSIGNAL, RX_FLAGS + one namespace with chain 0 signal
+static const uint8_t rt_atheros[] = {
+        0x00, 0x00, 0x24, 0x00, 0x2f, 0x40, 0x00, 0xa0, 0x20, 0x08, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00,                                                 // padding for TSFT
+        0x5b, 0x3a, 0x91, 0x0c, 0x00, 0x00, 0x00, 0x00,                         // TSFT
+        0x10, 0x0c, 0xa8, 0x09, 0xa0, 0x00, 0xd6, 0x00,                         // FLAGS, RATE, CHANNEL, ANTSIGNAL
+        0x00, 0x00, 0xd6, 0x00                                                  // RX_FLAGS, ANTSIGNAL, ANTENNA
+};
+
+// rt2800usb (RT5572): FLAGS, RATE, CHANNEL, DBM_ANTSIGNAL, RX_FLAGS
+static const uint8_t rt_ralink[] = {
+        0x00, 0x00, 0x12, 0x00, 0x2e, 0x40, 0x00, 0x00,
+        0x10, 0x0c, 0x6c, 0x09, 0xc0, 0x00, 0xc9, 0x00,                         // FLAGS, RATE, CHANNEL, ANTSIGNAL
+        0x00, 0x00                                                              // RX_FLAGS
+};
+
+// rtl8812au: TSFT, FLAGS, CHANNEL, DBM_ANTSIGNAL, LOCK_QUALITY, RX_FLAGS, VHT + two namespaces with per chain signal
+static const uint8_t rt_realtek[] = {
+        0x00, 0x00, 0x34, 0x00, 0xab, 0x40, 0x20, 0xa0, 0x20, 0x08, 0x00, 0xa0,
+        0x20, 0x08, 0x00, 0x00,
+        0x8c, 0x1f, 0x27, 0x01, 0x00, 0x00, 0x00, 0x00,                         // TSFT
+        0x10, 0x00, 0x85, 0x16, 0x40, 0x01, 0xcf, 0x00,                         // FLAGS, CHANNEL, ANTSIGNAL
+        0x64, 0x00, 0x00, 0x00,                                                 // LOCK_QUALITY, RX_FLAGS
+        0x04, 0x00, 0x00, 0x22, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // VHT
+        0xcf, 0x00, 0xd1, 0x01                                                  // ANTSIGNAL/ANTENNA of both chains
+};
+
+static const rt_capture_t captures[] = {
+        {"atheros", rt_atheros, sizeof(rt_atheros)},
+        {"ralink",  rt_ralink,  sizeof(rt_ralink)},
+        {"realtek", rt_realtek, sizeof(rt_realtek)}
+};
+#define NUM_CAPTURES (sizeof(captures) / sizeof(captures[0]))
+
+// Same statistics parse_frame() extracts
+typedef struct {
+    uint8_t rate;
+    uint8_t lock_quality;
+    int8_t current_signal_dbm;
+    int8_t ant_signal_dbm[8];
+    uint8_t num_antennas;
+    int checksum_correct;
+} rt_stats_t;
+
+volatile uint32_t sink;
+
+static inline uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static inline void apply_field(rt_stats_t *stats, int index, const uint8_t *arg, uint8_t *antenna) {
+    switch (index) {
+        case IEEE80211_RADIOTAP_RATE:
+            stats->rate = *arg;
+            break;
+        case IEEE80211_RADIOTAP_ANTENNA:
+            *antenna = *arg;
+            break;
+        case IEEE80211_RADIOTAP_FLAGS:
+            stats->checksum_correct = (*arg & IEEE80211_RADIOTAP_F_BADFCS) == 0;
+            break;
+        case IEEE80211_RADIOTAP_LOCK_QUALITY:
+            stats->lock_quality = *arg;
+            break;
+        case IEEE80211_RADIOTAP_DBM_ANTSIGNAL:
+            if (*antenna == 0)
+                stats->current_signal_dbm = (int8_t) *arg;
+            if (*antenna < 8)
+                stats->ant_signal_dbm[*antenna] = (int8_t) *arg;
+            break;
+        default:
+            break;
+    }
+}
+
+static int parse_iterator(const uint8_t *header, int length, rt_stats_t *stats) {
+    struct ieee80211_radiotap_iterator rti;
+    uint8_t antenna = 0;
+    if (ieee80211_radiotap_iterator_init(&rti, (struct ieee80211_radiotap_header *) header, length, NULL) != 0)
+        return -1;
+    while (ieee80211_radiotap_iterator_next(&rti) == 0)
+        apply_field(stats, rti.this_arg_index, rti.this_arg, &antenna);
+    stats->num_antennas = (uint8_t) (antenna + 1);
+    return 0;
+}
+
+static int parse_plan(db_rt_plan_t *plan, const uint8_t *header, int length, rt_stats_t *stats) {
+    const db_rt_field_t *fields;
+    uint8_t antenna = 0;
+    int num_fields = db_rt_get_fields(plan, header, length, &fields);
+    if (num_fields < 0)
+        return -1;
+    for (int i = 0; i < num_fields; i++)
+        apply_field(stats, fields[i].index, header + fields[i].offset, &antenna);
+    stats->num_antennas = (uint8_t) (antenna + 1);
+    return 0;
+}
+
+/**
+ * Times the parsing of a sequence of headers. One plan is used for all frames (like one adapter).
+ *
+ * @param sequence Headers to parse. Parsed round robin
+ * @param num Number of headers in sequence
+ * @param use_plan true to use db_rt_get_fields(), false for the radiotap iterator
+ * @return ns per parsed frame
+ */
+static double bench(const rt_capture_t **sequence, int num, unsigned int frames, bool use_plan, db_rt_plan_t *plan) {
+    rt_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    db_rt_plan_init(plan);
+    uint64_t start = now_ns();
+    for (unsigned int i = 0; i < frames; i++) {
+        const rt_capture_t *c = sequence[i % num];
+        if (use_plan)
+            parse_plan(plan, c->header, c->length, &stats);
+        else
+            parse_iterator(c->header, c->length, &stats);
+        sink += (uint32_t) stats.current_signal_dbm + stats.rate;
+    }
+    return (double) (now_ns() - start) / frames;
+}
+
+/**
+ * Parses every capture with both methods (plan cold and warm) and compares the extracted statistics
+ *
+ * @return number of captures with differing results
+ */
+static int verify() {
+    int errors = 0;
+    for (unsigned int c = 0; c < NUM_CAPTURES; c++) {
+        db_rt_plan_t plan;
+        db_rt_plan_init(&plan);
+        rt_stats_t expected, cold, warm;
+        memset(&expected, 0, sizeof(rt_stats_t));
+        memset(&cold, 0, sizeof(rt_stats_t));
+        memset(&warm, 0, sizeof(rt_stats_t));
+        int ret = parse_iterator(captures[c].header, captures[c].length, &expected);
+        ret |= parse_plan(&plan, captures[c].header, captures[c].length, &cold);
+        ret |= parse_plan(&plan, captures[c].header, captures[c].length, &warm);
+        if (ret != 0 || memcmp(&expected, &cold, sizeof(rt_stats_t)) != 0 ||
+            memcmp(&expected, &warm, sizeof(rt_stats_t)) != 0 || !plan.valid || plan.hit_cnt != 1) {
+            printf("%-10s MISMATCH between radiotap iterator and parse plan\n", captures[c].name);
+            errors++;
+        } else {
+            printf("%-10s %2i bytes, %u present words, %u fields: rate %u, signal %i dBm, %u antennas\n",
+                   captures[c].name, captures[c].length, plan.num_present, plan.num_fields, expected.rate,
+                   expected.current_signal_dbm, expected.num_antennas);
+        }
+    }
+    return errors;
+}
+
+int main(int argc, char *argv[]) {
+    unsigned int frames = 5000000;
+    int c;
+    while ((c = getopt(argc, argv, "n:h")) != -1) {
+        switch (c) {
+            case 'n':
+                frames = (unsigned int) strtoul(optarg, NULL, 10);
+                break;
+            default:
+                printf("Radiotap parsing microbenchmark. Use\n\t-n <frames> Frames to parse per run (default %u)\n",
+                       frames);
+                return 0;
+        }
+    }
+    if (frames == 0)
+        frames = 1;
+    int errors = verify();
+
+    db_rt_plan_t plan;
+    printf("\n%-12s %14s %14s %9s %12s\n", "capture", "iterator ns", "plan ns", "speedup", "plan hits");
+    for (unsigned int i = 0; i <= NUM_CAPTURES; i++) {
+        const rt_capture_t *sequence[NUM_CAPTURES];
+        int num = 1;
+        const char *name;
+        if (i < NUM_CAPTURES) {
+            sequence[0] = &captures[i];
+            name = captures[i].name;
+        } else {
+            // worst case: layout changes with every frame so the plan never hits
+            for (unsigned int j = 0; j < NUM_CAPTURES; j++)
+                sequence[j] = &captures[j];
+            num = NUM_CAPTURES;
+            name = "alternating";
+        }
+        double iterator_ns = bench(sequence, num, frames, false, &plan);
+        double plan_ns = bench(sequence, num, frames, true, &plan);
+        printf("%-12s %14.2f %14.2f %8.2fx %11.1f%%\n", name, iterator_ns, plan_ns, iterator_ns / plan_ns,
+               100.0 * plan.hit_cnt / (plan.hit_cnt + plan.miss_cnt));
+    }
+    return errors == 0 ? 0 : 1;
+}
@@ -10,6 +10,7 @@ void lib_init_packet_buffer(packet_buffer_t *p) {
 	p->crc_correct = 0;
 	p->len = 0;
 	p->data = NULL;
+	p->slot = NULL;
 }
 
 void lib_alloc_packet_buffer(packet_buffer_t *p, size_t len) {
@@ -23,7 +24,8 @@ void lib_alloc_packet_buffer(packet_buffer_t *p, size_t len) {
 void lib_free_packet_buffer(packet_buffer_t *p) {
 	assert(p != NULL);
 
-	free(p->data);
+	if (p->slot == NULL) // arena slots are owned by the arena
+		free(p->data);
 	p->len = 0;
 }
 
@@ -44,6 +46,64 @@ packet_buffer_t *lib_alloc_packet_buffer_list(size_t num_packets, size_t packet_
 	return retval;
 }
 
+/**
+ * Allocates one contiguous block of memory for all slots of the arena
+ *
+ * @param arena Arena to initialize
+ * @param num_slots Number of slots the arena can hand out
+ * @param slot_size Size of every slot in bytes
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+int lib_init_slot_arena(slot_arena_t *arena, size_t num_slots, size_t slot_size) {
+	assert(arena != NULL && num_slots > 0 && slot_size > 0);
+
+	arena->memory = (uint8_t *)calloc(num_slots, slot_size);
+	if (arena->memory == NULL)
+		return -1;
+	arena->slot_size = slot_size;
+	arena->num_slots = num_slots;
+	arena->used_slots = 0;
+	return 0;
+}
+
+/**
+ * @param arena
+ * @return Next unused slot of the arena or NULL if all slots are taken
+ */
+uint8_t *lib_take_arena_slot(slot_arena_t *arena) {
+	if (arena->used_slots >= arena->num_slots)
+		return NULL;
+	return arena->memory + arena->slot_size * arena->used_slots++;
+}
+
+/**
+ * Creates a list of packet buffers whose data lives in slots of the arena. Received frames can be stored by swapping
+ * the slot of the packet buffer with the slot the frame was received into.
+ *
+ * @param arena Arena with at least num_packets unused slots
+ * @param num_packets
+ * @return List of packet buffers or NULL if the arena does not have enough slots
+ */
+packet_buffer_t *lib_alloc_arena_packet_buffer_list(slot_arena_t *arena, size_t num_packets) {
+	packet_buffer_t *retval;
+	int i;
+
+	assert(num_packets > 0);
+	if (arena->num_slots - arena->used_slots < num_packets)
+		return NULL;
+
+	retval = (packet_buffer_t *)malloc(sizeof(packet_buffer_t) * num_packets);
+	assert(retval != NULL);
+
+	for(i=0; i<num_packets; ++i) {
+		lib_init_packet_buffer(retval + i);
+		retval[i].slot = lib_take_arena_slot(arena);
+		retval[i].data = retval[i].slot;
+	}
+
+	return retval;
+}
+
 void lib_free_packet_buffer_list(packet_buffer_t *p, size_t num_packets) {
 	int i;
 
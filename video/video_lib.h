@@ -2,6 +2,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include "../common/db_protocol.h"
 
 
@@ -10,17 +11,34 @@ typedef struct {
 	int crc_correct;
 	uint len; // this is the actual length of the packet stored in data
 	uint8_t *data; // this is video_packet_data_t
+	uint8_t *slot; // arena slot that contains data (NULL if data was allocated by lib_alloc_packet_buffer_list)
 } packet_buffer_t;
 
+// Preallocated pool of equally sized slots. Slots are never returned, owners swap them instead
+typedef struct {
+	uint8_t *memory;
+	size_t slot_size;
+	size_t num_slots;
+	size_t used_slots;
+} slot_arena_t;
+
 typedef struct {
 	int block_num;
 	int packet_buffer_len;  // number of packets stored in packet buffer
+	int good_packet_cnt;    // number of stored packets with correct FCS. Block can be decoded once it reaches k
+	bool released;          // block was decoded and delivered. Later packets of it are only counted
+	uint64_t first_rx_ns;   // arrival of the first packet of the block
+	uint8_t num_data;       // DATA packets (k) of this block as announced by the sender
+	uint8_t num_fec;        // FEC packets of this block as announced by the sender
+	uint8_t missing_fecs;   // FEC packets the block lacked to be repaired. 0 if it was repaired
 	packet_buffer_t *packet_buffer_list;
 } block_buffer_t;
 
 // outside of FEC
 typedef struct {
-    uint32_t sequence_number;
+    uint32_t sequence_number;   // block_num * (max. DATA + FEC packets per block) + position inside the block
+    uint8_t num_data;           // DATA packets in this block. Less than configured if the block was flushed early
+    uint8_t num_fec;            // FEC packets in this block
 } __attribute__((packed)) video_packet_header_t;
 
 // protected by FEC
@@ -35,4 +53,23 @@ typedef struct {
 	video_packet_data_t video_packet_data; // protected by FEC
 } __attribute__((packed)) db_video_packet_t;
 
+#define MAX_INTERLEAVE_DEPTH 16    // max. number of blocks video_air sends interleaved (-I)
+
+#define VIDEO_FEEDBACK_TYPE_LOSS 0x01
+#define VIDEO_FEEDBACK_HIST_LEN 16
+
+// Loss report video_gnd sends to video_air for adaptive FEC (DB_PORT_VIDEO, direction DB_DIREC_DRONE). Covers the
+// blocks video_gnd finished since its previous report. The last entry of a histogram counts that value or more
+typedef struct {
+    uint8_t type;               // VIDEO_FEEDBACK_TYPE_LOSS
+    uint8_t hist_len;           // VIDEO_FEEDBACK_HIST_LEN
+    uint16_t report_nr;
+    uint32_t packet_cnt;        // packets the reported blocks were sent with
+    uint16_t lost_hist[VIDEO_FEEDBACK_HIST_LEN];    // blocks by number of packets that were lost or arrived corrupt
+    uint16_t damage_hist[VIDEO_FEEDBACK_HIST_LEN];  // unrecoverable blocks by number of FEC packets they lacked
+} __attribute__((packed)) video_feedback_t;
+
 packet_buffer_t *lib_alloc_packet_buffer_list(size_t num_packets, size_t packet_length);
+int lib_init_slot_arena(slot_arena_t *arena, size_t num_slots, size_t slot_size);
+uint8_t *lib_take_arena_slot(slot_arena_t *arena);
+packet_buffer_t *lib_alloc_arena_packet_buffer_list(slot_arena_t *arena, size_t num_packets);
@@ -0,0 +1,309 @@
+/*
+ *   This file is part of DroneBridge: https://github.com/DroneBridge/DroneBridge
+ *
+ *   Copyright 2020 Wolfgang Christl
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+/**
+ * End to end benchmark of the video link without WiFi hardware. Starts video_air and video_gnd on an emulated adapter
+ * (see common/db_emu.h) and streams time stamped records through them. Every record fills one video packet, so a FEC
+ * block carries exactly <data packets> consecutive records. Reports goodput, block recovery rate and the latency
+ * distribution of the recovered blocks for the link impairments given with -e.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include "../common/db_emu.h"
+
+#define BENCH_MAGIC         0x44424c42  // "DBLB"
+#define BENCH_FLUSH_BLOCKS  2           // extra blocks sent after the measurement so that the last block gets out
+
+typedef struct {
+    uint32_t magic;
+    uint32_t index;
+    uint64_t write_ns;
+    uint32_t check;
+} __attribute__((packed)) bench_record_t;
+
+char *air_path = "./video_air", *gnd_path = "./video_gnd", *emu_config = "";
+int num_data = 8, num_fec = 4, pack_size = 1024, comm_id = 111, duration_s = 5;
+unsigned int rate_kbps = 4000;
+bool verbose = false;
+
+int record_length;          // payload of one video packet: pack_size minus the length field of the packet
+uint32_t num_records;       // records in the measurement. Multiple of num_data
+uint64_t *write_ns, *arrive_ns;
+uint32_t received_cnt = 0, corrupt_cnt = 0, duplicate_cnt = 0;
+
+static inline uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static inline bool is_record(const uint8_t *data) {
+    bench_record_t r;
+    memcpy(&r, data, sizeof(r));
+    return r.magic == BENCH_MAGIC && r.check == (r.index ^ 0xa5a5a5a5u ^ (uint32_t) r.write_ns);
+}
+
+/**
+ * Reads the decoded stream from video_gnd. Records of lost packets are missing, so the parser resyncs on the magic.
+ */
+void *reader_thread(void *arg) {
+    int fd = *(int *) arg;
+    size_t buf_size = (size_t) record_length * 64, fill = 0;
+    uint8_t *buf = malloc(buf_size);
+    ssize_t ret;
+    while ((ret = read(fd, buf + fill, buf_size - fill)) > 0) {
+        uint64_t now = now_ns();
+        fill += ret;
+        size_t pos = 0;
+        while (fill - pos >= (size_t) record_length) {
+            if (!is_record(buf + pos)) {
+                pos++;
+                corrupt_cnt++;
+                continue;
+            }
+            bench_record_t r;
+            memcpy(&r, buf + pos, sizeof(r));
+            if (r.index < num_records) {
+                if (arrive_ns[r.index] != 0)
+                    duplicate_cnt++;
+                else
+                    arrive_ns[r.index] = now;
+                received_cnt++;
+            }
+            pos += record_length;
+        }
+        memmove(buf, buf + pos, fill - pos);
+        fill -= pos;
+    }
+    free(buf);
+    return NULL;
+}
+
+/**
+ * Starts a module with stdin or stdout redirected to a pipe
+ *
+ * @param pipe_fd Returns our end of the pipe
+ * @param use_stdin true to write to stdin of the module, false to read its stdout
+ * @return PID of the module
+ */
+pid_t spawn_module(char *const argv[], int *pipe_fd, bool use_stdin) {
+    int fds[2];
+    if (pipe(fds) < 0) {
+        perror("DB_LINK_BENCH: pipe");
+        exit(-1);
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(use_stdin ? fds[0] : fds[1], use_stdin ? STDIN_FILENO : STDOUT_FILENO);
+        if (!verbose) {
+            int dev_null = open("/dev/null", O_WRONLY);
+            dup2(dev_null, STDERR_FILENO);
+            if (use_stdin)
+                dup2(dev_null, STDOUT_FILENO);
+        }
+        close(fds[0]);
+        close(fds[1]);
+        execv(argv[0], argv);
+        perror("DB_LINK_BENCH: Could not start module");
+        _exit(127);
+    } else if (pid < 0) {
+        perror("DB_LINK_BENCH: fork");
+        exit(-1);
+    }
+    close(use_stdin ? fds[0] : fds[1]);
+    *pipe_fd = use_stdin ? fds[1] : fds[0];
+    return pid;
+}
+
+int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+void process_command_line_args(int argc, char *argv[]) {
+    int c;
+    while ((c = getopt(argc, argv, "a:g:e:d:r:f:b:t:c:v")) != -1) {
+        switch (c) {
+            case 'a':
+                air_path = optarg;
+                break;
+            case 'g':
+                gnd_path = optarg;
+                break;
+            case 'e':
+                emu_config = optarg;
+                break;
+            case 'd':
+                num_data = (int) strtol(optarg, NULL, 10);
+                break;
+            case 'r':
+                num_fec = (int) strtol(optarg, NULL, 10);
+                break;
+            case 'f':
+                pack_size = (int) strtol(optarg, NULL, 10);
+                break;
+            case 'b':
+                rate_kbps = (unsigned int) strtoul(optarg, NULL, 10);
+                break;
+            case 't':
+                duration_s = (int) strtol(optarg, NULL, 10);
+                break;
+            case 'c':
+                comm_id = (int) strtol(optarg, NULL, 10);
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                printf("Hardware free benchmark of the video link. Runs video_air and video_gnd on an emulated adapter"
+                       "\n\n\t-a Path to video_air (default %s)"
+                       "\n\t-g Path to video_gnd (default %s)"
+                       "\n\t-e Link impairments, e.g. \"loss=0.1,burst=3,delay=2000,jitter=500,rate=12000\". See "
+                       "db_emu.h"
+                       "\n\t-d Number of data packets in a block (default %i)"
+                       "\n\t-r Number of FEC packets per block (default %i)"
+                       "\n\t-f Bytes per packet (default %i)"
+                       "\n\t-b Stream bit rate in kbit/s (default %u)"
+                       "\n\t-t Duration in seconds (default %i)"
+                       "\n\t-c Communication ID (default %i)"
+                       "\n\t-v Show output of the modules\n", air_path, gnd_path, num_data, num_fec, pack_size,
+                       rate_kbps, duration_s, comm_id);
+                exit(0);
+        }
+    }
+    if (num_data < 1 || num_fec < 0 || rate_kbps == 0 || duration_s < 1 ||
+        pack_size - (int) sizeof(uint32_t) < (int) sizeof(bench_record_t)) {
+        printf("DB_LINK_BENCH: Invalid parameters\n");
+        exit(-1);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    process_command_line_args(argc, argv);
+    signal(SIGPIPE, SIG_IGN);
+    record_length = pack_size - (int) sizeof(uint32_t);
+    uint64_t interval_ns = (uint64_t) record_length * 8 * 1000000ULL / rate_kbps;
+    num_records = (uint32_t) ((uint64_t) duration_s * 1000000000ULL / interval_ns);
+    num_records = (num_records / num_data + 1) * num_data;
+    write_ns = calloc(num_records, sizeof(uint64_t));
+    arrive_ns = calloc(num_records, sizeof(uint64_t));
+    if (write_ns == NULL || arrive_ns == NULL) {
+        printf("DB_LINK_BENCH: Out of memory\n");
+        return -1;
+    }
+
+    char adapter[IFNAMSIZ], comm_id_str[8], data_str[8], fec_str[8], pack_size_str[8];
+    snprintf(adapter, sizeof(adapter), "%sb%i", DB_EMU_IF_PREFIX, getpid());
+    snprintf(comm_id_str, sizeof(comm_id_str), "%i", comm_id);
+    snprintf(data_str, sizeof(data_str), "%i", num_data);
+    snprintf(fec_str, sizeof(fec_str), "%i", num_fec);
+    snprintf(pack_size_str, sizeof(pack_size_str), "%i", pack_size);
+    setenv(DB_EMU_ENV, emu_config, 1);
+    char *gnd_argv[] = {gnd_path, "-n", adapter, "-c", comm_id_str, "-d", data_str, "-r", fec_str, "-f",
+                        pack_size_str, "-u", "N", NULL};
+    char *air_argv[] = {air_path, "-n", adapter, "-c", comm_id_str, "-d", data_str, "-r", fec_str, "-f",
+                        pack_size_str, NULL};
+    int gnd_fd, air_fd;
+    pid_t gnd_pid = spawn_module(gnd_argv, &gnd_fd, false);
+    usleep(300000);     // video_gnd must be on the medium before video_air sends
+    pid_t air_pid = spawn_module(air_argv, &air_fd, true);
+    usleep(300000);
+    pthread_t reader;
+    pthread_create(&reader, NULL, reader_thread, &gnd_fd);
+
+    printf("DB_LINK_BENCH: %u records of %i bytes at %u kbit/s, %i data + %i FEC packets per block, link: %s\n",
+           num_records, record_length, rate_kbps, num_data, num_fec, strlen(emu_config) > 0 ? emu_config : "perfect");
+    uint8_t *record = calloc(1, (size_t) record_length);
+    uint32_t total = num_records + BENCH_FLUSH_BLOCKS * num_data;
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < total; i++) {
+        uint64_t due = start + i * interval_ns;
+        uint64_t now = now_ns();
+        if (due > now) {
+            struct timespec ts = {.tv_sec = (time_t) ((due - now) / 1000000000ULL),
+                                  .tv_nsec = (long) ((due - now) % 1000000000ULL)};
+            nanosleep(&ts, NULL);
+        }
+        bench_record_t r = {.magic = BENCH_MAGIC, .index = i, .write_ns = now_ns()};
+        r.check = r.index ^ 0xa5a5a5a5u ^ (uint32_t) r.write_ns;
+        if (i < num_records)
+            write_ns[i] = r.write_ns;
+        memcpy(record, &r, sizeof(r));
+        if (write(air_fd, record, (size_t) record_length) != record_length) {
+            printf("DB_LINK_BENCH: video_air stopped reading: %s\n", strerror(errno));
+            break;
+        }
+    }
+    uint64_t send_duration_ns = write_ns[num_records - 1] - write_ns[0];
+    usleep(500000);
+    close(air_fd);
+    kill(air_pid, SIGINT);
+    waitpid(air_pid, NULL, 0);
+    usleep(200000);
+    kill(gnd_pid, SIGINT);
+    waitpid(gnd_pid, NULL, 0);
+    pthread_join(reader, NULL);
+    close(gnd_fd);
+
+    uint32_t num_blocks = num_records / num_data, complete_blocks = 0, delivered = 0;
+    uint64_t *latency = malloc(sizeof(uint64_t) * num_blocks);
+    for (uint32_t b = 0; b < num_blocks; b++) {
+        uint64_t last_arrival = 0;
+        bool complete = true;
+        for (int p = 0; p < num_data; p++) {
+            uint64_t a = arrive_ns[b * num_data + p];
+            if (a == 0)
+                complete = false;
+            else
+                delivered++;
+            if (a > last_arrival)
+                last_arrival = a;
+        }
+        if (complete)
+            latency[complete_blocks++] = last_arrival - write_ns[b * num_data + num_data - 1];
+    }
+    qsort(latency, complete_blocks, sizeof(uint64_t), compare_u64);
+    double goodput_kbps = send_duration_ns > 0 ? delivered * (double) record_length * 8e6 / send_duration_ns : 0;
+    printf("DB_LINK_BENCH: goodput %.1f kbit/s, %u of %u records, %u of %u blocks complete (%.2f%%)\n",
+           goodput_kbps, delivered, num_records, complete_blocks, num_blocks, 100.0 * complete_blocks / num_blocks);
+    if (duplicate_cnt > 0 || corrupt_cnt > 0)
+        printf("DB_LINK_BENCH: %u duplicate records, %u bytes skipped while resyncing\n", duplicate_cnt, corrupt_cnt);
+    if (complete_blocks > 0)
+        printf("DB_LINK_BENCH: block latency p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+               latency[complete_blocks / 2] / 1e6, latency[complete_blocks * 9 / 10] / 1e6,
+               latency[complete_blocks * 99 / 100] / 1e6, latency[complete_blocks - 1] / 1e6);
+    free(latency);
+    free(record);
+    free(write_ns);
+    free(arrive_ns);
+    return received_cnt > 0 ? 0 : 1;
+}
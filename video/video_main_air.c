@@ -31,7 +31,9 @@
 #include <signal.h>
 #include <errno.h>
 #include <sys/un.h>
+#include <poll.h>
 #include "fec.h"
+#include "gf256.h"
 #include "video_lib.h"
 #include "../common/db_protocol.h"
 #include "../common/db_raw_send_receive.h"
@@ -43,29 +45,82 @@
 #define MAX_PACKET_LENGTH (DATA_UNI_LENGTH + RADIOTAP_LENGTH + DB_RAW_V2_HEADER_LENGTH)
 #define MAX_DATA_OR_FEC_PACKETS_PER_BLOCK 32
 #define MAX_USER_PACKET_LENGTH 1450
+#define NAL_UNIT_TYPE_IDR 5
+#define NAL_UNIT_TYPE_SPS 7
+#define NAL_UNIT_TYPE_PPS 8
 
 bool keeprunning = true;
 uint8_t comm_id, frame_type, db_vid_seqnum = 0;
 unsigned int num_interfaces = 0, num_data_per_block = 8, num_fec_per_block = 4, pack_size = 1024, bitrate_op = 11, vid_adhere_80211;
+int use_tx_ring;
+unsigned int max_block_age_ms, num_data_keyframe;
+bool adaptive_fec;                  // adjust the FEC packets per block to the loss reports of the ground station
+unsigned int min_fec_per_block;     // lower bound of the adaptive FEC. Upper bound is num_fec_per_block
+unsigned int curr_fec_per_block;    // FEC packets currently sent with a full block
+unsigned int interleave_depth;      // blocks that get sent interleaved. 1 = no interleaving
+unsigned int data_slot[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK], fec_slot[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
+uint32_t tx_ring_kick_cnt = 0;
+uint8_t *tx_ring_fallback_data[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];  // DATA packets of a block while the ring stalls
+bool block_in_tx_ring;              // DATA packet buffers of the current block point into the TX ring
 db_uav_status_t *db_uav_status;
 char adapters[DB_MAX_ADAPTERS][IFNAMSIZ];
 db_socket_t raw_sockets[DB_MAX_ADAPTERS];
+db_frame_batch_t block_batch;
 struct timespec start_time, end_time;
 
 volatile int recorder_running = 1;
 volatile uint32_t receive_count = 0;
 
+// H.264 Annex-B parser state
+typedef struct {
+    unsigned int zeros;     // zero bytes not yet written to a packet since they may belong to a start code
+    bool start_code;        // start code found. Next byte is the NAL unit header
+    bool protect;           // the current NAL unit is a SPS, PPS or IDR slice
+} nal_parser_t;
+
+// Cross-block interleaver: FEC encoded blocks wait until interleave_depth blocks are ready, then go on air together
+typedef struct {
+    uint32_t seq_nr;
+    unsigned int num_data;
+    unsigned int num_fec;
+    uint64_t ready_ns;          // time the block was FEC encoded
+} interleaved_block_t;
+
+typedef struct {
+    interleaved_block_t blocks[MAX_INTERLEAVE_DEPTH];
+    unsigned int num_blocks;    // blocks waiting to be sent
+    packet_buffer_t *pb_lists;  // DATA packets of all blocks. num_data_per_block per block
+    uint8_t *fec_pool;          // FEC packets of all blocks. num_fec_per_block of pack_size bytes per block
+} interleaver_t;
+
+interleaver_t interleaver;
+
 typedef struct {
     uint32_t seq_nr;
     int fd;
     int curr_pb;
     packet_buffer_t *pb_list;
+    uint64_t block_start_ms;    // time the first data of the current block was read. 0 if block is empty
+    bool protect;               // current block carries SPS, PPS or IDR data: fewer DATA packets, all FEC packets
+    nal_parser_t nal;
 } input_t;
 
 static inline int TimeSpecToUSeconds(struct timespec *ts) {
     return (int) (ts->tv_sec + ts->tv_nsec / 1000.0);
 }
 
+static inline uint64_t current_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static inline uint64_t current_time_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + (uint64_t) ts.tv_nsec / 1000000;
+}
+
 void int_handler(int dummy) {
     keeprunning = false;
 }
@@ -89,56 +144,342 @@ void write_to_unix(db_unix_tcp_client unix_server_clients[DB_MAX_UNIX_TCP_CLIENT
 }
 
 /**
- * Sends a DATA or FEC block or any other data using all available adapters
+ * Injects all frames of the batch (one FEC block) using all available adapters. One sendmmsg() per adapter.
+ *
+ * @param batch The batch containing DATA and FEC packets of a block
+ */
+void transmit_batch(db_frame_batch_t *batch) {
+    if (batch->num_frames == 0)
+        return;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    for (int i = 0; i < num_interfaces; i++) {
+        if (db_send_batch_div(&raw_sockets[i], batch) < batch->num_frames)
+            db_uav_status->injection_fail_cnt++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    db_uav_status->injected_packet_cnt += batch->num_frames;
+    db_uav_status->injection_batch_size = (uint16_t) batch->num_frames;
+    db_uav_status->injection_syscall_cnt = batch->syscall_cnt;
+    db_uav_status->injection_time_packet =
+            (TimeSpecToUSeconds(&end_time) - TimeSpecToUSeconds(&start_time)) / batch->num_frames;
+}
+
+/**
+ * Adds a DATA or FEC packet to the batch of the current block. Payload is referenced, not copied.
  *
+ * @param batch The batch of the current block
  * @param seq_nr Video header sequence number
- * @param data_uni_to_ground Pointer to transmission buffer
+ * @param num_data Number of DATA packets of the block
+ * @param num_fec Number of FEC packets of the block
  * @param packet_data Packet payload (FEC block or DATA block + length field)
  * @param data_length payload length
+ * @return 0 on success or -1 if the packet could not be added. It is counted as injection failure then
+ */
+int add_packet_to_batch(db_frame_batch_t *batch, uint32_t seq_nr, uint8_t num_data, uint8_t num_fec,
+                        uint8_t *packet_data, uint data_length) {
+    video_packet_header_t video_packet_header;
+    video_packet_header.sequence_number = seq_nr;
+    video_packet_header.num_data = num_data;
+    video_packet_header.num_fec = num_fec;
+    if (db_batch_add(batch, DB_PORT_VIDEO, update_seq_num(&db_vid_seqnum), (uint8_t *) &video_packet_header,
+                     sizeof(video_packet_header_t), packet_data, (uint16_t) data_length) < 0) {
+        db_uav_status->injection_fail_cnt++;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Calculates the position of every DATA and FEC packet inside the interleaved block. Must match with receiving side
+ *
+ * @param num_data Number of DATA packets of the block
+ * @param num_fec Number of FEC packets of the block
+ * @param d_slot Returns the position of every DATA packet
+ * @param f_slot Returns the position of every FEC packet
+ */
+void calc_block_slots(unsigned int num_data, unsigned int num_fec, unsigned int *d_slot, unsigned int *f_slot) {
+    unsigned int di = 0, fi = 0, slot = 0;
+    while (di < num_data || fi < num_fec) {
+        if (di < num_data) d_slot[di++] = slot++;
+        if (fi < num_fec) f_slot[fi++] = slot++;
+    }
+}
+
+/**
+ * Number of FEC packets sent along with a block of num_data DATA packets. Blocks that get flushed early keep the
+ * configured ratio of FEC to DATA packets (rounded up) so they are as well protected as full blocks.
+ */
+unsigned int fec_per_block(unsigned int num_data) {
+    return (curr_fec_per_block * num_data + num_data_per_block - 1) / num_data_per_block;
+}
+
+/**
+ * Adaptive FEC: Picks the FEC packets per block from a loss report of the ground station. Enough FEC packets to repair
+ * 99% of the reported blocks plus one in reserve. Increases at once if blocks could not be repaired, decreases by at
+ * most one packet per report.
+ *
+ * @param report Loss report as received from video_gnd
+ */
+void adapt_fec(const video_feedback_t *report) {
+    uint32_t num_blocks = 0, damaged_blocks = 0, blocks = 0;
+    for (int i = 0; i < VIDEO_FEEDBACK_HIST_LEN; i++) {
+        num_blocks += report->lost_hist[i];
+        damaged_blocks += report->damage_hist[i];
+    }
+    if (num_blocks == 0)
+        return;
+    unsigned int needed = 0;
+    while (needed < VIDEO_FEEDBACK_HIST_LEN - 1) {
+        blocks += report->lost_hist[needed];
+        if (blocks * 100 >= num_blocks * 99)
+            break;
+        needed++;
+    }
+    needed++;
+    if (damaged_blocks > 0 && needed <= curr_fec_per_block)
+        needed = curr_fec_per_block + 1;
+    else if (needed < curr_fec_per_block)
+        needed = curr_fec_per_block - 1;
+    if (needed > num_fec_per_block) needed = num_fec_per_block;
+    if (needed < min_fec_per_block) needed = min_fec_per_block;
+    if (needed != curr_fec_per_block) {
+        LOG_SYS_STD(LOG_INFO, "DB_VIDEO_AIR: Adaptive FEC: %u FEC packets per block (%u of %u blocks damaged, "
+                              "%u packets)\n", needed, damaged_blocks, num_blocks, report->packet_cnt);
+        curr_fec_per_block = needed;
+        db_uav_status->fec_per_block = (uint8_t) needed;
+    }
+}
+
+/**
+ * Adaptive FEC: Reads the loss reports the ground station sent since the last call. Does not block. Every report is
+ * sent via all adapters of the ground station, duplicates are skipped.
+ */
+void receive_feedback() {
+    static uint8_t rx_buffer[MAX_PACKET_LENGTH];
+    static uint16_t last_report_nr;
+    static bool got_report = false;
+    for (int k = 0; k < num_interfaces; k++) {
+        ssize_t rx_length;
+        while ((rx_length = recv(raw_sockets[k].db_socket, rx_buffer, MAX_PACKET_LENGTH, MSG_DONTWAIT)) > 0) {
+            uint16_t payload_length, radiotap_length;
+            db_seq_num_t seq_num;
+            video_feedback_t *report = (video_feedback_t *) get_db_payload_pointer_seq(rx_buffer, rx_length,
+                                                                                         &payload_length, &seq_num,
+                                                                                         &radiotap_length);
+            if (report == NULL || payload_length < sizeof(video_feedback_t) ||
+                report->type != VIDEO_FEEDBACK_TYPE_LOSS || report->hist_len != VIDEO_FEEDBACK_HIST_LEN)
+                continue;
+            if (got_report && report->report_nr == last_report_nr)
+                continue;
+            got_report = true;
+            last_report_nr = report->report_nr;
+            db_uav_status->feedback_report_cnt++;
+            adapt_fec(report);
+        }
+    }
+}
+
+/**
+ * DATA packets go on air only up to their data_length, the receiver fills up the rest with zeros. Clears the tail of
+ * every DATA packet so that the FEC encoder sees the same packets.
+ *
+ * @param pbl DATA packets of the block
+ * @param num_data Number of DATA packets
+ * @param packet_size FEC packet size
+ */
+void clear_data_packet_tails(packet_buffer_t *pbl, unsigned int num_data, uint packet_size) {
+    for (unsigned int i = 0; i < num_data; i++)
+        memset(pbl[i].data + pbl[i].len, 0, packet_size - pbl[i].len);
+}
+
+/**
+ * @return Number of bytes of a DATA packet (video_packet_data_t) that get injected. Long enough for the frame to carry
+ * the minimum DroneBridge payload
+ */
+static inline uint16_t data_packet_length(packet_buffer_t *pb) {
+    const uint min_length = DB_MIN_PAYLOAD_LENGTH_DATA_BEACON - sizeof(video_packet_header_t);
+    return (uint16_t) (pb->len < min_length ? min_length : pb->len);
+}
+
+/**
+ * Points the packet buffers of the next block directly into the TX ring of the first adapter. Data read from stdin
+ * ends up in the frame that gets injected without further copying. If the kernel does not release the frames in time
+ * (driver or medium stall) the block is read into tx_ring_fallback_data and copied into the ring when it gets sent.
+ *
+ * @param pbl Packet buffers of the block (video_packet_data_t)
+ */
+void assign_tx_ring_buffers(packet_buffer_t *pbl) {
+    static uint32_t stall_cnt = 0;
+    for (int i = 0; i < num_data_per_block; i++) {
+        uint8_t *payload = db_tx_ring_get_payload(raw_sockets[0].tx_ring, data_slot[i]);
+        if (payload == NULL) {
+            if (stall_cnt++ % 100 == 0)
+                LOG_SYS_STD(LOG_ERR, "DB_VIDEO_AIR: TX ring stalled %u times. Kernel does not release frames of "
+                                     "%s\n", stall_cnt, adapters[0]);
+            for (int j = 0; j < num_data_per_block; j++)
+                pbl[j].data = tx_ring_fallback_data[j];
+            block_in_tx_ring = false;
+            return;
+        }
+        pbl[i].data = payload + sizeof(video_packet_header_t);
+    }
+    block_in_tx_ring = true;
+}
+
+/**
+ * Copies the DATA packets of a block that was read while the TX ring stalled into their ring frames.
+ *
+ * @param pbl Packet buffers of the block pointing to tx_ring_fallback_data
+ * @param num_data Number of DATA packets in pbl
+ * @return 0 on success or -1 if the ring still has no free frames. The block must be dropped then
  */
-void transmit_packet(uint32_t seq_nr, uint8_t *packet_data, uint data_length) {
-    // create pointer directly to sockets send buffer (use of DB high performance send function)
-    struct data_uni *data_to_ground = get_hp_raw_buffer(vid_adhere_80211);
-    // set video packet to payload field of raw protocol buffer
-    db_video_packet_t *db_video_p = (db_video_packet_t *) (data_to_ground->bytes);
-    db_video_p->video_packet_header.sequence_number = seq_nr;
-    db_uav_status->injected_packet_cnt++;
-
-    //copy data to raw packet payload buffer (into video packet struct)
-    memcpy(&db_video_p->video_packet_data, packet_data, (size_t) data_length);
+int move_block_into_tx_ring(packet_buffer_t *pbl, unsigned int num_data) {
+    for (unsigned int i = 0; i < num_data; i++) {
+        uint8_t *payload = db_tx_ring_get_payload(raw_sockets[0].tx_ring, data_slot[i]);
+        if (payload == NULL)
+            return -1;
+        memcpy(payload + sizeof(video_packet_header_t), pbl[i].data, pbl[i].len);
+        pbl[i].data = payload + sizeof(video_packet_header_t);
+    }
+    return 0;
+}
+
+/**
+ * Same as transmit_block() but using the PACKET_TX_RING of every adapter. DATA packets already sit inside the ring of
+ * the first adapter, FEC packets get encoded directly into it. The block is then copied to the rings of all other
+ * adapters. One syscall per adapter and block.
+ *
+ * @param pbl Array where the future payload data is located as blocks of data (located inside the TX ring)
+ * @param seq_nr: video_packet_header_t sequence number
+ * @param packet_size: FEC packet size
+ * @param num_data: Number of DATA packets in pbl. Less than num_data_per_block if the block is flushed early
+ * @param num_fec: Number of FEC packets to generate. At most num_fec_per_block, less with adaptive FEC
+ */
+void transmit_block_tx_ring(packet_buffer_t *pbl, uint32_t *seq_nr, uint packet_size, unsigned int num_data,
+                            unsigned int num_fec) {
+    int i;
+    unsigned int num_frames = num_data + num_fec;
+    static uint8_t *data_blocks[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
+    static uint8_t *fec_blocks[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
+    static uint8_t *slot_payload[2 * MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
+    static uint16_t slot_length[2 * MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
+    unsigned int short_data_slot[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK], short_fec_slot[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
+    unsigned int *d_slot = data_slot, *f_slot = fec_slot;
+    db_tx_ring_t *ring = raw_sockets[0].tx_ring;
+
+    if (!block_in_tx_ring && move_block_into_tx_ring(pbl, num_data) < 0) {
+        LOG_SYS_STD(LOG_WARNING, "DB_VIDEO_AIR: TX ring still stalled. Skipping block\n");
+        db_uav_status->injection_fail_cnt++;
+        goto block_done;
+    }
+    if (num_data < num_data_per_block || num_fec < num_fec_per_block) {
+        // The DATA packets sit at their positions of a block with all FEC packets. Move them to the positions of the
+        // short block so that the block occupies consecutive ring frames. Packets only ever move towards the start.
+        calc_block_slots(num_data, num_fec, short_data_slot, short_fec_slot);
+        for (i = 0; i < num_data; ++i) {
+            if (short_data_slot[i] == data_slot[i])
+                continue;
+            uint8_t *payload = db_tx_ring_get_payload(ring, short_data_slot[i]);
+            if (payload == NULL) {
+                LOG_SYS_STD(LOG_WARNING, "DB_VIDEO_AIR: No free TX ring frame for DATA packet. Skipping block\n");
+                db_uav_status->injection_fail_cnt++;
+                goto block_done;
+            }
+            memmove(payload + sizeof(video_packet_header_t), pbl[i].data, pbl[i].len);
+            pbl[i].data = payload + sizeof(video_packet_header_t);
+        }
+        d_slot = short_data_slot;
+        f_slot = short_fec_slot;
+    }
+    for (i = 0; i < num_data; ++i) {
+        data_blocks[i] = pbl[i].data;
+        slot_payload[d_slot[i]] = pbl[i].data - sizeof(video_packet_header_t);
+        slot_length[d_slot[i]] = data_packet_length(&pbl[i]);
+    }
+    for (i = 0; i < num_fec; ++i) {
+        slot_payload[f_slot[i]] = db_tx_ring_get_payload(ring, f_slot[i]);
+        if (slot_payload[f_slot[i]] == NULL) {
+            LOG_SYS_STD(LOG_WARNING, "DB_VIDEO_AIR: No free TX ring frame for FEC packet. Skipping block\n");
+            db_uav_status->injection_fail_cnt++;
+            goto block_done;
+        }
+        fec_blocks[i] = slot_payload[f_slot[i]] + sizeof(video_packet_header_t);
+        slot_length[f_slot[i]] = (uint16_t) packet_size;
+    }
+
+    if (num_fec) { // Number of FEC packets per block can be 0
+        clock_gettime(CLOCK_MONOTONIC, &start_time);
+        clear_data_packet_tails(pbl, num_data, packet_size);
+        fec_encode(packet_size, data_blocks, num_data, (unsigned char **) fec_blocks, num_fec);
+        clock_gettime(CLOCK_MONOTONIC, &end_time);
+        db_uav_status->encoding_time = TimeSpecToUSeconds(&end_time) - TimeSpecToUSeconds(&start_time);
+    }
+
     clock_gettime(CLOCK_MONOTONIC, &start_time);
-    for (int i = 0; i < num_interfaces; i++) {
-        db_send_hp_div(&raw_sockets[i], DB_PORT_VIDEO, sizeof(video_packet_header_t) + data_length,
-                       update_seq_num(&db_vid_seqnum));
+    for (unsigned int slot = 0; slot < num_frames; slot++) {
+        video_packet_header_t *video_packet_header = (video_packet_header_t *) slot_payload[slot];
+        video_packet_header->sequence_number = *seq_nr + slot;
+        video_packet_header->num_data = (uint8_t) num_data;
+        video_packet_header->num_fec = (uint8_t) num_fec;
+        db_tx_ring_commit(ring, slot, DB_PORT_VIDEO, (uint16_t) (slot_length[slot] + sizeof(video_packet_header_t)),
+                          update_seq_num(&db_vid_seqnum));
+    }
+    for (int k = 1; k < num_interfaces; k++) {
+        for (unsigned int slot = 0; slot < num_frames; slot++) {
+            if (db_tx_ring_copy_frame(raw_sockets[k].tx_ring, ring, slot) < 0)
+                db_uav_status->injection_fail_cnt++;
+        }
+    }
+    for (int k = 0; k < num_interfaces; k++) {
+        if (db_send_tx_ring(raw_sockets[k].tx_ring, num_frames) < 0)
+            db_uav_status->injection_fail_cnt++;
+        tx_ring_kick_cnt++;
     }
     clock_gettime(CLOCK_MONOTONIC, &end_time);
-    db_uav_status->injection_time_packet = TimeSpecToUSeconds(&end_time) - TimeSpecToUSeconds(&start_time);
-    // if (db_uav_status->injection_time_packet < 1) db_uav_status->injection_fail_cnt++;
+    db_uav_status->injected_packet_cnt += num_frames;
+    db_uav_status->injection_batch_size = (uint16_t) num_frames;
+    db_uav_status->injection_syscall_cnt = tx_ring_kick_cnt;
+    db_uav_status->injection_time_packet =
+            (TimeSpecToUSeconds(&end_time) - TimeSpecToUSeconds(&start_time)) / num_frames;
+    // block sent: update sequence number. Blocks always span the sequence numbers of a full block
+    *seq_nr += num_data_per_block + num_fec_per_block;
+    db_uav_status->injected_block_cnt++;
+
+block_done:
+    for (i = 0; i < num_data_per_block; ++i) {
+        pbl[i].len = 0;
+    }
+    assign_tx_ring_buffers(pbl);
 }
 
 /**
- * Takes payload data (a block), generates FEC block for DATA and sends DATA and FEC packets interleaved
+ * Takes payload data (a block), generates FEC block for DATA and sends DATA and FEC packets interleaved. DATA packets
+ * are sent without the unused end of the packet, FEC packets always have packet_size bytes.
  *
  * @param pbl Array where the future payload data is located as blocks of data (payload is split into arrays)
  * @param seq_nr: video_packet_header_t sequence number
  * @param packet_size: FEC packet size
+ * @param num_data: Number of DATA packets in pbl. Less than num_data_per_block if the block is flushed early
+ * @param num_fec: Number of FEC packets to generate. At most num_fec_per_block
  */
-void transmit_block(packet_buffer_t *pbl, uint32_t *seq_nr, uint packet_size) {
+void transmit_block(packet_buffer_t *pbl, uint32_t *seq_nr, uint packet_size, unsigned int num_data,
+                    unsigned int num_fec) {
     int i;
     static uint8_t *data_blocks[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
     static uint8_t fec_pool[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK][MAX_USER_PACKET_LENGTH];
     static uint8_t *fec_blocks[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
 
-    for (i = 0; i < num_data_per_block; ++i) {
+    for (i = 0; i < num_data; ++i) {
         data_blocks[i] = pbl[i].data;
     }
-    for (i = 0; i < num_fec_per_block; ++i) {
+    for (i = 0; i < num_fec; ++i) {
         fec_blocks[i] = fec_pool[i];
     }
 
-    if (num_fec_per_block) { // Number of FEC packets per block can be 0
+    if (num_fec) { // Number of FEC packets per block can be 0
         clock_gettime(CLOCK_MONOTONIC, &start_time);
-        fec_encode(packet_size, data_blocks, num_data_per_block, (unsigned char **) fec_blocks, num_fec_per_block);
+        clear_data_packet_tails(pbl, num_data, packet_size);
+        fec_encode(packet_size, data_blocks, num_data, (unsigned char **) fec_blocks, num_fec);
         clock_gettime(CLOCK_MONOTONIC, &end_time);
         db_uav_status->encoding_time = TimeSpecToUSeconds(&end_time) - TimeSpecToUSeconds(&start_time);
     }
@@ -147,20 +488,24 @@ void transmit_block(packet_buffer_t *pbl, uint32_t *seq_nr, uint packet_size) {
     int di = 0;
     int fi = 0;
     uint32_t seq_nr_tmp = *seq_nr;
-    while (di < num_data_per_block || fi < num_fec_per_block) {
-        if (di < num_data_per_block) {
-            transmit_packet(seq_nr_tmp, data_blocks[di], packet_size);
+    db_batch_reset(&block_batch);
+    while (di < num_data || fi < num_fec) {
+        if (di < num_data) {
+            add_packet_to_batch(&block_batch, seq_nr_tmp, num_data, num_fec, data_blocks[di],
+                                data_packet_length(&pbl[di]));
             seq_nr_tmp++; // every packet gets a sequence number
             di++;
         }
 
-        if (fi < num_fec_per_block) {
-            transmit_packet(seq_nr_tmp, fec_pool[fi], packet_size);
+        if (fi < num_fec) {
+            add_packet_to_batch(&block_batch, seq_nr_tmp, num_data, num_fec, fec_pool[fi], packet_size);
             seq_nr_tmp++; // every packet gets a sequence number
             fi++;
         }
     }
-    *seq_nr += num_data_per_block + num_fec_per_block; // block sent: update sequence number
+    transmit_batch(&block_batch);
+    // block sent: update sequence number. Blocks always span the sequence numbers of a full block
+    *seq_nr += num_data_per_block + num_fec_per_block;
 
     //reset the length back
     for (i = 0; i < num_data_per_block; ++i) {
@@ -169,11 +514,283 @@ void transmit_block(packet_buffer_t *pbl, uint32_t *seq_nr, uint packet_size) {
     db_uav_status->injected_block_cnt++;
 }
 
+/**
+ * Finds the packet that goes into a slot of a block. Inverse of calc_block_slots()
+ *
+ * @param num_data Number of DATA packets of the block
+ * @param num_fec Number of FEC packets of the block
+ * @param slot Position inside the block
+ * @param index Returns the index of the DATA or FEC packet
+ * @return true if the slot holds a DATA packet, false for a FEC packet
+ */
+static inline bool slot_packet(unsigned int num_data, unsigned int num_fec, unsigned int slot, unsigned int *index) {
+    unsigned int pairs = num_data < num_fec ? num_data : num_fec;
+    if (slot < 2 * pairs) {
+        *index = slot / 2;
+        return slot % 2 == 0;
+    }
+    *index = slot - pairs;
+    return num_data > num_fec;
+}
+
+/**
+ * Injects all blocks waiting in the interleaver. Packets go on air round robin: first packet of every block, second
+ * packet of every block and so on. A burst that hits up to interleave_depth consecutive packets takes at most one
+ * packet of each block. Every packet keeps the sequence number of its position inside its own block.
+ *
+ * @param input Input that owns the interleaver. Its first packet buffer is the current one afterwards
+ */
+void transmit_interleaved_blocks(input_t *input) {
+    unsigned int max_length = 0;
+    for (unsigned int b = 0; b < interleaver.num_blocks; b++) {
+        if (interleaver.blocks[b].num_data + interleaver.blocks[b].num_fec > max_length)
+            max_length = interleaver.blocks[b].num_data + interleaver.blocks[b].num_fec;
+    }
+    db_batch_reset(&block_batch);
+    for (unsigned int slot = 0; slot < max_length; slot++) {
+        for (unsigned int b = 0; b < interleaver.num_blocks; b++) {
+            interleaved_block_t *block = &interleaver.blocks[b];
+            unsigned int index;
+            if (slot >= block->num_data + block->num_fec)
+                continue;
+            if (slot_packet(block->num_data, block->num_fec, slot, &index)) {
+                packet_buffer_t *pb = &interleaver.pb_lists[b * num_data_per_block + index];
+                add_packet_to_batch(&block_batch, block->seq_nr + slot, block->num_data, block->num_fec, pb->data,
+                                    data_packet_length(pb));
+            } else {
+                add_packet_to_batch(&block_batch, block->seq_nr + slot, block->num_data, block->num_fec,
+                                    interleaver.fec_pool + (b * num_fec_per_block + index) * pack_size, pack_size);
+            }
+            if (block_batch.num_frames == DB_MAX_BATCH_FRAMES) {
+                transmit_batch(&block_batch);
+                db_batch_reset(&block_batch);
+            }
+        }
+    }
+    if (block_batch.num_frames > 0)
+        transmit_batch(&block_batch);
+
+    // time the blocks waited for the others. Smoothed over the last ~16 interleaved groups
+    uint64_t now_ns = current_time_ns(), delay_ns = 0;
+    for (unsigned int b = 0; b < interleaver.num_blocks; b++)
+        delay_ns += now_ns - interleaver.blocks[b].ready_ns;
+    uint32_t delay_us = (uint32_t) (delay_ns / interleaver.num_blocks / 1000);
+    uint32_t avg_us = db_uav_status->interleave_delay_us;
+    db_uav_status->interleave_delay_us = avg_us == 0 ? delay_us : avg_us - avg_us / 16 + delay_us / 16;
+
+    for (unsigned int i = 0; i < interleaver.num_blocks * num_data_per_block; i++)
+        interleaver.pb_lists[i].len = 0;
+    db_uav_status->injected_block_cnt += interleaver.num_blocks;
+    interleaver.num_blocks = 0;
+    input->pb_list = interleaver.pb_lists;
+    input->block_start_ms = 0;
+}
+
+/**
+ * FEC encodes the current block of the input and puts it into the interleaver. Sends all blocks of the interleaver
+ * once interleave_depth blocks are ready.
+ *
+ * @param input Input with the block. Its current packet buffers are those of the next block afterwards
+ * @param num_data Number of DATA packets of the block
+ * @param num_fec Number of FEC packets to generate. At most num_fec_per_block
+ */
+void interleave_block(input_t *input, unsigned int num_data, unsigned int num_fec) {
+    static uint8_t *data_blocks[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
+    static uint8_t *fec_blocks[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
+    interleaved_block_t *block = &interleaver.blocks[interleaver.num_blocks];
+    for (unsigned int i = 0; i < num_data; ++i)
+        data_blocks[i] = input->pb_list[i].data;
+    for (unsigned int i = 0; i < num_fec; ++i)
+        fec_blocks[i] = interleaver.fec_pool + (interleaver.num_blocks * num_fec_per_block + i) * pack_size;
+    if (num_fec) {
+        clock_gettime(CLOCK_MONOTONIC, &start_time);
+        clear_data_packet_tails(input->pb_list, num_data, pack_size);
+        fec_encode(pack_size, data_blocks, num_data, (unsigned char **) fec_blocks, num_fec);
+        clock_gettime(CLOCK_MONOTONIC, &end_time);
+        db_uav_status->encoding_time = TimeSpecToUSeconds(&end_time) - TimeSpecToUSeconds(&start_time);
+    }
+    block->seq_nr = input->seq_nr;
+    block->num_data = num_data;
+    block->num_fec = num_fec;
+    block->ready_ns = current_time_ns();
+    // Blocks always span the sequence numbers of a full block
+    input->seq_nr += num_data_per_block + num_fec_per_block;
+    interleaver.num_blocks++;
+    if (interleaver.num_blocks == interleave_depth)
+        transmit_interleaved_blocks(input);
+    else
+        input->pb_list = interleaver.pb_lists + interleaver.num_blocks * num_data_per_block;
+}
+
+/**
+ * FEC encodes and injects the current block of the input. Blocks with SPS, PPS or IDR data get all FEC packets, others
+ * get FEC packets in proportion to their DATA packets.
+ *
+ * @param input Input with the block to send. Its first packet buffer is the current one afterwards
+ * @param num_data Number of DATA packets of the block that hold data
+ */
+void send_block(input_t *input, unsigned int num_data) {
+    static uint32_t sent_block_cnt = 0;
+    unsigned int num_fec = fec_per_block(num_data);
+    if (input->protect) {
+        num_fec = num_fec_per_block;
+        db_uav_status->protected_block_cnt++;
+    }
+    // FEC encode packets of length pack_size. DATA packets are zero padded for that but only sent up to data_length
+    if (interleave_depth > 1)
+        interleave_block(input, num_data, num_fec);
+    else if (use_tx_ring)
+        transmit_block_tx_ring(input->pb_list, &(input->seq_nr), pack_size, num_data, num_fec);
+    else
+        transmit_block(input->pb_list, &(input->seq_nr), pack_size, num_data, num_fec); // input->pb_list is video_packet_data_t[num_fec + num_data]
+    if (++sent_block_cnt % 500 == 1) {
+        LOG_SYS_STD(LOG_INFO,
+                    "DB_VIDEO_AIR: \ttried to inject %i packets, maybe failed %i, injection time/packet %ius, "
+                    "FEC encoding time %ius, %i frames/batch, %i syscalls, %i blocks flushed early, "
+                    "%i keyframe blocks, %i FEC packets/block, %i loss reports, interleaver delay %ius         \n",
+                    db_uav_status->injected_packet_cnt, db_uav_status->injection_fail_cnt,
+                    db_uav_status->injection_time_packet, db_uav_status->encoding_time,
+                    db_uav_status->injection_batch_size, db_uav_status->injection_syscall_cnt,
+                    db_uav_status->flushed_block_cnt, db_uav_status->protected_block_cnt,
+                    db_uav_status->fec_per_block, db_uav_status->feedback_report_cnt,
+                    db_uav_status->interleave_delay_us);
+    }
+    input->curr_pb = 0;
+    if (interleaver.num_blocks == 0)
+        input->block_start_ms = 0;  // otherwise the max. age applies to the oldest block waiting in the interleaver
+    input->protect = false;
+    if (adaptive_fec)
+        receive_feedback();
+}
+
+/**
+ * Closes the current packet of the block. Sends the block if the packet was its last one
+ *
+ * @param input Input with the packet to close
+ */
+void finish_packet(input_t *input) {
+    packet_buffer_t *pb = input->pb_list + input->curr_pb;
+    // fill packet buffer length field
+    ((video_packet_data_t *) pb->data)->data_length = pb->len;
+    unsigned int block_length = input->protect ? num_data_keyframe : num_data_per_block;
+    if (input->curr_pb >= block_length - 1) {
+        // transmit entire block - consisting of packets that get sent interleaved
+        send_block(input, block_length);
+    } else {
+        input->curr_pb++;
+    }
+}
+
+/**
+ * Sends the block with the DATA packets it has so far. An unfinished packet goes out as it is.
+ *
+ * @param input Input with a block that holds data
+ */
+void send_partial_block(input_t *input) {
+    packet_buffer_t *pb = input->pb_list + input->curr_pb;
+    unsigned int num_data = (unsigned int) input->curr_pb;
+    if (pb->len > sizeof(uint32_t)) {
+        ((video_packet_data_t *) pb->data)->data_length = pb->len;
+        num_data++;
+    }
+    send_block(input, num_data);
+}
+
+/**
+ * The max. block age expired: Sends the current block with the data it has so far and all blocks waiting in the
+ * interleaver.
+ *
+ * @param input
+ */
+void flush_blocks(input_t *input) {
+    packet_buffer_t *pb = input->pb_list + input->curr_pb;
+    if (input->curr_pb > 0 || pb->len > sizeof(uint32_t)) {
+        db_uav_status->flushed_block_cnt++;
+        send_partial_block(input);
+    }
+    if (interleaver.num_blocks > 0)
+        transmit_interleaved_blocks(input);
+}
+
+/**
+ * Appends a byte of the H.264 stream to the current packet. Closes the packet once it is full.
+ */
+static inline void nal_append(input_t *input, uint8_t byte) {
+    packet_buffer_t *pb = input->pb_list + input->curr_pb;
+    if (pb->len == 0)
+        pb->len = sizeof(uint32_t); //make space for a length field (will be filled later)
+    if (input->curr_pb == 0 && pb->len == sizeof(uint32_t)) {
+        // first byte of a new block. The block carries the kind of NAL unit it starts with
+        input->protect = input->nal.protect;
+        if (max_block_age_ms > 0 && input->block_start_ms == 0)
+            input->block_start_ms = current_time_ms();
+    }
+    pb->data[pb->len++] = byte;
+    if (pb->len == pack_size)
+        finish_packet(input);
+}
+
+/**
+ * Called at the start of every NAL unit. The NAL unit begins a new packet. SPS, PPS and IDR slices are kept apart from
+ * other NAL units in blocks of their own so that they can get a stronger FEC ratio.
+ *
+ * @param input
+ * @param nal_unit_type Type from the NAL unit header
+ */
+void start_nal_unit(input_t *input, uint8_t nal_unit_type) {
+    packet_buffer_t *pb = input->pb_list + input->curr_pb;
+    bool packet_empty = pb->len <= sizeof(uint32_t);
+    input->nal.protect = nal_unit_type == NAL_UNIT_TYPE_SPS || nal_unit_type == NAL_UNIT_TYPE_PPS ||
+                         nal_unit_type == NAL_UNIT_TYPE_IDR;
+    if (input->curr_pb == 0 && packet_empty)
+        return;
+    if (input->nal.protect != input->protect)
+        send_partial_block(input);
+    else if (!packet_empty)
+        finish_packet(input);
+}
+
+/**
+ * Packetizes a H.264 Annex-B byte stream. Every NAL unit starts with its start code at the beginning of a packet.
+ * Zero bytes are held back until it is clear whether they are part of a start code.
+ *
+ * @param input
+ * @param data Stream data as read from stdin
+ * @param length Length of data
+ */
+void packetize_nal_units(input_t *input, const uint8_t *data, size_t length) {
+    nal_parser_t *nal = &input->nal;
+    for (size_t i = 0; i < length; i++) {
+        uint8_t byte = data[i];
+        if (nal->start_code) {
+            nal->start_code = false;
+            start_nal_unit(input, (uint8_t) (byte & 0x1fu));
+            for (; nal->zeros > 0; nal->zeros--)
+                nal_append(input, 0);
+            nal_append(input, 1);
+            nal_append(input, byte);
+        } else if (byte == 0) {
+            if (nal->zeros == 3) // a start code has at most three zero bytes
+                nal_append(input, 0);
+            else
+                nal->zeros++;
+        } else if (byte == 1 && nal->zeros >= 2) {
+            nal->start_code = true;
+        } else {
+            for (; nal->zeros > 0; nal->zeros--)
+                nal_append(input, 0);
+            nal_append(input, byte);
+        }
+    }
+}
+
 void process_command_line_args(int argc, char *argv[]) {
     num_interfaces = 0, comm_id = DEFAULT_V2_COMMID, bitrate_op = 11;
     num_data_per_block = 8, num_fec_per_block = 4, pack_size = 1024, frame_type = 1, vid_adhere_80211 = 0;
+    use_tx_ring = 0, max_block_age_ms = 0, num_data_keyframe = 0, adaptive_fec = false, min_fec_per_block = 0;
+    interleave_depth = 1;
     int c;
-    while ((c = getopt(argc, argv, "n:c:d:r:f:b:t:a:")) != -1) {
+    while ((c = getopt(argc, argv, "n:c:d:r:f:b:t:a:ml:k:F:I:")) != -1) {
         switch (c) {
             case 'n':
                 strncpy(adapters[num_interfaces], optarg, IFNAMSIZ);
@@ -199,6 +816,22 @@ void process_command_line_args(int argc, char *argv[]) {
             case 'a':
                 vid_adhere_80211 = (uint) strtol(optarg, NULL, 10);
                 break;
+            case 'm':
+                use_tx_ring = 1;
+                break;
+            case 'l':
+                max_block_age_ms = (unsigned int) strtol(optarg, NULL, 10);
+                break;
+            case 'k':
+                num_data_keyframe = (unsigned int) strtol(optarg, NULL, 10);
+                break;
+            case 'F':
+                adaptive_fec = true;
+                min_fec_per_block = (unsigned int) strtol(optarg, NULL, 10);
+                break;
+            case 'I':
+                interleave_depth = (unsigned int) strtol(optarg, NULL, 10);
+                break;
             default:
                 printf("Based of Wifibroadcast by befinitiv, based on packetspammer by Andy Green.  Licensed under GPL2\n"
                        "This tool takes a data stream via the DroneBridge long range video port and outputs it via stdout, "
@@ -215,7 +848,23 @@ void process_command_line_args(int argc, char *argv[]) {
                        "supported with Ralink chipsets)"
                        "\n\t-t [1|2] DroneBridge v2 raw protocol packet/frame type: 1=RTS, 2=DATA (CTS protection)"
                        "\n\t-a [0|1] disable/enable. Offsets the payload by some bytes so that it sits outside the "
-                       "802.11 header. Set this to 1 if you are using a non DB-Rasp Kernel!\n", 1024, DATA_UNI_LENGTH);
+                       "802.11 header. Set this to 1 if you are using a non DB-Rasp Kernel!"
+                       "\n\t-m Inject using a memory mapped TX ring (PACKET_TX_RING). FEC packets get encoded directly "
+                       "into the ring. One syscall per block and adapter"
+                       "\n\t-l [ms] Max. age of a block. If the block is not full by then it gets sent with the DATA "
+                       "packets it has so far and proportionally less FEC packets. Bounds the latency added when the "
+                       "video bit rate is low. 0 = always wait for full blocks (default)"
+                       "\n\t-k [num] Input is a H.264 Annex-B stream. Every NAL unit starts a new packet. SPS, PPS and "
+                       "IDR slices go into blocks of at most [num] DATA packets that get all -r FEC packets. Choose "
+                       "[num] < -d for a stronger FEC ratio on keyframes. 0 = treat input as plain bytes (default)"
+                       "\n\t-F [min] Adaptive FEC: Adjust the FEC packets per block between [min] and -r to the loss "
+                       "reports of the ground station (video_gnd -F). Starts with -r. Keyframe blocks (-k) always get "
+                       "-r FEC packets"
+                       "\n\t-I [depth] Interleave the packets of [depth] consecutive blocks so that a burst loss hits "
+                       "each of them only once. Adds the time it takes to fill [depth] - 1 blocks to the latency (bound "
+                       "by -l). Needs to match with rx (video_gnd -I). Injects via sendmmsg(), -m is ignored. "
+                       "Default: 1 = no interleaving\n",
+                       1024, DATA_UNI_LENGTH);
                 abort();
         }
     }
@@ -239,9 +888,14 @@ int main(int argc, char *argv[]) {
     db_uav_status->skipped_fec_cnt = 0, db_uav_status->injected_block_cnt = 0,
     db_uav_status->injection_time_packet = 0, db_uav_status->wifi_adapter_cnt = num_interfaces;
     db_uav_status->injected_packet_cnt = 0;
+    db_uav_status->injection_batch_size = 0, db_uav_status->injection_syscall_cnt = 0;
+    db_uav_status->flushed_block_cnt = 0, db_uav_status->protected_block_cnt = 0;
+    db_uav_status->fec_per_block = (uint8_t) num_fec_per_block, db_uav_status->feedback_report_cnt = 0;
+    db_uav_status->interleave_depth = (uint8_t) interleave_depth, db_uav_status->interleave_delay_us = 0;
     db_uav_status->encoding_time = 0;
     int param_min_packet_length = 24;
     uint8_t some_buff[1];
+    static uint8_t nal_read_buffer[DATA_UNI_LENGTH];
 
     if (num_interfaces == 0) {
         LOG_SYS_STD(LOG_ERR, "DB_VIDEO_AIR: No interface specified. Aborting\n");
@@ -268,19 +922,55 @@ int main(int argc, char *argv[]) {
         abort();
     }
 
+    if (adaptive_fec && min_fec_per_block > num_fec_per_block) {
+        LOG_SYS_STD(LOG_ERR, "DB_VIDEO_AIR: Min. FEC packets of the adaptive FEC exceed the FEC packets per block "
+                             "(%d > %d)\n", min_fec_per_block, num_fec_per_block);
+        abort();
+    }
+    curr_fec_per_block = num_fec_per_block;
+
+    if (interleave_depth < 1 || interleave_depth > MAX_INTERLEAVE_DEPTH) {
+        LOG_SYS_STD(LOG_ERR, "DB_VIDEO_AIR: Interleaver depth must be between 1 and %d\n", MAX_INTERLEAVE_DEPTH);
+        abort();
+    }
+    if (interleave_depth > 1 && use_tx_ring) {
+        LOG_SYS_STD(LOG_WARNING, "DB_VIDEO_AIR: Interleaving injects via sendmmsg(). Not using the TX ring\n");
+        use_tx_ring = 0;
+    }
+
+    if (num_data_keyframe > num_data_per_block) {
+        LOG_SYS_STD(LOG_ERR, "DB_VIDEO_AIR: Keyframe blocks can not have more DATA packets than other blocks (%d > %d)\n",
+                    num_data_keyframe, num_data_per_block);
+        abort();
+    }
+
     input.fd = STDIN_FILENO;
     input.seq_nr = 0;
     input.curr_pb = 0;
-    input.pb_list = lib_alloc_packet_buffer_list(num_data_per_block, MAX_PACKET_LENGTH);
+    input.block_start_ms = 0;
+    input.protect = false;
+    memset(&input.nal, 0, sizeof(nal_parser_t));
+    input.pb_list = lib_alloc_packet_buffer_list(num_data_per_block * interleave_depth, MAX_PACKET_LENGTH);
+    interleaver.num_blocks = 0;
+    interleaver.pb_lists = input.pb_list;
+    interleaver.fec_pool = NULL;
+    if (interleave_depth > 1 && num_fec_per_block > 0) {
+        interleaver.fec_pool = malloc((size_t) interleave_depth * num_fec_per_block * pack_size);
+        if (interleaver.fec_pool == NULL) {
+            LOG_SYS_STD(LOG_ERR, "DB_VIDEO_AIR: Could not allocate the interleaver\n");
+            abort();
+        }
+    }
 
     //prepare the buffers with headers
     int j = 0;
-    for (j = 0; j < num_data_per_block; ++j) {
+    for (j = 0; j < num_data_per_block * interleave_depth; ++j) {
         input.pb_list[j].len = 0;
     }
 
     //initialize forward error correction
     fec_init();
+    LOG_SYS_STD(LOG_INFO, "DB_VIDEO_AIR: Using %s GF(256) kernel\n", gf256_kernel_name());
 
     // open DroneBridge raw sockets
     for (int k = 0; k < num_interfaces; ++k) {
@@ -288,6 +978,25 @@ int main(int argc, char *argv[]) {
                                         frame_type);
         strncpy(db_uav_status->adapter[k].name, adapters[k], IFNAMSIZ);
     }
+    db_batch_init(&block_batch, &raw_sockets[0], vid_adhere_80211);
+    calc_block_slots(num_data_per_block, num_fec_per_block, data_slot, fec_slot);
+    if (use_tx_ring) {
+        for (int k = 0; k < num_interfaces; ++k) {
+            if (db_socket_enable_tx_ring(&raw_sockets[k], DB_TX_RING_FRAME_NR, vid_adhere_80211) < 0) {
+                LOG_SYS_STD(LOG_WARNING, "DB_VIDEO_AIR: Could not set up TX ring on %s. Using sendmmsg()\n",
+                            adapters[k]);
+                for (int l = 0; l < k; l++) db_socket_disable_tx_ring(&raw_sockets[l]);
+                use_tx_ring = 0;
+                break;
+            }
+        }
+        if (use_tx_ring) {
+            for (j = 0; j < num_data_per_block; ++j) {
+                tx_ring_fallback_data[j] = input.pb_list[j].data;
+            }
+            assign_tx_ring_buffers(input.pb_list);
+        }
+    }
 // -------------------------------
 // Setting up unix tcp server for local apps to access data received via pipe
 // -------------------------------
@@ -298,6 +1007,16 @@ int main(int argc, char *argv[]) {
     unsigned int addrlen = sizeof(unix_server.addr);
     for (int i = 0; i < DB_MAX_UNIX_TCP_CLIENTS; i++) unix_server_clients[i].client_sock = -1;
 
+    if (max_block_age_ms > 0)
+        LOG_SYS_STD(LOG_INFO, "DB_VIDEO_AIR: Flushing blocks older than %ums\n", max_block_age_ms);
+    if (interleave_depth > 1)
+        LOG_SYS_STD(LOG_INFO, "DB_VIDEO_AIR: Interleaving the packets of %u blocks\n", interleave_depth);
+    if (num_data_keyframe > 0)
+        LOG_SYS_STD(LOG_INFO, "DB_VIDEO_AIR: H.264 packetizing. SPS/PPS/IDR blocks: %u DATA, %u FEC packets\n",
+                    num_data_keyframe, num_fec_per_block);
+    if (adaptive_fec)
+        LOG_SYS_STD(LOG_INFO, "DB_VIDEO_AIR: Adaptive FEC between %u and %u FEC packets per block\n",
+                    min_fec_per_block, num_fec_per_block);
     LOG_SYS_STD(LOG_INFO, "DB_VIDEO_AIR: started!\n");
     while (keeprunning) {
         // do some unix server stuff - accept new clients
@@ -323,9 +1042,23 @@ int main(int argc, char *argv[]) {
         if (pb->len == 0) {
             pb->len += sizeof(uint32_t); //make space for a length field (will be filled later)
         }
-        //read the data into packet buffer (inside block)
-        ssize_t inl = read(input.fd, pb->data + pb->len, pack_size - pb->len);
-        if (inl < 0 || inl > pack_size - pb->len) {
+        // wait for more data only as long as the block may still grow. Then send what we have
+        if (max_block_age_ms > 0 && input.block_start_ms > 0) {
+            uint64_t deadline_ms = input.block_start_ms + max_block_age_ms, now_ms = current_time_ms();
+            struct pollfd input_pfd = {.fd = input.fd, .events = POLLIN};
+            int ready = deadline_ms > now_ms ? poll(&input_pfd, 1, (int) (deadline_ms - now_ms)) : 0;
+            if (ready < 0 && errno == EINTR)
+                continue;
+            if (ready == 0) {
+                flush_blocks(&input);
+                continue;
+            }
+        }
+        //read the data into packet buffer (inside block). The H.264 packetizer reads into a buffer and copies from there
+        uint8_t *read_buffer = num_data_keyframe > 0 ? nal_read_buffer : pb->data + pb->len;
+        size_t read_length = num_data_keyframe > 0 ? pack_size : pack_size - pb->len;
+        ssize_t inl = read(input.fd, read_buffer, read_length);
+        if (inl < 0 || inl > read_length) {
             perror("DB_VIDEO_AIR: reading stdin\n");
             abort();
         }
@@ -335,31 +1068,18 @@ int main(int argc, char *argv[]) {
             usleep((__useconds_t) 5e5);
             continue;
         }
-        write_to_unix(unix_server_clients, &pb->data[pb->len], inl);    // write received data to UNIX clients
-        pb->len += inl;
+        write_to_unix(unix_server_clients, read_buffer, inl);    // write received data to UNIX clients
+        if (num_data_keyframe > 0) {
+            packetize_nal_units(&input, nal_read_buffer, (size_t) inl);
+            pb = input.pb_list + input.curr_pb;
+        } else {
+            pb->len += inl;
+            if (input.block_start_ms == 0 && max_block_age_ms > 0)
+                input.block_start_ms = current_time_ms();
+        }
         // check if this packet is finished
         if (pb->len >= param_min_packet_length) {
-            // fill packet buffer length field
-            video_packet_data_t *video_p_data = (video_packet_data_t *) (pb->data);
-            video_p_data->data_length = pb->len;
-            // check if this block is finished
-            if (input.curr_pb == num_data_per_block - 1) {
-                // transmit entire block - consisting of packets that get sent interleaved
-                // always transmit/FEC encode packets of length pack_size, even if payload (data_length) is less
-                transmit_block(input.pb_list, &(input.seq_nr), pack_size); // input.pb_list is video_packet_data_t[num_fec + num_data]
-                if (db_uav_status->injected_block_cnt % 500 == 1) {
-                    LOG_SYS_STD(LOG_INFO,
-                                "DB_VIDEO_AIR: \ttried to inject %i packets, maybe failed %i, injection time/packet %ius, "
-                                "FEC encoding time %ius         \n",
-                                db_uav_status->injected_packet_cnt, db_uav_status->injection_fail_cnt,
-                                db_uav_status->injection_time_packet, db_uav_status->encoding_time);
-                }
-
-                input.curr_pb = 0;
-                // send to unix socket clients
-            } else {
-                input.curr_pb++;
-            }
+            finish_packet(&input);
             // detect disconnections of unix clients
             for (int t = 0; t < DB_MAX_UNIX_TCP_CLIENTS; t++) {
                 if (unix_server_clients[t].client_sock > 0) {
@@ -374,8 +1094,10 @@ int main(int argc, char *argv[]) {
         }
     }
     for (int i = 0; i < DB_MAX_ADAPTERS; i++) {
-        if (raw_sockets[i].db_socket > 0)
-            close(raw_sockets[i].db_socket);
+        if (raw_sockets[i].db_socket > 0) {
+            db_socket_disable_tx_ring(&raw_sockets[i]);
+            close_db_socket(&raw_sockets[i]);
+        }
     }
     for (int i = 0; i < DB_MAX_UNIX_TCP_CLIENTS; i++) {
         if (unix_server_clients[i].client_sock > 0)
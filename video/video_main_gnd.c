@@ -23,6 +23,7 @@
  * It is called a video destination hint packet.
  */
 
+#define _GNU_SOURCE // pthread_setaffinity_np()
 #include <stdbool.h>
 #include <sys/resource.h>
 #include <arpa/inet.h>
@@ -34,7 +35,13 @@
 #include <sys/time.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <linux/filter.h>
 #include "fec.h"
+#include "gf256.h"
 #include "video_lib.h"
 #include "../common/shared_memory.h"
 #include "../common/db_raw_receive.h"
@@ -42,23 +49,42 @@
 #include "../common/db_raw_send_receive.h"
 #include "../common/db_common.h"
 #include "../common/db_unix.h"
+#include "../common/db_spsc_ring.h"
+#include "../common/db_pcap.h"
+#include "../common/db_recorder.h"
 
 #define MAX_PACKET_LENGTH 4192
 #define MAX_USER_PACKET_LENGTH 1450
 #define MAX_DATA_OR_FEC_PACKETS_PER_BLOCK 32
 #define DEBUG 0
 #define UDP_BUFF_SIZE 2048
+#define RX_QUEUE_SLOTS 512          // per adapter queue between receiver thread and FEC thread
+#define PUBLISH_QUEUE_SLOTS 256     // queue between FEC thread and publish thread
+#define DEDUPE_WINDOW 1024          // number of video sequence numbers remembered for duplicate detection
+#define THREAD_POLL_TIMEOUT_MS 500
+#define MAX_FANOUT_WORKERS 16
+#define REORDER_POLL_TIMEOUT_MS 5   // reorder stage re-checks the worker queues at least this often
+#define REORDER_TIMEOUT_MS 100      // max time the reorder stage waits for a block whose worker has no data at all
 
 int num_interfaces = 0;
 int dest_port_video, unix_sock;
 uint8_t comm_id, num_data_per_block, num_fec_per_block;
-uint8_t lr_buffer[MAX_DB_DATA_LENGTH] = {0};
-bool pass_through, udp_enabled = true, output_to_usb_bridge = false, send_to_std_out = true;
+slot_arena_t frame_arena;            // MAX_PACKET_LENGTH sized slots for received frames and block reassembly
+bool pass_through, udp_enabled = true, output_to_usb_bridge = false, send_to_std_out = true, use_rx_ring = false,
+        use_threads = false;
 volatile bool keeprunning = true;
-int param_block_buffers = 1;
+int param_block_buffers = 1;        // reassembly window in blocks. Interleaver depth of the UAV (-I)
 int pack_size = MAX_USER_PACKET_LENGTH;
+int num_fanout_workers = 0;          // 0 = fanout mode disabled
+unsigned int feedback_interval_ms = 0;  // adaptive FEC: interval of the loss reports sent to the UAV. 0 = disabled
+db_socket_t *feedback_sockets[DB_MAX_ADAPTERS];  // sockets the loss reports are sent with. NULL in replay mode
+// loss statistics of the blocks finished since the last report. Updated by all decoders
+uint32_t feedback_lost_hist[VIDEO_FEEDBACK_HIST_LEN], feedback_damage_hist[VIDEO_FEEDBACK_HIST_LEN];
+uint32_t feedback_packet_cnt = 0;
+uint64_t next_feedback_ns = 0;
+uint16_t feedback_report_nr = 0;
 db_gnd_status_t *db_gnd_status = NULL;
-int max_block_num = -1, udp_socket;
+int udp_socket;
 struct sockaddr_in client_video_addr;
 struct sockaddr_un unix_socket_addr;
 long long prev_time = 0;
@@ -69,12 +95,75 @@ socklen_t server_length = sizeof(struct sockaddr_un);
 char adapters[DB_MAX_ADAPTERS][IFNAMSIZ];
 char overwrite_ip[INET6_ADDRSTRLEN];
 bool fixed_ip = false;
+char *replay_files[DB_MAX_ADAPTERS];   // replay mode: capture files that replace the adapters
+int num_replay_files = 0;
+double replay_speed = 1;                // 1 = original speed, 0 = as fast as possible
+char *recorder_dir = NULL;              // flight recorder enabled if set
+db_recorder_t *recorder = NULL;
 
 typedef struct {
     int selectable_fd;
     int n80211HeaderLength;
+    db_rx_ring_t *rx_ring; // NULL if frames are received via recv()
+    db_socket_t db_sock;   // for close_db_socket()
 } monitor_interface_t;
 
+// Threaded mode: one receiver thread per adapter -> FEC thread -> publish thread
+typedef struct {
+    uint8_t *payload;           // points to db_video_packet_t inside frame
+    uint16_t payload_length;
+    int crc_correct;
+    uint8_t *frame;             // arena slot. Swapped with the slot of the packet buffer if the FEC thread keeps it
+} rx_queue_slot_t;
+
+typedef struct {
+    uint32_t length;
+    bool fec_decoded;
+    int block_num;              // fanout mode: block the data belongs to. -1 if not part of a decoded block
+    bool end_of_block;          // fanout mode: marks the end of block_num. Carries no data
+    uint8_t data[MAX_USER_PACKET_LENGTH];
+} publish_queue_slot_t;
+
+// Block reassembly and FEC decoding state. Owned by one thread: main thread, FEC thread (-t) or fanout worker (-w)
+typedef struct {
+    block_buffer_t *block_buffer_list;
+    int max_block_num;
+    int retired_block_num;      // block that left the reassembly window last. -1 if none since start or TX restart
+    int block_step;             // distance between consecutive blocks seen by this decoder. N in fanout mode
+    uint8_t *rx_slot;           // arena slot the next frame is received into (if this thread receives the frames)
+    db_rt_plan_t *radiotap_plans;   // per adapter (if this thread receives the frames)
+    db_spsc_ring_t *publish_queue;  // queue to the publish thread. NULL to publish directly
+    int recorder_ring;              // flight recorder ring of the thread receiving the frames
+    int publish_block_num;      // block that is currently delivered. Tags publish queue slots in fanout mode
+} video_decoder_t;
+
+typedef struct {
+    monitor_interface_t *interface;
+    int adapter_no;
+    db_spsc_ring_t queue;       // receiver thread -> FEC thread
+    uint32_t queue_full_cnt;
+    pthread_t thread;
+} rx_worker_t;
+
+rx_worker_t rx_workers[DB_MAX_ADAPTERS];
+db_spsc_ring_t publish_queue;   // FEC thread -> publish thread
+sem_t rx_queue_items, publish_queue_items;
+uint32_t dedupe_table[DEDUPE_WINDOW];  // video sequence number + 1 of the last correct packet seen per table entry
+db_rt_plan_t radiotap_plans[MAX_PENUMBRA_INTERFACES];  // per adapter. Only used by the thread receiving on it
+
+// Fanout mode: Every adapter has one socket per worker. All sockets of an adapter form a PACKET_FANOUT group and the
+// kernel steers every frame to the worker owning its block (block_num % N). Workers receive, decode and hand the data
+// to the reorder stage (publish thread) that restores the block order
+typedef struct {
+    monitor_interface_t interfaces[MAX_PENUMBRA_INTERFACES];   // socket of this worker for every adapter
+    db_rt_plan_t radiotap_plans[MAX_PENUMBRA_INTERFACES];
+    video_decoder_t decoder;
+    db_spsc_ring_t publish_queue;   // worker -> reorder stage
+    pthread_t thread;
+} fanout_worker_t;
+
+fanout_worker_t fanout_workers[MAX_FANOUT_WORKERS];
+
 
 void int_handler(int dummy) {
     keeprunning = false;
@@ -87,6 +176,12 @@ long long current_timestamp() {
     return milliseconds;
 }
 
+uint64_t current_timestamp_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
 
 /**
  * Init UDP socket bound to port 5000 for sending UDP video stream & for receiving video destination hints
@@ -154,41 +249,436 @@ void publish_data(uint8_t *data, uint32_t message_length, bool fec_decoded) {
     }
 }
 
+/**
+ * Waits for a free slot in the publish queue of the decoder
+ *
+ * @return The slot or NULL if the program is terminating
+ */
+publish_queue_slot_t *publish_queue_producer_slot(video_decoder_t *decoder) {
+    publish_queue_slot_t *slot;
+    while ((slot = db_spsc_ring_producer_slot(decoder->publish_queue)) == NULL) {
+        if (!keeprunning) return NULL;
+        usleep(100); // outputs are slower than the link. Back pressure instead of dropping decoded data
+    }
+    return slot;
+}
+
+/**
+ * Hands data to the outputs. In threaded mode the data is copied to the publish thread so that slow outputs do not
+ * block decoding. Otherwise it is published directly.
+ *
+ * @param decoder Decoder that produced the data
+ * @param data Data to publish
+ * @param message_length Length of data
+ * @param fec_decoded Indicator if the data also contains FEC packets. True if pure DATA packets (and fully decoded FEC)
+ */
+void deliver_data(video_decoder_t *decoder, uint8_t *data, uint32_t message_length, bool fec_decoded) {
+    if (decoder->publish_queue == NULL) {
+        publish_data(data, message_length, fec_decoded);
+        return;
+    }
+    if (message_length > MAX_USER_PACKET_LENGTH)
+        message_length = MAX_USER_PACKET_LENGTH;
+    publish_queue_slot_t *slot = publish_queue_producer_slot(decoder);
+    if (slot == NULL)
+        return;
+    memcpy(slot->data, data, message_length);
+    slot->length = message_length;
+    slot->fec_decoded = fec_decoded;
+    slot->block_num = fec_decoded ? decoder->publish_block_num : -1;
+    slot->end_of_block = false;
+    db_spsc_ring_push(decoder->publish_queue);
+    sem_post(&publish_queue_items);
+}
+
+/**
+ * Fanout mode: Tells the reorder stage that all data of a block was delivered (also if nothing could be recovered)
+ *
+ * @param decoder Decoder of a fanout worker
+ * @param block_num The finished block
+ */
+void deliver_end_of_block(video_decoder_t *decoder, int block_num) {
+    publish_queue_slot_t *slot = publish_queue_producer_slot(decoder);
+    if (slot == NULL)
+        return;
+    slot->length = 0;
+    slot->fec_decoded = true;
+    slot->block_num = block_num;
+    slot->end_of_block = true;
+    db_spsc_ring_push(decoder->publish_queue);
+    sem_post(&publish_queue_items);
+}
+
+/**
+ * Adaptive FEC: Sends the loss statistics gathered since the last report to the UAV once feedback_interval_ms passed.
+ * Called by all decoders, only one of them sends the report.
+ */
+void send_feedback_report() {
+    uint64_t now_ns = current_timestamp_ns();
+    uint64_t due_ns = __atomic_load_n(&next_feedback_ns, __ATOMIC_RELAXED);
+    if (now_ns < due_ns || !__atomic_compare_exchange_n(&next_feedback_ns, &due_ns,
+                                                        now_ns + feedback_interval_ms * 1000000ULL, false,
+                                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        return;
+    video_feedback_t report;
+    report.type = VIDEO_FEEDBACK_TYPE_LOSS;
+    report.hist_len = VIDEO_FEEDBACK_HIST_LEN;
+    report.report_nr = __atomic_fetch_add(&feedback_report_nr, 1, __ATOMIC_RELAXED);
+    report.packet_cnt = __atomic_exchange_n(&feedback_packet_cnt, 0, __ATOMIC_RELAXED);
+    for (int i = 0; i < VIDEO_FEEDBACK_HIST_LEN; i++) {
+        uint32_t lost = __atomic_exchange_n(&feedback_lost_hist[i], 0, __ATOMIC_RELAXED);
+        uint32_t damaged = __atomic_exchange_n(&feedback_damage_hist[i], 0, __ATOMIC_RELAXED);
+        report.lost_hist[i] = (uint16_t) (lost > UINT16_MAX ? UINT16_MAX : lost);
+        report.damage_hist[i] = (uint16_t) (damaged > UINT16_MAX ? UINT16_MAX : damaged);
+    }
+    for (int i = 0; i < num_interfaces; i++) {
+        if (feedback_sockets[i] != NULL)
+            db_send_div(feedback_sockets[i], (uint8_t *) &report, DB_PORT_VIDEO, sizeof(video_feedback_t),
+                        report.report_nr, 0);
+    }
+}
+
+/**
+ * Adaptive FEC: Adds a finished block to the loss statistics of the next report
+ *
+ * @param num_packets Packets the block was sent with
+ * @param lost Packets of the block that were lost or arrived corrupt
+ * @param missing_fecs FEC packets the block lacked to be repaired. 0 if it was repaired
+ */
+void feedback_account_block(unsigned int num_packets, unsigned int lost, unsigned int missing_fecs) {
+    if (feedback_interval_ms == 0)
+        return;
+    __atomic_add_fetch(&feedback_packet_cnt, num_packets, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&feedback_lost_hist[lost < VIDEO_FEEDBACK_HIST_LEN ? lost : VIDEO_FEEDBACK_HIST_LEN - 1], 1,
+                       __ATOMIC_RELAXED);
+    if (missing_fecs > 0)
+        __atomic_add_fetch(&feedback_damage_hist[missing_fecs < VIDEO_FEEDBACK_HIST_LEN ? missing_fecs :
+                                                 VIDEO_FEEDBACK_HIST_LEN - 1], 1, __ATOMIC_RELAXED);
+    send_feedback_report();
+}
+
+/**
+ * Clears the packet buffers of a block so that it can take the packets of another block
+ */
+void block_buffer_clear(block_buffer_t *block) {
+    packet_buffer_t *p = block->packet_buffer_list;
+    for (int j = 0; j < num_data_per_block + num_fec_per_block; ++j) {
+        p->valid = 0;
+        p->crc_correct = 0;
+        p->len = 0;
+        p++;
+    }
+    block->packet_buffer_len = 0;
+    block->good_packet_cnt = 0;
+    block->released = false;
+    block->num_data = num_data_per_block;
+    block->num_fec = num_fec_per_block;
+    block->missing_fecs = 0;
+}
+
 void block_buffer_list_reset(block_buffer_t *block_buffer_list, int block_buffer_list_len) {
+    for (int i = 0; i < block_buffer_list_len; ++i) {
+        block_buffer_list[i].block_num = -1;
+        block_buffer_clear(&block_buffer_list[i]);
+    }
+}
+
+/**
+ * Repairs a block using FEC and delivers its data. Called as soon as k packets of the block arrived with correct FCS,
+ * when all packets of the block arrived or when the block leaves the reassembly window, whatever happens first. Blocks
+ * get released in order, see release_complete_blocks().
+ * Packets that did not arrive (yet) count as erased. DATA packets shorter than the FEC block size get zero padded.
+ * Uses the number of DATA and FEC packets the sender announced for
+ * the block. Updates the release latency in the status.
+ *
+ * @param decoder
+ * @param block Block to release. Stays in the window so that late packets of it can be told apart from new blocks
+ */
+void release_block(video_decoder_t *decoder, block_buffer_t *block) {
+    packet_buffer_t *packet_buffer_list = block->packet_buffer_list;
     int i;
-    block_buffer_t *rb = block_buffer_list;
+    decoder->publish_block_num = block->block_num;
+
+    //we have both pointers to the packet buffers (to get information about crc and vadility) and raw data pointers for fec_decode
+    packet_buffer_t *data_pkgs[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
+    packet_buffer_t *fec_pkgs[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
+    uint8_t *data_blocks[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
+    uint8_t *fec_blocks[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
+    int datas_missing = 0, datas_corrupt = 0, fecs_missing = 0, fecs_corrupt = 0;
+    uint di = 0, fi = 0;
+    const uint num_data = block->num_data, num_fec = block->num_fec;
+
+
+    // first, split the received packets into DATA a FEC packets and count the damaged packets
+    // We assume that the packets are correctly ordered inside the packet buffer list
+    i = 0;
+    while (di < num_data || fi < num_fec) {
+        if (di < num_data) {
+            data_pkgs[di] = packet_buffer_list + i++;
+            data_blocks[di] = data_pkgs[di]->data;
+            if (!data_pkgs[di]->valid)
+                datas_missing++;
+            if (data_pkgs[di]->valid && !data_pkgs[di]->crc_correct)
+                datas_corrupt++;
+            di++;
+        }
+
+        if (fi < num_fec) {
+            fec_pkgs[fi] = packet_buffer_list + i++;
+            if (!fec_pkgs[fi]->valid)
+                fecs_missing++;
+
+            if (fec_pkgs[fi]->valid && !fec_pkgs[fi]->crc_correct)
+                fecs_corrupt++;
+
+            fi++;
+        }
+    }
+
+    const int good_fecs_c = num_fec - fecs_missing - fecs_corrupt;
+    const int datas_missing_c = datas_missing;
+    const int datas_corrupt_c = datas_corrupt;
+
+    int good_fecs = good_fecs_c;
+    //the following three fields are infos for fec_decode
+    unsigned int fec_block_nos[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
+    unsigned int erased_blocks[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
+    unsigned short nr_fec_blocks = 0;
+
+    // Only decode using FEC if we actually lost data packets
+    if (datas_missing_c + datas_corrupt_c > 0) {
+        // Use FEC to try to retain the information
+        fi = 0;
+        di = 0;
+
+        //look for missing DATA and replace them with good FECs
+        while (di < num_data && fi < num_fec) {
+            //if this data is fine we go to the next
+            if (data_pkgs[di]->valid && data_pkgs[di]->crc_correct) {
+                di++;
+                continue;
+            }
+
+            //if this DATA is corrupt and there are less good fecs than missing datas we cannot do anything for this data
+            if (data_pkgs[di]->valid && !data_pkgs[di]->crc_correct && good_fecs <= datas_missing) {
+                di++;
+                continue;
+            }
+
+            //if this FEC is not received we go on to the next
+            if (!fec_pkgs[fi]->valid) {
+                fi++;
+                continue;
+            }
+
+            //if this FEC is corrupted and there are more lost packages than good fecs we should replace this DATA even with this corrupted FEC
+            //otherwise skip it: the good FECs that follow suffice
+            if (!fec_pkgs[fi]->crc_correct && datas_missing <= good_fecs) {
+                fi++;
+                continue;
+            }
+
+
+            if (!data_pkgs[di]->valid)
+                datas_missing--;
+            else if (!data_pkgs[di]->crc_correct)
+                datas_corrupt--;
+
+            if (fec_pkgs[fi]->crc_correct)
+                good_fecs--;
+
+            //at this point, data is invalid and fec is good -> replace data with fec
+            erased_blocks[nr_fec_blocks] = di;
+            fec_block_nos[nr_fec_blocks] = fi;
+            fec_blocks[nr_fec_blocks] = fec_pkgs[fi]->data;
+            di++;
+            fi++;
+            nr_fec_blocks++;
+        }
+
+        int reconstruction_failed = datas_missing_c + datas_corrupt_c > good_fecs_c;
+
+        if (reconstruction_failed) {
+            //we did not have enough FEC packets to repair this block
+            __atomic_add_fetch(&db_gnd_status->damaged_block_cnt, 1, __ATOMIC_RELAXED);
+            block->missing_fecs = (uint8_t) (datas_missing_c + datas_corrupt_c - good_fecs_c);
+            //LOG_SYS_STD(LOG_ERR, "Could not fully reconstruct block %x! Damage rate: %f (%d / %d blocks)\n", last_block_num, 1.0 * rx_status->damaged_block_cnt / rx_status->received_block_cnt, rx_status->damaged_block_cnt, rx_status->received_block_cnt);
+            //debug_print("Data mis: %d\tData corr: %d\tFEC mis: %d\tFEC corr: %d\n", datas_missing_c, datas_corrupt_c, fecs_missing_c, fecs_corrupt_c);
+        }
+
+
+        // DATA packets arrive without the unused end of the packet. The sender encoded FEC with zeros in its place
+        for (i = 0; i < num_data + num_fec; ++i) {
+            packet_buffer_t *packet = packet_buffer_list + i;
+            if (packet->valid && packet->len < (uint) pack_size)
+                memset(packet->data + packet->len, 0, pack_size - packet->len);
+        }
+
+        //decode data and publish it
+        fec_decode(pack_size, data_blocks, num_data, fec_blocks, fec_block_nos, erased_blocks,
+                   nr_fec_blocks);
+        unsigned int inv_cache_hits, inv_cache_misses;
+        fec_get_inv_cache_stats(&inv_cache_hits, &inv_cache_misses);
+        db_gnd_status->fec_inv_cache_hit_cnt = inv_cache_hits;
+        db_gnd_status->fec_inv_cache_miss_cnt = inv_cache_misses;
+        for (i = 0; i < num_data; ++i) {
+            video_packet_data_t *vpd_corrected = (video_packet_data_t *) data_blocks[i];
+            if (!reconstruction_failed || data_pkgs[i]->valid) {
+                //if reconstruction did fail, the data_length value is undefined. better limit it to some sensible value
+                if (vpd_corrected->data_length > pack_size) {
+                    vpd_corrected->data_length = (uint32_t) pack_size;
+                }
+                // do not publish the data_length field of video_packet_data_t struct
+                deliver_data(decoder, data_blocks[i] + 4, vpd_corrected->data_length - 4, true);
+            }
+        }
+    } else {
+        // All data packets received correctly - no need for FEC
+        for (int w = 0; w < num_data; ++w) {
+            video_packet_data_t *data_packet = (video_packet_data_t *) data_blocks[w];
+            deliver_data(decoder, data_blocks[w] + 4, data_packet->data_length - 4, true);
+        }
+    }
+    block->released = true;
+    if (num_fanout_workers > 0)
+        deliver_end_of_block(decoder, block->block_num);
+
+    // smoothed over the last ~16 blocks. Several fanout workers may update it at the same time, any of them is fine
+    uint32_t latency_us = (uint32_t) ((current_timestamp_ns() - block->first_rx_ns) / 1000);
+    uint32_t avg_us = __atomic_load_n(&db_gnd_status->block_release_us, __ATOMIC_RELAXED);
+    __atomic_store_n(&db_gnd_status->block_release_us, avg_us == 0 ? latency_us :
+                                                       avg_us - avg_us / 16 + latency_us / 16, __ATOMIC_RELAXED);
+}
 
-    for (i = 0; i < block_buffer_list_len; ++i) {
-        rb->block_num = -1;
-        rb->packet_buffer_len = 0;
+/**
+ * @return true if the block can be decoded: k packets arrived with correct FCS or all packets arrived
+ */
+static inline bool block_complete(const block_buffer_t *block) {
+    return block->good_packet_cnt >= block->num_data || block->packet_buffer_len == block->num_data + block->num_fec;
+}
 
-        int j;
-        packet_buffer_t *p = rb->packet_buffer_list;
-        for (j = 0; j < num_data_per_block + num_fec_per_block; ++j) {
-            p->valid = 0;
-            p->crc_correct = 0;
-            p->len = 0;
-            p++;
+/**
+ * Releases the complete blocks of the window in the order of their block numbers. Stops at the first block that is not
+ * complete yet. With interleaving (window of more than one block) a block may complete before older blocks do. It
+ * then waits for them so that the output keeps the block order.
+ *
+ * @param decoder
+ */
+void release_complete_blocks(video_decoder_t *decoder) {
+    block_buffer_t *block_buffer_list = decoder->block_buffer_list;
+    while (true) {
+        block_buffer_t *oldest = NULL;
+        for (int i = 0; i < param_block_buffers; ++i) {
+            if (block_buffer_list[i].block_num != -1 && !block_buffer_list[i].released &&
+                (oldest == NULL || block_buffer_list[i].block_num < oldest->block_num))
+                oldest = &block_buffer_list[i];
         }
+        if (oldest == NULL || !block_complete(oldest))
+            return;
+        if (oldest->packet_buffer_len < oldest->num_data + oldest->num_fec)
+            __atomic_add_fetch(&db_gnd_status->early_release_cnt, 1, __ATOMIC_RELAXED);
+        release_block(decoder, oldest);
+    }
+}
+
+/**
+ * Removes a block from the reassembly window to make room for a new one. Releases the block if that did not happen
+ * yet and accounts the packets that never arrived or arrived corrupt.
+ *
+ * @param decoder
+ * @param block Block to remove. Empty afterwards
+ */
+void retire_block(video_decoder_t *decoder, block_buffer_t *block) {
+    if (!block->released)
+        release_block(decoder, block);
+    if (decoder->retired_block_num >= 0) {
+        // blocks of which not a single packet arrived. Reported as lost completely
+        int skipped = (block->block_num - decoder->retired_block_num) / decoder->block_step - 1;
+        for (int b = 0; b < skipped && b < VIDEO_FEEDBACK_HIST_LEN; b++)
+            feedback_account_block(num_data_per_block + num_fec_per_block, num_data_per_block + num_fec_per_block,
+                                   num_data_per_block);
+    }
+    decoder->retired_block_num = block->block_num;
+    int lost = block->num_data + block->num_fec - block->good_packet_cnt;
+    __atomic_add_fetch(&db_gnd_status->received_block_cnt, 1, __ATOMIC_RELAXED);
+    db_gnd_status->lost_per_block_cnt = (uint32_t) lost;
+    __atomic_add_fetch(&db_gnd_status->lost_packet_cnt, lost, __ATOMIC_RELAXED);
+    feedback_account_block(block->num_data + block->num_fec, (unsigned int) lost, block->missing_fecs);
+    block_buffer_clear(block);
+}
 
-        rb++;
+/**
+ * @return Index of the block with the lowest block number in the reassembly window. Unused buffers come first
+ */
+int oldest_block(video_decoder_t *decoder) {
+    int min_block_num = INT_MAX;
+    int min_block_num_idx = 0;
+    for (int i = 0; i < param_block_buffers; ++i) {
+        if (decoder->block_buffer_list[i].block_num < min_block_num) {
+            min_block_num = decoder->block_buffer_list[i].block_num;
+            min_block_num_idx = i;
+        }
     }
+    return min_block_num_idx;
+}
+
+/**
+ * Takes a new block into the reassembly window. Retires the block whose buffer it gets
+ *
+ * @param decoder
+ * @param idx Buffer to use for the block. The oldest one of the window (see oldest_block())
+ * @param block_num Number of the new block
+ * @param header Header of the first received packet of the block. Tells its number of DATA and FEC packets
+ * @return Buffer of the new block
+ */
+block_buffer_t *open_block(video_decoder_t *decoder, int idx, int block_num, video_packet_header_t *header) {
+    block_buffer_t *block = &decoder->block_buffer_list[idx];
+    //debug_print("removing block %x at index %i for block %x\n", block->block_num, idx, block_num);
+    if (block->block_num != -1)
+        retire_block(decoder, block);
+    block->block_num = block_num;
+    block->num_data = header->num_data;
+    block->num_fec = header->num_fec;
+    if (param_block_buffers > 1)
+        release_complete_blocks(decoder);   // blocks that waited for the retired one
+    return block;
 }
 
 /**
- * Takes a stream of payload (FEC & DATA) and does error correction publishing the corrected data in the end
+ * Takes a stream of payload (FEC & DATA) and does error correction publishing the corrected data in the end.
+ * A block is decoded and published as soon as any k of its packets arrived with correct FCS. Packets that arrive
+ * for a block that was already released only get counted. Blocks may carry less DATA and FEC packets than configured
+ * (flushed early by the sender). They still span the sequence numbers of a full block.
  *
  * @param data: The payload of raw protocol (a db_video_packet_t)
  * @param data_len: Length of the payload
  * @param crc_correct: Was the FCF of the raw packet OK
- * @param block_buffer_list: An array of block_buffer_t structs
+ * @param decoder: Decoder state containing the block buffers
+ * @param frame_slot: Arena slot that contains data. If the packet is stored, the slot is swapped with the slot of its
+ * packet buffer and the caller receives the next frame into the old slot of the packet buffer. NULL if data is not
+ * inside an arena slot (e.g. receive ring), then the packet gets copied
  */
-void process_video_payload(uint8_t *data, uint16_t data_len, int crc_correct, block_buffer_t *block_buffer_list) {
+void process_video_payload(uint8_t *data, uint16_t data_len, int crc_correct, video_decoder_t *decoder,
+                           uint8_t **frame_slot) {
     uint block_num;
     uint packet_num;
-    bool all_data_avail = false;    // indicator for second iteration inited by GOTO jump when full block was received
     int i;
+    block_buffer_t *block_buffer_list = decoder->block_buffer_list;
     db_video_packet_t *db_video_packet = (db_video_packet_t *) data;
+    video_packet_header_t *header = &db_video_packet->video_packet_header;
+
+    if (data_len < sizeof(video_packet_header_t) + sizeof(uint32_t))
+        return;
+    if (crc_correct && (header->num_data == 0 || header->num_data > num_data_per_block ||
+                        header->num_fec > num_fec_per_block)) {
+        static bool warned = false;
+        if (!warned)
+            LOG_SYS_STD(LOG_ERR, "DB_VIDEO_GND: Received block with %u DATA and %u FEC packets. Configured max. is "
+                                 "%u/%u. Check -d and -r\n", header->num_data, header->num_fec, num_data_per_block,
+                        num_fec_per_block);
+        warned = true;
+        return;
+    }
 
     //if aram_data_packets_per_block+num_fec_per_block would be limited to powers of two, this could be replaced by a logical AND operation
     block_num = db_video_packet->video_packet_header.sequence_number / (num_data_per_block + num_fec_per_block);
@@ -197,288 +687,747 @@ void process_video_payload(uint8_t *data, uint16_t data_len, int crc_correct, bl
 
     //we have received a block number that exceeds the currently seen ones -> we need to make room for this new block
     //or we have received a block_num that is several times smaller than the current window of buffers -> this indicated that either the window is too small or that the transmitter has been restarted
-    int tx_restart = (block_num + 128 * param_block_buffers < max_block_num);
-    second_iteration_entry:
-    // with block_buffer_list length == 1 (d=1) this means we received all packets of a block (we still might miss some)
-    if ((block_num > max_block_num || tx_restart || all_data_avail) &&
-        crc_correct) { // process prev block since we received packet for new block
+    int tx_restart = (block_num + 128 * param_block_buffers * decoder->block_step < decoder->max_block_num);
+    if ((block_num > decoder->max_block_num || tx_restart) && crc_correct) {
         if (tx_restart) {
-            db_gnd_status->tx_restart_cnt++;
+            __atomic_add_fetch(&db_gnd_status->tx_restart_cnt, 1, __ATOMIC_RELAXED);
             LOG_SYS_STD(LOG_ERR,
                         "TX RESTART: Detected blk %x that lies outside of the current retr block buffer window "
                         "(max_block_num = %x) (if there was no tx restart, increase window size via -d)\n",
-                        block_num, max_block_num);
+                        block_num, decoder->max_block_num);
             block_buffer_list_reset(block_buffer_list, param_block_buffers);
+            decoder->retired_block_num = -1;
         }
-        //first, find the minimum block num in the buffers list. this will be the block that we replace
-        int min_block_num = INT_MAX;
-        int min_block_num_idx = 0;
-        for (i = 0; i < param_block_buffers; ++i) {
-            if (block_buffer_list[i].block_num < min_block_num) {
-                min_block_num = block_buffer_list[i].block_num;
-                min_block_num_idx = i;
-            }
-        }
-
-        //debug_print("removing block %x at index %i for block %x\n", min_block_num, min_block_num_idx, block_num);
+        open_block(decoder, oldest_block(decoder), (int) block_num, header);
+        decoder->max_block_num = block_num;
+    }
 
-        packet_buffer_t *packet_buffer_list = block_buffer_list[min_block_num_idx].packet_buffer_list;
-        int last_block_num = block_buffer_list[min_block_num_idx].block_num;
+    //find the buffer into which we have to write this packet
+    block_buffer_t *rbb = block_buffer_list;
+    for (i = 0; i < param_block_buffers; ++i) {
+        if (rbb->block_num == block_num) {
+            break;
+        }
+        rbb++;
+    }
 
-        if (last_block_num != -1) {
-            db_gnd_status->received_block_cnt++;
+    //check if we have actually found the corresponding block. this could not be the case due to a corrupt packet
+    if (i == param_block_buffers) {
+        // Interleaving: The first packets of this block got lost while packets of newer blocks arrived. Take the block
+        // as long as it is newer than the oldest block of the window, otherwise it already left the window
+        int oldest_idx = oldest_block(decoder);
+        if (param_block_buffers == 1 || !crc_correct || (int) block_num <= decoder->retired_block_num ||
+            block_buffer_list[oldest_idx].block_num >= (int) block_num)
+            return;
+        rbb = open_block(decoder, oldest_idx, (int) block_num, header);
+    }
+    packet_num = db_video_packet->video_packet_header.sequence_number % (num_data_per_block +
+                                                                         num_fec_per_block); //if retr_block_size would be limited to powers of two, this could be replace by a locical and operation
+    if (packet_num >= rbb->num_data + rbb->num_fec)
+        return; // outside of a short block, must be corrupt
+    packet_buffer_t *packet = &rbb->packet_buffer_list[packet_num];
+    if (rbb->released) {
+        // block already went out. Only keep track of the packet for the loss statistics, its data is not needed
+        __atomic_add_fetch(&db_gnd_status->late_packet_cnt, 1, __ATOMIC_RELAXED);
+        if (crc_correct && !packet->crc_correct) {
+            packet->valid = 1;
+            packet->crc_correct = 1;
+            rbb->good_packet_cnt++;
+        }
+        return;
+    }
 
-            //we have both pointers to the packet buffers (to get information about crc and vadility) and raw data pointers for fec_decode
-            packet_buffer_t *data_pkgs[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
-            packet_buffer_t *fec_pkgs[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
-            uint8_t *data_blocks[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
-            uint8_t *fec_blocks[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
-            int datas_missing = 0, datas_corrupt = 0, fecs_missing = 0, fecs_corrupt = 0;
-            uint di = 0, fi = 0;
+    //only overwrite packets where the checksum is not yet correct. otherwise the packets are already received correctly
+    if (packet->crc_correct == 0) {
+        uint8_t *packet_data = data + sizeof(video_packet_header_t);
+        // FEC decoding may write pack_size bytes to data, make sure they fit into the slot
+        if (frame_slot != NULL && packet_data + pack_size <= *frame_slot + MAX_PACKET_LENGTH) {
+            uint8_t *free_slot = packet->slot;
+            packet->slot = *frame_slot;
+            packet->data = packet_data;
+            *frame_slot = free_slot;
+        } else {
+            packet->data = packet->slot;
+            memcpy(packet->data, packet_data, data_len - sizeof(video_packet_header_t));
+        }
+        if (rbb->packet_buffer_len == 0)
+            rbb->first_rx_ns = current_timestamp_ns();
+        if (!packet->valid)
+            rbb->packet_buffer_len++;
+        if (crc_correct)
+            rbb->good_packet_cnt++;
+        packet->len = (uint) (data_len - sizeof(video_packet_header_t));
+        packet->valid = 1;
+        packet->crc_correct = crc_correct;
+    }
+    // k good packets are enough to recover the block. No need to wait for the rest or for a packet of the next block
+    if (block_complete(rbb))
+        release_complete_blocks(decoder);
+}
 
+/**
+ * Extracts the payload from a received frame and reads radiotap header for RSSI info. Updates the adapter statistics.
+ * The payload is not copied out of the frame. Only touches the statistics of the given adapter so it can be called by
+ * the receiver thread of that adapter. Hands the frame to the flight recorder if enabled.
+ *
+ * @param frame Received frame starting with the radiotap header (recv buffer or frame inside the receive ring)
+ * @param frame_length Length of the received frame
+ * @param adapter_no
+ * @param radiotap_plan Radiotap parse plan of the adapter. Only used by the calling thread
+ * @param recorder_ring Flight recorder ring of the calling thread
+ * @param message_length Returns the length of the payload
+ * @param checksum_correct Returns 0 if the radiotap header reports a bad FCS
+ * @return Pointer to the payload of raw protocol (video header + data = db_video_packet) inside frame. NULL on error
+ */
+uint8_t *parse_frame(uint8_t *frame, ssize_t frame_length, int adapter_no, db_rt_plan_t *radiotap_plan,
+                     int recorder_ring, uint16_t *message_length, int *checksum_correct) {
+    const db_rt_field_t *rt_fields;
+    uint8_t *payload;
+    uint16_t radiotap_length = 0;
+    uint8_t current_antenna_indx = 0, seq_num_video = 0;
+    *checksum_correct = 1;
+
+    __atomic_add_fetch(&db_gnd_status->received_packet_cnt, 1, __ATOMIC_RELAXED);
+    if (recorder != NULL &&
+        !db_recorder_write(recorder, recorder_ring, (uint8_t) adapter_no, frame, (uint32_t) frame_length))
+        __atomic_add_fetch(&db_gnd_status->recorder_overrun_cnt, 1, __ATOMIC_RELAXED);
+    payload = get_db_payload_pointer(frame, frame_length, message_length, &seq_num_video, &radiotap_length);
+    if (payload == NULL) {
+        LOG_SYS_STD(LOG_ERR, "DB_VIDEO_GND: Received frame with invalid payload length\n");
+        return NULL;
+    }
+    // field offsets are cached per adapter. The radiotap iterator only runs if the header layout changes
+    int num_rt_fields = db_rt_get_fields(radiotap_plan, frame, radiotap_length, &rt_fields);
+    if (num_rt_fields < 0) {
+        LOG_SYS_STD(LOG_ERR, "DB_VIDEO_GND: Could not init radiotap header\n");
+        return NULL;
+    }
+    for (int i = 0; i < num_rt_fields; i++) {
+        uint8_t *rt_arg = frame + rt_fields[i].offset;
+        switch (rt_fields[i].index) {
+            case IEEE80211_RADIOTAP_RATE:
+                db_gnd_status->adapter[adapter_no].rate = (*rt_arg);
+                break;
+            case IEEE80211_RADIOTAP_ANTENNA:
+                current_antenna_indx = (*rt_arg);
+                break;
+            case IEEE80211_RADIOTAP_FLAGS:
+                *checksum_correct = (*rt_arg & IEEE80211_RADIOTAP_F_BADFCS) == 0;
+                break;
+            case IEEE80211_RADIOTAP_LOCK_QUALITY:
+                db_gnd_status->adapter[adapter_no].lock_quality = (*rt_arg);
+            case IEEE80211_RADIOTAP_DBM_ANTSIGNAL:
+                if (current_antenna_indx == 0) // first occurrence in header will be general RSSI
+                    db_gnd_status->adapter[adapter_no].current_signal_dbm = (int8_t) (*rt_arg);
+                if (current_antenna_indx <= MAX_ANTENNA_CNT)
+                    db_gnd_status->adapter[adapter_no].ant_signal_dbm[current_antenna_indx] = (int8_t) (*rt_arg);
+                break;
+            default:
+                break;
+        }
+    }
+    db_gnd_status->adapter[adapter_no].num_antennas = (uint8_t) (current_antenna_indx + 1);
+    if (!*checksum_correct)
+        __atomic_add_fetch(&db_gnd_status->adapter[adapter_no].wrong_crc_cnt, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&db_gnd_status->adapter[adapter_no].received_packet_cnt, 1, __ATOMIC_RELAXED);
 
-            // first, split the received packets into DATA a FEC packets and count the damaged packets
-            // We assume that the packets are correctly ordered inside the packet buffer list
-            i = 0;
-            while (di < num_data_per_block || fi < num_fec_per_block) {
-                if (di < num_data_per_block) {
-                    data_pkgs[di] = packet_buffer_list + i++;
-                    data_blocks[di] = data_pkgs[di]->data;
-                    if (!data_pkgs[di]->valid)
-                        datas_missing++;
-                    if (data_pkgs[di]->valid && !data_pkgs[di]->crc_correct)
-                        datas_corrupt++;
-                    di++;
-                }
+    db_gnd_status->last_update = time(NULL);
+    return payload;
+}
 
-                if (fi < num_fec_per_block) {
-                    fec_pkgs[fi] = packet_buffer_list + i++;
-                    if (!fec_pkgs[fi]->valid)
-                        fecs_missing++;
+/**
+ * Extracts the payload from a received frame and forwards it to the decoding stage.
+ *
+ * @param frame Received frame starting with the radiotap header (recv buffer or frame inside the receive ring)
+ * @param frame_length Length of the received frame
+ * @param decoder
+ * @param adapter_no
+ * @param frame_slot Arena slot containing the frame or NULL (see process_video_payload())
+ */
+void process_frame(uint8_t *frame, ssize_t frame_length, video_decoder_t *decoder, int adapter_no,
+                   uint8_t **frame_slot) {
+    uint16_t message_length;
+    int checksum_correct;
+    uint8_t *payload = parse_frame(frame, frame_length, adapter_no, &decoder->radiotap_plans[adapter_no],
+                                   decoder->recorder_ring, &message_length, &checksum_correct);
+    if (payload == NULL)
+        return;
+    if (pass_through) {
+        // Do not decode using FEC - pure UDP pass through, decoding of FEC must happen on following applications
+        // TODO: Implement custom protocol in case of pass_through that tells the receiver about the adapter that it was received on
+        deliver_data(decoder, payload, message_length, false);
+    }
+    process_video_payload(payload, message_length, checksum_correct, decoder, frame_slot);
+}
 
-                    if (fec_pkgs[fi]->valid && !fec_pkgs[fi]->crc_correct)
-                        fecs_corrupt++;
+/**
+ * Receives a frame from the socket and processes it
+ *
+ * @param interface
+ * @param decoder
+ * @param adapter_no
+ */
+void process_packet(monitor_interface_t *interface, video_decoder_t *decoder, int adapter_no) {
+    // receive
+    ssize_t l = recv(interface->selectable_fd, decoder->rx_slot, MAX_DB_DATA_LENGTH, 0);
+    int err = errno;
+    if (l > 0) {
+        process_frame(decoder->rx_slot, l, decoder, adapter_no, &decoder->rx_slot);
+    } else {
+        LOG_SYS_STD(LOG_ERR, "DB_VIDEO_GND: Received an error: %s\n", strerror(err));
+    }
+}
 
-                    fi++;
-                }
-            }
+/**
+ * Processes all frames of all ring blocks that the kernel handed to user space. Frames are processed in place.
+ *
+ * @param interface Interface with set up receive ring
+ * @param decoder
+ * @param adapter_no
+ */
+void process_ring(monitor_interface_t *interface, video_decoder_t *decoder, int adapter_no) {
+    db_rx_block_iter_t iter;
+    uint8_t *frame;
+    uint32_t frame_length;
+    while (db_rx_ring_next_block(interface->rx_ring, &iter)) {
+        while ((frame = db_rx_block_next_frame(&iter, &frame_length)) != NULL)
+            process_frame(frame, frame_length, decoder, adapter_no, NULL);
+        db_rx_ring_release_block(interface->rx_ring, &iter);
+    }
+}
 
-            const int good_fecs_c = num_fec_per_block - fecs_missing - fecs_corrupt;
-            const int datas_missing_c = datas_missing;
-            const int datas_corrupt_c = datas_corrupt;
-            db_gnd_status->lost_per_block_cnt = datas_missing + datas_corrupt + fecs_missing + fecs_corrupt;
-            db_gnd_status->lost_packet_cnt += db_gnd_status->lost_per_block_cnt;
-
-            int good_fecs = good_fecs_c;
-            //the following three fields are infos for fec_decode
-            unsigned int fec_block_nos[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
-            unsigned int erased_blocks[MAX_DATA_OR_FEC_PACKETS_PER_BLOCK];
-            unsigned short nr_fec_blocks = 0;
-
-            // Only decode using FEC if we actually lost data packets
-            if (datas_missing_c + datas_corrupt_c > 0) {
-                // Use FEC to try to retain the information
-                fi = 0;
-                di = 0;
-
-                //look for missing DATA and replace them with good FECs
-                while (di < num_data_per_block && fi < num_fec_per_block) {
-                    //if this data is fine we go to the next
-                    if (data_pkgs[di]->valid && data_pkgs[di]->crc_correct) {
-                        di++;
-                        continue;
-                    }
-
-                    //if this DATA is corrupt and there are less good fecs than missing datas we cannot do anything for this data
-                    if (data_pkgs[di]->valid && !data_pkgs[di]->crc_correct && good_fecs <= datas_missing) {
-                        di++;
-                        continue;
-                    }
-
-                    //if this FEC is not received we go on to the next
-                    if (!fec_pkgs[fi]->valid) {
-                        fi++;
-                        continue;
-                    }
-
-                    //if this FEC is corrupted and there are more lost packages than good fecs we should replace this DATA even with this corrupted FEC
-                    if (!fec_pkgs[fi]->crc_correct && datas_missing > good_fecs) {
-                        fi++;
-                        continue;
-                    }
-
-
-                    if (!data_pkgs[di]->valid)
-                        datas_missing--;
-                    else if (!data_pkgs[di]->crc_correct)
-                        datas_corrupt--;
-
-                    if (fec_pkgs[fi]->crc_correct)
-                        good_fecs--;
-
-                    //at this point, data is invalid and fec is good -> replace data with fec
-                    erased_blocks[nr_fec_blocks] = di;
-                    fec_block_nos[nr_fec_blocks] = fi;
-                    fec_blocks[nr_fec_blocks] = fec_pkgs[fi]->data;
-                    di++;
-                    fi++;
-                    nr_fec_blocks++;
-                }
+/**
+ * Pins a thread to a CPU core. Core number wraps around the number of available cores.
+ *
+ * @param thread Thread to pin
+ * @param core Preferred core
+ */
+void pin_thread(pthread_t thread, int core) {
+    long num_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_cores < 1) num_cores = 1;
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(core % num_cores, &cpu_set);
+    if (pthread_setaffinity_np(thread, sizeof(cpu_set_t), &cpu_set) != 0)
+        LOG_SYS_STD(LOG_ERR, "DB_VIDEO_GND: Could not pin thread to core %li\n", core % num_cores);
+}
 
-                int reconstruction_failed = datas_missing_c + datas_corrupt_c > good_fecs_c;
+/**
+ * Waits for an item in a queue. Times out so that threads can check keeprunning.
+ *
+ * @param items Semaphore counting the items of the queue(s)
+ * @param timeout_ms Max time to wait
+ * @return 0 if an item is available, -1 on timeout
+ */
+int wait_for_item(sem_t *items, int timeout_ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += timeout_ms * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    return sem_timedwait(items, &deadline);
+}
 
-                if (reconstruction_failed) {
-                    //we did not have enough FEC packets to repair this block
-                    db_gnd_status->damaged_block_cnt++;
-                    //LOG_SYS_STD(LOG_ERR, "Could not fully reconstruct block %x! Damage rate: %f (%d / %d blocks)\n", last_block_num, 1.0 * rx_status->damaged_block_cnt / rx_status->received_block_cnt, rx_status->damaged_block_cnt, rx_status->received_block_cnt);
-                    //debug_print("Data mis: %d\tData corr: %d\tFEC mis: %d\tFEC corr: %d\n", datas_missing_c, datas_corrupt_c, fecs_missing_c, fecs_corrupt_c);
-                }
+/**
+ * Checks if a correct copy of this video packet was already received via another adapter. Corrupted packets are never
+ * treated as duplicates since a correct copy might still replace them.
+ *
+ * @param payload db_video_packet_t
+ * @param crc_correct
+ * @return true if packet can be dropped
+ */
+bool is_duplicate(uint8_t *payload, int crc_correct) {
+    if (!crc_correct)
+        return false;
+    uint32_t seq_num = ((video_packet_header_t *) payload)->sequence_number;
+    return __atomic_exchange_n(&dedupe_table[seq_num % DEDUPE_WINDOW], seq_num + 1, __ATOMIC_RELAXED) == seq_num + 1;
+}
 
+/**
+ * Receiver thread: Parses a frame and hands the payload to the FEC thread.
+ *
+ * @param worker The receiver of the adapter
+ * @param frame Received frame. Either already inside the queue slot or somewhere else (receive ring)
+ * @param frame_length
+ * @param slot Queue slot containing the frame or NULL if frame is not located inside the queue (receive ring or drop
+ *             buffer because the queue was full)
+ */
+void enqueue_frame(rx_worker_t *worker, uint8_t *frame, ssize_t frame_length, rx_queue_slot_t *slot) {
+    uint16_t message_length;
+    int checksum_correct;
+    uint8_t *payload = parse_frame(frame, frame_length, worker->adapter_no, &radiotap_plans[worker->adapter_no],
+                                   worker->adapter_no, &message_length, &checksum_correct);
+    if (payload == NULL || message_length > MAX_PACKET_LENGTH)
+        return;
+    // claim the slot before the packet is marked as seen. Otherwise a copy from another adapter gets dropped as
+    // duplicate while this one is dropped because the queue is full
+    bool in_slot = slot != NULL;
+    if (!in_slot && (slot = db_spsc_ring_producer_slot(&worker->queue)) == NULL) {
+        if (worker->queue_full_cnt++ % 1000 == 0)
+            LOG_SYS_STD(LOG_ERR, "DB_VIDEO_GND: FEC thread can not keep up. Dropped %u packets of %s\n",
+                        worker->queue_full_cnt, adapters[worker->adapter_no]);
+        return;
+    }
+    if (is_duplicate(payload, checksum_correct))
+        return;
+    if (!in_slot) {
+        memcpy(slot->frame, payload, message_length);
+        payload = slot->frame;
+    }
+    slot->payload = payload;
+    slot->payload_length = message_length;
+    slot->crc_correct = checksum_correct;
+    db_spsc_ring_push(&worker->queue);
+    sem_post(&rx_queue_items);
+}
 
-                //decode data and publish it
-                fec_decode(pack_size, data_blocks, num_data_per_block, fec_blocks, fec_block_nos, erased_blocks,
-                           nr_fec_blocks);
-                for (i = 0; i < num_data_per_block; ++i) {
-                    video_packet_data_t *vpd_corrected = (video_packet_data_t *) data_blocks[i];
-                    if (!reconstruction_failed || data_pkgs[i]->valid) {
-                        //if reconstruction did fail, the data_length value is undefined. better limit it to some sensible value
-                        if (vpd_corrected->data_length > pack_size) {
-                            vpd_corrected->data_length = (uint32_t) pack_size;
-                        }
-                        // do not publish the data_length field of video_packet_data_t struct
-                        publish_data(data_blocks[i] + 4, vpd_corrected->data_length - 4, true);
-                    }
-                }
-            } else {
-                // All data packets received correctly - no need for FEC
-                for (int w = 0; w < num_data_per_block; ++w) {
-                    video_packet_data_t *data_packet = (video_packet_data_t *) data_blocks[w];
-                    publish_data(data_blocks[w] + 4, data_packet->data_length - 4, true);
-                }
+/**
+ * Receiver thread of an adapter. Receives directly into the queue slots that are processed by the FEC thread.
+ */
+void *receiver_thread(void *arg) {
+    rx_worker_t *worker = arg;
+    uint8_t drop_buffer[MAX_DB_DATA_LENGTH];   // used in case the queue is full. Frame is still counted
+    struct pollfd poll_fd = {.fd = worker->interface->selectable_fd, .events = POLLIN};
+    while (keeprunning) {
+        if (poll(&poll_fd, 1, THREAD_POLL_TIMEOUT_MS) <= 0)
+            continue;
+        if (worker->interface->rx_ring != NULL) {
+            db_rx_block_iter_t iter;
+            uint8_t *frame;
+            uint32_t frame_length;
+            while (db_rx_ring_next_block(worker->interface->rx_ring, &iter)) {
+                while ((frame = db_rx_block_next_frame(&iter, &frame_length)) != NULL)
+                    enqueue_frame(worker, frame, frame_length, NULL);
+                db_rx_ring_release_block(worker->interface->rx_ring, &iter);
             }
+        } else {
+            rx_queue_slot_t *slot = db_spsc_ring_producer_slot(&worker->queue);
+            uint8_t *buffer = slot != NULL ? slot->frame : drop_buffer;
+            ssize_t l = recv(worker->interface->selectable_fd, buffer, MAX_DB_DATA_LENGTH, 0);
+            if (l > 0)
+                enqueue_frame(worker, buffer, l, slot);
+            else
+                LOG_SYS_STD(LOG_ERR, "DB_VIDEO_GND: Received an error: %s\n", strerror(errno));
+        }
+    }
+    return NULL;
+}
 
-
-            //reset buffers
-            for (i = 0; i < num_data_per_block + num_fec_per_block; ++i) {
-                packet_buffer_t *p = packet_buffer_list + i;
-                p->valid = 0;
-                p->crc_correct = 0;
-                p->len = 0;
+/**
+ * FEC thread: Takes the packets of all receiver threads and does block reassembly and FEC decoding.
+ */
+void *fec_thread(void *arg) {
+    video_decoder_t *decoder = arg;
+    int next_worker = 0;
+    while (keeprunning) {
+        if (wait_for_item(&rx_queue_items, THREAD_POLL_TIMEOUT_MS) != 0)
+            continue;
+        // there is at least one packet in one of the queues. Serve queues round robin
+        for (int i = 0; i < num_interfaces; i++) {
+            rx_worker_t *worker = &rx_workers[(next_worker + i) % num_interfaces];
+            rx_queue_slot_t *slot = db_spsc_ring_consumer_slot(&worker->queue);
+            if (slot != NULL) {
+                if (pass_through)
+                    deliver_data(decoder, slot->payload, slot->payload_length, false);
+                process_video_payload(slot->payload, slot->payload_length, slot->crc_correct, decoder, &slot->frame);
+                db_spsc_ring_pop(&worker->queue);
+                next_worker = (worker->adapter_no + 1) % num_interfaces;
+                break;
             }
         }
+    }
+    return NULL;
+}
 
-        block_buffer_list[min_block_num_idx].packet_buffer_len = 0;
-        block_buffer_list[min_block_num_idx].block_num = block_num;
-        max_block_num = block_num;
+/**
+ * Publish thread: Writes decoded data to the outputs (UDP, unix domain socket, stdout)
+ */
+void *publish_thread(void *arg) {
+    while (keeprunning) {
+        if (wait_for_item(&publish_queue_items, THREAD_POLL_TIMEOUT_MS) != 0)
+            continue;
+        publish_queue_slot_t *slot = db_spsc_ring_consumer_slot(&publish_queue);
+        publish_data(slot->data, slot->length, slot->fec_decoded);
+        db_spsc_ring_pop(&publish_queue);
     }
-    if (all_data_avail) // only relevant during second iteration
-        return; // already did the next part in first iteration. Exit function
+    return NULL;
+}
 
-    //find the buffer into which we have to write this packet
-    block_buffer_t *rbb = block_buffer_list;
-    for (i = 0; i < param_block_buffers; ++i) {
-        if (rbb->block_num == block_num) {
-            break;
+/**
+ * Starts one pinned receiver thread per adapter, the FEC thread and the publish thread
+ *
+ * @param interfaces
+ * @param decoder Decoder used by the FEC thread
+ * @param fec_worker Returns the FEC thread
+ * @param publish_worker Returns the publish thread
+ */
+void start_threads(monitor_interface_t *interfaces, video_decoder_t *decoder, pthread_t *fec_worker,
+                   pthread_t *publish_worker) {
+    sem_init(&rx_queue_items, 0, 0);
+    sem_init(&publish_queue_items, 0, 0);
+    if (db_spsc_ring_init(&publish_queue, PUBLISH_QUEUE_SLOTS, sizeof(publish_queue_slot_t)) != 0) {
+        LOG_SYS_STD(LOG_ERR, "DB_VIDEO_GND: Could not allocate publish queue\n");
+        exit(-1);
+    }
+    decoder->publish_queue = &publish_queue;
+    pthread_create(publish_worker, NULL, publish_thread, NULL);
+    pthread_create(fec_worker, NULL, fec_thread, decoder);
+    pin_thread(*fec_worker, 0);
+    for (int i = 0; i < num_interfaces; i++) {
+        rx_workers[i].interface = &interfaces[i];
+        rx_workers[i].adapter_no = i;
+        rx_workers[i].queue_full_cnt = 0;
+        if (db_spsc_ring_init(&rx_workers[i].queue, RX_QUEUE_SLOTS, sizeof(rx_queue_slot_t)) != 0) {
+            LOG_SYS_STD(LOG_ERR, "DB_VIDEO_GND: Could not allocate receive queue\n");
+            exit(-1);
         }
-        rbb++;
+        for (uint32_t j = 0; j <= rx_workers[i].queue.slot_mask; j++) {
+            rx_queue_slot_t *slot = (rx_queue_slot_t *) (rx_workers[i].queue.slots + j * rx_workers[i].queue.slot_size);
+            if ((slot->frame = lib_take_arena_slot(&frame_arena)) == NULL) {
+                LOG_SYS_STD(LOG_ERR, "DB_VIDEO_GND: Not enough frame slots for receive queue\n");
+                exit(-1);
+            }
+        }
+        pthread_create(&rx_workers[i].thread, NULL, receiver_thread, &rx_workers[i]);
+        pin_thread(rx_workers[i].thread, i + 1);
     }
+}
 
-    //check if we have actually found the corresponding block. this could not be the case due to a corrupt packet
-    if (i != param_block_buffers) {
-        packet_buffer_t *packet_buffer_list = rbb->packet_buffer_list;
-        packet_num = db_video_packet->video_packet_header.sequence_number % (num_data_per_block +
-                                                                             num_fec_per_block); //if retr_block_size would be limited to powers of two, this could be replace by a locical and operation
-
-        //only overwrite packets where the checksum is not yet correct. otherwise the packets are already received correctly
-        if (packet_buffer_list[packet_num].crc_correct == 0) {
-            memcpy(packet_buffer_list[packet_num].data, data + sizeof(video_packet_header_t),
-                   data_len - sizeof(video_packet_header_t));
-            packet_buffer_list[packet_num].len = (uint) (data_len - sizeof(video_packet_header_t));
-            packet_buffer_list[packet_num].valid = 1;
-            packet_buffer_list[packet_num].crc_correct = crc_correct;
-            rbb->packet_buffer_len++;
-        }
+/**
+ * Fanout worker: Receives the frames of its blocks from its socket of every adapter, decodes them and hands the data
+ * to the reorder stage
+ */
+void *fanout_worker_thread(void *arg) {
+    fanout_worker_t *worker = arg;
+    struct pollfd poll_fds[MAX_PENUMBRA_INTERFACES];
+    for (int i = 0; i < num_interfaces; i++) {
+        poll_fds[i].fd = worker->interfaces[i].selectable_fd;
+        poll_fds[i].events = POLLIN;
     }
-    // Check if we got all possible packets of a block already and decode, no need to wait for a packet of the next block to indicate
-    if (rbb->packet_buffer_len == (num_data_per_block + num_fec_per_block)) {
-        all_data_avail = true;
-        block_num++;
-        goto second_iteration_entry;
+    while (keeprunning) {
+        if (poll(poll_fds, (nfds_t) num_interfaces, THREAD_POLL_TIMEOUT_MS) <= 0)
+            continue;
+        for (int i = 0; i < num_interfaces; i++) {
+            if ((poll_fds[i].revents & POLLIN) == 0)
+                continue;
+            if (worker->interfaces[i].rx_ring != NULL)
+                process_ring(&worker->interfaces[i], &worker->decoder, i);
+            else
+                process_packet(&worker->interfaces[i], &worker->decoder, i);
+        }
     }
+    return NULL;
 }
 
 /**
- * Extracts the payload from received packet, reads radiotap header for RSSI info and forwards payload to decoding stage
+ * Publishes the slots at the head of a worker queue that do not belong to a decoded block (pass through packets)
  *
- * @param interface
- * @param block_buffer_list
- * @param adapter_no
+ * @return First slot of the queue that belongs to a block or NULL if the queue is empty
  */
-void process_packet(monitor_interface_t *interface, block_buffer_t *block_buffer_list, int adapter_no) {
-    struct ieee80211_radiotap_iterator rti;
+publish_queue_slot_t *reorder_queue_head(db_spsc_ring_t *queue) {
+    publish_queue_slot_t *slot;
+    while ((slot = db_spsc_ring_consumer_slot(queue)) != NULL && slot->block_num < 0) {
+        publish_data(slot->data, slot->length, slot->fec_decoded);
+        db_spsc_ring_pop(queue);
+    }
+    return slot;
+}
 
-    uint8_t payload_buffer[DATA_UNI_LENGTH]; // contains payload of raw protocol (video header + data = db_video_packet)
-    uint16_t radiotap_length = 0;
-    int checksum_correct = 1;
-    uint8_t current_antenna_indx = 0, seq_num_video = 0;
-    uint16_t message_length;
+/**
+ * Reorder stage of the fanout mode (publish thread): Every worker delivers its blocks in ascending order, so the next
+ * block in order is always found at the head of the queue of its worker (block_num % N). A block is skipped once its
+ * worker delivered a later block (nothing could be decoded) or after REORDER_TIMEOUT_MS without any data of its
+ * worker. Data of skipped blocks that arrives later is dropped.
+ */
+void *reorder_thread(void *arg) {
+    int next_block = -1;
+    long long stall_start = 0;
+    while (keeprunning) {
+        publish_queue_slot_t *heads[MAX_FANOUT_WORKERS];
+        int min_block = INT_MAX, min_worker = 0;
+        for (int w = 0; w < num_fanout_workers; w++) {
+            heads[w] = reorder_queue_head(&fanout_workers[w].publish_queue);
+            if (heads[w] != NULL && heads[w]->block_num < min_block) {
+                min_block = heads[w]->block_num;
+                min_worker = w;
+            }
+        }
+        if (min_block == INT_MAX) {
+            wait_for_item(&publish_queue_items, REORDER_POLL_TIMEOUT_MS);
+            continue;
+        }
+        // start of stream or the workers detected a tx restart (see process_video_payload())
+        if (next_block < 0 || next_block - min_block > 128 * num_fanout_workers) {
+            next_block = min_block;
+            // interleaved blocks complete at about the same time. Older blocks of other workers may still follow
+            if (param_block_buffers > 1)
+                next_block -= min_block % num_fanout_workers;
+        }
 
-    // receive
-    ssize_t l = recv(interface->selectable_fd, lr_buffer, MAX_DB_DATA_LENGTH, 0);
-    int err = errno;
-    if (l > 0) {
-        db_gnd_status->received_packet_cnt++;
-        message_length = get_db_payload(lr_buffer, l, payload_buffer, &seq_num_video, &radiotap_length);
-        if (pass_through) {
-            // Do not decode using FEC - pure UDP pass through, decoding of FEC must happen on following applications
-            // TODO: Implement custom protocol in case of pass_through that tells the receiver about the adapter that it was received on
-            publish_data(payload_buffer, message_length, false);
-        }
-        if (ieee80211_radiotap_iterator_init(&rti, (struct ieee80211_radiotap_header *) lr_buffer, radiotap_length,
-                                             NULL) != 0) {
-            LOG_SYS_STD(LOG_ERR, "DB_VIDEO_GND: Could not init radiotap header\n");
-            return;
+        int owner = next_block % num_fanout_workers;
+        publish_queue_slot_t *slot = heads[owner];
+        if (slot != NULL && slot->block_num == next_block) {
+            if (slot->end_of_block)
+                next_block++;
+            else
+                publish_data(slot->data, slot->length, slot->fec_decoded);
+            db_spsc_ring_pop(&fanout_workers[owner].publish_queue);
+            stall_start = 0;
+        } else if (min_block < next_block) {
+            db_spsc_ring_pop(&fanout_workers[min_worker].publish_queue);    // late data of a skipped block
+        } else if (slot != NULL) {
+            next_block++;   // worker is already past this block
+            stall_start = 0;
+        } else {
+            // other workers are ahead. Give the worker of this block some time before skipping it
+            long long now_ms = current_timestamp();
+            if (stall_start == 0) {
+                stall_start = now_ms;
+            } else if (now_ms - stall_start > REORDER_TIMEOUT_MS) {
+                next_block++;
+                stall_start = 0;
+                continue;
+            }
+            wait_for_item(&publish_queue_items, REORDER_POLL_TIMEOUT_MS);
         }
-        while ((ieee80211_radiotap_iterator_next(&rti)) == 0) {
-            switch (rti.this_arg_index) {
-                case IEEE80211_RADIOTAP_RATE:
-                    db_gnd_status->adapter[adapter_no].rate = (*rti.this_arg);
-                    break;
-                case IEEE80211_RADIOTAP_ANTENNA:
-                    current_antenna_indx = (*rti.this_arg);
-                    break;
-                case IEEE80211_RADIOTAP_FLAGS:
-                    checksum_correct = (*rti.this_arg & IEEE80211_RADIOTAP_F_BADFCS) == 0;
-                    break;
-                case IEEE80211_RADIOTAP_LOCK_QUALITY:
-                    db_gnd_status->adapter[adapter_no].lock_quality = (*rti.this_arg);
-                case IEEE80211_RADIOTAP_DBM_ANTSIGNAL:
-                    if (current_antenna_indx == 0) // first occurrence in header will be general RSSI
-                        db_gnd_status->adapter[adapter_no].current_signal_dbm = (int8_t) (*rti.this_arg);
-                    if (current_antenna_indx <= MAX_ANTENNA_CNT)
-                        db_gnd_status->adapter[adapter_no].ant_signal_dbm[current_antenna_indx] = (int8_t) (*rti.this_arg);
-                    break;
-                default:
-                    break;
+    }
+    return NULL;
+}
+
+/**
+ * Allocates the block buffers of a decoder from the frame arena
+ *
+ * @param decoder
+ * @param plans Radiotap parse plans of the adapters if the thread of the decoder receives the frames itself, else NULL
+ * @param block_step Distance between the blocks the decoder gets to see. 1 or the number of fanout workers
+ */
+void init_decoder(video_decoder_t *decoder, db_rt_plan_t *plans, int block_step) {
+    //block buffers contain both the block_num as well as packet buffers for a block.
+    decoder->block_buffer_list = malloc(sizeof(block_buffer_t) * param_block_buffers);
+    for (int i = 0; i < param_block_buffers; ++i) {
+        decoder->block_buffer_list[i].packet_buffer_list = lib_alloc_arena_packet_buffer_list(
+                &frame_arena, num_data_per_block + num_fec_per_block);
+    }
+    block_buffer_list_reset(decoder->block_buffer_list, param_block_buffers);
+    decoder->max_block_num = -1;
+    decoder->retired_block_num = -1;
+    decoder->block_step = block_step;
+    decoder->radiotap_plans = plans;
+    decoder->rx_slot = plans != NULL ? lib_take_arena_slot(&frame_arena) : NULL;
+    decoder->publish_queue = NULL;
+    decoder->publish_block_num = -1;
+    decoder->recorder_ring = 0;
+}
+
+/**
+ * Replay mode (-R): Feeds the radiotap frames of capture files through the same path as received frames
+ * (parse_frame() -> process_video_payload()). Every file is replayed as one adapter and the frames of all files are
+ * merged by their time stamps. A single pcapng file with multiple interfaces (e.g. a flight recording) replays every
+ * interface as one adapter. Reports decode throughput, CPU time per frame and the status counters when done.
+ *
+ * @param decoder Decoder of the main thread
+ */
+void replay_captures(video_decoder_t *decoder) {
+    db_pcap_reader_t readers[DB_MAX_ADAPTERS];
+    db_pcap_frame_t frames[DB_MAX_ADAPTERS];
+    bool pending[DB_MAX_ADAPTERS];
+    for (int f = 0; f < num_replay_files; f++) {
+        if (db_pcap_open(&readers[f], replay_files[f]) < 0)
+            exit(-1);
+        pending[f] = db_pcap_next(&readers[f], &frames[f]) > 0;
+    }
+    uint64_t first_timestamp = UINT64_MAX, frame_cnt = 0, byte_cnt = 0, process_ns = 0;
+    for (int f = 0; f < num_replay_files; f++) {
+        if (pending[f] && frames[f].timestamp_ns < first_timestamp)
+            first_timestamp = frames[f].timestamp_ns;
+    }
+    struct timespec cpu_start, cpu_end;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_start);
+    uint64_t start = current_timestamp_ns();
+    while (keeprunning) {
+        int next = -1;
+        for (int f = 0; f < num_replay_files; f++) {
+            if (pending[f] && (next < 0 || frames[f].timestamp_ns < frames[next].timestamp_ns))
+                next = f;
+        }
+        if (next < 0)
+            break;
+        db_pcap_frame_t *frame = &frames[next];
+        if (replay_speed > 0 && frame->timestamp_ns > first_timestamp) {
+            uint64_t due = start + (uint64_t) ((double) (frame->timestamp_ns - first_timestamp) / replay_speed);
+            uint64_t now_ns = current_timestamp_ns();
+            if (due > now_ns) {
+                struct timespec ts = {.tv_sec = (time_t) ((due - now_ns) / 1000000000ULL),
+                                      .tv_nsec = (long) ((due - now_ns) % 1000000000ULL)};
+                nanosleep(&ts, NULL);
+            }
+        }
+        int adapter_no = num_replay_files == 1 ? (int) frame->interface_id : next;
+        if (adapter_no < DB_MAX_ADAPTERS && frame->length <= MAX_PACKET_LENGTH) {
+            if ((uint32_t) adapter_no >= db_gnd_status->wifi_adapter_cnt) {
+                memset(&db_gnd_status->adapter[adapter_no], 0, sizeof(db_adapter_status));
+                snprintf(db_gnd_status->adapter[adapter_no].name, IFNAMSIZ, "if%i", adapter_no);
+                db_gnd_status->wifi_adapter_cnt = (uint32_t) adapter_no + 1;
             }
+            // frame is received into the arena slot like with recv() since the decoder might keep the slot
+            memcpy(decoder->rx_slot, frame->data, frame->length);
+            uint64_t process_start = current_timestamp_ns();
+            process_frame(decoder->rx_slot, frame->length, decoder, adapter_no, &decoder->rx_slot);
+            process_ns += current_timestamp_ns() - process_start;
+            frame_cnt++;
+            byte_cnt += frame->length;
         }
-        db_gnd_status->adapter[adapter_no].num_antennas = (uint8_t) (current_antenna_indx + 1);
-        if (!checksum_correct)
-            db_gnd_status->adapter[adapter_no].wrong_crc_cnt++;
-        db_gnd_status->adapter[adapter_no].received_packet_cnt++;
+        int ret = db_pcap_next(&readers[next], frame);
+        pending[next] = ret > 0;
+        if (ret < 0)
+            LOG_SYS_STD(LOG_ERR, "DB_VIDEO_GND: Stopped replay of %s\n", replay_files[next]);
+    }
+    uint64_t wall_ns = current_timestamp_ns() - start;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_end);
+    uint64_t cpu_ns = (uint64_t) (cpu_end.tv_sec - cpu_start.tv_sec) * 1000000000ULL +
+                      (uint64_t) (cpu_end.tv_nsec - cpu_start.tv_nsec);
+    uint32_t skipped_cnt = 0;
+    for (int f = 0; f < num_replay_files; f++) {
+        skipped_cnt += readers[f].skipped_cnt;
+        db_pcap_close(&readers[f]);
+    }
+    if (frame_cnt == 0) {
+        LOG_SYS_STD(LOG_NOTICE, "DB_VIDEO_GND: No radiotap frames found in the capture files\n");
+        return;
+    }
+    LOG_SYS_STD(LOG_NOTICE, "DB_VIDEO_GND: Replayed %llu frames (%llu bytes, %u skipped) in %.3f s\n",
+                (unsigned long long) frame_cnt, (unsigned long long) byte_cnt, skipped_cnt, wall_ns / 1e9);
+    LOG_SYS_STD(LOG_NOTICE, "DB_VIDEO_GND: Receive path %.1f ns/frame (%.1f Mbit/s), CPU %.1f ns/frame incl. file "
+                            "reading\n", (double) process_ns / frame_cnt,
+                process_ns > 0 ? byte_cnt * 8e3 / process_ns : 0.0, (double) cpu_ns / frame_cnt);
+    LOG_SYS_STD(LOG_NOTICE, "DB_VIDEO_GND: Packets received %u, lost %u, max. lost per block %u | Blocks received %u, "
+                            "damaged %u | TX restarts %u | FEC inverse cache hits %u, misses %u\n",
+                db_gnd_status->received_packet_cnt, db_gnd_status->lost_packet_cnt,
+                db_gnd_status->lost_per_block_cnt, db_gnd_status->received_block_cnt,
+                db_gnd_status->damaged_block_cnt, db_gnd_status->tx_restart_cnt,
+                db_gnd_status->fec_inv_cache_hit_cnt, db_gnd_status->fec_inv_cache_miss_cnt);
+    LOG_SYS_STD(LOG_NOTICE, "DB_VIDEO_GND: Blocks released early %u, late packets %u, avg. block release %u us\n",
+                db_gnd_status->early_release_cnt, db_gnd_status->late_packet_cnt, db_gnd_status->block_release_us);
+    for (uint32_t a = 0; a < db_gnd_status->wifi_adapter_cnt && a < DB_MAX_ADAPTERS; a++)
+        LOG_SYS_STD(LOG_NOTICE, "DB_VIDEO_GND: \t%s: %u frames, %u bad FCS, %i dBm\n", db_gnd_status->adapter[a].name,
+                    db_gnd_status->adapter[a].received_packet_cnt, db_gnd_status->adapter[a].wrong_crc_cnt,
+                    db_gnd_status->adapter[a].current_signal_dbm);
+}
 
-        db_gnd_status->last_update = time(NULL);
-        process_video_payload(payload_buffer, message_length, checksum_correct, block_buffer_list);
-    } else {
-        LOG_SYS_STD(LOG_ERR, "DB_VIDEO_GND: Received an error: %s\n", strerror(err));
+/**
+ * Fanout mode: Opens one socket per worker on every adapter and joins the sockets of an adapter to a PACKET_FANOUT
+ * group. A hash or CPU based fanout would spread the packets of one block over several workers. Instead a classic BPF
+ * program reads the sequence number of the video packet and returns (sequence_number / (k + m)) % N, so every worker
+ * receives all packets of its blocks. The payload offset is estimated from the frame length like in
+ * get_db_payload_pointer(). Bytes are addressed relative to the link layer header (SKF_LL_OFF) since the program runs
+ * before the kernel hands the frame to the socket.
+ *
+ * @param adapter_no
+ * @return 0 on success or -1 on failure
+ */
+int open_fanout_sockets(int adapter_no) {
+    const uint32_t ll = (uint32_t) SKF_LL_OFF;
+    struct sock_filter steering[] = {
+            BPF_STMT(BPF_LD | BPF_B | BPF_ABS, ll + 3),         // radiotap length (LE16)
+            BPF_STMT(BPF_ALU | BPF_LSH | BPF_K, 8),
+            BPF_STMT(BPF_MISC | BPF_TAX, 0),
+            BPF_STMT(BPF_LD | BPF_B | BPF_ABS, ll + 2),
+            BPF_STMT(BPF_ALU | BPF_OR | BPF_X, 0),
+            BPF_STMT(BPF_ST, 0),                                // M[0] = radiotap length
+            BPF_STMT(BPF_MISC | BPF_TAX, 0),
+            BPF_STMT(BPF_LD | BPF_B | BPF_IND, ll + 8),         // payload length of DB raw v2 header (LE16)
+            BPF_STMT(BPF_ALU | BPF_LSH | BPF_K, 8),
+            BPF_STMT(BPF_ST, 1),
+            BPF_STMT(BPF_LD | BPF_B | BPF_IND, ll + 7),
+            BPF_STMT(BPF_LDX | BPF_MEM, 1),
+            BPF_STMT(BPF_ALU | BPF_OR | BPF_X, 0),
+            BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, 4),             // frame may contain the FCS
+            BPF_STMT(BPF_ST, 1),                                // M[1] = payload length + 4
+            BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0),
+            BPF_STMT(BPF_LDX | BPF_MEM, 0),
+            BPF_STMT(BPF_ALU | BPF_SUB | BPF_X, 0),
+            BPF_STMT(BPF_ALU | BPF_SUB | BPF_K, DB_RAW_V2_HEADER_LENGTH),
+            BPF_STMT(BPF_LDX | BPF_MEM, 1),
+            BPF_JUMP(BPF_JMP | BPF_JGT | BPF_X, 0, 0, 3),      // longer than payload: sent with DB_RAW_OFFSET
+            BPF_STMT(BPF_LD | BPF_MEM, 0),
+            BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, DB_RAW_V2_HEADER_LENGTH + DB_RAW_OFFSET),
+            BPF_JUMP(BPF_JMP | BPF_JA, 2, 0, 0),
+            BPF_STMT(BPF_LD | BPF_MEM, 0),
+            BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, DB_RAW_V2_HEADER_LENGTH),
+            BPF_STMT(BPF_ST, 2),                                // M[2] = offset of db_video_packet_t
+            BPF_STMT(BPF_MISC | BPF_TAX, 0),
+            BPF_STMT(BPF_LD | BPF_B | BPF_IND, ll + 3),         // sequence number (LE32)
+            BPF_STMT(BPF_ALU | BPF_LSH | BPF_K, 8),
+            BPF_STMT(BPF_ST, 3),
+            BPF_STMT(BPF_LD | BPF_B | BPF_IND, ll + 2),
+            BPF_STMT(BPF_LDX | BPF_MEM, 3),
+            BPF_STMT(BPF_ALU | BPF_OR | BPF_X, 0),
+            BPF_STMT(BPF_ALU | BPF_LSH | BPF_K, 8),
+            BPF_STMT(BPF_ST, 3),
+            BPF_STMT(BPF_LDX | BPF_MEM, 2),
+            BPF_STMT(BPF_LD | BPF_B | BPF_IND, ll + 1),
+            BPF_STMT(BPF_LDX | BPF_MEM, 3),
+            BPF_STMT(BPF_ALU | BPF_OR | BPF_X, 0),
+            BPF_STMT(BPF_ALU | BPF_LSH | BPF_K, 8),
+            BPF_STMT(BPF_ST, 3),
+            BPF_STMT(BPF_LDX | BPF_MEM, 2),
+            BPF_STMT(BPF_LD | BPF_B | BPF_IND, ll),
+            BPF_STMT(BPF_LDX | BPF_MEM, 3),
+            BPF_STMT(BPF_ALU | BPF_OR | BPF_X, 0),
+            BPF_STMT(BPF_ALU | BPF_DIV | BPF_K, num_data_per_block + num_fec_per_block),    // block number
+            BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, (uint32_t) num_fanout_workers),
+            BPF_STMT(BPF_RET | BPF_A, 0),
+    };
+    struct sock_fprog steering_program = {.len = sizeof(steering) / sizeof(steering[0]), .filter = steering};
+    uint16_t group_id = 0;
+    for (int w = 0; w < num_fanout_workers; w++) {
+        db_socket_t db_sock = open_db_socket(adapters[adapter_no], comm_id, 'm', 11, DB_DIREC_DRONE, DB_PORT_VIDEO,
+                                             DB_FRAMETYPE_DATA);
+        if (db_sock.db_socket < 0)
+            return -1;
+        if (use_rx_ring)
+            db_socket_enable_rx_ring(&db_sock, DB_RX_RING_BLOCK_SIZE, DB_RX_RING_BLOCK_NR);
+        // sockets get their index in the group in the order they join. Worker w must join as w-th socket
+        if (db_socket_join_fanout(&db_sock, &group_id, &steering_program) < 0)
+            return -1;
+        fanout_workers[w].interfaces[adapter_no].selectable_fd = db_sock.db_socket;
+        fanout_workers[w].interfaces[adapter_no].rx_ring = db_sock.rx_ring;
+        fanout_workers[w].interfaces[adapter_no].db_sock = db_sock;
+    }
+    return 0;
+}
+
+/**
+ * Fanout mode: Starts the pinned workers and the reorder stage
+ *
+ * @param publish_worker Returns the reorder thread
+ */
+void start_fanout_workers(pthread_t *publish_worker) {
+    sem_init(&publish_queue_items, 0, 0);
+    for (int w = 0; w < num_fanout_workers; w++) {
+        if (db_spsc_ring_init(&fanout_workers[w].publish_queue, PUBLISH_QUEUE_SLOTS, sizeof(publish_queue_slot_t)) != 0) {
+            LOG_SYS_STD(LOG_ERR, "DB_VIDEO_GND: Could not allocate publish queue\n");
+            exit(-1);
+        }
+        init_decoder(&fanout_workers[w].decoder, fanout_workers[w].radiotap_plans, num_fanout_workers);
+        fanout_workers[w].decoder.publish_queue = &fanout_workers[w].publish_queue;
+        fanout_workers[w].decoder.recorder_ring = w;
+    }
+    pthread_create(publish_worker, NULL, reorder_thread, NULL);
+    for (int w = 0; w < num_fanout_workers; w++) {
+        pthread_create(&fanout_workers[w].thread, NULL, fanout_worker_thread, &fanout_workers[w]);
+        pin_thread(fanout_workers[w].thread, w);
     }
 }
 
 void process_command_line_args(int argc, char *argv[]) {
     num_interfaces = 0, comm_id = DEFAULT_V2_COMMID, pass_through = false, udp_enabled = true, send_to_std_out = true;
     num_data_per_block = 8, num_fec_per_block = 4, pack_size = 1024, dest_port_video = APP_PORT_VIDEO;
+    use_rx_ring = false, use_threads = false, num_fanout_workers = 0;
     int c;
-    while ((c = getopt(argc, argv, "n:c:r:f:p:d:u:v:i:os")) != -1) {
+    while ((c = getopt(argc, argv, "n:c:r:f:p:d:u:v:i:w:R:S:C:F:I:osmt")) != -1) {
         switch (c) {
             case 'n':
                 strncpy(adapters[num_interfaces], optarg, IFNAMSIZ);
@@ -519,6 +1468,31 @@ void process_command_line_args(int argc, char *argv[]) {
             case 's':
                 send_to_std_out = false;
                 break;
+            case 'm':
+                use_rx_ring = true;
+                break;
+            case 't':
+                use_threads = true;
+                break;
+            case 'w':
+                num_fanout_workers = (int) strtol(optarg, NULL, 10);
+                break;
+            case 'R':
+                if (num_replay_files < DB_MAX_ADAPTERS)
+                    replay_files[num_replay_files++] = optarg;
+                break;
+            case 'S':
+                replay_speed = strtod(optarg, NULL);
+                break;
+            case 'C':
+                recorder_dir = optarg;
+                break;
+            case 'F':
+                feedback_interval_ms = (unsigned int) strtol(optarg, NULL, 10);
+                break;
+            case 'I':
+                param_block_buffers = (int) strtol(optarg, NULL, 10);
+                break;
             default:
                 printf("Based of Wifibroadcast by befinitiv, based on packet spammer by Andy Green.  Licensed under GPL2\n"
                        "This tool takes a data stream via the DroneBridge long range video port and outputs it via stdout, "
@@ -527,7 +1501,8 @@ void process_command_line_args(int argc, char *argv[]) {
                        "\n\n\t-n Name of a network interface that should be used to receive the stream. Must be in monitor "
                        "mode. Multiple interfaces supported by calling this option multiple times (-n inter1 -n inter2 -n interx)"
                        "\n\t-c <communication id> Choose a number from 0-255. Same on ground station and UAV!."
-                       "\n\t-d Number of data packets in a block (default 8). Needs to match with tx."
+                       "\n\t-d Number of data packets in a block (default 8). Needs to match with tx. Blocks flushed "
+                       "early by the UAV (video_air -l) carry less"
                        "\n\t-r Number of FEC packets per block (default 4). Needs to match with tx."
                        "\n\t-f Bytes per packet (default %d. max %d). This is also the FEC "
                        "block size. Needs to match with tx."
@@ -536,7 +1511,21 @@ void process_command_line_args(int argc, char *argv[]) {
                        "\n\t-v Destination port of video stream when set via UDP"
                        "\n\t-p <Y|N> to enable/disable pass through of encoded FEC packets via UDP to port: %i"
                        "\n\t-o Send to output to unix domain socket at %s so that DroneBridge USBBridge can forward it"
-                       "\n\t-s Disable decoded output to stdout",
+                       "\n\t-s Disable decoded output to stdout"
+                       "\n\t-m Receive via PACKET_MMAP ring (TPACKET_V3) instead of recv() to save syscalls and copies"
+                       "\n\t-t Multithreaded: One receiver thread per adapter (pinned to a core), one thread for FEC "
+                       "decoding and one thread for the outputs"
+                       "\n\t-w <workers> Fanout: Spread the blocks over N pinned worker threads that receive and decode "
+                       "them in parallel (PACKET_FANOUT). Output keeps the block order. Overrides -t"
+                       "\n\t-R <file> Replay mode: Decode the frames of a pcap/pcapng capture (radiotap) instead of "
+                       "receiving. Every file is one adapter (-R file1 -R file2). Reports throughput & CPU time per frame"
+                       "\n\t-S <factor> Replay speed: 1 = original timing (default), 4 = four times faster, 0 = as "
+                       "fast as possible"
+                       "\n\t-C <dir> Flight recorder: Write all received frames to rotating pcapng files in <dir>"
+                       "\n\t-F <ms> Adaptive FEC: Send loss reports to the UAV every <ms> milliseconds so that video_air "
+                       "can adjust the FEC packets per block (see -F of video_air). Default: 0 = disabled"
+                       "\n\t-I <depth> Interleaver depth. Needs to match with tx (video_air -I). Keeps <depth> blocks "
+                       "in the reassembly window. Default: 1 = no interleaving",
                        1024, MAX_USER_PACKET_LENGTH, APP_PORT_VIDEO_FEC, DB_UNIX_DOMAIN_VIDEO_PATH);
                 abort();
         }
@@ -552,13 +1541,34 @@ int main(int argc, char *argv[]) {
     int i;
     struct sockaddr_in udp_video_hint_src;
     uint8_t udp_buff[UDP_BUFF_SIZE];
-    block_buffer_t *block_buffer_list;
+    video_decoder_t decoder;
 
     process_command_line_args(argc, argv);
+    if (num_replay_files > 0) {
+        // capture files replace the adapters. Frames are processed by the main thread
+        num_interfaces = num_replay_files;
+        num_fanout_workers = 0;
+        use_threads = false;
+        for (int j = 0; j < num_replay_files; j++) {
+            const char *file_name = strrchr(replay_files[j], '/');
+            snprintf(adapters[j], IFNAMSIZ, "%s", file_name != NULL ? file_name + 1 : replay_files[j]);
+        }
+    }
     if (num_interfaces == 0) {
         LOG_SYS_STD(LOG_ERR, "DB_VIDEO_GND: No interface specified. Aborting\n");
         abort();
     }
+    if (param_block_buffers < 1 || param_block_buffers > MAX_INTERLEAVE_DEPTH) {
+        LOG_SYS_STD(LOG_ERR, "DB_VIDEO_GND: Interleaver depth must be between 1 and %d\n", MAX_INTERLEAVE_DEPTH);
+        abort();
+    }
+    if (num_fanout_workers < 0 || num_fanout_workers > MAX_FANOUT_WORKERS) {
+        LOG_SYS_STD(LOG_ERR, "DB_VIDEO_GND: Number of fanout workers is limited to %d\n", MAX_FANOUT_WORKERS);
+        abort();
+    }
+    if (num_fanout_workers > 0)
+        use_threads = false;
+    bool adapters_threaded = use_threads || num_fanout_workers > 0;  // adapters are served by other threads
 
     if (pack_size > MAX_USER_PACKET_LENGTH) {
         LOG_SYS_STD(LOG_ERR, "Packet length is limited to %d bytes (you requested %d bytes)\n", MAX_USER_PACKET_LENGTH,
@@ -567,6 +1577,7 @@ int main(int argc, char *argv[]) {
     }
 
     fec_init();
+    LOG_SYS_STD(LOG_NOTICE, "DB_VIDEO_GND: Using %s GF(256) kernel\n", gf256_kernel_name());
     init_outputs();
     if (fixed_ip && udp_enabled) {
         LOG_SYS_STD(LOG_NOTICE, "DB_VIDEO_GND: Sending to %s\n", overwrite_ip);
@@ -581,12 +1592,36 @@ int main(int argc, char *argv[]) {
     db_gnd_status->received_block_cnt = 0;
     db_gnd_status->damaged_block_cnt = 0;
     db_gnd_status->tx_restart_cnt = 0;
+    db_gnd_status->fec_inv_cache_hit_cnt = 0;
+    db_gnd_status->fec_inv_cache_miss_cnt = 0;
+    db_gnd_status->recorder_overrun_cnt = 0;
+    db_gnd_status->early_release_cnt = 0;
+    db_gnd_status->late_packet_cnt = 0;
+    db_gnd_status->block_release_us = 0;
 
     // init DroneBridge raw sockets to listen for incoming data
     for (int j = 0; j < num_interfaces; ++j) {
-        db_socket_t db_sock = open_db_socket(adapters[j], comm_id, 'm', 11, DB_DIREC_DRONE, DB_PORT_VIDEO,
-                                             DB_FRAMETYPE_DATA);
-        interfaces[j].selectable_fd = db_sock.db_socket;
+        if (num_replay_files > 0) {
+            interfaces[j].selectable_fd = -1;
+            interfaces[j].rx_ring = NULL;
+            interfaces[j].db_sock.db_socket = -1;
+            feedback_sockets[j] = NULL;
+        } else if (num_fanout_workers > 0) {
+            if (open_fanout_sockets(j) < 0) {
+                LOG_SYS_STD(LOG_ERR, "DB_VIDEO_GND: Could not set up fanout on %s\n", adapters[j]);
+                exit(-1);
+            }
+            feedback_sockets[j] = &fanout_workers[0].interfaces[j].db_sock;
+        } else {
+            db_socket_t db_sock = open_db_socket(adapters[j], comm_id, 'm', 11, DB_DIREC_DRONE, DB_PORT_VIDEO,
+                                                 DB_FRAMETYPE_DATA);
+            if (use_rx_ring)
+                db_socket_enable_rx_ring(&db_sock, DB_RX_RING_BLOCK_SIZE, DB_RX_RING_BLOCK_NR);
+            interfaces[j].selectable_fd = db_sock.db_socket;
+            interfaces[j].rx_ring = db_sock.rx_ring;
+            interfaces[j].db_sock = db_sock;
+            feedback_sockets[j] = &interfaces[j].db_sock;
+        }
         strcpy(db_gnd_status->adapter[j].name, adapters[j]);
         LOG_SYS_STD(LOG_NOTICE, "\t%s\n", db_gnd_status->adapter[j].name);
         db_gnd_status->adapter[j].received_packet_cnt = 0;
@@ -605,30 +1640,55 @@ int main(int argc, char *argv[]) {
     strcpy(unix_socket_addr.sun_path, DB_UNIX_DOMAIN_VIDEO_PATH);
     // UDP server socket to receive video dst hints
 
-    //block buffers contain both the block_num as well as packet buffers for a block.
-    block_buffer_list = malloc(sizeof(block_buffer_t) * param_block_buffers);
-    for (i = 0; i < param_block_buffers; ++i) {
-        block_buffer_list[i].block_num = -1;
-        block_buffer_list[i].packet_buffer_len = 0;
-        block_buffer_list[i].packet_buffer_list = lib_alloc_packet_buffer_list(num_data_per_block + num_fec_per_block,
-                                                                               MAX_PACKET_LENGTH);
+    // One slot per packet of every block buffer plus the slots frames get received into. Received packets are not
+    // copied into their block: the slot they were received into is swapped with the slot of the packet buffer
+    size_t decoder_slots = (size_t) param_block_buffers * (num_data_per_block + num_fec_per_block);
+    size_t arena_slots = decoder_slots + (use_threads ? (size_t) num_interfaces * RX_QUEUE_SLOTS : 1);
+    if (num_fanout_workers > 0)
+        arena_slots = (size_t) num_fanout_workers * (decoder_slots + 1);
+    if (lib_init_slot_arena(&frame_arena, arena_slots, MAX_PACKET_LENGTH) != 0) {
+        LOG_SYS_STD(LOG_ERR, "DB_VIDEO_GND: Could not allocate frame buffers\n");
+        exit(-1);
+    }
+
+    if (recorder_dir != NULL) {
+        // every thread that receives frames records into its own ring
+        int recorder_rings = num_fanout_workers > 0 ? num_fanout_workers : num_interfaces;
+        if ((recorder = db_recorder_open(recorder_dir, "video", adapters, num_interfaces, recorder_rings)) == NULL)
+            exit(-1);
+    }
+
+    pthread_t fec_worker, publish_worker;
+    if (num_fanout_workers > 0) {
+        start_fanout_workers(&publish_worker);
+    } else {
+        init_decoder(&decoder, use_threads ? NULL : radiotap_plans, 1);
+        if (use_threads)
+            start_threads(interfaces, &decoder, &fec_worker, &publish_worker);
     }
 
     LOG_SYS_STD(LOG_NOTICE, "DB_VIDEO_GND: started on %i interfaces\n", num_interfaces);
+    if (num_replay_files > 0) {
+        replay_captures(&decoder);
+        keeprunning = false;
+    }
     fd_set readset;
+    struct timeval select_timeout;
     unsigned int client_address_size = sizeof(udp_video_hint_src);
     while (keeprunning) {
         FD_ZERO(&readset);
 
         int max_sd = udp_socket;
         FD_SET(udp_socket, &readset);
-        for (i = 0; i < num_interfaces; i++) {
+        for (i = 0; i < num_interfaces && !adapters_threaded; i++) {
             FD_SET(interfaces[i].selectable_fd, &readset);
             if (interfaces[i].selectable_fd > max_sd)
                 max_sd = interfaces[i].selectable_fd;
         }
+        select_timeout.tv_sec = 1;
+        select_timeout.tv_usec = 0;
 
-        int select_return = select(max_sd + 1, &readset, NULL, NULL, NULL);
+        int select_return = select(max_sd + 1, &readset, NULL, NULL, adapters_threaded ? &select_timeout : NULL);
         if (select_return == -1 && errno != EINTR) {
             perror("DB_VIDEO_GND: select() returned error: ");
         } else if (select_return > 0) {
@@ -643,17 +1703,40 @@ int main(int argc, char *argv[]) {
                 } else
                     perror("DB_VIDEO_GND: Error receiving on UDP socket: ");
             }
-            for (i = 0; i < num_interfaces; i++) {
+            for (i = 0; i < num_interfaces && !adapters_threaded; i++) {
                 if (FD_ISSET(interfaces[i].selectable_fd, &readset)) {
-                    process_packet(&interfaces[i], block_buffer_list, i);
+                    if (interfaces[i].rx_ring != NULL)
+                        process_ring(&interfaces[i], &decoder, i);
+                    else
+                        process_packet(&interfaces[i], &decoder, i);
                 }
             }
         }
     }
 
-    for (int g = 0; i < num_interfaces; ++i) {
-        close(interfaces[g].selectable_fd);
+    if (use_threads) {
+        pthread_join(fec_worker, NULL);
+        pthread_join(publish_worker, NULL);
+        for (i = 0; i < num_interfaces; i++)
+            pthread_join(rx_workers[i].thread, NULL);
+    }
+    if (num_fanout_workers > 0) {
+        pthread_join(publish_worker, NULL);
+        for (int w = 0; w < num_fanout_workers; w++) {
+            pthread_join(fanout_workers[w].thread, NULL);
+            for (i = 0; i < num_interfaces; i++) {
+                if (fanout_workers[w].interfaces[i].rx_ring != NULL)
+                    close_rx_ring(fanout_workers[w].interfaces[i].rx_ring);
+                close_db_socket(&fanout_workers[w].interfaces[i].db_sock);
+            }
+        }
+    }
+    for (int g = 0; g < num_interfaces && num_fanout_workers == 0; ++g) {
+        if (interfaces[g].rx_ring != NULL)
+            close_rx_ring(interfaces[g].rx_ring);
+        close_db_socket(&interfaces[g].db_sock);
     }
+    db_recorder_close(recorder);
     unlink(DB_UNIX_DOMAIN_VIDEO_PATH);
     close(unix_sock);
     if (udp_enabled) close(udp_socket);